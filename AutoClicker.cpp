@@ -1,66 +1,492 @@
 #include "AutoClicker.h"
+#include "ClickHumanizer.h"
+#include "Clock.h"
+#include "InputLog.h"
+#include "PixelTrigger.h"
+#include "ScreenCapture.h"
+#include "WorkStealingPool.h"
 
-AutoClicker::AutoClicker() : running(false), clickCount(0) {}
+#include <algorithm>
+#include <climits>
 
-AutoClicker::~AutoClicker() { Stop(); }
+AutoClicker::AutoClicker() : AutoClicker(CreateDefaultInputSink()) {}
+
+AutoClicker::AutoClicker(std::unique_ptr<InputSink> sink)
+    : running(false), clickCount(0), pendingRun(RunMode::None), busy(false),
+      shuttingDown(false), inputSink(std::move(sink)), nextHumanizer(nullptr),
+      retiredHumanizer(nullptr), defaultScreenSource(true) {
+  scheduler.SetWakeSignal(&wake);
+  workerThread = std::thread(&AutoClicker::WorkerThread, this);
+}
+
+AutoClicker::~AutoClicker() {
+  Stop();
+  {
+    std::lock_guard<std::mutex> guard(controlLock);
+    shuttingDown = true;
+  }
+  controlChanged.notify_all();
+  workerThread.join();
+  delete nextHumanizer.exchange(nullptr);
+  delete retiredHumanizer.exchange(nullptr);
+}
 
 void AutoClicker::Start(const ClickSettings &settings) {
-  if (running)
+  std::lock_guard<std::mutex> command(commandLock);
+  StartLocked(settings);
+}
+
+void AutoClicker::StartLocked(const ClickSettings &settings) {
+  if (running || !inputSink)
     return;
 
+  // A macro or replay that ran to completion may still be saving its
+  // statistics; that takes microseconds.
+  std::unique_lock<std::mutex> lock(controlLock);
+  controlChanged.wait(lock, [this] { return !busy; });
+
   currentSettings = settings;
+  // Histogram files are read here, not on the worker. One that cannot be
+  // used leaves that part of the click fixed.
+  std::string error;
+  humanizer.reset(new ClickHumanizer());
+  humanizer->Build(currentSettings, error);
+  detectionTime.Reset(); // Only the pixel trigger records into it
+
+  // Same for the trigger's template image. A trigger that cannot run leaves
+  // the clicker on its timer.
+  const PixelTrigger trigger = PixelTrigger::FromSettings(currentSettings);
+  watcher.reset();
+  if (trigger.mode != PixelTriggerMode::Off && !screenSource &&
+      defaultScreenSource) {
+    screenSource = CreateDefaultScreenSource();
+    defaultScreenSource = false;
+  }
+  if (trigger.mode != PixelTriggerMode::Off && screenSource && !macro &&
+      replayPath.empty()) {
+    if (trigger.mode == PixelTriggerMode::Template && !searchPool)
+      searchPool.reset(new WorkStealingPool());
+    watcher.reset(new PixelWatcher(trigger));
+    if (!watcher->Prepare(searchPool.get(), error))
+      watcher.reset();
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(publishLock);
+    delete nextHumanizer.exchange(nullptr);
+    delete retiredHumanizer.exchange(nullptr);
+    liveSettings.Store(currentSettings);
+  }
+
+  if (!replayPath.empty())
+    pendingRun = RunMode::Replay;
+  else if (watcher)
+    pendingRun = RunMode::Trigger;
+  else
+    pendingRun = macro ? RunMode::Macro : RunMode::Click;
+  busy = true;
   running = true;
-  workerThread = std::thread(&AutoClicker::ClickThread, this);
+  lock.unlock();
+  controlChanged.notify_all();
 }
 
-void AutoClicker::Stop() {
+void AutoClicker::UpdateSettings(const ClickSettings &settings) {
+  std::lock_guard<std::mutex> guard(publishLock);
   if (!running)
     return;
 
+  // The humanizer bakes in interval and position, so every update gets a new
+  // one. It goes out before the settings: a worker that sees the new version
+  // also finds its humanizer.
+  std::string error;
+  ClickHumanizer *next = new ClickHumanizer();
+  next->Build(settings, error);
+  delete retiredHumanizer.exchange(nullptr);
+  delete nextHumanizer.exchange(next); // One the worker never took
+  liveSettings.Store(settings);
+  wake.Notify();
+}
+
+void AutoClicker::Stop() {
+  std::lock_guard<std::mutex> command(commandLock);
+  StopLocked();
+}
+
+void AutoClicker::StopLocked() {
+  // Cuts the worker's current wait short; it then sees `running` and ends
+  // the run after at most the injection call in progress.
   running = false;
-  if (workerThread.joinable()) {
-    workerThread.join();
+  wake.Notify();
+  std::unique_lock<std::mutex> lock(controlLock);
+  controlChanged.wait(lock, [this] { return !busy; });
+}
+
+void AutoClicker::WorkerThread() {
+  RealTimeScope realTime;
+  std::unique_lock<std::mutex> lock(controlLock);
+  for (;;) {
+    controlChanged.wait(lock, [this] {
+      return shuttingDown || pendingRun != RunMode::None;
+    });
+    if (shuttingDown)
+      return;
+    const RunMode mode = pendingRun;
+    pendingRun = RunMode::None;
+    // Applied on this thread for this run only; a denied step just leaves
+    // the worker as it was.
+    if (currentSettings.realTime)
+      realTimeStatus = realTime.Enter(currentSettings.realTimeCpu);
+    else
+      realTimeStatus = RealTimeStatus();
+    lock.unlock();
+
+    // A Stop() that raced with this Start() already cleared `running`, so
+    // dropping its notification here is harmless.
+    wake.Reset();
+    switch (mode) {
+    case RunMode::Click:
+      ClickLoop();
+      break;
+    case RunMode::Macro:
+      MacroLoop();
+      break;
+    case RunMode::Replay:
+      ReplayLoop();
+      break;
+    case RunMode::Trigger:
+      TriggerLoop();
+      break;
+    default:
+      break;
+    }
+    // Published before `running` drops, for callers that poll IsRunning()
+    // and then read the stats.
+    const SchedulerStats stats = scheduler.GetStats();
+    lock.lock();
+    lastRunStats = stats;
+    lock.unlock();
+    running = false;
+    realTime.Leave();
+
+    lock.lock();
+    busy = false;
+    controlChanged.notify_all();
   }
 }
 
 bool AutoClicker::IsRunning() const { return running; }
 
 void AutoClicker::Toggle(const ClickSettings &settings) {
-  if (running) {
-    Stop();
-  } else {
-    Start(settings);
-  }
+  std::lock_guard<std::mutex> command(commandLock);
+  if (running)
+    StopLocked();
+  else
+    StartLocked(settings);
+}
+
+void AutoClicker::SetInputSink(std::unique_ptr<InputSink> sink) {
+  std::lock_guard<std::mutex> command(commandLock);
+  if (running)
+    return;
+  inputSink = std::move(sink);
+}
+
+void AutoClicker::SetMacro(std::shared_ptr<const MacroProgram> program) {
+  std::lock_guard<std::mutex> command(commandLock);
+  if (running)
+    return;
+  macro = std::move(program);
+}
+
+void AutoClicker::SetReplayLog(const std::string &path) {
+  std::lock_guard<std::mutex> command(commandLock);
+  if (running)
+    return;
+  replayPath = path;
+}
+
+void AutoClicker::SetScreenSource(std::unique_ptr<ScreenSource> source) {
+  std::lock_guard<std::mutex> command(commandLock);
+  if (running)
+    return;
+  screenSource = std::move(source);
+  defaultScreenSource = false;
 }
 
 unsigned long AutoClicker::GetClickCount() const { return clickCount; }
 
-void AutoClicker::ClickThread() {
-  INPUT inputs[2] = {};
+SchedulerStats AutoClicker::GetSchedulerStats() const {
+  std::lock_guard<std::mutex> guard(controlLock);
+  return lastRunStats;
+}
+
+ClickTelemetry AutoClicker::GetTelemetry() const {
+  ClickTelemetry t;
+  t.lateness = scheduler.GetLatenessHistogram().Snapshot();
+  t.injection = injectionTime.Snapshot();
+  t.detection = detectionTime.Snapshot();
+  return t;
+}
 
-  // Set up common input structure
-  inputs[0].type = INPUT_MOUSE;
-  inputs[1].type = INPUT_MOUSE;
+RealTimeStatus AutoClicker::GetRealTimeStatus() const {
+  std::lock_guard<std::mutex> guard(controlLock);
+  return realTimeStatus;
+}
+
+void ClampClickSettings(ClickSettings &s) {
+  auto clamp = [](int &v, int lo, int hi) {
+    v = std::min(std::max(v, lo), hi);
+  };
+  // The floor goes on the whole period: -5 ms + 999 us is not 999 us.
+  const int64_t periodUs = (int64_t)s.intervalMs * 1000 + s.intervalUs;
+  if (periodUs <= 0) {
+    s.intervalMs = 1; // The dialog's minimum
+    s.intervalUs = 0;
+  } else if (s.intervalMs < 0 || s.intervalUs < 0) {
+    s.intervalMs = (int)std::min<int64_t>(periodUs / 1000, INT_MAX);
+    s.intervalUs = (int)(periodUs % 1000);
+  }
+  clamp(s.missPolicy, (int)MissPolicy::CatchUp, (int)MissPolicy::Skip);
+  clamp(s.intervalDistribution, 0, 3); // DistributionKind
+  clamp(s.positionDistribution, 0, 3);
+  clamp(s.intervalSpreadUs, 0, INT_MAX);
+  clamp(s.positionSpreadPx, 0, INT_MAX);
+  clamp(s.triggerMode, 0, 3); // PixelTriggerMode
+  clamp(s.triggerWidth, 1, INT_MAX);
+  clamp(s.triggerHeight, 1, INT_MAX);
+  clamp(s.triggerTolerance, 0, 255);
+  clamp(s.triggerPollHz, 1, 10000);
+  clamp(s.templateThreshold, 0, 100);
+  clamp(s.realTimeCpu, -1, INT_MAX);
+  s.intervalHistogram[sizeof(s.intervalHistogram) - 1] = 0;
+  s.positionHistogram[sizeof(s.positionHistogram) - 1] = 0;
+  s.templateImage[sizeof(s.templateImage) - 1] = 0;
+}
+
+static int64_t GetIntervalNs(const ClickSettings &s) {
+  return (int64_t)s.intervalMs * 1000000LL + (int64_t)s.intervalUs * 1000LL;
+}
+
+int AutoClicker::GetBurstSize(int64_t periodNs) {
+  if (periodNs <= 0)
+    return kMaxBurstClicks;
+  int64_t n = (kBurstWakePeriodNs + periodNs - 1) / periodNs;
+  if (n < 1)
+    return 1;
+  return n > kMaxBurstClicks ? kMaxBurstClicks : (int)n;
+}
+
+void AutoClicker::AdoptHumanizer() {
+  ClickHumanizer *next = nextHumanizer.exchange(nullptr);
+  if (!next)
+    return;
+  // Only frees something if two updates came between the writer's visits.
+  delete retiredHumanizer.exchange(humanizer.release());
+  humanizer.reset(next);
+}
+
+void AutoClicker::ClickLoop() {
+  InputSink &sink = *inputSink;
+  FastRandom rng((uint64_t)Clock::NowNs() ^ (uint64_t)(uintptr_t)this);
+  ClickSettings settings;
+  uint32_t version = liveSettings.Load(settings);
+
+  // Everything below is derived from `settings` and recomputed when
+  // UpdateSettings() publishes new ones.
+  MouseButton button;
+  MissPolicy policy;
+  bool randomInterval;
+  int64_t periodNs;
+  int burst;
+  auto derive = [&]() {
+    button = settings.isLeftClick ? MouseButton::Left : MouseButton::Right;
+    policy = (MissPolicy)settings.missPolicy;
+    randomInterval = humanizer->HasRandomInterval();
+    // In burst mode each tick delivers `burst` clicks and the tick period is
+    // stretched to match, so the average rate stays the configured one.
+    // Random intervals are per click, so they do not burst.
+    periodNs = GetIntervalNs(settings);
+    burst = settings.burstMode && !randomInterval ? GetBurstSize(periodNs) : 1;
+  };
+  derive();
+
+  // Deadlines are absolute, so the time spent injecting does not add to the
+  // period. The first tick is due immediately. Random intervals advance an
+  // absolute timeline like macro waits do.
+  scheduler.Start(periodNs * burst, policy);
+  injectionTime.Reset();
+  int64_t deadlineNs = Clock::NowNs();
 
   while (running) {
-    if (currentSettings.fixedPosition) {
-      SetCursorPos(currentSettings.x, currentSettings.y);
+    if (randomInterval) {
+      int64_t lateness = scheduler.WaitUntil(deadlineNs);
+      if (!scheduler.WasInterrupted()) {
+        if (policy == MissPolicy::Skip && lateness > 0)
+          deadlineNs += lateness;
+        deadlineNs += humanizer->NextIntervalNs(rng);
+      }
+    } else {
+      scheduler.WaitNext();
+    }
+    if (!running)
+      break;
+    // Stop() clears `running` before it notifies, so the loop condition still
+    // catches a Stop() that lands between the check above and this reset.
+    const bool interrupted = scheduler.WasInterrupted();
+    if (interrupted)
+      wake.Reset();
+
+    // New settings: one load per tick when there are none. The pending
+    // deadline is kept and moved by the change of period, so the phase
+    // carries over.
+    if (liveSettings.Version() != version) {
+      version = liveSettings.Load(settings);
+      AdoptHumanizer();
+      const bool wasRandom = randomInterval;
+      const int64_t oldTickNs = periodNs * burst;
+      const int64_t pendingNs =
+          wasRandom ? deadlineNs : scheduler.GetNextDeadlineNs();
+      derive();
+      if (randomInterval)
+        deadlineNs = pendingNs;
+      else if (wasRandom)
+        scheduler.Retune(periodNs * burst, policy, pendingNs);
+      else
+        scheduler.Retune(periodNs * burst, policy,
+                         pendingNs - oldTickNs + periodNs * burst);
+    }
+    if (interrupted)
+      continue;
+
+    const int64_t injectStart = Clock::NowNs();
+    if (settings.fixedPosition) {
+      int x = settings.x, y = settings.y;
+      if (humanizer->HasRandomPosition())
+        humanizer->NextPosition(rng, x, y);
+      sink.MoveTo(x, y);
+    }
+
+    if (burst > 1) {
+      clickCount += sink.ClickBurst(button, burst);
+    } else {
+      if (sink.Click(button))
+        clickCount++;
     }
+    injectionTime.Record(Clock::NowNs() - injectStart);
+  }
+}
+
+void AutoClicker::MacroLoop() {
+  InputSink &sink = *inputSink;
+  const MissPolicy policy = (MissPolicy)currentSettings.missPolicy;
+  MacroRunner runner(*macro);
 
-    DWORD downFlag = currentSettings.isLeftClick ? MOUSEEVENTF_LEFTDOWN
-                                                 : MOUSEEVENTF_RIGHTDOWN;
-    DWORD upFlag =
-        currentSettings.isLeftClick ? MOUSEEVENTF_LEFTUP : MOUSEEVENTF_RIGHTUP;
+  // Same deadline wait as the click loop. Waits in the script advance an
+  // absolute timeline; with MissPolicy::Skip a late wake-up shifts the rest of
+  // the timeline instead of being caught up.
+  scheduler.Start(GetIntervalNs(currentSettings), policy);
+  injectionTime.Reset();
+  int64_t timeNs = Clock::NowNs();
+
+  while (running && !runner.IsFinished()) {
+    int64_t lateness = scheduler.WaitUntil(timeNs);
+    if (!running)
+      break;
+    if (scheduler.WasInterrupted()) { // Settings update; nothing to pick up
+      wake.Reset();
+      continue;
+    }
+    if (policy == MissPolicy::Skip && lateness > 0)
+      timeNs += lateness;
+
+    unsigned long clicks = 0;
+    const int64_t injectStart = Clock::NowNs();
+    timeNs = runner.Step(sink, timeNs, clicks);
+    injectionTime.Record(Clock::NowNs() - injectStart);
+    clickCount += clicks;
+  }
+}
 
-    inputs[0].mi.dwFlags = downFlag;
-    inputs[1].mi.dwFlags = upFlag;
+void AutoClicker::ReplayLoop() {
+  InputSink &sink = *inputSink;
+  const MissPolicy policy = (MissPolicy)currentSettings.missPolicy;
+  InputLogReader reader;
+
+  // Event times are offsets from the first recorded event, replayed on an
+  // absolute timeline from now with the same deadline wait as the click loop,
+  // so lateness lands in the same statistics. With MissPolicy::Skip a late
+  // wake-up shifts the rest of the timeline instead of being caught up.
+  scheduler.Start(GetIntervalNs(currentSettings), policy);
+  injectionTime.Reset();
+  int64_t baseNs = Clock::NowNs();
+
+  InputEvent ev;
+  if (reader.Open(replayPath)) {
+    bool pending = false; // `ev` still to be sent after an interrupted wait
+    while (running && (pending || reader.Next(ev))) {
+      int64_t lateness = scheduler.WaitUntil(baseNs + ev.timeNs);
+      if (!running)
+        break;
+      pending = scheduler.WasInterrupted();
+      if (pending) { // Settings update; nothing to pick up
+        wake.Reset();
+        continue;
+      }
+      if (policy == MissPolicy::Skip && lateness > 0)
+        baseNs += lateness;
+
+      const int64_t injectStart = Clock::NowNs();
+      const bool sent = SendInputEvent(sink, ev);
+      injectionTime.Record(Clock::NowNs() - injectStart);
+      if (sent && ev.type == InputEventType::ButtonDown)
+        clickCount++;
+    }
+  }
+}
+
+void AutoClicker::TriggerLoop() {
+  InputSink &sink = *inputSink;
+  ClickSettings settings;
+  uint32_t version = liveSettings.Load(settings);
+
+  // Polls on the same deadline scheduler as the click loop. A capture that
+  // overruns the poll period skips the polls it missed instead of bunching
+  // them up, so MissPolicy does not apply here.
+  const int pollHz =
+      currentSettings.triggerPollHz > 0 ? currentSettings.triggerPollHz : 200;
+  scheduler.Start(1000000000LL / pollHz, MissPolicy::Skip);
+  injectionTime.Reset();
+
+  while (running) {
+    scheduler.WaitNext();
+    if (!running)
+      break;
+    // Same pickup as the click loop; only button and position apply here.
+    const bool interrupted = scheduler.WasInterrupted();
+    if (interrupted)
+      wake.Reset();
+    if (liveSettings.Version() != version)
+      version = liveSettings.Load(settings);
+    if (interrupted)
+      continue;
 
-    SendInput(2, inputs, sizeof(INPUT));
-    clickCount++;
+    int hitX, hitY;
+    const int64_t pollStart = Clock::NowNs();
+    const bool fire = watcher->Poll(*screenSource, hitX, hitY);
+    const int64_t injectStart = Clock::NowNs();
+    detectionTime.Record(injectStart - pollStart);
+    if (!fire)
+      continue;
 
-    // Simple sleep for interval. For higher precision < 15ms, a different
-    // approach would be needed. But for a basic auto clicker, Sleep is
-    // sufficient and CPU friendly.
-    Sleep(currentSettings.intervalMs);
+    // Clicks on the template it found, otherwise where the timer would: the
+    // fixed position, else the cursor.
+    if (watcher->ClicksAtHit())
+      sink.MoveTo(hitX, hitY);
+    else if (settings.fixedPosition)
+      sink.MoveTo(settings.x, settings.y);
+    if (sink.Click(settings.isLeftClick ? MouseButton::Left
+                                        : MouseButton::Right))
+      clickCount++;
+    injectionTime.Record(Clock::NowNs() - injectStart);
   }
 }
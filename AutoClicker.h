@@ -1,10 +1,18 @@
 #ifndef AUTOCLICKER_H
 #define AUTOCLICKER_H
 
+#include "ClickScheduler.h"
+#include "InputSink.h"
+#include "Macro.h"
+#include "RealTime.h"
+#include "Clock.h"
+#include "SeqLock.h"
 #include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
-#include <windows.h>
 
 struct ClickSettings {
   int intervalMs = 100;
@@ -13,29 +21,177 @@ struct ClickSettings {
   int x = 0;
   int y = 0;
   int themeIndex = 0;
-  int hotkeyVk = VK_F6;
+  int hotkeyVk = 0x75; // VK_F6
   int hotkeyMod = 0;
+  int intervalUs = 0; // Added to intervalMs, allows sub-millisecond periods
+  int missPolicy = (int)MissPolicy::CatchUp;
+  bool burstMode = false; // Batch clicks per wake-up at high rates
+  int frameRateHz = 60;    // Theme animation: 30, 60 or 120
+  // Humanized clicking (ClickHumanizer.h); DistributionKind values.
+  int intervalDistribution = 0;
+  int intervalSpreadUs = 0;     // Uniform half-width or gaussian sigma
+  int positionDistribution = 0; // Offsets around x/y, fixed position only
+  int positionSpreadPx = 0;
+  char intervalHistogram[260] = {}; // "<interval us> <weight>" per line
+  char positionHistogram[260] = {}; // "<dx> <dy> <weight>" per line
+  // Pixel trigger (PixelTrigger.h): click when a screen region matches a
+  // colour or changes, instead of on a timer. PixelTriggerMode values.
+  int triggerMode = 0;
+  int triggerX = 0; // Watched region, screen coordinates
+  int triggerY = 0;
+  int triggerWidth = 1;
+  int triggerHeight = 1;
+  int triggerColor = 0; // 0xRRGGBB
+  int triggerTolerance = 0; // Per channel, 0..255
+  int triggerPollHz = 200;
+  char templateImage[260] = {}; // Template mode: .bmp to look for
+  int templateThreshold = 90;   // Template mode: correlation in percent
+  // Low-latency mode for the worker (RealTime.h): pinned to one CPU at
+  // real-time priority while it runs.
+  bool realTime = false;
+  int realTimeCpu = -1; // -1: the last CPU available
+  bool controlServer = false; // Serve ControlServer.h on the default endpoint
+  // A second Start/Stop hotkey, same encoding as hotkeyVk/hotkeyMod; 0: none
+  int altHotkeyVk = 0;
+  int altHotkeyMod = 0;
 };
 
+// Brings settings that did not come through the dialog (control clients,
+// the command line) within the dialog's limits. A period (intervalMs plus
+// intervalUs) of zero or less becomes 1 ms, and there are no negative
+// intervals, spreads or region sizes. Enum fields and percentages stay in range, and file names
+// end in a NUL.
+void ClampClickSettings(ClickSettings &s);
+
+// Live view of the worker: how late each tick woke up against its deadline,
+// how long each injection call (move + click, or one macro step) took, and
+// with a pixel trigger how long each capture + compare took.
+struct ClickTelemetry {
+  LatencySnapshot lateness;
+  LatencySnapshot injection;
+  LatencySnapshot detection;
+};
+
+class ClickHumanizer;
+class PixelWatcher;
+class ScreenSource;
+class WorkStealingPool;
+
 class AutoClicker {
 public:
+  // Uses CreateDefaultInputSink().
   AutoClicker();
+  explicit AutoClicker(std::unique_ptr<InputSink> sink);
   ~AutoClicker();
 
+  // Start and Stop only hand over to a worker thread that lives as long as
+  // this object, so both return within microseconds whatever the interval:
+  // Stop cuts the worker's wait short and returns once it is idle. Settings
+  // that name files (histograms, template image) are still read by Start.
+  // Start, Stop, Toggle and the setters below may be called from any thread;
+  // they take one command lock, so each sees the others complete.
   void Start(const ClickSettings &settings);
   void Stop();
   bool IsRunning() const;
   void Toggle(const ClickSettings &settings);
 
+  // Hands new settings to a running clicker; it switches at its next tick
+  // (a long wait is cut short). The timer picks up interval, button,
+  // position, miss policy, burst and humanizer, keeping its phase; a pixel
+  // trigger picks up button and position. What selects the loop (trigger,
+  // macro, replay), the trigger itself and real-time mode wait for the next
+  // Start(). Files are read here, not on the worker. Does nothing while
+  // stopped.
+  void UpdateSettings(const ClickSettings &settings);
+
+  // Replaces the injection backend. Ignored while running.
+  void SetInputSink(std::unique_ptr<InputSink> sink);
+  InputSink *GetInputSink() const { return inputSink.get(); }
+
+  // When set, Start() runs this program instead of the single-click loop and
+  // stops by itself when it reaches the end. Pass nullptr to clear. Ignored
+  // while running.
+  void SetMacro(std::shared_ptr<const MacroProgram> program);
+
+  // When set, Start() replays this recorded input log (InputLog.h) with its
+  // original timing instead of clicking, and stops by itself at the end.
+  // Takes precedence over a macro. The log is streamed from a memory mapping,
+  // so its size does not matter. Pass "" to clear. Ignored while running.
+  void SetReplayLog(const std::string &path);
+
+  // Screen capture for the pixel trigger. Defaults to
+  // CreateDefaultScreenSource(), made by the first Start() with a trigger so
+  // clickers that never watch the screen never touch GDI. Without one, a
+  // trigger setting is ignored and the clicker runs on its timer. Ignored
+  // while running.
+  void SetScreenSource(std::unique_ptr<ScreenSource> source);
+
   unsigned long GetClickCount() const;
+  // Timing of the last completed run (period, skipped ticks, jitter).
+  SchedulerStats GetSchedulerStats() const;
+  // Histograms of the current or last run. Lock-free; does not disturb the
+  // worker.
+  ClickTelemetry GetTelemetry() const;
+  // What real-time mode applied to the worker for the current or last run
+  // (inactive if the run did not ask for it).
+  RealTimeStatus GetRealTimeStatus() const;
+
+  // Clicks per wake-up in burst mode: enough that the worker wakes at most
+  // once per kBurstWakePeriodNs, capped at kMaxBurstClicks.
+  static int GetBurstSize(int64_t periodNs);
+  static const int64_t kBurstWakePeriodNs = 1000000;
 
 private:
-  void ClickThread();
+  enum class RunMode { None, Click, Macro, Replay, Trigger };
+
+  // Start() / Stop() with commandLock held.
+  void StartLocked(const ClickSettings &settings);
+  void StopLocked();
+
+  // Parks between runs and runs one of the loops below per Start().
+  void WorkerThread();
+  void ClickLoop();
+  void MacroLoop();
+  void ReplayLoop();
+  void TriggerLoop();
+  // Takes a humanizer handed over by UpdateSettings(), if any.
+  void AdoptHumanizer();
 
   std::atomic<bool> running;
   std::atomic<unsigned long> clickCount;
   std::thread workerThread;
-  ClickSettings currentSettings;
+  std::mutex commandLock; // Serializes Start/Stop/Toggle and the setters
+  mutable std::mutex controlLock;
+  std::condition_variable controlChanged;
+  RunMode pendingRun; // Set by Start(), taken by the worker
+  bool busy;          // From Start() until the worker is idle again
+  bool shuttingDown;
+  WakeSignal wake;    // Notified by Stop()
+  RealTimeStatus realTimeStatus; // Written by the worker under controlLock
+  ClickSettings currentSettings; // As given to Start()
+  // Latest settings for the running loop: stored by Start() and
+  // UpdateSettings() under publishLock, read by the worker without locking.
+  SeqLock<ClickSettings> liveSettings;
+  std::mutex publishLock;
+  std::unique_ptr<InputSink> inputSink;
+  std::shared_ptr<const MacroProgram> macro;
+  std::string replayPath;
+  std::unique_ptr<ClickHumanizer> humanizer; // Built by Start()
+  // Ownership passes through these by exchange: UpdateSettings() parks a new
+  // humanizer in `nextHumanizer`, the worker swaps it in and parks the old
+  // one in `retiredHumanizer`, which the next update frees.
+  std::atomic<ClickHumanizer *> nextHumanizer;
+  std::atomic<ClickHumanizer *> retiredHumanizer;
+  std::unique_ptr<ScreenSource> screenSource;
+  bool defaultScreenSource; // Not created or replaced yet
+  // Template search threads, made by the first Start() that needs them and
+  // kept for the clicker's lifetime.
+  std::unique_ptr<WorkStealingPool> searchPool;
+  std::unique_ptr<PixelWatcher> watcher; // Built by Start() for a trigger
+  ClickScheduler scheduler;
+  SchedulerStats lastRunStats; // Written by the worker under controlLock
+  LatencyHistogram injectionTime;
+  LatencyHistogram detectionTime;
 };
 
 #endif // AUTOCLICKER_H
@@ -0,0 +1,2269 @@
+// Headless benchmarks for the click engine.
+//
+//   AutoClickerBench burst [--sink null|win32|uinput] [--seconds N]
+//   AutoClickerBench macro [--steps N] [--seconds N]
+//   AutoClickerBench render [--width W] [--height H] [--seconds N]
+//   AutoClickerBench particles [--seconds N]
+//   AutoClickerBench glyphs [--seconds N]
+//   AutoClickerBench dirty [--width W] [--height H] [--frames N]
+//                          [--max-rects N]
+//   AutoClickerBench frames [--width W] [--height H] [--seconds N]
+//   AutoClickerBench engine [--period-ms P] [--seconds N]
+//   AutoClickerBench replay [--events N] [--seconds N] [--file PATH] [--keep]
+//   AutoClickerBench distributions [--samples N]
+//   AutoClickerBench pixels [--seconds N] [--poll-hz N]
+//   AutoClickerBench templates [--seconds N] [--size N]
+//   AutoClickerBench startstop [--cycles N] [--threads N] [--seconds N]
+//   AutoClickerBench hotswap [--seconds N] [--updates N]
+//   AutoClickerBench realtime [--seconds N] [--interval-us N] [--load N]
+//                             [--cpu N]
+//   AutoClickerBench control [--seconds N] [--clients N] [--batch N]
+//   AutoClickerBench startup [--runs N] [--cli PATH] [--limit-ms N]
+//   AutoClickerBench hotkey [--presses N] [--limit-us N]
+//   AutoClickerBench overlay [--width W] [--height H] [--frames N]
+//   AutoClickerBench themes [--reloads N] [--limit-us N]
+//
+// Backends other than `null` inject real input, so run them on a machine
+// (or VM / CI node) where stray clicks do not matter.
+
+#include "AutoClicker.h"
+#include "ClickEngine.h"
+#include "ControlServer.h"
+#include "Clock.h"
+#include "DirtyRegion.h"
+#include "DisplayList.h"
+#include "Distribution.h"
+#include "GlyphAtlas.h"
+#include "HotkeyListener.h"
+#include "InputLog.h"
+#include "Macro.h"
+#include "MappedFile.h"
+#include "ParticleSystem.h"
+#include "PixelTrigger.h"
+#include "RenderLoop.h"
+#include "ScreenCapture.h"
+#include "SeqLock.h"
+#include "SettingsFile.h"
+#include "TemplateMatcher.h"
+#include "SoftRenderer.h"
+#include "ThemePack.h"
+#include "ThemeScene.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+#endif
+
+#ifdef __linux__
+#include <linux/input.h>
+#endif
+
+typedef std::map<std::string, std::string> BenchArgs;
+
+static BenchArgs ParseArgs(int argc, char **argv, int first) {
+  BenchArgs args;
+  for (int i = first; i < argc; i++) {
+    std::string key = argv[i];
+    if (key.compare(0, 2, "--") != 0)
+      continue;
+    key = key.substr(2);
+    args[key] = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "1";
+  }
+  return args;
+}
+
+static std::string GetArg(const BenchArgs &args, const char *key,
+                          const char *def) {
+  auto it = args.find(key);
+  return it == args.end() ? def : it->second;
+}
+
+static double GetArgDouble(const BenchArgs &args, const char *key, double def) {
+  auto it = args.find(key);
+  return it == args.end() ? def : atof(it->second.c_str());
+}
+
+static std::unique_ptr<InputSink> CreateSinkByName(const std::string &name) {
+#ifdef _WIN32
+  if (name == "win32")
+    return std::unique_ptr<InputSink>(new Win32InputSink());
+#endif
+#ifdef __linux__
+  if (name == "uinput") {
+    std::unique_ptr<UinputInputSink> sink(new UinputInputSink());
+    if (!sink->IsOpen()) {
+      fprintf(stderr, "Cannot open /dev/uinput\n");
+      return nullptr;
+    }
+    return std::unique_ptr<InputSink>(sink.release());
+  }
+#endif
+  if (name == "null")
+    return std::unique_ptr<InputSink>(new RecordingInputSink());
+  fprintf(stderr, "Unknown sink '%s'\n", name.c_str());
+  return nullptr;
+}
+
+// Clicks/sec of one pair per call (Click) against batched ClickBurst calls.
+static int BenchBurst(const BenchArgs &args) {
+  std::unique_ptr<InputSink> sink =
+      CreateSinkByName(GetArg(args, "sink", "null"));
+  if (!sink)
+    return 1;
+  const int64_t durationNs =
+      (int64_t)(GetArgDouble(args, "seconds", 1.0) * 1e9);
+
+  printf("sink: %s\n", sink->Name());
+  printf("%8s %16s %10s\n", "batch", "clicks/sec", "speedup");
+
+  const int batches[] = {1, 4, 16, 64, kMaxBurstClicks};
+  double baseline = 0.0;
+  for (int batch : batches) {
+    uint64_t clicks = 0;
+    const int64_t start = Clock::NowNs();
+    int64_t now = start;
+    while (now - start < durationNs) {
+      if (batch == 1) {
+        sink->Click(MouseButton::Left);
+        clicks++;
+      } else {
+        clicks += sink->ClickBurst(MouseButton::Left, batch);
+      }
+      now = Clock::NowNs();
+    }
+    double rate = clicks * 1e9 / (double)(now - start);
+    if (batch == 1)
+      baseline = rate;
+    printf("%8d %16.0f %9.1fx\n", batch, rate,
+           baseline > 0 ? rate / baseline : 0.0);
+  }
+  return 0;
+}
+
+// Per-event cost of the macro interpreter against the plain click loop, both
+// into a null sink so only engine overhead is measured.
+static int BenchMacro(const BenchArgs &args) {
+  const int steps = (int)GetArgDouble(args, "steps", 10000);
+  const int64_t durationNs =
+      (int64_t)(GetArgDouble(args, "seconds", 1.0) * 1e9);
+
+  // loop { click; move; click right; move; ... } with `steps` lines.
+  std::string source = "loop\n";
+  for (int i = 0; i < steps; i++) {
+    if (i % 2 == 0)
+      source += (i % 4 == 0) ? "click\n" : "click right\n";
+    else
+      source += "move " + std::to_string(i % 1920) + " " +
+                std::to_string(i % 1080) + "\n";
+  }
+  source += "end\n";
+
+  MacroProgram program;
+  std::string error;
+  if (!CompileMacro(source, program, error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+
+  RecordingInputSink sink;
+  int64_t start = Clock::NowNs();
+  int64_t now = start;
+  while (now - start < durationNs) {
+    for (int i = 0; i < 1024; i++)
+      sink.Click(MouseButton::Left);
+    now = Clock::NowNs();
+  }
+  double loopNs = (now - start) / (double)sink.GetEventCount();
+
+  sink.Clear();
+  MacroRunner runner(program);
+  unsigned long clicks = 0;
+  start = Clock::NowNs();
+  now = start;
+  while (now - start < durationNs) {
+    runner.Step(sink, now, clicks);
+    now = Clock::NowNs();
+  }
+  double macroNs = (now - start) / (double)sink.GetEventCount();
+
+  printf("program: %d steps, %zu instructions (%zu bytes)\n", steps,
+         program.code.size(), program.code.size() * sizeof(MacroInstr));
+  printf("%-14s %10s\n", "path", "ns/event");
+  printf("%-14s %10.2f\n", "click loop", loopNs);
+  printf("%-14s %10.2f\n", "macro", macroNs);
+  return 0;
+}
+
+// Runs `frame` repeatedly for `durationNs` and returns the mean time per call.
+static double TimePerCall(int64_t durationNs, const std::function<void()> &frame) {
+  uint64_t calls = 0;
+  const int64_t start = Clock::NowNs();
+  int64_t now = start;
+  while (now - start < durationNs) {
+    frame();
+    calls++;
+    now = Clock::NowNs();
+  }
+  return (now - start) / (double)calls;
+}
+
+// Per-frame cost of the software renderer's theme primitives.
+static int BenchRender(const BenchArgs &args) {
+  const int width = (int)GetArgDouble(args, "width", 1920);
+  const int height = (int)GetArgDouble(args, "height", 1080);
+  const int64_t durationNs =
+      (int64_t)(GetArgDouble(args, "seconds", 0.5) * 1e9);
+
+  Framebuffer fb(width, height);
+  const uint32_t bg = PackColor(20, 40, 100);
+  const uint32_t grid = PackColor(30, 60, 150);
+
+  std::vector<int> px(100000), py(100000);
+  for (size_t i = 0; i < px.size(); i++) {
+    px[i] = rand() % width;
+    py[i] = rand() % height;
+  }
+
+  Sprite sprite;
+  sprite.width = sprite.height = 16;
+  for (int i = 0; i < 16 * 16; i++)
+    sprite.pixels.push_back(PackColor(0, 255, 0, (i * 7) & 0xFF));
+
+  struct Case {
+    const char *name;
+    std::function<void()> frame;
+  };
+  const Case cases[] = {
+      {"solid fill", [&] { FillRect(fb, 0, 0, width, height, bg); }},
+      {"hatch fill",
+       [&] { FillHatchCross(fb, 0, 0, width, height, bg, grid); }},
+      {"100 stars",
+       [&] {
+         for (int i = 0; i < 100; i++)
+           FillRect(fb, px[i], py[i], 2, 2, grid);
+       }},
+      {"100k stars",
+       [&] {
+         for (size_t i = 0; i < px.size(); i++)
+           FillRect(fb, px[i], py[i], 2, 2, grid);
+       }},
+      {"alpha blend",
+       [&] { BlendRect(fb, 0, 0, width, height, grid, 128); }},
+      {"1k sprites",
+       [&] {
+         for (int i = 0; i < 1000; i++)
+           BlitSprite(fb, px[i], py[i], sprite);
+       }},
+  };
+
+  printf("framebuffer: %dx%d\n", width, height);
+  printf("%-14s %12s\n", "case", "us/frame");
+  for (const Case &c : cases)
+    printf("%-14s %12.1f\n", c.name, TimePerCall(durationNs, c.frame) / 1000.0);
+  return 0;
+}
+
+// Update cost per particle of one fixed simulation step.
+static int BenchParticles(const BenchArgs &args) {
+  const int64_t durationNs =
+      (int64_t)(GetArgDouble(args, "seconds", 0.5) * 1e9);
+  ParticleParams params;
+  params.minLength = 5;
+  params.maxLength = 19;
+  params.lengthSpacing = 14.0f;
+
+  printf("%-12s %12s %14s\n", "particles", "us/step", "ns/particle");
+  const size_t counts[] = {100, 10000, 100000, 1000000};
+  for (size_t n : counts) {
+    ParticleSystem ps;
+    ps.Init(n, params, 3840, 2160, 1);
+    double ns = TimePerCall(durationNs, [&] { ps.Step(); });
+    printf("%-12zu %12.2f %14.3f\n", n, ns / 1000.0, ns / n);
+  }
+  return 0;
+}
+
+// Matrix rain frame cost when every glyph is an atlas blit, across window
+// sizes and stream counts (streams scale with area as in the app). ns/glyph
+// excludes the background fill.
+static int BenchGlyphs(const BenchArgs &args) {
+  const int64_t durationNs =
+      (int64_t)(GetArgDouble(args, "seconds", 0.5) * 1e9);
+
+  std::vector<GlyphMask> masks;
+  int cellWidth = 0;
+  RasterizeBuiltinGlyphs("01", 14, masks, cellWidth);
+  std::vector<uint32_t> levels;
+  for (int i = 0; i < 12; i++)
+    levels.push_back(PackColor(0, i == 0 ? 255 : 150 - i * 10, 0));
+  GlyphAtlas atlas;
+  atlas.Build(masks, cellWidth, 14, levels);
+
+  ParticleParams params;
+  params.minSpeed = 2.0f;
+  params.maxSpeed = 6.9f;
+  params.minLength = 5;
+  params.maxLength = 19;
+  params.lengthSpacing = 14.0f;
+
+  struct Size {
+    int width, height;
+  };
+  const Size sizes[] = {{800, 600}, {1920, 1080}, {3840, 2160}};
+  printf("%-11s %9s %9s %12s %12s\n", "window", "streams", "glyphs",
+         "us/frame", "ns/glyph");
+  for (const Size &size : sizes) {
+    Framebuffer fb(size.width, size.height);
+    size_t streams = (size_t)size.width * size.height * 40 / (800 * 600);
+    ParticleSystem rain;
+    rain.Init(streams, params, size.width, size.height, 1);
+    size_t glyphs = 0;
+    for (size_t m = 0; m < rain.Count(); m++)
+      glyphs += rain.Length()[m];
+
+    auto fill = [&] {
+      FillRect(fb, 0, 0, size.width, size.height, PackColor(0, 0, 0));
+    };
+    double fillNs = TimePerCall(durationNs, fill);
+    uint32_t rng = 0x2545F491;
+    double ns = TimePerCall(durationNs, [&] {
+      fill();
+      for (size_t m = 0; m < rain.Count(); m++) {
+        for (int i = 0; i < rain.Length()[m]; i++) {
+          rng ^= rng << 13;
+          rng ^= rng >> 17;
+          rng ^= rng << 5;
+          atlas.Draw(fb, (int)rain.X()[m], (int)rain.Y()[m] - i * 14,
+                     (int)(rng >> 31), i);
+        }
+      }
+      rain.Step();
+    });
+    printf("%5dx%-5d %9zu %9zu %12.1f %12.1f\n", size.width, size.height,
+           streams, glyphs, ns / 1000.0, (ns - fillNs) / glyphs);
+  }
+  return 0;
+}
+
+// Matrix glyphs from the built-in font, as ThemeScene draws them.
+static std::shared_ptr<const GlyphAtlas> BuiltinRainGlyphs() {
+  std::vector<GlyphMask> masks;
+  int cellWidth = 0;
+  RasterizeBuiltinGlyphs("01", 14, masks, cellWidth);
+  std::vector<uint32_t> levels;
+  for (int i = 0; i < 12; i++)
+    levels.push_back(PackColor(0, i == 0 ? 255 : 150 - i * 10, 0));
+  std::shared_ptr<GlyphAtlas> atlas(new GlyphAtlas());
+  atlas->Build(masks, cellWidth, 14, levels);
+  return atlas;
+}
+
+static ThemeStyle BenchStyle(ThemeAnimation animation) {
+  ThemeStyle style;
+  style.animation = animation;
+  style.background = PackColor(0, 0, 20);
+  // As themes/space.theme and themes/matrix.theme
+  if (animation == ThemeAnimation::Stars) {
+    style.particleCount = 100;
+    style.particles.minSpeed = 1.0f;
+    style.particles.maxSpeed = 5.9f;
+  } else if (animation == ThemeAnimation::Rain) {
+    style.particleCount = 40;
+    style.particles.minSpeed = 2.0f;
+    style.particles.maxSpeed = 6.9f;
+    style.particles.minLength = 5;
+    style.particles.maxLength = 19;
+    style.glyphs = BuiltinRainGlyphs();
+  }
+  return style;
+}
+
+// Pixels pushed per frame with dirty-rectangle repaint versus repainting the
+// whole client area, for the two animated themes.
+static int BenchDirty(const BenchArgs &args) {
+  const int width = (int)GetArgDouble(args, "width", 1920);
+  const int height = (int)GetArgDouble(args, "height", 1080);
+  const int frames = (int)GetArgDouble(args, "frames", 300);
+  const size_t maxRects = (size_t)GetArgDouble(args, "max-rects", 1024);
+  const uint64_t full = (uint64_t)width * height;
+
+  printf("client: %dx%d (%llu pixels), %d frames\n", width, height,
+         (unsigned long long)full, frames);
+  printf("%-8s %10s %8s %14s %10s %12s\n", "theme", "particles", "rects",
+         "pixels/frame", "of full", "us/frame");
+  const ThemeAnimation themes[] = {ThemeAnimation::Stars,
+                                   ThemeAnimation::Rain};
+  for (ThemeAnimation theme : themes) {
+    ThemeScene scene(1);
+    scene.SetStyle(BenchStyle(theme));
+    DirtyRegion dirty;
+    dirty.Resize(width, height);
+    scene.Update(width, height, 0.0, 30, dirty); // Applies the style
+
+    std::vector<DirtyRect> rects;
+    uint64_t pixels = 0, rectCount = 0;
+    int64_t start = Clock::NowNs();
+    for (int f = 0; f < frames; f++) {
+      dirty.Clear();
+      scene.Update(width, height, ParticleSystem::kStepSeconds, 30, dirty);
+      dirty.GetRects(rects, maxRects);
+      rectCount += rects.size();
+      for (const DirtyRect &r : rects)
+        pixels += (uint64_t)(r.right - r.left) * (r.bottom - r.top);
+    }
+    double us = (Clock::NowNs() - start) / 1000.0 / frames;
+    printf("%-8s %10zu %8.1f %14.0f %9.1f%% %12.1f\n",
+           theme == ThemeAnimation::Stars ? "space" : "matrix",
+           scene.ParticleCount(), (double)rectCount / frames,
+           (double)pixels / frames, 100.0 * pixels / ((double)full * frames),
+           us);
+  }
+  return 0;
+}
+
+// Overlay display list: per-frame lookup of what to redraw under the Space
+// theme's dirty rectangles, against testing every element as DrawUIOverlay
+// used to, for dialogs of 10 to 10k labels (one group box per ten). Exits 1
+// if the two disagree.
+static int BenchOverlay(const BenchArgs &args) {
+  const int width = (int)GetArgDouble(args, "width", 1920);
+  const int height = (int)GetArgDouble(args, "height", 1080);
+  const int frames = (int)GetArgDouble(args, "frames", 300);
+
+  // Dirty rectangles of real animation frames
+  std::vector<std::vector<DirtyRect>> frameRects(frames);
+  {
+    ThemeScene scene(1);
+    scene.SetStyle(BenchStyle(ThemeAnimation::Stars));
+    DirtyRegion dirty;
+    dirty.Resize(width, height);
+    scene.Update(width, height, 0.0, 60, dirty);
+    for (std::vector<DirtyRect> &rects : frameRects) {
+      dirty.Clear();
+      scene.Update(width, height, ParticleSystem::kStepSeconds, 60, dirty);
+      dirty.GetRects(rects, 1024);
+    }
+  }
+
+  bool ok = true;
+  printf("%dx%d client, %d frames of space theme dirty rectangles\n", width,
+         height, frames);
+  printf("%8s %8s %12s %14s %14s\n", "labels", "items", "drawn/frame",
+         "list us/frame", "scan us/frame");
+  const int counts[] = {10, 100, 1000, 10000};
+  const wchar_t label[] = L"Interval (ms):";
+  for (int n : counts) {
+    std::mt19937 rng(7);
+    DisplayList list;
+    for (int i = 0; i < n; i++) {
+      const int x = (int)(rng() % (uint32_t)(width - 120));
+      const int y = (int)(rng() % (uint32_t)(height - 60)) + 8;
+      if (i % 10 == 0) {
+        const DirtyRect box = {x, y, x + 120, y + 50};
+        const DirtyRect title = {x + 10, y - 7, x + 70, y + 6};
+        list.AddFrame(box, 0, &title);
+        list.AddText(title, 0, L"Mouse", 5);
+      } else {
+        list.AddText({x, y, x + 72, y + 13}, 0, label, 14);
+      }
+    }
+    list.Build();
+
+    std::vector<uint32_t> items, scanned;
+    uint64_t drawn = 0;
+    int64_t start = Clock::NowNs();
+    for (const std::vector<DirtyRect> &rects : frameRects) {
+      list.Query(rects.data(), rects.size(), items);
+      drawn += items.size();
+    }
+    const double listUs = (Clock::NowNs() - start) / 1e3 / frames;
+
+    // The old loop: every element against the update area, every frame.
+    start = Clock::NowNs();
+    for (const std::vector<DirtyRect> &rects : frameRects) {
+      scanned.clear();
+      for (uint32_t i = 0; i < list.Size(); i++) {
+        const DirtyRect &b = list.Item(i).bounds;
+        for (const DirtyRect &r : rects)
+          if (b.left < r.right && r.left < b.right && b.top < r.bottom &&
+              r.top < b.bottom) {
+            scanned.push_back(i);
+            break;
+          }
+      }
+    }
+    const double scanUs = (Clock::NowNs() - start) / 1e3 / frames;
+    list.Query(frameRects.back().data(), frameRects.back().size(), items);
+    if (items != scanned)
+      ok = false;
+
+    printf("%8d %8zu %12.1f %14.2f %14.2f\n", n, list.Size(),
+           (double)drawn / frames, listUs, scanUs);
+  }
+  printf("check: %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+// Runs the render thread at each target rate and reports pacing: frames
+// composed, deadlines missed, compose time and wake-up lateness. Then checks
+// that a static theme composes one frame per resize and none in between
+// (exit code 1 if not).
+static int BenchFrames(const BenchArgs &args) {
+  const int width = (int)GetArgDouble(args, "width", 1920);
+  const int height = (int)GetArgDouble(args, "height", 1080);
+  const double seconds = GetArgDouble(args, "seconds", 2.0);
+
+  printf("frame: %dx%d, matrix rain, %.1f s per rate\n", width, height,
+         seconds);
+  printf("%-6s %8s %8s %12s %12s %12s %14s\n", "rate", "frames", "missed",
+         "p50 ms", "p99 ms", "max ms", "late p99 ms");
+  const int rates[] = {30, 60, 120};
+  for (int rate : rates) {
+    ThemeScene scene(1);
+    scene.SetStyle(BenchStyle(ThemeAnimation::Rain));
+    RenderLoop loop;
+    loop.SetSize(width, height);
+    loop.Start(
+        rate,
+        [&](RenderFrame &frame, double elapsed, int hz) {
+          scene.Update(frame.pixels.Width(), frame.pixels.Height(), elapsed,
+                       hz, frame.dirty);
+          scene.Render(frame.pixels);
+        },
+        nullptr);
+    Clock::SleepUntilNs(Clock::NowNs() + (int64_t)(seconds * 1e9));
+    loop.Stop();
+
+    RenderStats rs = loop.GetStats();
+    printf("%3d Hz %8llu %8llu %12.3f %12.3f %12.3f %14.3f\n", rs.rateHz,
+           (unsigned long long)rs.frames,
+           (unsigned long long)rs.missedFrames, rs.frameTime.p50Ns / 1e6,
+           rs.frameTime.p99Ns / 1e6, rs.frameTime.maxNs / 1e6,
+           rs.lateness.p99Ns / 1e6);
+  }
+
+  // A static theme: one frame, then parked until resized.
+  ThemeScene scene(1);
+  scene.SetStyle(BenchStyle(ThemeAnimation::None));
+  RenderLoop loop;
+  loop.SetAnimated(false);
+  loop.SetSize(width, height);
+  loop.Start(
+      60,
+      [&](RenderFrame &frame, double elapsed, int hz) {
+        scene.Update(frame.pixels.Width(), frame.pixels.Height(), elapsed, hz,
+                     frame.dirty);
+        scene.Render(frame.pixels);
+      },
+      nullptr);
+  Clock::SleepUntilNs(Clock::NowNs() + (int64_t)(seconds * 1e9 / 2));
+  loop.SetSize(width / 2, height / 2);
+  Clock::SleepUntilNs(Clock::NowNs() + (int64_t)(seconds * 1e9 / 2));
+  loop.Stop();
+  const uint64_t staticFrames = loop.GetStats().frames;
+  const bool ok = staticFrames == 2;
+  printf("static theme: %llu frames in %.1f s with one resize\n",
+         (unsigned long long)staticFrames, seconds);
+  printf("check: %s (expected 2 frames)\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+// One scheduler thread running 10, 1k and 100k jobs of the same period with
+// their phases spread evenly, into a null sink. While it runs, an extra job is
+// added and another removed every 10 ms to show runtime changes leave the
+// others alone. Reports scheduling cost per click (heap work, no injection)
+// and lateness. Then stops a 1 ms catch-up job for 300 ms and restarts it;
+// exits 1 if it fires more than 20 times in the 10 ms after the restart.
+static int BenchEngine(const BenchArgs &args) {
+  const int64_t periodNs =
+      (int64_t)(GetArgDouble(args, "period-ms", 100.0) * 1e6);
+  const double seconds = GetArgDouble(args, "seconds", 3.0);
+
+  printf("period: %.3f ms per job, %.1f s per run, null sink\n",
+         periodNs / 1e6, seconds);
+  printf("%-7s %12s %8s %10s %10s %12s %12s %12s %9s\n", "jobs", "clicks/s",
+         "churn", "disp p50", "disp p99", "late p50 us", "late p99 us",
+         "late max us", "skipped");
+  const size_t counts[] = {10, 1000, 100000};
+  for (size_t count : counts) {
+    ClickEngine engine(std::unique_ptr<InputSink>(new RecordingInputSink()));
+    ClickJob job;
+    job.periodNs = periodNs;
+    job.missPolicy = MissPolicy::Skip;
+    for (size_t i = 0; i < count; i++) {
+      job.firstDelayNs = (int64_t)(periodNs * i / count);
+      engine.AddJob(job);
+    }
+    engine.Start();
+
+    const int64_t startNs = Clock::NowNs();
+    const int64_t endNs = startNs + (int64_t)(seconds * 1e9);
+    ClickJob extra = job;
+    extra.firstDelayNs = periodNs / 2;
+    ClickJobId extraId = 0;
+    uint64_t churn = 0;
+    for (int64_t t = startNs + 10000000; t < endNs; t += 10000000) {
+      Clock::SleepUntilNs(t);
+      if (extraId)
+        engine.RemoveJob(extraId);
+      extraId = engine.AddJob(extra);
+      churn++;
+    }
+    Clock::SleepUntilNs(endNs);
+    engine.Stop();
+
+    ClickEngineStats es = engine.GetStats();
+    printf("%-7zu %12.0f %8llu %7lld ns %7lld ns %12.1f %12.1f %12.1f "
+           "%9llu\n",
+           count, es.clicks / seconds, (unsigned long long)churn,
+           (long long)es.dispatch.p50Ns, (long long)es.dispatch.p99Ns,
+           es.lateness.p50Ns / 1e3, es.lateness.p99Ns / 1e3,
+           es.lateness.maxNs / 1e3, (unsigned long long)es.skippedTicks);
+  }
+
+  // A CatchUp job must not make up for the time the engine was stopped.
+  ClickEngine engine(std::unique_ptr<InputSink>(new RecordingInputSink()));
+  ClickJob job;
+  job.periodNs = 1000000;
+  job.missPolicy = MissPolicy::CatchUp;
+  engine.AddJob(job);
+  engine.Start();
+  Clock::SleepUntilNs(Clock::NowNs() + 100000000);
+  engine.Stop();
+  Clock::SleepUntilNs(Clock::NowNs() + 300000000);
+  engine.Start();
+  Clock::SleepUntilNs(Clock::NowNs() + 10000000);
+  engine.Stop();
+  const uint64_t resumed = engine.GetStats().clicks;
+  const bool ok = resumed <= 20;
+  printf("1 ms catch-up job, 10 ms after a 300 ms stop: %llu clicks\n",
+         (unsigned long long)resumed);
+  printf("check: %s (at most 20)\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+// Current working set of this process, for the constant-memory check.
+static size_t ResidentBytes() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc = {};
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    return pmc.WorkingSetSize;
+  return 0;
+#else
+  unsigned long pages = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (!f)
+    return 0;
+  if (fscanf(f, "%lu %lu", &pages, &resident) != 2)
+    resident = 0;
+  fclose(f);
+  return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// Writes a synthetic session (mouse moves about 1 ms apart with clicks and
+// key presses mixed in), decodes all of it from the memory mapping while
+// watching the working set, then replays the start of it through the click
+// worker into a null sink and reports the same lateness statistics as live
+// clicking. Use --events 500000000 for a multi-gigabyte log.
+static int BenchReplay(const BenchArgs &args) {
+  const uint64_t count = (uint64_t)GetArgDouble(args, "events", 20000000);
+  const double seconds = GetArgDouble(args, "seconds", 3.0);
+  const std::string path = GetArg(args, "file", "bench_replay.acil");
+
+  InputLogWriter writer;
+  if (!writer.Open(path)) {
+    fprintf(stderr, "Cannot create %s\n", path.c_str());
+    return 1;
+  }
+  uint32_t rng = 0x9E3779B9;
+  InputEvent ev;
+  int64_t t = 0;
+  int64_t start = Clock::NowNs();
+  for (uint64_t i = 0; i < count; i++) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    ev = InputEvent();
+    t += 800000 + rng % 400000;
+    ev.timeNs = t;
+    if (i % 50 == 48 || i % 50 == 49) {
+      ev.type = i % 50 == 48 ? InputEventType::ButtonDown
+                             : InputEventType::ButtonUp;
+    } else if (i % 200 == 100 || i % 200 == 101) {
+      ev.type = i % 200 == 100 ? InputEventType::KeyDown : InputEventType::KeyUp;
+      ev.key = 0x41 + (int)(rng % 26);
+    } else {
+      ev.type = InputEventType::Move;
+      ev.x = 960 + (int)(rng % 64) - 32;
+      ev.y = 540 + (int)((rng >> 8) % 64) - 32;
+    }
+    writer.Append(ev);
+  }
+  const uint64_t bytes = writer.BytesWritten();
+  if (!writer.Close()) {
+    fprintf(stderr, "Writing %s failed\n", path.c_str());
+    return 1;
+  }
+  double writeS = (Clock::NowNs() - start) / 1e9;
+  printf("log: %llu events, %.1f MB, %.2f bytes/event, %.1f h of input\n",
+         (unsigned long long)count, bytes / 1e6, (double)bytes / count,
+         t / 3.6e12);
+  printf("%-8s %12s %12s %16s\n", "phase", "events/s", "MB/s",
+         "max resident MB");
+  printf("%-8s %12.0f %12.1f %16s\n", "write", count / writeS,
+         bytes / 1e6 / writeS, "-");
+
+  InputLogReader reader;
+  if (!reader.Open(path)) {
+    fprintf(stderr, "Cannot open %s\n", path.c_str());
+    return 1;
+  }
+  const size_t baseResident = ResidentBytes();
+  size_t maxResident = baseResident;
+  uint64_t decoded = 0;
+  start = Clock::NowNs();
+  while (reader.Next(ev)) {
+    if (++decoded % 1000000 == 0) {
+      size_t r = ResidentBytes();
+      if (r > maxResident)
+        maxResident = r;
+    }
+  }
+  double readS = (Clock::NowNs() - start) / 1e9;
+  printf("%-8s %12.0f %12.1f %16.1f\n", "read", decoded / readS,
+         bytes / 1e6 / readS, (maxResident - baseResident) / 1e6);
+  reader.Close();
+  if (decoded != count) {
+    fprintf(stderr, "Decoded %llu of %llu events\n",
+            (unsigned long long)decoded, (unsigned long long)count);
+    return 1;
+  }
+
+  AutoClicker clicker(std::unique_ptr<InputSink>(new RecordingInputSink()));
+  clicker.SetReplayLog(path);
+  ClickSettings settings;
+  clicker.Start(settings);
+  Clock::SleepUntilNs(Clock::NowNs() + (int64_t)(seconds * 1e9));
+  clicker.Stop();
+
+  SchedulerStats ss = clicker.GetSchedulerStats();
+  printf("replay: %llu events in %.1f s, lateness p50 %.1f us, p99 %.1f us, "
+         "p99.9 %.1f us, max %.1f us\n",
+         (unsigned long long)ss.ticks, seconds, ss.latenessP50Ns / 1e3,
+         ss.latenessP99Ns / 1e3, ss.latenessP999Ns / 1e3,
+         ss.latenessMaxNs / 1e3);
+
+  if (!args.count("keep"))
+    remove(path.c_str());
+  return 0;
+}
+
+// Pearson chi-square of observed bin counts against bin probabilities, tested
+// at the 0.1% level (critical value from the Wilson-Hilferty approximation).
+// Bins of probability 0 must stay empty and are not counted as freedom.
+static bool CheckDistribution(const char *name, double nsPerSample,
+                              const std::vector<uint64_t> &counts,
+                              const std::vector<double> &probs) {
+  uint64_t n = 0;
+  for (uint64_t c : counts)
+    n += c;
+  double chi2 = 0.0;
+  int bins = 0;
+  bool impossible = false;
+  for (size_t i = 0; i < counts.size(); i++) {
+    if (probs[i] <= 0.0) {
+      impossible = impossible || counts[i] > 0;
+      continue;
+    }
+    const double expected = probs[i] * n;
+    chi2 += (counts[i] - expected) * (counts[i] - expected) / expected;
+    bins++;
+  }
+  const int dof = bins - 1;
+  const double z = 3.0902; // Upper 0.1% of the standard normal
+  const double h = 2.0 / (9.0 * dof);
+  const double critical = dof * pow(1.0 - h + z * sqrt(h), 3.0);
+  const bool pass = !impossible && chi2 < critical;
+  printf("%-20s %10.2f %12.1f %6d %10.1f  %s\n", name, nsPerSample, chi2, dof,
+         critical, pass ? "PASS" : "FAIL");
+  return pass;
+}
+
+// Sampling cost of each humanizer distribution and a chi-square check of the
+// generated stream against the distribution it was built from. Exits with 1
+// if any check fails, so it can gate a build.
+static int BenchDistributions(const BenchArgs &args) {
+  const uint64_t n = (uint64_t)GetArgDouble(args, "samples", 2000000);
+  const int64_t timeNs = 200000000;
+  FastRandom rng(12345);
+  volatile double sink = 0.0;
+  bool ok = true;
+
+  printf("%llu samples per check\n", (unsigned long long)n);
+  printf("%-20s %10s %12s %6s %10s  %s\n", "distribution", "ns/sample",
+         "chi-square", "dof", "critical", "result");
+
+  // Generic so each sampler is inlined into the timing loop.
+  auto timeSamples = [&](auto sample) {
+    return TimePerCall(timeNs, [&] {
+             double acc = 0.0;
+             for (int i = 0; i < 1024; i++)
+               acc += sample();
+             sink = sink + acc;
+           }) /
+           1024.0;
+  };
+
+  // Uniform: 50 equal bins over [-1000, 1000].
+  {
+    Distribution d;
+    d.SetUniform(1000.0);
+    std::vector<uint64_t> counts(50);
+    for (uint64_t i = 0; i < n; i++) {
+      int bin = (int)((d.Sample(rng) + 1000.0) / 40.0);
+      counts[bin < 0 ? 0 : bin > 49 ? 49 : bin]++;
+    }
+    ok &= CheckDistribution("uniform", timeSamples([&] {
+                              return d.Sample(rng);
+                            }),
+                            counts, std::vector<double>(50, 1.0 / 50));
+  }
+
+  // Gaussian: 64 equally likely bins between normal quantiles, tails
+  // included in the outer two.
+  {
+    Distribution d;
+    d.SetGaussian(1.0);
+    std::vector<double> edges;
+    for (int k = 1; k < 64; k++)
+      edges.push_back(Distribution::InverseNormal(k / 64.0));
+    std::vector<uint64_t> counts(64);
+    for (uint64_t i = 0; i < n; i++) {
+      double v = d.Sample(rng);
+      counts[std::upper_bound(edges.begin(), edges.end(), v) - edges.begin()]++;
+    }
+    ok &= CheckDistribution("gaussian", timeSamples([&] {
+                              return d.Sample(rng);
+                            }),
+                            counts, std::vector<double>(64, 1.0 / 64));
+  }
+
+  // Histogram: 100 values with uneven weights, some of them zero.
+  {
+    std::vector<double> values, weights;
+    double sum = 0.0;
+    for (int i = 0; i < 100; i++) {
+      values.push_back(i);
+      weights.push_back(i % 7 == 3 ? 0.0 : 1.0 + (i * 37 % 11));
+      sum += weights.back();
+    }
+    Distribution d;
+    d.SetHistogram(values, weights);
+    std::vector<uint64_t> counts(100);
+    for (uint64_t i = 0; i < n; i++)
+      counts[(int)d.Sample(rng)]++;
+    std::vector<double> probs;
+    for (double w : weights)
+      probs.push_back(w / sum);
+    ok &= CheckDistribution("histogram", timeSamples([&] {
+                              return d.Sample(rng);
+                            }),
+                            counts, probs);
+  }
+
+  // Position offsets: uniform over an 11x11 square of pixels.
+  {
+    OffsetDistribution d;
+    d.SetUniform(5);
+    std::vector<uint64_t> counts(121);
+    int dx, dy;
+    for (uint64_t i = 0; i < n; i++) {
+      d.Sample(rng, dx, dy);
+      counts[(dy + 5) * 11 + dx + 5]++;
+    }
+    ok &= CheckDistribution("offset uniform", timeSamples([&] {
+                              d.Sample(rng, dx, dy);
+                              return (double)(dx + dy);
+                            }),
+                            counts, std::vector<double>(121, 1.0 / 121));
+  }
+
+  // Position offsets: a joint (dx, dy) histogram.
+  {
+    std::vector<int> hx, hy;
+    std::vector<double> weights;
+    double sum = 0.0;
+    for (int y = -3; y <= 3; y++)
+      for (int x = -3; x <= 3; x++) {
+        hx.push_back(x);
+        hy.push_back(y);
+        weights.push_back(1.0 / (1 + x * x + 2 * y * y));
+        sum += weights.back();
+      }
+    OffsetDistribution d;
+    d.SetHistogram(hx, hy, weights);
+    std::vector<uint64_t> counts(49);
+    int dx, dy;
+    for (uint64_t i = 0; i < n; i++) {
+      d.Sample(rng, dx, dy);
+      counts[(dy + 3) * 7 + dx + 3]++;
+    }
+    std::vector<double> probs;
+    for (double w : weights)
+      probs.push_back(w / sum);
+    ok &= CheckDistribution("offset histogram", timeSamples([&] {
+                              d.Sample(rng, dx, dy);
+                              return (double)(dx + dy);
+                            }),
+                            counts, probs);
+  }
+
+  printf("%-20s %10.2f\n", "rand() for reference", timeSamples([] {
+           return (double)rand();
+         }));
+  return ok ? 0 : 1;
+}
+
+// Pixel trigger: checks every kernel against the scalar one, then reports
+// polls/sec of the colour and change scans on 1080p and 4K regions (full
+// scans: no match, no change), and paint-to-click latency through
+// AutoClicker with a synthetic screen. Exits 1 if a kernel disagrees.
+static int BenchPixels(const BenchArgs &args) {
+  const int64_t durationNs =
+      (int64_t)(GetArgDouble(args, "seconds", 0.5) * 1e9);
+  const int pollHz = (int)GetArgDouble(args, "poll-hz", 500);
+  const PixelKernel best = BestPixelKernel();
+  std::vector<PixelKernel> kernels;
+  for (int k = 0; k <= (int)best; k++)
+    kernels.push_back((PixelKernel)k);
+
+  // Noise with planted hits at awkward offsets (row ends, vector tails).
+  bool ok = true;
+  FastRandom rng(42);
+  Framebuffer a(1003, 67), b(1003, 67);
+  const uint32_t target = PackColor(200, 100, 50) & 0xFFFFFF;
+  for (int trial = 0; trial < 2000; trial++) {
+    for (int row = 0; row < a.Height(); row++)
+      for (int col = 0; col < a.Width(); col++) {
+        // Channels stay 20+ away from the target unless planted.
+        uint32_t v = (uint32_t)rng.Next() & 0x3F3F3F;
+        a.Row(row)[col] = v | ((uint32_t)rng.Next() & 0xFF000000u);
+        b.Row(row)[col] = v | ((uint32_t)rng.Next() & 0xFF000000u);
+      }
+    const int px = (int)(rng.Next() % a.Width());
+    const int py = (int)(rng.Next() % a.Height());
+    const int tolerance = (int)(rng.Next() % 16);
+    if (trial % 3 != 0) {
+      int d = tolerance + (int)(trial % 2); // Just inside, or just outside
+      a.Row(py)[px] = PackColor(200 - d, 100 + tolerance, 50);
+      b.Row(py)[px] ^= 1u << (trial % 24);
+    }
+
+    int sx = -1, sy = -1;
+    bool sFound = FindColor(a, target, tolerance, sx, sy, PixelKernel::Scalar);
+    // Framebuffer copies share pixels, so references get their own.
+    Framebuffer bs(b.Width(), b.Height()), bk(b.Width(), b.Height());
+    CopyPixels(bs, b, 0, 0, b.Width(), b.Height());
+    int dx = -1, dy = -1;
+    bool dFound = SyncChanges(a, bs, dx, dy, PixelKernel::Scalar);
+    for (PixelKernel k : kernels) {
+      int kx = -1, ky = -1;
+      bool found = FindColor(a, target, tolerance, kx, ky, k);
+      if (found != sFound || (found && (kx != sx || ky != sy))) {
+        fprintf(stderr, "FAIL %s colour scan, trial %d\n", PixelKernelName(k),
+                trial);
+        ok = false;
+      }
+      CopyPixels(bk, b, 0, 0, b.Width(), b.Height());
+      found = SyncChanges(a, bk, kx, ky, k);
+      if (found != dFound || (found && (kx != dx || ky != dy))) {
+        fprintf(stderr, "FAIL %s change scan, trial %d\n", PixelKernelName(k),
+                trial);
+        ok = false;
+      }
+      for (int row = 0; row < a.Height(); row++)
+        for (int col = 0; col < a.Width(); col++)
+          if ((a.Row(row)[col] ^ bk.Row(row)[col]) & 0xFFFFFF) {
+            fprintf(stderr, "FAIL %s reference not synced, trial %d\n",
+                    PixelKernelName(k), trial);
+            ok = false;
+            row = a.Height();
+            break;
+          }
+    }
+  }
+  printf("kernel check: %s (best: %s)\n", ok ? "PASS" : "FAIL",
+         PixelKernelName(best));
+
+  struct Size {
+    const char *name;
+    int width, height;
+  };
+  const Size sizes[] = {{"1080p", 1920, 1080}, {"4K", 3840, 2160}};
+  printf("\n%-6s %-7s %-7s %12s %10s %10s\n", "region", "scan", "kernel",
+         "polls/s", "us/poll", "GB/s");
+  for (const Size &size : sizes) {
+    Framebuffer frame(size.width, size.height);
+    Framebuffer reference(size.width, size.height);
+    FillRect(frame, 0, 0, size.width, size.height, PackColor(30, 30, 30));
+    CopyPixels(reference, frame, 0, 0, size.width, size.height);
+    const double bytes = (double)size.width * size.height * 4;
+    for (int scan = 0; scan < 2; scan++)
+      for (PixelKernel k : kernels) {
+        int x, y;
+        double ns = TimePerCall(durationNs, [&] {
+          if (scan == 0)
+            FindColor(frame, 0xFF0000, 8, x, y, k);
+          else
+            SyncChanges(frame, reference, x, y, k);
+        });
+        const double read = scan == 0 ? bytes : 2 * bytes;
+        printf("%-6s %-7s %-7s %12.0f %10.1f %10.2f\n", size.name,
+               scan == 0 ? "colour" : "change", PixelKernelName(k), 1e9 / ns,
+               ns / 1e3, read / ns);
+      }
+
+    // Capture included: the synthetic source copies the region like BitBlt.
+    SyntheticScreenSource screen(size.width, size.height);
+    PixelTrigger trigger;
+    trigger.mode = PixelTriggerMode::Change;
+    trigger.width = size.width;
+    trigger.height = size.height;
+    PixelWatcher watcher(trigger);
+    int x, y;
+    double ns = TimePerCall(durationNs, [&] { watcher.Poll(screen, x, y); });
+    printf("%-6s %-7s %-7s %12.0f %10.1f %10s\n", size.name, "capture",
+           PixelKernelName(best), 1e9 / ns, ns / 1e3, "-");
+  }
+
+  // Paint-to-click: a change trigger on a 4K region polled at pollHz.
+  SyntheticScreenSource *screen = new SyntheticScreenSource(3840, 2160);
+  RecordingInputSink *sink = new RecordingInputSink(1024);
+  AutoClicker clicker((std::unique_ptr<InputSink>(sink)));
+  clicker.SetScreenSource(std::unique_ptr<ScreenSource>(screen));
+  ClickSettings settings;
+  settings.triggerMode = (int)PixelTriggerMode::Change;
+  settings.triggerWidth = 3840;
+  settings.triggerHeight = 2160;
+  settings.triggerPollHz = pollHz;
+  clicker.Start(settings);
+
+  const int paints = 50;
+  std::vector<int64_t> paintedAt;
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  for (int i = 0; i < paints; i++) {
+    // Random phase against the poll clock, bottom-right so the scan is long.
+    Clock::SleepUntilNs(Clock::NowNs() + 20000000 +
+                        (int64_t)(rng.Next() % 5000000));
+    paintedAt.push_back(Clock::NowNs());
+    screen->Paint(3800, 2100, 8, 8, PackColor(i * 5, 255, 0));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  clicker.Stop();
+
+  std::vector<int64_t> latency;
+  size_t next = 0;
+  for (const InputEvent &ev : sink->GetEvents()) {
+    if (ev.type != InputEventType::ButtonDown)
+      continue;
+    while (next + 1 < paintedAt.size() && paintedAt[next + 1] <= ev.timeNs)
+      next++;
+    if (next < paintedAt.size() && paintedAt[next] <= ev.timeNs)
+      latency.push_back(ev.timeNs - paintedAt[next]);
+  }
+  std::sort(latency.begin(), latency.end());
+  ClickTelemetry t = clicker.GetTelemetry();
+  printf("\npaint-to-click, 4K change trigger at %d Hz: %zu/%d clicks\n",
+         pollHz, latency.size(), paints);
+  if (!latency.empty())
+    printf("  p50 %.2f ms  p99 %.2f ms  max %.2f ms (poll period %.2f ms)\n",
+           latency[latency.size() / 2] / 1e6,
+           latency[latency.size() * 99 / 100] / 1e6, latency.back() / 1e6,
+           1e3 / pollHz);
+  printf("  capture + compare p50 %.2f ms  p99 %.2f ms\n",
+         t.detection.p50Ns / 1e6, t.detection.p99Ns / 1e6);
+  if (latency.size() != (size_t)paints)
+    ok = false;
+  return ok ? 0 : 1;
+}
+
+// Screen-like synthetic frame: a gradient under a few thousand flat boxes.
+static void PaintDesktop(Framebuffer &fb, FastRandom &rng) {
+  for (int y = 0; y < fb.Height(); y++)
+    FillRect(fb, 0, y, fb.Width(), 1, PackColor(40, 60 + y * 100 / fb.Height(),
+                                                120));
+  const int boxes = fb.Width() * fb.Height() / 2000;
+  for (int i = 0; i < boxes; i++) {
+    int w = 8 + (int)(rng.Next() % 120), h = 8 + (int)(rng.Next() % 40);
+    uint32_t c = (uint32_t)rng.Next();
+    FillRect(fb, (int)(rng.Next() % fb.Width()), (int)(rng.Next() % fb.Height()),
+             w, h, PackColor(c & 0xFF, (c >> 8) & 0xFF, (c >> 16) & 0xFF));
+  }
+}
+
+// A button-like target: rings and a diagonal stripe.
+static void PaintTarget(Framebuffer &fb, int x0, int y0, int size) {
+  for (int y = 0; y < size; y++)
+    for (int x = 0; x < size; x++) {
+      int dx = x - size / 2, dy = y - size / 2;
+      int ring = (int)std::sqrt((double)(dx * dx + dy * dy)) / 5;
+      uint32_t c = (ring & 1) ? PackColor(230, 200, 30) : PackColor(30, 30, 90);
+      if (std::abs(x - y) < 3)
+        c = PackColor(250, 250, 250);
+      PlotPoint(fb, x0 + x, y0 + y, c);
+    }
+}
+
+// Template matching: finds a size x size target in 1080p and 4K frames.
+// "full" searches a brand-new frame every time, "moved" alternates between
+// two frames where only the target moved (the cache reconverts just the
+// changed bands), "unchanged" shows the cached path. Exits 1 if a search
+// misses the target.
+static int BenchTemplates(const BenchArgs &args) {
+  const int64_t durationNs =
+      (int64_t)(GetArgDouble(args, "seconds", 1.0) * 1e9);
+  const int size = (int)GetArgDouble(args, "size", 64);
+  FastRandom rng(7);
+
+  Framebuffer target(size, size);
+  PaintTarget(target, 0, 0, size);
+
+  struct Size {
+    const char *name;
+    int width, height;
+  };
+  const Size sizes[] = {{"1080p", 1920, 1080}, {"4K", 3840, 2160}};
+  WorkStealingPool pool;
+  bool ok = true;
+  printf("template %dx%d, %d threads\n", size, size, pool.GetThreadCount());
+  printf("%-6s %-10s %8s %12s %10s %10s\n", "frame", "case", "threads",
+         "matches/s", "ms/match", "score");
+  for (const Size &fs : sizes) {
+    Framebuffer frames[2];
+    int tx[2], ty[2];
+    for (int f = 0; f < 2; f++) {
+      frames[f].Resize(fs.width, fs.height);
+      PaintDesktop(frames[f], rng);
+      tx[f] = (int)(rng.Next() % (fs.width - size));
+      ty[f] = (int)(rng.Next() % (fs.height - size));
+    }
+    // Same desktop in both frames, so only the target's bands differ.
+    CopyPixels(frames[1], frames[0], 0, 0, fs.width, fs.height);
+    for (int f = 0; f < 2; f++)
+      PaintTarget(frames[f], tx[f], ty[f], size);
+
+    for (int threaded = 0; threaded < 2; threaded++) {
+      TemplateMatcher matcher(threaded ? &pool : nullptr);
+      matcher.SetTemplate(target);
+      const char *cases[] = {"full", "moved", "unchanged"};
+      for (int mode = 0; mode < 3; mode++) {
+        int frame = 0;
+        double score = 1.0;
+        double ns = TimePerCall(durationNs, [&] {
+          if (mode == 0)
+            matcher.InvalidateCache();
+          if (mode != 2)
+            frame ^= 1;
+          TemplateMatch m = matcher.Find(frames[frame]);
+          if (!m.found || m.x != tx[frame] || m.y != ty[frame]) {
+            if (ok)
+              fprintf(stderr, "FAIL %s %s: found=%d at %d,%d, want %d,%d\n",
+                      fs.name, cases[mode], (int)m.found, m.x, m.y, tx[frame],
+                      ty[frame]);
+            ok = false;
+          }
+          score = std::min(score, m.score);
+        });
+        printf("%-6s %-10s %8d %12.1f %10.3f %10.4f\n", fs.name, cases[mode],
+               threaded ? pool.GetThreadCount() : 1, 1e9 / ns, ns / 1e6,
+               score);
+      }
+    }
+  }
+  printf("steals: %llu\n", (unsigned long long)pool.GetStealCount());
+  printf("check: %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+// What the hotkey handler sees: how long Start() and Stop() block the
+// caller, how long from Start() to the first click, and whether anything is
+// injected after Stop() returns. The long interval is the case that used to
+// block Stop() for a whole interval. Then --threads threads (the dialog, the
+// hotkey thread, the control server) call Start/Stop/Toggle at random on one
+// clicker for --seconds; a call that takes over a second counts as stuck.
+static int BenchStartStop(const BenchArgs &args) {
+  const int cycles = (int)GetArgDouble(args, "cycles", 200);
+  const int threads = std::max(2, (int)GetArgDouble(args, "threads", 4));
+  const int64_t hammerNs =
+      (int64_t)(GetArgDouble(args, "seconds", 1.0) * 1e9);
+  RecordingInputSink *sink = new RecordingInputSink(4096);
+  AutoClicker clicker((std::unique_ptr<InputSink>(sink)));
+
+  auto report = [](const char *name, std::vector<int64_t> &v) {
+    std::sort(v.begin(), v.end());
+    printf("%-22s %10.1f %10.1f %10.1f\n", name, v[v.size() / 2] / 1e3,
+           v[v.size() * 99 / 100] / 1e3, v.back() / 1e3);
+  };
+
+  // Reference: what every Start() used to pay before doing anything.
+  std::vector<int64_t> spawn;
+  for (int i = 0; i < cycles; i++) {
+    const int64_t t0 = Clock::NowNs();
+    std::thread t([] {});
+    t.join();
+    spawn.push_back(Clock::NowNs() - t0);
+  }
+
+  bool ok = true;
+  printf("%d start/stop cycles per interval, null sink\n", cycles);
+  printf("%-22s %10s %10s %10s\n", "", "p50 us", "p99 us", "max us");
+  report("thread spawn + join", spawn);
+  const int intervalsMs[] = {10000, 1};
+  for (int intervalMs : intervalsMs) {
+    ClickSettings settings;
+    settings.intervalMs = intervalMs;
+    std::vector<int64_t> startCall, firstClick, stopCall;
+    uint64_t lateEvents = 0;
+    for (int i = 0; i < cycles; i++) {
+      sink->Clear();
+      const int64_t t0 = Clock::NowNs();
+      clicker.Start(settings);
+      startCall.push_back(Clock::NowNs() - t0);
+      while (sink->GetEventCount() == 0)
+        std::this_thread::yield();
+      firstClick.push_back(sink->GetEvents()[0].timeNs - t0);
+
+      // Stop mid-interval (10 s) or mid-stream (1 ms).
+      Clock::SleepUntilNs(Clock::NowNs() + 2000000);
+      const int64_t t1 = Clock::NowNs();
+      clicker.Stop();
+      stopCall.push_back(Clock::NowNs() - t1);
+      const uint64_t quiet = sink->GetEventCount();
+      Clock::SleepUntilNs(Clock::NowNs() + 1000000);
+      lateEvents += sink->GetEventCount() - quiet;
+    }
+    printf("interval %d ms:\n", intervalMs);
+    report("  Start() call", startCall);
+    report("  Start() to 1st click", firstClick);
+    report("  Stop() call", stopCall);
+    printf("  events after Stop(): %llu\n", (unsigned long long)lateEvents);
+    if (lateEvents)
+      ok = false;
+  }
+
+  ClickSettings fast;
+  fast.intervalMs = 1;
+  std::atomic<bool> hammering(true);
+  std::atomic<int> finished(0);
+  std::unique_ptr<std::atomic<int64_t>[]> callStart(
+      new std::atomic<int64_t>[threads]);
+  std::vector<uint64_t> calls(threads, 0);
+  std::vector<int64_t> longest(threads, 0);
+  std::vector<std::thread> callers;
+  for (int t = 0; t < threads; t++) {
+    callStart[t] = 0;
+    callers.emplace_back([&, t] {
+      std::mt19937 rng(t + 1);
+      while (hammering) {
+        const int64_t t0 = Clock::NowNs();
+        callStart[t] = t0;
+        switch (rng() % 3) {
+        case 0:
+          clicker.Start(fast);
+          break;
+        case 1:
+          clicker.Stop();
+          break;
+        default:
+          clicker.Toggle(fast);
+        }
+        callStart[t] = 0;
+        longest[t] = std::max(longest[t], Clock::NowNs() - t0);
+        calls[t]++;
+      }
+      finished++;
+    });
+  }
+  const int64_t hammerEnd = Clock::NowNs() + hammerNs;
+  bool stuck = false;
+  while (!stuck && finished < threads) {
+    Clock::SleepUntilNs(Clock::NowNs() + 1000000);
+    const int64_t now = Clock::NowNs();
+    if (now >= hammerEnd)
+      hammering = false;
+    for (int t = 0; t < threads; t++) {
+      const int64_t started = callStart[t];
+      if (started && now - started > 1000000000)
+        stuck = true;
+    }
+  }
+  if (stuck) {
+    printf("%d threads calling Start/Stop/Toggle: a call is stuck (running "
+           "%d)\ncheck: FAIL\n",
+           threads, clicker.IsRunning() ? 1 : 0);
+    fflush(stdout);
+    _Exit(1); // The stuck thread cannot be joined
+  }
+  for (std::thread &t : callers)
+    t.join();
+  clicker.Stop();
+  const uint64_t quiet = sink->GetEventCount();
+  Clock::SleepUntilNs(Clock::NowNs() + 5000000);
+  const bool stopped =
+      !clicker.IsRunning() && sink->GetEventCount() == quiet;
+  uint64_t totalCalls = 0;
+  int64_t maxCall = 0;
+  for (int t = 0; t < threads; t++) {
+    totalCalls += calls[t];
+    maxCall = std::max(maxCall, longest[t]);
+  }
+  printf("%d threads calling Start/Stop/Toggle: %llu calls, longest %.1f "
+         "us, %s after the final Stop()\n",
+         threads, (unsigned long long)totalCalls, maxCall / 1e3,
+         stopped ? "quiet" : "STILL CLICKING");
+  ok = ok && stopped;
+  printf("check: %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+// Live settings: what the worker pays per tick to look for new settings,
+// whether a reader can ever see half of one update and half of another, and
+// how long an update takes to reach the clicks.
+static int BenchHotSwap(const BenchArgs &args) {
+  const int64_t durationNs =
+      (int64_t)(GetArgDouble(args, "seconds", 1.0) * 1e9);
+  const int updates = (int)GetArgDouble(args, "updates", 200);
+  bool ok = true;
+
+  // Every field a writer sets carries the same number, so a torn copy shows
+  // up as a mismatch.
+  auto stamp = [](ClickSettings &s, int n) {
+    s.x = s.y = s.triggerX = s.triggerY = s.intervalUs = n;
+    snprintf(s.templateImage, sizeof(s.templateImage), "%d", n);
+    snprintf(s.positionHistogram, sizeof(s.positionHistogram), "%d", n);
+  };
+  auto consistent = [](const ClickSettings &s) {
+    char text[32];
+    snprintf(text, sizeof(text), "%d", s.x);
+    return s.y == s.x && s.triggerX == s.x && s.triggerY == s.x &&
+           s.intervalUs == s.x && strcmp(s.templateImage, text) == 0 &&
+           strcmp(s.positionHistogram, text) == 0;
+  };
+
+  printf("ClickSettings: %zu bytes\n", sizeof(ClickSettings));
+  printf("%-28s %10s\n", "reader", "ns/call");
+  SeqLock<ClickSettings> lock;
+  {
+    ClickSettings s;
+    stamp(s, 1);
+    lock.Store(s);
+    uint32_t sink = 0;
+    double versionNs = TimePerCall(durationNs / 4, [&] {
+      for (int i = 0; i < 1000; i++)
+        sink += lock.Version();
+    });
+    double loadNs = TimePerCall(durationNs / 4, [&] { sink += lock.Load(s); });
+    printf("%-28s %10.2f\n", "Version() (per tick)", versionNs / 1000);
+    printf("%-28s %10.2f\n", "Load() (per update)", loadNs);
+    if (sink == 1)
+      printf("\n"); // Keeps the loops from being optimized away
+  }
+
+  // Torn reads: a writer publishes as fast as it can while the reader copies.
+  {
+    std::atomic<bool> stop(false);
+    uint64_t stores = 0;
+    std::thread writer([&] {
+      ClickSettings s;
+      for (int n = 2; !stop; n++) {
+        stamp(s, n);
+        lock.Store(s);
+        stores++;
+      }
+    });
+    uint64_t loads = 0, torn = 0;
+    ClickSettings s;
+    const int64_t end = Clock::NowNs() + durationNs / 2;
+    while (Clock::NowNs() < end) {
+      lock.Load(s);
+      loads++;
+      if (!consistent(s))
+        torn++;
+    }
+    stop = true;
+    writer.join();
+    printf("concurrent: %llu stores, %llu loads, %llu torn\n",
+           (unsigned long long)stores, (unsigned long long)loads,
+           (unsigned long long)torn);
+    if (torn)
+      ok = false;
+  }
+
+  RecordingInputSink *sink = new RecordingInputSink(1 << 20);
+  AutoClicker clicker((std::unique_ptr<InputSink>(sink)));
+
+  // Every click of a 1 ms clicker goes to a fixed position; updates move it.
+  // Clicks must land where one whole update put them, and the first click
+  // after an update must use it.
+  ClickSettings settings;
+  settings.intervalMs = 1;
+  settings.fixedPosition = true;
+  settings.x = settings.y = 0;
+  clicker.Start(settings);
+  std::vector<int64_t> updateNs(updates), callNs(updates);
+  for (int i = 0; i < updates; i++) {
+    settings.x = settings.y = i + 1;
+    Clock::SleepUntilNs(Clock::NowNs() + 3000000);
+    updateNs[i] = Clock::NowNs();
+    clicker.UpdateSettings(settings);
+    callNs[i] = Clock::NowNs() - updateNs[i];
+  }
+  Clock::SleepUntilNs(Clock::NowNs() + 3000000);
+  clicker.Stop();
+
+  std::vector<int64_t> pickup;
+  uint64_t mixed = 0, stale = 0;
+  {
+    std::vector<InputEvent> events = sink->GetEvents();
+    size_t next = 0; // Update whose first click we are looking for
+    for (const InputEvent &ev : events) {
+      if (ev.type != InputEventType::Move)
+        continue;
+      if (ev.x != ev.y)
+        mixed++;
+      while (next < (size_t)updates && ev.timeNs >= updateNs[next] &&
+             ev.x > (int)next + 1)
+        next++; // Overtaken by a later update before it clicked
+      if (next >= (size_t)updates || ev.timeNs < updateNs[next])
+        continue;
+      if (ev.x == (int)next + 1) {
+        pickup.push_back(ev.timeNs - updateNs[next]);
+        next++;
+      } else if (ev.timeNs - updateNs[next] - callNs[next] > 1000000) {
+        stale++; // A whole interval after UpdateSettings(), old position
+        next++;
+      } // Otherwise a tick that read its settings just before the update
+    }
+  }
+  printf("1 ms clicker, %d position updates:\n", updates);
+  printf("%-28s %10s %10s %10s\n", "", "p50 us", "p99 us", "max us");
+  auto report = [](const char *name, std::vector<int64_t> v) {
+    if (v.empty())
+      return;
+    std::sort(v.begin(), v.end());
+    printf("%-28s %10.1f %10.1f %10.1f\n", name, v[v.size() / 2] / 1e3,
+           v[v.size() * 99 / 100] / 1e3, v.back() / 1e3);
+  };
+  report("  UpdateSettings() call", callNs);
+  report("  update to 1st new click", pickup);
+  printf("  mixed x/y: %llu, stale clicks: %llu\n", (unsigned long long)mixed,
+         (unsigned long long)stale);
+  if (mixed || stale || pickup.empty())
+    ok = false;
+
+  // A long interval is cut short: 10 s -> 1 ms clicks within about 1 ms.
+  std::vector<int64_t> retune;
+  for (int i = 0; i < 20; i++) {
+    ClickSettings slow;
+    slow.intervalMs = 10000;
+    sink->Clear();
+    clicker.Start(slow);
+    while (sink->GetEventCount() == 0)
+      std::this_thread::yield();
+    Clock::SleepUntilNs(Clock::NowNs() + 2000000);
+    ClickSettings fast = slow;
+    fast.intervalMs = 1;
+    const int64_t t0 = Clock::NowNs();
+    clicker.UpdateSettings(fast);
+    while (sink->GetEventCount() < 4) // Down + up of the first two clicks
+      std::this_thread::yield();
+    retune.push_back(sink->GetEvents()[2].timeNs - t0);
+    clicker.Stop();
+  }
+  report("10 s -> 1 ms, next click", retune);
+  if (retune.back() > 1000000000LL)
+    ok = false;
+
+  printf("check: %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+// Click jitter with real-time mode off and on, same workload: the click
+// loop on a null sink while `load` threads keep every CPU busy. Without
+// privileges the "on" run shows what fell back.
+static int BenchRealTime(const BenchArgs &args) {
+  const int64_t durationNs =
+      (int64_t)(GetArgDouble(args, "seconds", 3.0) * 1e9);
+  const int intervalUs = (int)GetArgDouble(args, "interval-us", 1000);
+  const int cpu = (int)GetArgDouble(args, "cpu", -1);
+  const unsigned hw = std::thread::hardware_concurrency();
+  const int load = (int)GetArgDouble(args, "load", hw ? hw : 1);
+
+  std::atomic<bool> stopLoad(false);
+  std::vector<std::thread> hogs;
+  for (int i = 0; i < load; i++)
+    hogs.emplace_back([&stopLoad, i] {
+      volatile uint64_t x = i;
+      while (!stopLoad)
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    });
+
+  AutoClicker clicker((std::unique_ptr<InputSink>(new RecordingInputSink())));
+  printf("interval %d us, %d load threads, %.1f s per run\n", intervalUs,
+         load, durationNs / 1e9);
+  printf("%-5s %10s %10s %10s %10s %10s %9s  %s\n", "mode", "p50 us",
+         "p90 us", "p99 us", "p99.9 us", "max us", "skipped", "applied");
+  for (int on = 0; on < 2; on++) {
+    ClickSettings settings;
+    settings.intervalMs = intervalUs / 1000;
+    settings.intervalUs = intervalUs % 1000;
+    settings.missPolicy = (int)MissPolicy::Skip;
+    settings.realTime = on != 0;
+    settings.realTimeCpu = cpu;
+    clicker.Start(settings);
+    Clock::SleepUntilNs(Clock::NowNs() + durationNs);
+    const RealTimeStatus rt = clicker.GetRealTimeStatus();
+    clicker.Stop();
+
+    const SchedulerStats st = clicker.GetSchedulerStats();
+    printf("%-5s %10.1f %10.1f %10.1f %10.1f %10.1f %9llu  %s\n",
+           on ? "on" : "off", st.latenessP50Ns / 1e3, st.latenessP90Ns / 1e3,
+           st.latenessP99Ns / 1e3, st.latenessP999Ns / 1e3,
+           st.latenessMaxNs / 1e3, (unsigned long long)st.skippedTicks,
+           rt.Describe().c_str());
+    if (!rt.notes.empty())
+      printf("      fell back: %s\n", rt.notes.c_str());
+  }
+
+  stopLoad = true;
+  for (std::thread &t : hogs)
+    t.join();
+  return 0;
+}
+
+// The control server under many local clients. Checks each command once,
+// then measures round trips of one client and commands/sec of `clients`
+// concurrent clients, one request at a time and in pipelined batches, while
+// the clicker keeps clicking every millisecond.
+static int BenchControl(const BenchArgs &args) {
+  const int64_t durationNs =
+      (int64_t)(GetArgDouble(args, "seconds", 1.0) * 1e9);
+  const int clients = (int)GetArgDouble(args, "clients", 256);
+  const int batch = (int)GetArgDouble(args, "batch", 32);
+
+  AutoClicker clicker((std::unique_ptr<InputSink>(new RecordingInputSink())));
+  ClickSettings initial;
+  ControlServer server(clicker, initial);
+  std::string endpoint = DefaultControlEndpoint(), error;
+  if (!server.Start(endpoint, error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  printf("endpoint %s\n", endpoint.c_str());
+
+  bool ok = true;
+  auto check = [&ok](bool condition, const char *what) {
+    if (!condition) {
+      fprintf(stderr, "FAIL %s\n", what);
+      ok = false;
+    }
+  };
+
+  // Every command once, on one connection.
+  {
+    ControlClient client;
+    check(client.Connect(endpoint), "connect");
+    ControlHeader h;
+    std::string reply;
+    check(client.Call(ControlOp::Ping, "hello", 5, h, reply) &&
+              reply == "hello",
+          "ping echo");
+    ClickSettings changed = initial;
+    changed.intervalMs = 1;
+    changed.fixedPosition = true;
+    changed.x = 123;
+    const std::string fields = EncodeSettingsChanges(initial, changed);
+    check(client.Call(ControlOp::SetSettings, fields.data(), fields.size(), h,
+                      reply) &&
+              h.status == (uint8_t)ControlStatus::Ok,
+          "set settings");
+    ClickSettings readBack;
+    check(client.Call(ControlOp::GetSettings, nullptr, 0, h, reply) &&
+              DecodeSettingsRecord((const uint8_t *)reply.data(),
+                                   reply.size(), readBack) &&
+              readBack.x == 123 && readBack.intervalMs == 1,
+          "get settings");
+    check(client.Call(ControlOp::Start, nullptr, 0, h, reply) &&
+              clicker.IsRunning(),
+          "start");
+    Clock::SleepUntilNs(Clock::NowNs() + 20000000);
+    ControlCounters counters = {};
+    check(client.Call(ControlOp::GetCounters, nullptr, 0, h, reply) &&
+              reply.size() == sizeof(counters),
+          "get counters");
+    memcpy(&counters, reply.data(), std::min(reply.size(), sizeof(counters)));
+    check(counters.running == 1 && counters.clicks > 0, "counters running");
+    check(client.Call(ControlOp::Stop, nullptr, 0, h, reply) &&
+              !clicker.IsRunning(),
+          "stop");
+    check(client.Call((ControlOp)99, nullptr, 0, h, reply) &&
+              h.status == (uint8_t)ControlStatus::UnknownOp,
+          "unknown op");
+    printf("3 changed fields: %zu bytes; full settings record: %zu bytes\n",
+           fields.size(), EncodeSettingsRecord(readBack).size());
+  }
+
+  auto report = [](const char *name, std::vector<int64_t> &v) {
+    std::sort(v.begin(), v.end());
+    printf("%-30s %10.1f %10.1f %10.1f\n", name, v[v.size() / 2] / 1e3,
+           v[v.size() * 99 / 100] / 1e3, v.back() / 1e3);
+  };
+  printf("%-30s %10s %10s %10s\n", "round trip", "p50 us", "p99 us",
+         "max us");
+  {
+    ControlClient client;
+    client.Connect(endpoint);
+    ControlHeader h;
+    std::string reply;
+    std::vector<int64_t> rtt;
+    for (int i = 0; i < 20000; i++) {
+      const int64_t t0 = Clock::NowNs();
+      if (!client.Call(ControlOp::GetCounters, nullptr, 0, h, reply))
+        break;
+      rtt.push_back(Clock::NowNs() - t0);
+    }
+    check(rtt.size() == 20000, "single client round trips");
+    if (!rtt.empty())
+      report("1 client, GetCounters", rtt);
+  }
+
+  // Load: every client connects first, then all send at once.
+  ClickSettings clicking;
+  clicking.intervalMs = 1;
+  clicker.Start(clicking);
+  const int depths[] = {1, batch};
+  for (int depth : depths) {
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false), failed(false);
+    std::atomic<uint64_t> commands(0);
+    std::vector<std::vector<int64_t>> rtts(clients);
+    std::vector<std::thread> threads;
+    for (int c = 0; c < clients; c++)
+      threads.emplace_back([&, c] {
+        ControlClient client;
+        if (!client.Connect(endpoint)) {
+          failed = true;
+          ready++;
+          return;
+        }
+        ready++;
+        while (!go)
+          std::this_thread::yield();
+        ControlHeader h;
+        std::string reply;
+        const int64_t end = Clock::NowNs() + durationNs;
+        while (Clock::NowNs() < end) {
+          const int64_t t0 = Clock::NowNs();
+          for (int i = 0; i < depth; i++)
+            client.Queue(i % 2 ? ControlOp::Ping : ControlOp::GetCounters);
+          if (!client.Flush()) {
+            failed = true;
+            return;
+          }
+          for (int i = 0; i < depth; i++)
+            if (!client.Receive(h, reply) ||
+                h.status != (uint8_t)ControlStatus::Ok) {
+              failed = true;
+              return;
+            }
+          rtts[c].push_back(Clock::NowNs() - t0);
+          commands += depth;
+        }
+      });
+    while (ready < clients)
+      std::this_thread::yield();
+    // The server accepts in its own time; give it a moment to catch up.
+    const int64_t acceptEnd = Clock::NowNs() + 1000000000LL;
+    while (server.GetConnectionCount() < clients && Clock::NowNs() < acceptEnd)
+      std::this_thread::yield();
+    const int peak = server.GetConnectionCount();
+    const int64_t t0 = Clock::NowNs();
+    go = true;
+    for (std::thread &t : threads)
+      t.join();
+    const double seconds = (Clock::NowNs() - t0) / 1e9;
+    check(!failed, "load clients");
+
+    std::vector<int64_t> all;
+    for (std::vector<int64_t> &v : rtts)
+      all.insert(all.end(), v.begin(), v.end());
+    char name[64];
+    snprintf(name, sizeof(name), "%d clients x %d pipelined", clients, depth);
+    if (!all.empty())
+      report(name, all);
+    printf("%-30s %10.0f commands/s, %d connections\n", "", commands / seconds,
+           peak);
+  }
+  clicker.Stop();
+  const SchedulerStats st = clicker.GetSchedulerStats();
+  printf("clicker during load: %llu ticks, lateness p50 %.1f us, p99 %.1f us\n",
+         (unsigned long long)st.ticks, st.latenessP50Ns / 1e3,
+         st.latenessP99Ns / 1e3);
+  printf("requests served: %llu\n",
+         (unsigned long long)server.GetRequestCount());
+  server.Stop();
+  printf("check: %s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
+
+// Key press to first click through HotkeyListener: presses a hotkey, waits
+// for the click that starts the run, presses it again to stop. On Windows
+// the key is injected with SendInput (F24) and goes through the low-level
+// hook, which lets injected keys through for this listener only
+// (SetAcceptInjected). On Linux the listener reads a FIFO fed with input_event records,
+// which goes through the same poll/read/dispatch as a keyboard, without
+// needing /dev/uinput. Exits 1 if a press does not start or stop the
+// clicker, or if the median press-to-click is above --limit-us (the tail
+// mostly shows how busy the machine is).
+static int BenchHotkey(const BenchArgs &args) {
+  const int presses = (int)GetArgDouble(args, "presses", 200);
+  const double limitUs = GetArgDouble(args, "limit-us", 1000.0);
+  RecordingInputSink *sink = new RecordingInputSink(4096);
+  AutoClicker clicker((std::unique_ptr<InputSink>(sink)));
+  ClickSettings settings;
+  settings.intervalMs = 10000; // One click per run
+
+  Hotkey hotkey;
+  ParseHotkey("F24", hotkey);
+  HotkeyListener listener;
+  listener.AddJob(clicker, settings, {hotkey});
+  listener.SetAcceptInjected(true); // SendInput below; no effect on Linux
+  std::vector<std::string> devices;
+#ifdef __linux__
+  const std::string fifo =
+      "/tmp/autoclicker-hotkey-" + std::to_string(getpid());
+  if (mkfifo(fifo.c_str(), 0600) != 0) {
+    fprintf(stderr, "Cannot create %s\n", fifo.c_str());
+    return 1;
+  }
+  devices.push_back(fifo);
+#endif
+  const bool started = listener.Start(nullptr, devices);
+#ifdef __linux__
+  const int keyboard = started ? open(fifo.c_str(), O_WRONLY) : -1;
+  unlink(fifo.c_str());
+#endif
+  if (!started) {
+    fprintf(stderr, "Cannot start the hotkey listener\n");
+    return 1;
+  }
+
+  auto press = [&] {
+#ifdef _WIN32
+    INPUT in[2] = {};
+    in[0].type = in[1].type = INPUT_KEYBOARD;
+    in[0].ki.wVk = in[1].ki.wVk = (WORD)hotkey.key;
+    in[1].ki.dwFlags = KEYEVENTF_KEYUP;
+    SendInput(2, in, sizeof(INPUT));
+#elif defined(__linux__)
+    input_event ev[4] = {};
+    ev[0].type = ev[2].type = EV_KEY;
+    ev[0].code = ev[2].code = (uint16_t)hotkey.key;
+    ev[0].value = 1;
+    ev[1].type = ev[3].type = EV_SYN; // SYN_REPORT after each, as evdev does
+    ssize_t written = write(keyboard, ev, sizeof(ev));
+    (void)written;
+#endif
+  };
+  // Waits up to a second for `done`.
+  auto await = [](const std::function<bool()> &done) {
+    const int64_t deadline = Clock::NowNs() + 1000000000;
+    while (!done()) {
+      if (Clock::NowNs() > deadline)
+        return false;
+      // Sleeps rather than spins, so on a single CPU the listener and the
+      // worker get it at once. The click time comes from the sink's stamp.
+      Clock::SleepUntilNs(Clock::NowNs() + 20000);
+    }
+    return true;
+  };
+
+  std::vector<int64_t> toClick, toStop;
+  bool ok = true;
+  for (int i = 0; i < presses && ok; i++) {
+    sink->Clear();
+    const int64_t t0 = Clock::NowNs();
+    press();
+    ok = await([&] { return sink->GetEventCount() > 0; });
+    if (!ok)
+      break;
+    toClick.push_back(sink->GetEvents()[0].timeNs - t0);
+
+    Clock::SleepUntilNs(Clock::NowNs() + 200000);
+    const int64_t t1 = Clock::NowNs();
+    press();
+    ok = await([&] { return !clicker.IsRunning(); });
+    toStop.push_back(Clock::NowNs() - t1);
+    Clock::SleepUntilNs(Clock::NowNs() + 200000);
+  }
+  listener.Stop();
+  clicker.Stop();
+#ifdef __linux__
+  close(keyboard);
+#endif
+
+  auto report = [](const char *name, std::vector<int64_t> &v) {
+    std::sort(v.begin(), v.end());
+    printf("%-24s %10.1f %10.1f %10.1f\n", name, v[v.size() / 2] / 1e3,
+           v[v.size() * 99 / 100] / 1e3, v.back() / 1e3);
+    return v[v.size() / 2] / 1e3;
+  };
+  double p50 = 0;
+  if (!toClick.empty() && !toStop.empty()) {
+    printf("%d presses of F24 through the %s\n", (int)toClick.size(),
+#ifdef _WIN32
+           "low-level keyboard hook");
+#else
+           "evdev reader");
+#endif
+    printf("%-24s %10s %10s %10s\n", "", "p50 us", "p99 us", "max us");
+    p50 = report("key press to 1st click", toClick);
+    report("key press to stopped", toStop);
+  }
+  printf("toggles: %llu\n", (unsigned long long)listener.GetToggleCount());
+  ok = ok && p50 <= limitUs;
+  printf("check: %s (p50 %.1f us, limit %.0f us)\n", ok ? "PASS" : "FAIL", p50,
+         limitUs);
+  return ok ? 0 : 1;
+}
+
+// Runs the CLI once and returns its stdout, with `ns` set to spawn-to-exit.
+// False if it could not be started or did not exit with 0.
+static bool RunProcess(const std::string &path,
+                       const std::vector<std::string> &argList,
+                       std::string &output, int64_t &ns) {
+  output.clear();
+  const int64_t t0 = Clock::NowNs();
+#ifdef _WIN32
+  std::string cmd = "\"" + path + "\"";
+  for (const std::string &a : argList)
+    cmd += " " + a;
+  SECURITY_ATTRIBUTES sa = {sizeof(sa), nullptr, TRUE};
+  HANDLE readEnd, writeEnd;
+  if (!CreatePipe(&readEnd, &writeEnd, &sa, 0))
+    return false;
+  SetHandleInformation(readEnd, HANDLE_FLAG_INHERIT, 0);
+  STARTUPINFOA si = {};
+  si.cb = sizeof(si);
+  si.dwFlags = STARTF_USESTDHANDLES;
+  si.hStdOutput = writeEnd;
+  si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+  PROCESS_INFORMATION pi;
+  const BOOL started = CreateProcessA(nullptr, &cmd[0], nullptr, nullptr, TRUE,
+                                      0, nullptr, nullptr, &si, &pi);
+  CloseHandle(writeEnd);
+  if (!started) {
+    CloseHandle(readEnd);
+    return false;
+  }
+  char buf[4096];
+  DWORD n;
+  while (ReadFile(readEnd, buf, sizeof(buf), &n, nullptr) && n > 0)
+    output.append(buf, n);
+  CloseHandle(readEnd);
+  WaitForSingleObject(pi.hProcess, INFINITE);
+  ns = Clock::NowNs() - t0;
+  DWORD code = 1;
+  GetExitCodeProcess(pi.hProcess, &code);
+  CloseHandle(pi.hThread);
+  CloseHandle(pi.hProcess);
+  return code == 0;
+#else
+  std::vector<char *> argv;
+  argv.push_back(const_cast<char *>(path.c_str()));
+  for (const std::string &a : argList)
+    argv.push_back(const_cast<char *>(a.c_str()));
+  argv.push_back(nullptr);
+  int fds[2];
+  if (pipe(fds) != 0)
+    return false;
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, fds[1], 1);
+  posix_spawn_file_actions_addclose(&actions, fds[0]);
+  pid_t pid;
+  const int err = posix_spawn(&pid, path.c_str(), &actions, nullptr,
+                              argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  close(fds[1]);
+  if (err != 0) {
+    close(fds[0]);
+    return false;
+  }
+  char buf[4096];
+  ssize_t n;
+  while ((n = read(fds[0], buf, sizeof(buf))) > 0)
+    output.append(buf, (size_t)n);
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  ns = Clock::NowNs() - t0;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+}
+
+// Cold start of the headless clicker: spawns it `runs` times for one click
+// into the null sink and reports the time from its main() to the first click
+// (as it prints it) and from spawn to exit. Exits 1 if the p99 startup is
+// above --limit-ms.
+static int BenchStartup(const BenchArgs &args) {
+  const int runs = std::max(1, (int)GetArgDouble(args, "runs", 50));
+  const double limitMs = GetArgDouble(args, "limit-ms", 5.0);
+#ifdef _WIN32
+  const std::string cli = GetArg(args, "cli", "bin\\AutoClickerCli.exe");
+#else
+  const std::string cli = GetArg(args, "cli", "bin/AutoClickerCli");
+#endif
+  const std::vector<std::string> cliArgs = {"--sink", "null", "--clicks", "1",
+                                            "--interval-ms", "1"};
+
+  std::vector<double> startupMs, processMs;
+  for (int i = 0; i < runs; i++) {
+    std::string out;
+    int64_t ns = 0;
+    if (!RunProcess(cli, cliArgs, out, ns)) {
+      fprintf(stderr, "Cannot run %s\n", cli.c_str());
+      return 1;
+    }
+    const size_t at = out.find("startup");
+    if (at == std::string::npos) {
+      fprintf(stderr, "No startup line in the output of %s\n", cli.c_str());
+      return 1;
+    }
+    startupMs.push_back(atof(out.c_str() + at + strlen("startup")));
+    processMs.push_back(ns / 1e6);
+  }
+
+  auto report = [&](const char *name, std::vector<double> &v) {
+    std::sort(v.begin(), v.end());
+    printf("%-28s p50 %7.3f  p99 %7.3f  max %7.3f ms\n", name,
+           v[v.size() / 2], v[v.size() * 99 / 100], v.back());
+    return v[v.size() * 99 / 100];
+  };
+  printf("%d runs of %s\n", runs, cli.c_str());
+  const double p99 = report("main() to first click", startupMs);
+  report("spawn to exit", processMs);
+  const bool ok = p99 <= limitMs;
+  printf("check: %s (p99 startup %.3f ms, limit %.1f ms)\n",
+         ok ? "PASS" : "FAIL", p99, limitMs);
+  return ok ? 0 : 1;
+}
+
+static const char kBenchPack[] =
+    "# As themes/matrix.theme\n"
+    "name = Matrix\n"
+    "order = 2\n"
+    "background = #000000\n"
+    "text = #00FF00\n"
+    "animation = rain\n"
+    "particles = 40\n"
+    "speed = 2.0 6.9\n"
+    "length = 5 19\n"
+    "glyphs = 01\n"
+    "glyph-font = Consolas\n"
+    "glyph-size = 14\n"
+    "glyph-colors = #00FF00 #008C00 #008200 #007800 #006E00 #006400 #005A00 "
+    "#005000 #004600 #003C00 #003200 #003200\n";
+
+static bool SameTheme(const ThemeDesc &a, const ThemeDesc &b) {
+  const ParticleParams &p = a.particles, &q = b.particles;
+  return a.name == b.name && a.order == b.order &&
+         a.systemColors == b.systemColors && a.background == b.background &&
+         a.text == b.text && a.hatch == b.hatch &&
+         a.hatchColor == b.hatchColor && a.animation == b.animation &&
+         a.particleCount == b.particleCount && p.minSpeed == q.minSpeed &&
+         p.maxSpeed == q.maxSpeed && p.minLength == q.minLength &&
+         p.maxLength == q.maxLength && p.minSize == q.minSize &&
+         p.maxSize == q.maxSize && p.minBrightness == q.minBrightness &&
+         p.maxBrightness == q.maxBrightness && a.glyphs == b.glyphs &&
+         a.glyphFont == b.glyphFont && a.glyphSize == b.glyphSize &&
+         a.glyphColors == b.glyphColors;
+}
+
+// Theme packs: checks that a pack survives parse -> blob -> decode and that
+// bad packs and out-of-range records are refused; compares loading 6 to 100k
+// themes from the compiled blob (map + decode the selected one) with parsing
+// their text packs; then
+// rewrites the blob --reloads times under a running ThemeLibrary::Watch()
+// while a reader thread keeps drawing themes from it, and reports the time
+// from the rewrite to the swap. Exits 1 if a check fails, a reader ever sees
+// a broken theme, or loading 100k themes takes longer than --limit-us.
+static int BenchThemes(const BenchArgs &args) {
+  const int reloads = (int)GetArgDouble(args, "reloads", 50);
+  const double limitUs = GetArgDouble(args, "limit-us", 1000.0);
+  const std::string path = "bench_themes.bin";
+  bool ok = true;
+
+  ThemeDesc matrix;
+  std::string error;
+  ThemeBlob decoded;
+  ThemeDesc back;
+  const std::string one = EncodeThemeBlob(
+      {ParseThemePack(kBenchPack, matrix, error) ? matrix : ThemeDesc()});
+  const bool roundTrip =
+      error.empty() &&
+      decoded.Attach((const uint8_t *)one.data(), one.size()) &&
+      decoded.Count() == 1 && decoded.Get(0, back) && SameTheme(matrix, back);
+  const char *bad[] = {"name = X\nbackground = #12345\n",
+                       "name = X\nspeed = 5 1\n",
+                       "name = X\nanimation = snow\n",
+                       "name = X\nanimation = rain\n", "order = 1\n",
+                       "name = X\ncolour = #000000\n"};
+  int refused = 0;
+  for (const char *text : bad)
+    refused += ParseThemePack(text, back, error) ? 0 : 1;
+  const std::string truncated = one.substr(0, one.size() - 1);
+  bool refusedBlob =
+      !decoded.Attach((const uint8_t *)truncated.data(), truncated.size());
+  // Records the parser would never write: the blob is read as is, so the
+  // loader must check them again.
+  ThemeDesc huge = matrix, tiny = matrix, wide = matrix;
+  huge.particleCount = 100001;
+  tiny.glyphSize = 0;
+  wide.particles.minBrightness = INT_MIN;
+  wide.particles.maxBrightness = INT_MAX;
+  const std::string forged = EncodeThemeBlob({huge, tiny, wide});
+  refusedBlob = refusedBlob &&
+                decoded.Attach((const uint8_t *)forged.data(), forged.size()) &&
+                !decoded.Get(0, back) && !decoded.Get(1, back) &&
+                !decoded.Get(2, back);
+  printf("round trip %s, %d/%d bad packs refused, truncated or forged blob "
+         "%s\n",
+         roundTrip ? "exact" : "DIFFERS", refused, (int)(sizeof(bad) /
+         sizeof(bad[0])), refusedBlob ? "refused" : "ACCEPTED");
+  ok = roundTrip && refused == (int)(sizeof(bad) / sizeof(bad[0])) &&
+       refusedBlob;
+
+  printf("%-8s %12s %14s %14s\n", "themes", "blob bytes", "blob load us",
+         "parse packs us");
+  double largestUs = 0;
+  for (size_t count : {(size_t)6, (size_t)1000, (size_t)100000}) {
+    std::vector<ThemeDesc> themes(count, matrix);
+    std::vector<std::string> texts(count);
+    for (size_t i = 0; i < count; i++) {
+      themes[i].name = "Theme " + std::to_string(i);
+      texts[i] = "name = " + themes[i].name + "\n" + kBenchPack;
+    }
+    const std::string blob = EncodeThemeBlob(themes);
+    if (!WriteFileAtomic(path, blob.data(), blob.size())) {
+      fprintf(stderr, "Cannot write %s\n", path.c_str());
+      return 1;
+    }
+
+    // What startup does: map, check, decode the selected theme.
+    std::vector<double> loadUs;
+    for (int i = 0; i < 21; i++) {
+      const int64_t t0 = Clock::NowNs();
+      ThemeBlob b;
+      ThemeDesc selected;
+      if (!b.Open(path) || !b.Get(count / 2, selected)) {
+        fprintf(stderr, "Cannot load %s\n", path.c_str());
+        return 1;
+      }
+      loadUs.push_back((Clock::NowNs() - t0) / 1e3);
+    }
+    std::sort(loadUs.begin(), loadUs.end());
+    const int64_t t0 = Clock::NowNs();
+    for (const std::string &text : texts)
+      ParseThemePack(text, back, error);
+    const double parseUs = (Clock::NowNs() - t0) / 1e3;
+    printf("%-8zu %12zu %14.1f %14.1f\n", count, blob.size(),
+           loadUs[loadUs.size() / 2], parseUs);
+    largestUs = loadUs[loadUs.size() / 2];
+  }
+
+  // Hot reload: alternate a 6- and a 7-theme blob under a running watcher.
+  std::vector<ThemeDesc> six(6, matrix), seven(7, matrix);
+  const std::string blobs[2] = {EncodeThemeBlob(six), EncodeThemeBlob(seven)};
+  ThemeLibrary library;
+  if (!WriteFileAtomic(path, blobs[0].data(), blobs[0].size()) ||
+      !library.Load(path) || !library.Watch(nullptr)) {
+    fprintf(stderr, "Cannot watch %s\n", path.c_str());
+    remove(path.c_str());
+    return 1;
+  }
+  std::atomic<bool> reading(true);
+  std::atomic<uint64_t> reads(0), broken(0);
+  std::thread reader([&] {
+    ThemeDesc t;
+    while (reading) {
+      std::shared_ptr<const ThemeBlob> b = library.Get();
+      const size_t n = b->Count();
+      if ((n != 6 && n != 7) || !b->Get(reads % n, t) ||
+          !SameTheme(t, matrix))
+        broken++;
+      reads++;
+    }
+  });
+  std::vector<double> swapUs;
+  int missed = 0;
+  for (int i = 1; i <= reloads; i++) {
+    const uint64_t before = library.GetReloadCount();
+    const std::string &blob = blobs[i % 2];
+    const int64_t t0 = Clock::NowNs();
+    WriteFileAtomic(path, blob.data(), blob.size());
+    while (library.GetReloadCount() == before &&
+           Clock::NowNs() - t0 < 2000000000)
+      std::this_thread::sleep_for(std::chrono::microseconds(20));
+    if (library.GetReloadCount() == before)
+      missed++;
+    else
+      swapUs.push_back((Clock::NowNs() - t0) / 1e3);
+  }
+  library.StopWatching();
+  reading = false;
+  reader.join();
+  remove(path.c_str());
+
+  std::sort(swapUs.begin(), swapUs.end());
+  if (!swapUs.empty())
+    printf("%d reloads: rewrite to swap p50 %.0f us, max %.0f us; %llu "
+           "reads, %llu broken, %d missed\n",
+           reloads, swapUs[swapUs.size() / 2], swapUs.back(),
+           (unsigned long long)reads.load(),
+           (unsigned long long)broken.load(), missed);
+  ok = ok && broken == 0 && missed == 0 && largestUs <= limitUs;
+  printf("check: %s (100k-theme load %.1f us, limit %.0f us)\n",
+         ok ? "PASS" : "FAIL", largestUs, limitUs);
+  return ok ? 0 : 1;
+}
+
+static void PrintUsage() {
+  printf("Usage: AutoClickerBench <benchmark> [options]\n\n"
+         "  burst [--sink null|win32|uinput] [--seconds N]\n"
+         "      Clicks/sec of one-pair-per-call vs. batched injection.\n"
+         "  macro [--steps N] [--seconds N]\n"
+         "      Per-event cost of the macro interpreter vs. the click loop.\n"
+         "  render [--width W] [--height H] [--seconds N]\n"
+         "      Per-frame cost of the software theme renderer.\n"
+         "  particles [--seconds N]\n"
+         "      Per-particle cost of one animation step.\n"
+         "  glyphs [--seconds N]\n"
+         "      Matrix rain frame cost with the pre-rendered glyph atlas.\n"
+         "  dirty [--width W] [--height H] [--frames N] [--max-rects N]\n"
+         "      Pixels pushed per frame with dirty rectangles vs. full "
+         "repaint.\n"
+         "  frames [--width W] [--height H] [--seconds N]\n"
+         "      Render thread pacing at 30/60/120 Hz; static themes park.\n"
+         "  engine [--period-ms P] [--seconds N]\n"
+         "      Multi-job scheduling cost and accuracy at 10/1k/100k jobs.\n"
+         "  replay [--events N] [--seconds N] [--file PATH] [--keep]\n"
+         "      Input log size, decode speed, memory and replay timing.\n"
+         "  distributions [--samples N]\n"
+         "      Humanizer sampling cost; chi-square check of each stream.\n"
+         "  pixels [--seconds N] [--poll-hz N]\n"
+         "      Pixel trigger kernels: check, polls/sec at 1080p/4K, "
+         "paint-to-click.\n"
+         "  templates [--seconds N] [--size N]\n"
+         "      Template matches/sec on synthetic 1080p and 4K frames.\n"
+         "  startstop [--cycles N] [--threads N] [--seconds N]\n"
+         "      Start/Stop call time, start-to-first-click, quiet after "
+         "Stop;\n"
+         "      concurrent Start/Stop/Toggle from several threads.\n"
+         "  hotswap [--seconds N] [--updates N]\n"
+         "      Live settings: reader cost, torn-read check, update-to-click "
+         "time.\n"
+         "  realtime [--seconds N] [--interval-us N] [--load N] [--cpu N]\n"
+         "      Click jitter under CPU load with real-time mode off and on.\n"
+         "  control [--seconds N] [--clients N] [--batch N]\n"
+         "      Control server: command check, round trips, commands/sec "
+         "under load.\n"
+         "  startup [--runs N] [--cli PATH] [--limit-ms N]\n"
+         "      Headless clicker cold start: main() to first click, spawn to "
+         "exit.\n"
+         "  hotkey [--presses N] [--limit-us N]\n"
+         "      Hotkey listener: key press to first click and to stopped.\n"
+         "  overlay [--width W] [--height H] [--frames N]\n"
+         "      Overlay display list lookup vs. per-element scan, 10-10k "
+         "labels.\n"
+         "  themes [--reloads N] [--limit-us N]\n"
+         "      Theme blob vs. text pack loading at 6-100k themes; hot "
+         "reload.\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    PrintUsage();
+    return 1;
+  }
+  std::string name = argv[1];
+  BenchArgs args = ParseArgs(argc, argv, 2);
+
+  if (name == "burst")
+    return BenchBurst(args);
+  if (name == "macro")
+    return BenchMacro(args);
+  if (name == "render")
+    return BenchRender(args);
+  if (name == "particles")
+    return BenchParticles(args);
+  if (name == "glyphs")
+    return BenchGlyphs(args);
+  if (name == "dirty")
+    return BenchDirty(args);
+  if (name == "frames")
+    return BenchFrames(args);
+  if (name == "engine")
+    return BenchEngine(args);
+  if (name == "replay")
+    return BenchReplay(args);
+  if (name == "distributions")
+    return BenchDistributions(args);
+  if (name == "pixels")
+    return BenchPixels(args);
+  if (name == "templates")
+    return BenchTemplates(args);
+  if (name == "startstop")
+    return BenchStartStop(args);
+  if (name == "hotswap")
+    return BenchHotSwap(args);
+  if (name == "realtime")
+    return BenchRealTime(args);
+  if (name == "control")
+    return BenchControl(args);
+  if (name == "startup")
+    return BenchStartup(args);
+  if (name == "hotkey")
+    return BenchHotkey(args);
+  if (name == "overlay")
+    return BenchOverlay(args);
+  if (name == "themes")
+    return BenchThemes(args);
+
+  PrintUsage();
+  return 1;
+}
@@ -0,0 +1,446 @@
+// Headless click engine for automation farms: no window, no GDI, no common
+// controls. Settings come from settings.dat and/or the command line; runs
+// until a limit is reached, the macro or replay ends, or Ctrl+C, then prints
+// a summary.
+//
+//   AutoClickerCli [--settings PATH] [--profile NAME]
+//                  [--interval-ms N] [--interval-us N] [--button left|right]
+//                  [--pos X Y] [--cursor] [--miss-policy catchup|skip]
+//                  [--burst] [--interval-jitter uniform|gaussian US]
+//                  [--position-jitter uniform|gaussian PX]
+//                  [--real-time] [--cpu N]
+//                  [--macro FILE] [--replay FILE]
+//                  [--clicks N] [--seconds N]
+//                  [--sink default|null|uinput|win32] [--control]
+//                  [--hotkey KEY]... [--device PATH]...
+//
+// Exit code 0 after a normal run, 1 on bad arguments or files.
+
+#include "AutoClicker.h"
+#include "Clock.h"
+#include "ControlServer.h"
+#include "Distribution.h"
+#include "HotkeyListener.h"
+#include "Macro.h"
+#include "SettingsFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <csignal>
+#endif
+
+namespace {
+
+// Taken first thing in main(), so the reported startup covers everything
+// this program does before its first click.
+int64_t g_mainNs = 0;
+
+WakeSignal *g_interrupt = nullptr; // Notified by Ctrl+C / SIGTERM
+
+// Forwards to the real sink, stamps the first press, and swallows presses
+// past the --clicks limit (notifying `done` when it is reached), so the run
+// ends on the exact count without the worker having to stop itself.
+class CountingSink : public InputSink {
+public:
+  CountingSink(std::unique_ptr<InputSink> target, uint64_t limit,
+               WakeSignal &done)
+      : target(std::move(target)), limit(limit), done(done), presses(0),
+        firstPressNs(0) {}
+
+  const char *Name() const override { return target->Name(); }
+  bool MoveTo(int x, int y) override { return target->MoveTo(x, y); }
+  bool Button(MouseButton button, bool down) override {
+    if (down && Take(1) == 0)
+      return false;
+    return target->Button(button, down);
+  }
+  bool Click(MouseButton button) override {
+    return Take(1) == 1 && target->Click(button);
+  }
+  int ClickBurst(MouseButton button, int count) override {
+    int allowed = Take(count);
+    return allowed ? target->ClickBurst(button, allowed) : 0;
+  }
+  bool Key(int key, bool down) override { return target->Key(key, down); }
+  bool Wheel(int delta) override { return target->Wheel(delta); }
+
+  uint64_t GetPresses() const { return presses.load(); }
+  int64_t GetFirstPressNs() const { return firstPressNs.load(); }
+
+private:
+  // How many of `count` presses may still go out. Worker thread only.
+  int Take(int count) {
+    const uint64_t sent = presses.load(std::memory_order_relaxed);
+    if (limit && sent >= limit)
+      return 0;
+    if (limit && sent + count > limit)
+      count = (int)(limit - sent);
+    if (sent == 0)
+      firstPressNs.store(Clock::NowNs());
+    presses.store(sent + count);
+    if (limit && sent + count == limit)
+      done.Notify();
+    return count;
+  }
+
+  std::unique_ptr<InputSink> target;
+  const uint64_t limit; // 0: none
+  WakeSignal &done;
+  std::atomic<uint64_t> presses;
+  std::atomic<int64_t> firstPressNs;
+};
+
+#ifdef _WIN32
+BOOL WINAPI OnConsoleCtrl(DWORD) {
+  if (g_interrupt)
+    g_interrupt->Notify();
+  return TRUE;
+}
+#else
+void OnSignal(int) {
+  if (g_interrupt)
+    g_interrupt->Notify(); // An atomic store and a write(): signal safe
+}
+#endif
+
+void PrintUsage() {
+  printf(
+      "Usage: AutoClickerCli [options]\n\n"
+      "Settings (applied in this order):\n"
+      "  --settings PATH        settings file (default settings.dat if a\n"
+      "                         profile is named)\n"
+      "  --profile NAME         profile from the settings file (default: its\n"
+      "                         active profile)\n"
+      "  --interval-ms N        --interval-us N (the whole period in us)\n"
+      "  --button left|right    --pos X Y (fixed position)   --cursor\n"
+      "  --miss-policy catchup|skip                 --burst\n"
+      "  --interval-jitter uniform|gaussian US\n"
+      "  --position-jitter uniform|gaussian PX\n"
+      "  --real-time [--cpu N]  pin the worker at real-time priority\n"
+      "What to run:\n"
+      "  --macro FILE           macro script instead of single clicks\n"
+      "  --replay FILE          recorded input log instead of single clicks\n"
+      "When to stop (else Ctrl+C, or the end of a macro / replay):\n"
+      "  --clicks N             --seconds N\n"
+      "Other:\n"
+      "  --sink default|null|uinput|win32\n"
+      "  --control              serve the control protocol on %s\n"
+      "  --hotkey KEY           start/stop on KEY (e.g. F6, Ctrl+Shift+A)\n"
+      "                         instead of at once; may be repeated\n"
+      "  --device PATH          keyboard to watch for --hotkey (Linux;\n"
+      "                         default: all of /dev/input)\n",
+      DefaultControlEndpoint().c_str());
+}
+
+bool ParseDistribution(const char *name, int &kind) {
+  if (strcmp(name, "uniform") == 0)
+    kind = (int)DistributionKind::Uniform;
+  else if (strcmp(name, "gaussian") == 0)
+    kind = (int)DistributionKind::Gaussian;
+  else
+    return false;
+  return true;
+}
+
+// Whole decimal numbers in lo..hi only: "10x" and "" are refused.
+bool ParseInteger(const char *text, long long lo, long long hi,
+                  long long &out) {
+  char *end = nullptr;
+  errno = 0;
+  out = strtoll(text, &end, 10);
+  return end != text && *end == 0 && errno == 0 && out >= lo && out <= hi;
+}
+
+// ParseInteger into an int setting; exits with code 1 and `what` on error.
+int IntegerArg(const char *text, const char *opt, long long lo,
+               const char *what) {
+  long long n = 0;
+  if (!ParseInteger(text, lo, INT_MAX, n)) {
+    fprintf(stderr, "%s needs %s, not '%s'\n", opt, what, text);
+    exit(1);
+  }
+  return (int)n;
+}
+
+std::unique_ptr<InputSink> CreateSink(const std::string &name) {
+  if (name == "default")
+    return CreateDefaultInputSink();
+  if (name == "null")
+    return std::unique_ptr<InputSink>(new RecordingInputSink());
+#ifdef _WIN32
+  if (name == "win32")
+    return std::unique_ptr<InputSink>(new Win32InputSink());
+#endif
+#ifdef __linux__
+  if (name == "uinput") {
+    std::unique_ptr<UinputInputSink> sink(new UinputInputSink());
+    if (sink->IsOpen())
+      return std::unique_ptr<InputSink>(sink.release());
+    fprintf(stderr, "Cannot open /dev/uinput\n");
+    return nullptr;
+  }
+#endif
+  fprintf(stderr, "Unknown sink '%s'\n", name.c_str());
+  return nullptr;
+}
+
+void PrintLatency(const char *name, const LatencySnapshot &s) {
+  if (s.count == 0)
+    return;
+  printf("%-12s p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f us\n",
+         name, s.p50Ns / 1e3, s.p90Ns / 1e3, s.p99Ns / 1e3, s.p999Ns / 1e3,
+         s.maxNs / 1e3);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  g_mainNs = Clock::NowNs();
+
+  // The settings file goes first so the other options override it.
+  std::string settingsPath, profile;
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--settings") == 0)
+      settingsPath = argv[i + 1];
+    else if (strcmp(argv[i], "--profile") == 0)
+      profile = argv[i + 1];
+  }
+  ClickSettings settings;
+  if (!profile.empty() && settingsPath.empty())
+    settingsPath = "settings.dat";
+  if (!settingsPath.empty()) {
+    SettingsFile file;
+    if (file.Open(settingsPath) != SettingsFile::Ok) {
+      fprintf(stderr, "Cannot read settings file %s\n", settingsPath.c_str());
+      return 1;
+    }
+    if (profile.empty())
+      profile = file.GetActiveProfileName();
+    if (!file.FindProfile(profile, settings)) {
+      fprintf(stderr, "No profile '%s' in %s\n", profile.c_str(),
+              settingsPath.c_str());
+      return 1;
+    }
+  }
+
+  std::string macroPath, replayPath, sinkName = "default";
+  uint64_t clickLimit = 0;
+  double seconds = 0.0;
+  bool control = false;
+  std::vector<Hotkey> hotkeys;
+  std::vector<std::string> devices;
+  for (int i = 1; i < argc; i++) {
+    const std::string opt = argv[i];
+    // Options with one or two values; a missing value is an error.
+    auto value = [&](int n) -> const char * {
+      return i + n < argc ? argv[i + n] : nullptr;
+    };
+    auto need = [&](int n) {
+      for (int k = 1; k <= n; k++)
+        if (!value(k)) {
+          fprintf(stderr, "%s needs %d value(s)\n", opt.c_str(), n);
+          exit(1);
+        }
+      i += n;
+    };
+    if (opt == "--settings" || opt == "--profile") {
+      need(1);
+    } else if (opt == "--interval-ms" || opt == "--interval-us") {
+      need(1);
+      const int n =
+          IntegerArg(argv[i], opt.c_str(), 1, "a positive whole number");
+      const bool us = opt == "--interval-us";
+      settings.intervalMs = us ? (int)(n / 1000) : (int)n;
+      settings.intervalUs = us ? (int)(n % 1000) : 0;
+    } else if (opt == "--button") {
+      need(1);
+      if (strcmp(argv[i], "left") != 0 && strcmp(argv[i], "right") != 0) {
+        fprintf(stderr, "Unknown button '%s'\n", argv[i]);
+        return 1;
+      }
+      settings.isLeftClick = strcmp(argv[i], "left") == 0;
+    } else if (opt == "--pos") {
+      need(2);
+      settings.fixedPosition = true;
+      settings.x = IntegerArg(argv[i - 1], "--pos", INT_MIN, "whole numbers");
+      settings.y = IntegerArg(argv[i], "--pos", INT_MIN, "whole numbers");
+    } else if (opt == "--cursor") {
+      settings.fixedPosition = false;
+    } else if (opt == "--miss-policy") {
+      need(1);
+      if (strcmp(argv[i], "catchup") == 0) {
+        settings.missPolicy = (int)MissPolicy::CatchUp;
+      } else if (strcmp(argv[i], "skip") == 0) {
+        settings.missPolicy = (int)MissPolicy::Skip;
+      } else {
+        fprintf(stderr, "Unknown miss policy '%s'\n", argv[i]);
+        return 1;
+      }
+    } else if (opt == "--burst") {
+      settings.burstMode = true;
+    } else if (opt == "--interval-jitter") {
+      need(2);
+      if (!ParseDistribution(argv[i - 1], settings.intervalDistribution)) {
+        fprintf(stderr, "Unknown distribution '%s'\n", argv[i - 1]);
+        return 1;
+      }
+      settings.intervalSpreadUs =
+          IntegerArg(argv[i], opt.c_str(), 0, "a whole number, 0 or more");
+    } else if (opt == "--position-jitter") {
+      need(2);
+      if (!ParseDistribution(argv[i - 1], settings.positionDistribution)) {
+        fprintf(stderr, "Unknown distribution '%s'\n", argv[i - 1]);
+        return 1;
+      }
+      settings.positionSpreadPx =
+          IntegerArg(argv[i], opt.c_str(), 0, "a whole number, 0 or more");
+    } else if (opt == "--real-time") {
+      settings.realTime = true;
+    } else if (opt == "--cpu") {
+      need(1);
+      settings.realTimeCpu =
+          IntegerArg(argv[i], "--cpu", 0, "a CPU number, 0 or more");
+    } else if (opt == "--macro") {
+      need(1);
+      macroPath = argv[i];
+    } else if (opt == "--replay") {
+      need(1);
+      replayPath = argv[i];
+    } else if (opt == "--clicks") {
+      need(1);
+      long long n = 0;
+      if (!ParseInteger(argv[i], 1, LLONG_MAX, n)) {
+        fprintf(stderr, "--clicks needs a positive whole number\n");
+        return 1;
+      }
+      clickLimit = (uint64_t)n;
+    } else if (opt == "--seconds") {
+      need(1);
+      char *end = nullptr;
+      seconds = strtod(argv[i], &end);
+      if (end == argv[i] || *end != 0 || !(seconds > 0.0)) {
+        fprintf(stderr, "--seconds needs a positive number\n");
+        return 1;
+      }
+    } else if (opt == "--sink") {
+      need(1);
+      sinkName = argv[i];
+    } else if (opt == "--control") {
+      control = true;
+    } else if (opt == "--hotkey") {
+      need(1);
+      Hotkey hk;
+      if (!ParseHotkey(argv[i], hk)) {
+        fprintf(stderr, "Unknown key '%s'\n", argv[i]);
+        return 1;
+      }
+      hotkeys.push_back(hk);
+    } else if (opt == "--device") {
+      need(1);
+      devices.push_back(argv[i]);
+    } else {
+      PrintUsage();
+      return opt == "--help" || opt == "-h" ? 0 : 1;
+    }
+  }
+  // Also covers a profile with a zero or negative period: same floor as the
+  // dialog, on the whole period.
+  ClampClickSettings(settings);
+
+  std::shared_ptr<MacroProgram> macro;
+  if (!macroPath.empty()) {
+    std::string error;
+    macro = std::make_shared<MacroProgram>();
+    if (!CompileMacroFile(macroPath, *macro, error)) {
+      fprintf(stderr, "%s: %s\n", macroPath.c_str(), error.c_str());
+      return 1;
+    }
+  }
+
+  std::unique_ptr<InputSink> target = CreateSink(sinkName);
+  if (!target)
+    return 1;
+  WakeSignal done;
+  g_interrupt = &done;
+#ifdef _WIN32
+  SetConsoleCtrlHandler(OnConsoleCtrl, TRUE);
+#else
+  signal(SIGINT, OnSignal);
+  signal(SIGTERM, OnSignal);
+#endif
+
+  CountingSink *sink = new CountingSink(std::move(target), clickLimit, done);
+  AutoClicker clicker((std::unique_ptr<InputSink>(sink)));
+  clicker.SetMacro(macro);
+  clicker.SetReplayLog(replayPath);
+
+  std::unique_ptr<ControlServer> server;
+  if (control) {
+    std::string error;
+    server.reset(new ControlServer(clicker, settings));
+    if (!server->Start(DefaultControlEndpoint(), error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    fprintf(stderr, "control: %s\n", server->GetEndpoint().c_str());
+  }
+
+  HotkeyListener listener;
+  if (!hotkeys.empty()) {
+    listener.AddJob(clicker, settings, hotkeys);
+    if (!listener.Start(nullptr, devices)) {
+      fprintf(stderr, "Cannot watch the keyboard\n");
+      return 1;
+    }
+  }
+
+  const int64_t startNs = Clock::NowNs();
+  if (hotkeys.empty())
+    clicker.Start(settings);
+  const int64_t endNs =
+      seconds > 0 ? startNs + (int64_t)(seconds * 1e9) : INT64_MAX;
+
+  // Wakes for Ctrl+C, the click limit or the time limit at once; looks in
+  // every few milliseconds to see a macro or replay end. With --control or
+  // --hotkey, the clicker may be stopped and started again, so only the
+  // limits end the run.
+  while (!done.IsNotified() && Clock::NowNs() < endNs &&
+         (server || listener.IsRunning() || clicker.IsRunning()))
+    done.SleepUntilNs(std::min(endNs, Clock::NowNs() + 5000000));
+  listener.Stop();
+  server.reset();
+  clicker.Stop();
+  const int64_t stopNs = Clock::NowNs();
+
+  const SchedulerStats st = clicker.GetSchedulerStats();
+  const ClickTelemetry t = clicker.GetTelemetry();
+  const double elapsed = (stopNs - startNs) / 1e9;
+  const uint64_t presses = sink->GetPresses();
+  printf("sink         %s\n", sink->Name());
+  printf("clicks       %llu in %.3f s (%.1f/s)\n", (unsigned long long)presses,
+         elapsed, elapsed > 0 ? presses / elapsed : 0.0);
+  if (sink->GetFirstPressNs() && hotkeys.empty()) // Not waiting for a key
+    printf("startup      %.3f ms from main() to the first click\n",
+           (sink->GetFirstPressNs() - g_mainNs) / 1e6);
+  printf("ticks        %llu, %llu skipped; period %.1f us target, %.1f us "
+         "achieved\n",
+         (unsigned long long)st.ticks, (unsigned long long)st.skippedTicks,
+         st.targetPeriodNs / 1e3, st.achievedPeriodNs / 1e3);
+  PrintLatency("lateness", t.lateness);
+  PrintLatency("injection", t.injection);
+  if (settings.realTime)
+    printf("real-time    %s\n", clicker.GetRealTimeStatus().Describe().c_str());
+  return 0;
+}
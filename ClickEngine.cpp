@@ -0,0 +1,268 @@
+#include "ClickEngine.h"
+#include "Clock.h"
+
+#include <algorithm>
+#include <chrono>
+
+ClickJob ClickJob::FromSettings(const ClickSettings &s) {
+  ClickJob job;
+  job.periodNs =
+      (int64_t)s.intervalMs * 1000000LL + (int64_t)s.intervalUs * 1000LL;
+  job.button = s.isLeftClick ? MouseButton::Left : MouseButton::Right;
+  job.fixedPosition = s.fixedPosition;
+  job.x = s.x;
+  job.y = s.y;
+  job.missPolicy = (MissPolicy)s.missPolicy;
+  return job;
+}
+
+ClickEngine::ClickEngine() : ClickEngine(CreateDefaultInputSink()) {}
+
+ClickEngine::ClickEngine(std::unique_ptr<InputSink> sink)
+    : inputSink(std::move(sink)), running(false), stoppedNs(0),
+      commandsPending(false), nextId(1), activeJobs(0), clicks(0),
+      skippedTicks(0) {}
+
+ClickEngine::~ClickEngine() { Stop(); }
+
+void ClickEngine::Start() {
+  if (running || !inputSink)
+    return;
+  if (thread.joinable())
+    thread.join();
+
+  // The thread is gone, so the heap is ours. One shift for every entry
+  // keeps both the heap order and each job's phase.
+  if (stoppedNs) {
+    const int64_t pausedNs = Clock::NowNs() - stoppedNs;
+    for (HeapEntry &e : heap)
+      e.deadlineNs += pausedNs;
+  }
+
+  clicks = 0;
+  skippedTicks = 0;
+  lateness.Reset();
+  dispatchTime.Reset();
+  injectionTime.Reset();
+  running = true;
+  thread = std::thread(&ClickEngine::Run, this);
+}
+
+void ClickEngine::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    running = false;
+  }
+  wake.notify_one();
+  if (thread.joinable()) {
+    thread.join();
+    stoppedNs = Clock::NowNs();
+  }
+}
+
+ClickJobId ClickEngine::AddJob(const ClickJob &job) {
+  Command c;
+  c.add = true;
+  c.job = job;
+  c.job.periodNs = std::max<int64_t>(job.periodNs, 1000); // 1us floor
+  {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    c.id = nextId++;
+    liveIds.insert(c.id);
+    commands.push_back(c);
+    commandsPending = true;
+  }
+  wake.notify_one();
+  return c.id;
+}
+
+bool ClickEngine::RemoveJob(ClickJobId id) {
+  Command c;
+  c.add = false;
+  c.id = id;
+  {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    if (!liveIds.erase(id))
+      return false;
+    commands.push_back(c);
+    commandsPending = true;
+  }
+  wake.notify_one();
+  return true;
+}
+
+void ClickEngine::RemoveAllJobs() {
+  {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    Command c;
+    c.add = false;
+    for (ClickJobId id : liveIds) {
+      c.id = id;
+      commands.push_back(c);
+    }
+    liveIds.clear();
+    commandsPending = true;
+  }
+  wake.notify_one();
+}
+
+size_t ClickEngine::GetJobCount() const {
+  std::lock_guard<std::mutex> lock(commandMutex);
+  return liveIds.size();
+}
+
+ClickEngineStats ClickEngine::GetStats() const {
+  ClickEngineStats s;
+  s.activeJobs = activeJobs.load(std::memory_order_relaxed);
+  s.clicks = clicks.load(std::memory_order_relaxed);
+  s.skippedTicks = skippedTicks.load(std::memory_order_relaxed);
+  s.lateness = lateness.Snapshot();
+  s.dispatch = dispatchTime.Snapshot();
+  s.injection = injectionTime.Snapshot();
+  return s;
+}
+
+void ClickEngine::ApplyCommands() {
+  std::vector<Command> batch;
+  {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    batch.swap(commands);
+    commandsPending = false;
+  }
+
+  const int64_t now = Clock::NowNs();
+  for (const Command &c : batch) {
+    if (c.add) {
+      uint32_t slot;
+      if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+      } else {
+        slot = (uint32_t)slots.size();
+        slots.push_back(Slot());
+      }
+      slots[slot].job = c.job;
+      slotOfJob[c.id] = slot;
+
+      HeapEntry e = {now + std::max<int64_t>(c.job.firstDelayNs, 0), slot,
+                     slots[slot].generation};
+      heap.push_back(e);
+      std::push_heap(heap.begin(), heap.end(), LaterDeadline);
+    } else {
+      auto it = slotOfJob.find(c.id);
+      if (it == slotOfJob.end())
+        continue;
+      slots[it->second].generation++;
+      freeSlots.push_back(it->second);
+      slotOfJob.erase(it);
+    }
+  }
+  activeJobs.store(slotOfJob.size(), std::memory_order_relaxed);
+
+  // Removed jobs leave stale entries behind; rebuild once they are the
+  // majority so the heap stays proportional to the live job count.
+  if (heap.size() > 64 && heap.size() > 2 * slotOfJob.size()) {
+    heap.erase(std::remove_if(heap.begin(), heap.end(),
+                              [this](const HeapEntry &e) {
+                                return slots[e.slot].generation !=
+                                       e.generation;
+                              }),
+               heap.end());
+    std::make_heap(heap.begin(), heap.end(), LaterDeadline);
+  }
+}
+
+bool ClickEngine::WaitForDeadline(int64_t deadlineNs) {
+  const int64_t window = Clock::SpinWindowNs();
+
+  for (;;) {
+    if (!running.load(std::memory_order_relaxed) ||
+        commandsPending.load(std::memory_order_acquire))
+      return false;
+
+    const int64_t now = Clock::NowNs();
+    const int64_t remaining = deadlineNs - now;
+    if (remaining <= window)
+      break;
+
+    if (remaining > window + kUninterruptibleSleepNs) {
+      // Far away: block where AddJob/RemoveJob/Stop can wake us.
+      std::unique_lock<std::mutex> lock(commandMutex);
+      wake.wait_for(lock,
+                    std::chrono::nanoseconds(remaining - window -
+                                             kUninterruptibleSleepNs),
+                    [this] { return !running || commandsPending; });
+    } else {
+      Clock::SleepUntilNs(deadlineNs - window);
+    }
+  }
+
+  Clock::SpinUntilNs(deadlineNs);
+  return true;
+}
+
+void ClickEngine::Fire(const HeapEntry &entry) {
+  const int64_t start = Clock::NowNs();
+  const ClickJob &job = slots[entry.slot].job;
+  lateness.Record(start - entry.deadlineNs);
+
+  // Same rescheduling as ClickScheduler::WaitNext, per job.
+  HeapEntry next = entry;
+  next.deadlineNs = entry.deadlineNs + job.periodNs;
+  if (job.missPolicy == MissPolicy::Skip && start >= next.deadlineNs) {
+    int64_t missed = (start - entry.deadlineNs) / job.periodNs;
+    skippedTicks.store(skippedTicks.load(std::memory_order_relaxed) + missed,
+                       std::memory_order_relaxed);
+    next.deadlineNs = entry.deadlineNs + (missed + 1) * job.periodNs;
+  }
+  heap.push_back(next);
+  std::push_heap(heap.begin(), heap.end(), LaterDeadline);
+
+  const int64_t injectStart = Clock::NowNs();
+  dispatchTime.Record(injectStart - start);
+
+  if (job.fixedPosition)
+    inputSink->MoveTo(job.x, job.y);
+  if (inputSink->Click(job.button))
+    clicks.store(clicks.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+  injectionTime.Record(Clock::NowNs() - injectStart);
+}
+
+void ClickEngine::Run() {
+  while (running.load(std::memory_order_relaxed)) {
+    if (commandsPending.load(std::memory_order_acquire))
+      ApplyCommands();
+
+    // Do not wait for a job that is gone.
+    while (!heap.empty() &&
+           slots[heap.front().slot].generation != heap.front().generation) {
+      std::pop_heap(heap.begin(), heap.end(), LaterDeadline);
+      heap.pop_back();
+    }
+
+    if (heap.empty()) {
+      std::unique_lock<std::mutex> lock(commandMutex);
+      wake.wait(lock, [this] { return !running || commandsPending; });
+      continue;
+    }
+
+    if (!WaitForDeadline(heap.front().deadlineNs))
+      continue;
+
+    // Fire everything that is due, earliest first.
+    int64_t now = Clock::NowNs();
+    while (!heap.empty() && heap.front().deadlineNs <= now) {
+      const HeapEntry entry = heap.front();
+      std::pop_heap(heap.begin(), heap.end(), LaterDeadline);
+      heap.pop_back();
+      if (slots[entry.slot].generation != entry.generation)
+        continue;
+      Fire(entry);
+      if (!running.load(std::memory_order_relaxed) ||
+          commandsPending.load(std::memory_order_acquire))
+        break;
+      now = Clock::NowNs();
+    }
+  }
+}
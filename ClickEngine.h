@@ -0,0 +1,135 @@
+#ifndef CLICKENGINE_H
+#define CLICKENGINE_H
+
+#include "AutoClicker.h"
+#include "ClickScheduler.h"
+#include "InputSink.h"
+#include "LatencyHistogram.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// One independent click target with its own position and interval.
+struct ClickJob {
+  int64_t periodNs = 100000000;
+  MouseButton button = MouseButton::Left;
+  bool fixedPosition = false;
+  int x = 0;
+  int y = 0;
+  MissPolicy missPolicy = MissPolicy::CatchUp;
+  int64_t firstDelayNs = 0; // From AddJob to the first click (phase)
+
+  static ClickJob FromSettings(const ClickSettings &settings);
+};
+
+// Never 0, never reused.
+typedef uint64_t ClickJobId;
+
+struct ClickEngineStats {
+  size_t activeJobs = 0;
+  uint64_t clicks = 0; // Clicks the sink accepted
+  uint64_t skippedTicks = 0;
+  LatencySnapshot lateness;  // Each click against its job's deadline
+  LatencySnapshot dispatch;  // Queue work per click, without the injection
+  LatencySnapshot injection; // Sink calls per click
+};
+
+// Runs any number of click jobs from one scheduler thread. Pending deadlines
+// of all jobs sit in one binary min-heap; the thread waits for the earliest
+// (coarse sleep, then spin, as in ClickScheduler), fires every job that is
+// due and pushes each back with its next absolute deadline.
+//
+// AddJob/RemoveJob may be called from any thread at any time. They queue a
+// command that the scheduler thread applies between clicks, waking it if it
+// is asleep; other jobs keep their timing. A removed job's heap entry is
+// dropped lazily when it reaches the top.
+class ClickEngine {
+public:
+  // Uses CreateDefaultInputSink().
+  ClickEngine();
+  explicit ClickEngine(std::unique_ptr<InputSink> sink);
+  ~ClickEngine();
+
+  // Jobs added while stopped start with the engine. Jobs that ran before
+  // a Stop() resume where they left off: their deadlines move by the time
+  // the engine was stopped, so no job catches up on ticks missed meanwhile.
+  void Start();
+  void Stop();
+  bool IsRunning() const { return running.load(); }
+
+  ClickJobId AddJob(const ClickJob &job);
+  // Returns false if `id` is unknown or already removed.
+  bool RemoveJob(ClickJobId id);
+  void RemoveAllJobs();
+
+  // Jobs added and not removed, including ones not yet applied.
+  size_t GetJobCount() const;
+  // Lock-free; does not disturb the scheduler thread.
+  ClickEngineStats GetStats() const;
+
+private:
+  // Longest sleep that cannot be cut short by a command; beyond it the
+  // thread waits on a condition variable first.
+  static const int64_t kUninterruptibleSleepNs = 2000000;
+
+  struct Command {
+    bool add;
+    ClickJobId id;
+    ClickJob job;
+  };
+  struct Slot {
+    ClickJob job;
+    uint32_t generation = 0; // Bumped on removal; stale heap entries differ
+  };
+  struct HeapEntry {
+    int64_t deadlineNs;
+    uint32_t slot;
+    uint32_t generation;
+  };
+
+  // Heap order for std::push_heap: earliest deadline on top.
+  static bool LaterDeadline(const HeapEntry &a, const HeapEntry &b) {
+    return a.deadlineNs > b.deadlineNs;
+  }
+
+  void Run();
+  void ApplyCommands();
+  // Returns false if interrupted by a command or Stop() before `deadlineNs`.
+  bool WaitForDeadline(int64_t deadlineNs);
+  void Fire(const HeapEntry &entry);
+
+  std::unique_ptr<InputSink> inputSink;
+  std::atomic<bool> running;
+  std::thread thread;
+  int64_t stoppedNs; // When Stop() ended the last run; 0 before any
+
+  // Command queue, shared with callers
+  mutable std::mutex commandMutex;
+  std::condition_variable wake;
+  std::vector<Command> commands;
+  std::atomic<bool> commandsPending;
+  std::unordered_set<ClickJobId> liveIds;
+  ClickJobId nextId;
+
+  // Owned by the scheduler thread
+  std::vector<HeapEntry> heap;
+  std::vector<Slot> slots;
+  std::vector<uint32_t> freeSlots;
+  std::unordered_map<ClickJobId, uint32_t> slotOfJob;
+
+  std::atomic<size_t> activeJobs;
+  std::atomic<uint64_t> clicks;
+  std::atomic<uint64_t> skippedTicks;
+  LatencyHistogram lateness;
+  LatencyHistogram dispatchTime;
+  LatencyHistogram injectionTime;
+};
+
+#endif // CLICKENGINE_H
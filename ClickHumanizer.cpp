@@ -0,0 +1,79 @@
+#include "ClickHumanizer.h"
+
+#include <cstring>
+
+// Settings strings are fixed-size arrays; a full one has no terminator.
+static std::string FieldString(const char *field, size_t size) {
+  const void *nul = memchr(field, '\0', size);
+  return std::string(field, nul ? (const char *)nul - field : size);
+}
+
+ClickHumanizer::ClickHumanizer() : baseNs(0), baseX(0), baseY(0) {}
+
+bool ClickHumanizer::Build(const ClickSettings &s, std::string &error) {
+  bool ok = true;
+  baseNs = (int64_t)s.intervalMs * 1000000LL + (int64_t)s.intervalUs * 1000LL;
+  baseX = s.x;
+  baseY = s.y;
+  interval.SetNone();
+  offset.SetNone();
+
+  switch ((DistributionKind)s.intervalDistribution) {
+  case DistributionKind::Uniform:
+    if (s.intervalSpreadUs > 0)
+      interval.SetUniform(s.intervalSpreadUs);
+    break;
+  case DistributionKind::Gaussian:
+    if (s.intervalSpreadUs > 0)
+      interval.SetGaussian(s.intervalSpreadUs);
+    break;
+  case DistributionKind::Histogram: {
+    std::vector<double> values, weights;
+    if (LoadHistogramFile(FieldString(s.intervalHistogram,
+                                      sizeof(s.intervalHistogram)),
+                          1, values, weights, error)) {
+      interval.SetHistogram(values, weights);
+      baseNs = 0;
+    } else {
+      ok = false;
+    }
+    break;
+  }
+  default:
+    break;
+  }
+
+  if (!s.fixedPosition)
+    return ok;
+  switch ((DistributionKind)s.positionDistribution) {
+  case DistributionKind::Uniform:
+    if (s.positionSpreadPx > 0)
+      offset.SetUniform(s.positionSpreadPx);
+    break;
+  case DistributionKind::Gaussian:
+    if (s.positionSpreadPx > 0)
+      offset.SetGaussian(s.positionSpreadPx);
+    break;
+  case DistributionKind::Histogram: {
+    std::vector<double> values, weights;
+    std::string fileError;
+    if (LoadHistogramFile(FieldString(s.positionHistogram,
+                                      sizeof(s.positionHistogram)),
+                          2, values, weights, fileError)) {
+      std::vector<int> dx, dy;
+      for (size_t i = 0; i < weights.size(); i++) {
+        dx.push_back((int)values[2 * i]);
+        dy.push_back((int)values[2 * i + 1]);
+      }
+      offset.SetHistogram(dx, dy, weights);
+    } else {
+      error = error.empty() ? fileError : error + "; " + fileError;
+      ok = false;
+    }
+    break;
+  }
+  default:
+    break;
+  }
+  return ok;
+}
@@ -0,0 +1,52 @@
+#ifndef CLICKHUMANIZER_H
+#define CLICKHUMANIZER_H
+
+#include "AutoClicker.h"
+#include "Distribution.h"
+
+#include <string>
+
+// The per-click randomness of ClickSettings, compiled once per run so the
+// click worker only samples tables.
+//
+// Interval: uniform or gaussian jitter of +/- intervalSpreadUs around the
+// configured interval, or intervals drawn from the intervalHistogram file
+// ("<interval us> <weight>" lines, replacing the configured interval).
+// Position: uniform or gaussian offsets of positionSpreadPx around x/y, or
+// (dx, dy) offsets drawn from the positionHistogram file.
+class ClickHumanizer {
+public:
+  ClickHumanizer();
+
+  // False with `error` set if a histogram file cannot be used; that part
+  // then stays fixed and the rest is still built.
+  bool Build(const ClickSettings &settings, std::string &error);
+
+  bool HasRandomInterval() const {
+    return interval.Kind() != DistributionKind::None;
+  }
+  bool HasRandomPosition() const {
+    return offset.Kind() != DistributionKind::None;
+  }
+
+  // Never below 1 us.
+  int64_t NextIntervalNs(FastRandom &rng) const {
+    int64_t ns = baseNs + (int64_t)(interval.Sample(rng) * 1000.0);
+    return ns > 1000 ? ns : 1000;
+  }
+  void NextPosition(FastRandom &rng, int &x, int &y) const {
+    int dx, dy;
+    offset.Sample(rng, dx, dy);
+    x = baseX + dx;
+    y = baseY + dy;
+  }
+
+private:
+  int64_t baseNs;
+  int baseX;
+  int baseY;
+  Distribution interval; // Microseconds
+  OffsetDistribution offset;
+};
+
+#endif // CLICKHUMANIZER_H
@@ -0,0 +1,92 @@
+#include "ClickScheduler.h"
+#include "Clock.h"
+
+#include <algorithm>
+
+ClickScheduler::ClickScheduler() : wake(nullptr), interrupted(false) {
+  Start(1000000, MissPolicy::CatchUp);
+}
+
+void ClickScheduler::Start(int64_t period, MissPolicy missPolicy) {
+  periodNs = std::max<int64_t>(period, 1000); // 1us floor
+  policy = missPolicy;
+  nextDeadlineNs = Clock::NowNs();
+  firstTickNs = 0;
+  lastTickNs = 0;
+  ticks = 0;
+  skippedTicks = 0;
+  lateness.Reset();
+  interrupted = false;
+}
+
+void ClickScheduler::Retune(int64_t period, MissPolicy missPolicy,
+                           int64_t nextDeadline) {
+  periodNs = std::max<int64_t>(period, 1000);
+  policy = missPolicy;
+  nextDeadlineNs = std::max(nextDeadline, Clock::NowNs());
+}
+
+int64_t ClickScheduler::WaitNext() {
+  const int64_t deadline = nextDeadlineNs;
+  const int64_t lateness = WaitUntil(deadline);
+  if (interrupted)
+    return 0;
+  const int64_t now = deadline + lateness;
+
+  nextDeadlineNs = deadline + periodNs;
+  if (policy == MissPolicy::Skip && now >= nextDeadlineNs) {
+    // Keep the original phase: jump to the first deadline still ahead of us.
+    int64_t missed = (now - deadline) / periodNs;
+    skippedTicks += missed;
+    nextDeadlineNs = deadline + (missed + 1) * periodNs;
+  }
+  return lateness;
+}
+
+int64_t ClickScheduler::WaitUntil(int64_t deadline) {
+  const int64_t window = Clock::SpinWindowNs();
+
+  interrupted = false;
+  if (wake) {
+    if (deadline - Clock::NowNs() > window &&
+        wake->SleepUntilNs(deadline - window)) {
+      interrupted = true;
+      return 0;
+    }
+    if (wake->SpinUntilNs(deadline)) {
+      interrupted = true;
+      return 0;
+    }
+  } else {
+    if (deadline - Clock::NowNs() > window)
+      Clock::SleepUntilNs(deadline - window);
+    Clock::SpinUntilNs(deadline);
+  }
+
+  const int64_t now = Clock::NowNs();
+  const int64_t late = now - deadline;
+
+  if (ticks == 0)
+    firstTickNs = now;
+  lastTickNs = now;
+  lateness.Record(late);
+  ticks++;
+  return late;
+}
+
+SchedulerStats ClickScheduler::GetStats() const {
+  SchedulerStats s;
+  s.ticks = ticks;
+  s.skippedTicks = skippedTicks;
+  s.targetPeriodNs = periodNs;
+  if (ticks > 1)
+    s.achievedPeriodNs = (double)(lastTickNs - firstTickNs) / (ticks - 1);
+
+  LatencySnapshot snap = lateness.Snapshot();
+  s.latenessP50Ns = snap.p50Ns;
+  s.latenessP90Ns = snap.p90Ns;
+  s.latenessP99Ns = snap.p99Ns;
+  s.latenessP999Ns = snap.p999Ns;
+  s.latenessMaxNs = snap.maxNs;
+  return s;
+}
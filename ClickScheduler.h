@@ -0,0 +1,78 @@
+#ifndef CLICKSCHEDULER_H
+#define CLICKSCHEDULER_H
+
+#include "LatencyHistogram.h"
+#include <cstdint>
+
+class WakeSignal;
+
+// What to do when the worker wakes up after one or more deadlines passed.
+enum class MissPolicy {
+  CatchUp = 0, // Fire the missed ticks back to back; keeps the average rate
+  Skip = 1,    // Drop the missed ticks and realign to the original phase
+};
+
+struct SchedulerStats {
+  uint64_t ticks = 0;
+  uint64_t skippedTicks = 0;
+  int64_t targetPeriodNs = 0;
+  double achievedPeriodNs = 0.0; // Mean period between first and last tick
+  // Lateness of each tick against its deadline (jitter)
+  int64_t latenessP50Ns = 0;
+  int64_t latenessP90Ns = 0;
+  int64_t latenessP99Ns = 0;
+  int64_t latenessP999Ns = 0;
+  int64_t latenessMaxNs = 0;
+};
+
+// Absolute-deadline tick generator. Deadlines are start + n * period, so time
+// spent between ticks (SendInput etc.) never accumulates into drift. Each wait
+// sleeps coarsely and then spins the last Clock::SpinWindowNs().
+class ClickScheduler {
+public:
+  ClickScheduler();
+
+  // Resets statistics. The first tick is due immediately.
+  void Start(int64_t periodNs, MissPolicy policy);
+
+  // Blocks until the next deadline and returns how late we woke up (ns).
+  int64_t WaitNext();
+
+  // Blocks until an arbitrary absolute deadline (used by macros, whose steps
+  // are not evenly spaced). Recorded in the same statistics as WaitNext().
+  int64_t WaitUntil(int64_t deadlineNs);
+
+  // Makes the waits return as soon as `signal` is notified (nullptr: never).
+  // An interrupted wait returns 0 and is not counted as a tick; WaitNext()
+  // then keeps its deadline for the next call.
+  void SetWakeSignal(WakeSignal *signal) { wake = signal; }
+  // Whether the last wait was cut short by the wake signal.
+  bool WasInterrupted() const { return interrupted; }
+
+  // Changes period and policy without resetting statistics. The next
+  // WaitNext() deadline becomes `nextDeadline`, or now if that has passed, so
+  // a shorter period does not have to catch up on ticks it never had.
+  void Retune(int64_t periodNs, MissPolicy policy, int64_t nextDeadline);
+  int64_t GetNextDeadlineNs() const { return nextDeadlineNs; }
+
+  // Not thread safe against a concurrent WaitNext(); read after the worker
+  // has stopped.
+  SchedulerStats GetStats() const;
+
+  // Lateness of every tick since Start(). Safe to snapshot while running.
+  const LatencyHistogram &GetLatenessHistogram() const { return lateness; }
+
+private:
+  int64_t periodNs;
+  MissPolicy policy;
+  int64_t nextDeadlineNs;
+  int64_t firstTickNs;
+  int64_t lastTickNs;
+  uint64_t ticks;
+  uint64_t skippedTicks;
+  LatencyHistogram lateness;
+  WakeSignal *wake;
+  bool interrupted;
+};
+
+#endif // CLICKSCHEDULER_H
@@ -0,0 +1,252 @@
+#include "Clock.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <time.h>
+#endif
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) ||             \
+    defined(__i386__)
+#include <immintrin.h>
+#define CPU_RELAX() _mm_pause()
+#else
+#define CPU_RELAX() ((void)0)
+#endif
+
+#ifdef _WIN32
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace {
+
+int64_t QpcFrequency() {
+  static const int64_t freq = [] {
+    LARGE_INTEGER f;
+    QueryPerformanceFrequency(&f);
+    return (int64_t)f.QuadPart;
+  }();
+  return freq;
+}
+
+// One waitable timer per thread. High resolution timers (Windows 10 1803+)
+// wake within ~0.5ms; older systems fall back to a normal timer and ~16ms.
+struct ThreadTimer {
+  HANDLE handle = NULL;
+  bool highRes = false;
+
+  ThreadTimer() {
+    handle = CreateWaitableTimerExW(NULL, NULL,
+                                    CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                    TIMER_ALL_ACCESS);
+    highRes = handle != NULL;
+    if (!handle)
+      handle = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+  }
+  ~ThreadTimer() {
+    if (handle)
+      CloseHandle(handle);
+  }
+};
+
+ThreadTimer &GetThreadTimer() {
+  thread_local ThreadTimer timer;
+  return timer;
+}
+
+} // namespace
+
+int64_t Clock::NowNs() {
+  LARGE_INTEGER c;
+  QueryPerformanceCounter(&c);
+  const int64_t freq = QpcFrequency();
+  // Split to avoid overflowing 64 bits on long uptimes.
+  return (c.QuadPart / freq) * 1000000000LL +
+         (c.QuadPart % freq) * 1000000000LL / freq;
+}
+
+void Clock::SleepUntilNs(int64_t deadlineNs) {
+  int64_t remaining = deadlineNs - NowNs();
+  if (remaining <= 0)
+    return;
+
+  ThreadTimer &timer = GetThreadTimer();
+  if (timer.handle) {
+    LARGE_INTEGER due;
+    due.QuadPart = -(remaining / 100); // Relative, 100ns units
+    if (due.QuadPart < 0 &&
+        SetWaitableTimer(timer.handle, &due, 0, NULL, NULL, FALSE)) {
+      WaitForSingleObject(timer.handle, INFINITE);
+      return;
+    }
+  }
+  Sleep((DWORD)(remaining / 1000000));
+}
+
+int64_t Clock::SpinWindowNs() {
+  return GetThreadTimer().highRes ? 1000000LL : 16000000LL;
+}
+
+WakeSignal::WakeSignal()
+    : notified(false), event(CreateEventW(NULL, TRUE, FALSE, NULL)) {}
+
+WakeSignal::~WakeSignal() {
+  if (event)
+    CloseHandle((HANDLE)event);
+}
+
+void WakeSignal::Notify() {
+  notified.store(true, std::memory_order_release);
+  if (event)
+    SetEvent((HANDLE)event);
+}
+
+void WakeSignal::Reset() {
+  notified.store(false, std::memory_order_release);
+  if (event)
+    ResetEvent((HANDLE)event);
+}
+
+bool WakeSignal::SleepUntilNs(int64_t deadlineNs) {
+  if (IsNotified())
+    return true;
+  int64_t remaining = deadlineNs - Clock::NowNs();
+  if (remaining <= 0)
+    return false;
+
+  ThreadTimer &timer = GetThreadTimer();
+  if (event && timer.handle) {
+    LARGE_INTEGER due;
+    due.QuadPart = -(remaining / 100); // Relative, 100ns units
+    if (due.QuadPart < 0 &&
+        SetWaitableTimer(timer.handle, &due, 0, NULL, NULL, FALSE)) {
+      HANDLE handles[2] = {(HANDLE)event, timer.handle};
+      if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) ==
+          WAIT_OBJECT_0) {
+        CancelWaitableTimer(timer.handle);
+        return true;
+      }
+      return IsNotified();
+    }
+  }
+  if (event)
+    WaitForSingleObject((HANDLE)event, (DWORD)(remaining / 1000000));
+  else
+    Sleep((DWORD)(remaining / 1000000));
+  return IsNotified();
+}
+
+#else
+
+int64_t Clock::NowNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void Clock::SleepUntilNs(int64_t deadlineNs) {
+  if (deadlineNs <= NowNs())
+    return;
+  timespec ts;
+  ts.tv_sec = (time_t)(deadlineNs / 1000000000LL);
+  ts.tv_nsec = (long)(deadlineNs % 1000000000LL);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+  }
+}
+
+int64_t Clock::SpinWindowNs() {
+  // Default timer slack is 50us; add headroom for wake-up latency.
+  return 200000LL;
+}
+
+#ifdef __linux__
+
+WakeSignal::WakeSignal()
+    : notified(false), fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+WakeSignal::~WakeSignal() {
+  if (fd >= 0)
+    close(fd);
+}
+
+void WakeSignal::Notify() {
+  notified.store(true, std::memory_order_release);
+  if (fd >= 0) {
+    uint64_t one = 1;
+    (void)!write(fd, &one, sizeof(one));
+  }
+}
+
+void WakeSignal::Reset() {
+  notified.store(false, std::memory_order_release);
+  if (fd >= 0) {
+    uint64_t count;
+    (void)!read(fd, &count, sizeof(count)); // Non-blocking drain
+  }
+}
+
+bool WakeSignal::SleepUntilNs(int64_t deadlineNs) {
+  if (fd < 0) {
+    // No eventfd: sleep in short slices and look at the flag in between.
+    while (!IsNotified() && Clock::NowNs() < deadlineNs)
+      Clock::SleepUntilNs(std::min(deadlineNs, Clock::NowNs() + 1000000));
+    return IsNotified();
+  }
+  pollfd p = {fd, POLLIN, 0};
+  for (;;) {
+    if (IsNotified())
+      return true;
+    const int64_t remaining = deadlineNs - Clock::NowNs();
+    if (remaining <= 0)
+      return false;
+    timespec ts;
+    ts.tv_sec = (time_t)(remaining / 1000000000LL);
+    ts.tv_nsec = (long)(remaining % 1000000000LL);
+    if (ppoll(&p, 1, &ts, NULL) == 0)
+      return IsNotified();
+    // Readable (notified) or EINTR: the loop decides.
+  }
+}
+
+#else
+
+WakeSignal::WakeSignal() : notified(false), fd(-1) {}
+WakeSignal::~WakeSignal() {}
+void WakeSignal::Notify() { notified.store(true, std::memory_order_release); }
+void WakeSignal::Reset() { notified.store(false, std::memory_order_release); }
+
+bool WakeSignal::SleepUntilNs(int64_t deadlineNs) {
+  while (!IsNotified() && Clock::NowNs() < deadlineNs)
+    Clock::SleepUntilNs(std::min(deadlineNs, Clock::NowNs() + 1000000));
+  return IsNotified();
+}
+
+#endif // __linux__
+
+#endif
+
+void Clock::SpinUntilNs(int64_t deadlineNs) {
+  while (NowNs() < deadlineNs) {
+    CPU_RELAX();
+  }
+}
+
+bool WakeSignal::SpinUntilNs(int64_t deadlineNs) {
+  while (Clock::NowNs() < deadlineNs) {
+    if (IsNotified())
+      return true;
+    CPU_RELAX();
+  }
+  return false;
+}
@@ -0,0 +1,59 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <atomic>
+#include <cstdint>
+
+// Portable monotonic clock used by the click scheduler.
+// Windows: QueryPerformanceCounter + high resolution waitable timer.
+// Linux:   CLOCK_MONOTONIC + clock_nanosleep(TIMER_ABSTIME).
+class Clock {
+public:
+  // Monotonic time in nanoseconds. Only differences are meaningful.
+  static int64_t NowNs();
+
+  // Blocks until roughly `deadlineNs`. The OS may wake us late by up to
+  // SpinWindowNs(), so precise callers sleep to (deadline - window) and spin.
+  static void SleepUntilNs(int64_t deadlineNs);
+
+  // Spins (without sleeping) until `deadlineNs` has passed.
+  static void SpinUntilNs(int64_t deadlineNs);
+
+  // How much earlier than a deadline we stop sleeping and start spinning.
+  static int64_t SpinWindowNs();
+};
+
+// Cuts a deadline wait short from another thread, so a worker sleeping
+// towards a distant deadline can be stopped at once. The sleep has the same
+// precision as Clock::SleepUntilNs; the wake-up goes through a manual-reset
+// event (Windows) or an eventfd (Linux) waited on together with the timer.
+// One waiting thread; any thread may Notify().
+class WakeSignal {
+public:
+  WakeSignal();
+  ~WakeSignal();
+
+  // Wakes the waiter now and keeps every later wait from blocking until
+  // Reset().
+  void Notify();
+  // Only while nobody waits.
+  void Reset();
+  bool IsNotified() const { return notified.load(std::memory_order_acquire); }
+
+  // Like Clock::SleepUntilNs / SpinUntilNs. True if cut short by Notify().
+  bool SleepUntilNs(int64_t deadlineNs);
+  bool SpinUntilNs(int64_t deadlineNs);
+
+private:
+  WakeSignal(const WakeSignal &) = delete;
+  WakeSignal &operator=(const WakeSignal &) = delete;
+
+  std::atomic<bool> notified;
+#ifdef _WIN32
+  void *event; // HANDLE
+#else
+  int fd; // eventfd, -1 where there is none
+#endif
+};
+
+#endif // CLOCK_H
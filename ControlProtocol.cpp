@@ -0,0 +1,47 @@
+#include "ControlProtocol.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+void AppendControlFrame(std::string &out, uint32_t id, ControlOp op,
+                        ControlStatus status, const void *payload,
+                        size_t size) {
+  ControlHeader h;
+  h.id = id;
+  h.length = (uint16_t)size;
+  h.op = (uint8_t)op;
+  h.status = (uint8_t)status;
+  out.append((const char *)&h, sizeof(h));
+  if (size)
+    out.append((const char *)payload, size);
+}
+
+ptrdiff_t ParseControlFrame(const char *data, size_t size,
+                            ControlHeader &header, const char *&payload) {
+  if (size < sizeof(ControlHeader))
+    return 0;
+  memcpy(&header, data, sizeof(header));
+  if (header.length > kControlMaxPayload)
+    return -1;
+  const size_t total = sizeof(ControlHeader) + header.length;
+  if (size < total)
+    return 0;
+  payload = data + sizeof(ControlHeader);
+  return (ptrdiff_t)total;
+}
+
+std::string DefaultControlEndpoint() {
+#ifdef _WIN32
+  return "\\\\.\\pipe\\AutoClicker-" + std::to_string(GetCurrentProcessId());
+#else
+  const char *dir = getenv("XDG_RUNTIME_DIR");
+  std::string path = dir && *dir ? dir : "/tmp";
+  return path + "/autoclicker-" + std::to_string(getpid()) + ".sock";
+#endif
+}
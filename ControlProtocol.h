@@ -0,0 +1,83 @@
+#ifndef CONTROLPROTOCOL_H
+#define CONTROLPROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Wire format of the local control channel (ControlServer.h). Little endian.
+//
+// Every request and every response is one frame: a ControlHeader followed by
+// `length` payload bytes. Clients may send any number of frames without
+// waiting (pipelining); the server answers each one, in order, with the same
+// id and opcode, and writes all the answers to one read's worth of requests
+// together.
+//
+//   op            request payload             response payload
+//   Ping          anything                    the same bytes
+//   Start         settings fields (optional)  -
+//   Stop          -                           -
+//   Toggle        settings fields (optional)  -
+//   GetSettings   -                           full settings record
+//   SetSettings   settings fields             -
+//   GetCounters   -                           ControlCounters
+//
+// Settings travel in the tag/length/value record of settings.dat
+// (SettingsFile.h). A request only needs the fields it changes
+// (EncodeSettingsChanges); they are applied over the server's current
+// settings, and a running clicker picks them up at its next tick.
+
+enum class ControlOp : uint8_t {
+  Ping = 0,
+  Start = 1,
+  Stop = 2,
+  Toggle = 3,
+  GetSettings = 4,
+  SetSettings = 5,
+  GetCounters = 6,
+};
+
+enum class ControlStatus : uint8_t {
+  Ok = 0,
+  UnknownOp = 1,
+  BadPayload = 2, // Settings record that does not parse
+};
+
+struct ControlHeader {
+  uint32_t id;     // Chosen by the client, echoed in the response
+  uint16_t length; // Payload bytes that follow
+  uint8_t op;      // ControlOp
+  uint8_t status;  // ControlStatus; 0 in requests
+};
+static_assert(sizeof(ControlHeader) == 8, "ControlHeader is a wire format");
+
+// Larger frames are a protocol error and close the connection.
+const size_t kControlMaxPayload = 8192;
+
+struct ControlCounters {
+  uint64_t clicks;
+  int64_t latenessP50Ns; // Current or last run
+  int64_t latenessP99Ns;
+  int64_t latenessMaxNs;
+  uint32_t running;
+  uint32_t reserved;
+};
+static_assert(sizeof(ControlCounters) == 40, "ControlCounters is a wire format");
+
+// Appends one frame. `size` must not exceed kControlMaxPayload.
+void AppendControlFrame(std::string &out, uint32_t id, ControlOp op,
+                        ControlStatus status, const void *payload = nullptr,
+                        size_t size = 0);
+
+// Looks for a complete frame at the start of `data`. Returns its total size
+// with `header` and `payload` set, 0 if more bytes are needed, or -1 if the
+// frame is too large.
+ptrdiff_t ParseControlFrame(const char *data, size_t size,
+                            ControlHeader &header, const char *&payload);
+
+// Name of this process's control endpoint: a socket under
+// $XDG_RUNTIME_DIR (else /tmp) on Linux, a pipe on Windows. Each process
+// gets its own, so scripts can address many instances.
+std::string DefaultControlEndpoint();
+
+#endif // CONTROLPROTOCOL_H
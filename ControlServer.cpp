@@ -0,0 +1,689 @@
+#include "ControlServer.h"
+#include "Clock.h"
+#include "SettingsFile.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+#endif
+
+namespace {
+
+const size_t kReadChunk = 64 * 1024;
+// Out of descriptors: how long the listener stays paused if no client leaves
+const int64_t kAcceptRetryNs = 100000000;
+
+} // namespace
+
+ControlServer::ControlServer(AutoClicker &clicker, const ClickSettings &initial)
+    : clicker(clicker), settings(initial), requests(0), connections(0) {
+#ifdef _WIN32
+  port = nullptr;
+#else
+  listenFd = -1;
+  epollFd = -1;
+  wakeFd = -1;
+  listenPausedNs = 0;
+#endif
+}
+
+ControlServer::~ControlServer() { Stop(); }
+
+bool ControlServer::ProcessInput(std::string &in, std::string &out) {
+  size_t pos = 0;
+  for (;;) {
+    ControlHeader header;
+    const char *payload = nullptr;
+    ptrdiff_t n =
+        ParseControlFrame(in.data() + pos, in.size() - pos, header, payload);
+    if (n < 0)
+      return false;
+    if (n == 0)
+      break;
+    Execute(header, payload, out);
+    pos += (size_t)n;
+  }
+  in.erase(0, pos);
+  return true;
+}
+
+void ControlServer::Execute(const ControlHeader &request, const char *payload,
+                            std::string &out) {
+  requests++;
+  const ControlOp op = (ControlOp)request.op;
+  ControlStatus status = ControlStatus::Ok;
+  switch (op) {
+  case ControlOp::Ping:
+    AppendControlFrame(out, request.id, op, status, payload, request.length);
+    return;
+
+  case ControlOp::Start:
+  case ControlOp::Toggle:
+  case ControlOp::SetSettings:
+    if (request.length &&
+        !ApplySettingsRecord((const uint8_t *)payload, request.length,
+                             settings)) {
+      status = ControlStatus::BadPayload;
+      break;
+    }
+    ClampClickSettings(settings); // Same limits as the dialog
+    if (op == ControlOp::Start)
+      clicker.Start(settings);
+    else if (op == ControlOp::Toggle)
+      clicker.Toggle(settings);
+    else
+      clicker.UpdateSettings(settings); // Only matters while running
+    break;
+
+  case ControlOp::Stop:
+    clicker.Stop();
+    break;
+
+  case ControlOp::GetSettings: {
+    const std::string record = EncodeSettingsRecord(settings);
+    AppendControlFrame(out, request.id, op, status, record.data(),
+                       record.size());
+    return;
+  }
+
+  case ControlOp::GetCounters: {
+    ControlCounters counters = {};
+    const LatencySnapshot lateness = clicker.GetTelemetry().lateness;
+    counters.clicks = clicker.GetClickCount();
+    counters.latenessP50Ns = lateness.p50Ns;
+    counters.latenessP99Ns = lateness.p99Ns;
+    counters.latenessMaxNs = lateness.maxNs;
+    counters.running = clicker.IsRunning() ? 1 : 0;
+    AppendControlFrame(out, request.id, op, status, &counters,
+                       sizeof(counters));
+    return;
+  }
+
+  default:
+    status = ControlStatus::UnknownOp;
+    break;
+  }
+  AppendControlFrame(out, request.id, op, status);
+}
+
+uint32_t ControlClient::Queue(ControlOp op, const void *payload, size_t size) {
+  const uint32_t id = nextId++;
+  AppendControlFrame(outbox, id, op, ControlStatus::Ok, payload, size);
+  return id;
+}
+
+bool ControlClient::Call(ControlOp op, const void *payload, size_t size,
+                         ControlHeader &header, std::string &response) {
+  Queue(op, payload, size);
+  return Flush() && Receive(header, response);
+}
+
+#ifdef _WIN32
+
+// One pipe instance. Its read OVERLAPPED also carries the connect; each
+// direction has at most one operation in flight.
+struct ControlServer::Connection {
+  OVERLAPPED readOv;
+  OVERLAPPED writeOv;
+  HANDLE pipe = INVALID_HANDLE_VALUE;
+  bool connected = false; // A client is attached (else still listening)
+  bool reading = false;
+  bool writing = false;
+  bool closing = false;
+  std::string in;
+  std::string out;
+  std::string sending; // Buffer of the write in flight
+  char buffer[kReadChunk];
+};
+
+bool ControlServer::CreateInstance(bool first) {
+  Connection *c = new Connection();
+  memset(&c->readOv, 0, sizeof(c->readOv));
+  memset(&c->writeOv, 0, sizeof(c->writeOv));
+  c->pipe = CreateNamedPipeA(
+      endpoint.c_str(),
+      PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED |
+          (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+      PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT |
+          PIPE_REJECT_REMOTE_CLIENTS,
+      PIPE_UNLIMITED_INSTANCES, (DWORD)kReadChunk, (DWORD)kReadChunk, 0, NULL);
+  if (c->pipe == INVALID_HANDLE_VALUE ||
+      !CreateIoCompletionPort(c->pipe, (HANDLE)port, (ULONG_PTR)c, 0)) {
+    if (c->pipe != INVALID_HANDLE_VALUE)
+      CloseHandle(c->pipe);
+    delete c;
+    return false;
+  }
+  open.insert(c);
+
+  c->reading = true; // The connect completes on readOv
+  if (!ConnectNamedPipe(c->pipe, &c->readOv)) {
+    DWORD err = GetLastError();
+    if (err == ERROR_PIPE_CONNECTED) {
+      // The client was faster than us; no completion will be queued.
+      PostQueuedCompletionStatus((HANDLE)port, 0, (ULONG_PTR)c, &c->readOv);
+    } else if (err != ERROR_IO_PENDING) {
+      c->reading = false;
+      Close(c);
+      Reap(c);
+    }
+  }
+  return true;
+}
+
+bool ControlServer::Start(const std::string &name, std::string &error) {
+  if (thread.joinable())
+    return true;
+  endpoint = name;
+  port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+  if (!port) {
+    error = "CreateIoCompletionPort failed: " + std::to_string(GetLastError());
+    return false;
+  }
+  if (!CreateInstance(true)) {
+    error = "cannot create pipe " + endpoint + ": " +
+            std::to_string(GetLastError());
+    CloseHandle((HANDLE)port);
+    port = nullptr;
+    return false;
+  }
+  thread = std::thread(&ControlServer::Run, this);
+  return true;
+}
+
+void ControlServer::StartRead(Connection *c) {
+  if (c->reading || c->closing || c->out.size() > kMaxPendingOutput)
+    return;
+  c->reading = true;
+  if (!ReadFile(c->pipe, c->buffer, (DWORD)sizeof(c->buffer), NULL,
+                &c->readOv) &&
+      GetLastError() != ERROR_IO_PENDING) {
+    c->reading = false;
+    Close(c);
+  }
+}
+
+void ControlServer::StartWrite(Connection *c) {
+  if (c->writing || c->closing || c->out.empty())
+    return;
+  c->sending.swap(c->out);
+  c->out.clear();
+  c->writing = true;
+  if (!WriteFile(c->pipe, c->sending.data(), (DWORD)c->sending.size(), NULL,
+                 &c->writeOv) &&
+      GetLastError() != ERROR_IO_PENDING) {
+    c->writing = false;
+    Close(c);
+  }
+}
+
+void ControlServer::Close(Connection *c) {
+  // Cancelling completes whatever is in flight with an error. The connection
+  // is freed by Reap() once nothing is, since the OVERLAPPEDs live inside
+  // it.
+  if (c->closing)
+    return;
+  c->closing = true;
+  CancelIoEx(c->pipe, NULL);
+  CloseHandle(c->pipe);
+  if (c->connected)
+    connections--;
+}
+
+void ControlServer::Reap(Connection *c) {
+  if (c->closing && !c->reading && !c->writing) {
+    open.erase(c);
+    delete c;
+  }
+}
+
+void ControlServer::Run() {
+  for (;;) {
+    DWORD bytes = 0;
+    ULONG_PTR key = 0;
+    OVERLAPPED *ov = nullptr;
+    const BOOL ok =
+        GetQueuedCompletionStatus((HANDLE)port, &bytes, &key, &ov, INFINITE);
+    if (!ov) {
+      if (key == 0)
+        break; // Stop()
+      continue;
+    }
+    Connection *c = (Connection *)key;
+
+    if (ov == &c->writeOv) {
+      c->writing = false;
+      c->sending.clear();
+      if (!ok)
+        Close(c);
+      StartWrite(c);
+      StartRead(c); // If it was held back by unread output
+    } else if (!c->connected) {
+      // A client took this instance; keep one listening for the next.
+      c->reading = false;
+      if (ok && !c->closing) {
+        c->connected = true;
+        connections++;
+        StartRead(c);
+      } else {
+        Close(c);
+      }
+      CreateInstance(false);
+    } else {
+      c->reading = false;
+      if (!ok || bytes == 0) {
+        Close(c); // Client went away
+      } else {
+        c->in.append(c->buffer, bytes);
+        if (!ProcessInput(c->in, c->out))
+          Close(c);
+      }
+      StartWrite(c);
+      StartRead(c);
+    }
+    Reap(c);
+  }
+}
+
+void ControlServer::Stop() {
+  if (!thread.joinable())
+    return;
+  PostQueuedCompletionStatus((HANDLE)port, 0, 0, NULL);
+  thread.join();
+
+  // Cancel everything, then collect the completions so no OVERLAPPED is
+  // freed while the kernel still owns it.
+  std::unordered_set<Connection *> all = open;
+  for (Connection *c : all) {
+    Close(c);
+    Reap(c);
+  }
+  while (!open.empty()) {
+    DWORD bytes;
+    ULONG_PTR key;
+    OVERLAPPED *ov;
+    GetQueuedCompletionStatus((HANDLE)port, &bytes, &key, &ov, 1000);
+    if (!ov)
+      continue;
+    Connection *c = (Connection *)key;
+    if (ov == &c->writeOv)
+      c->writing = false;
+    else
+      c->reading = false;
+    Reap(c);
+  }
+  CloseHandle((HANDLE)port);
+  port = nullptr;
+}
+
+ControlClient::ControlClient()
+    : inboxPos(0), nextId(1), pipe(INVALID_HANDLE_VALUE) {}
+
+ControlClient::~ControlClient() { Close(); }
+
+bool ControlClient::Connect(const std::string &endpoint) {
+  Close();
+  for (int attempt = 0; attempt < 10; attempt++) {
+    HANDLE h = CreateFileA(endpoint.c_str(), GENERIC_READ | GENERIC_WRITE, 0,
+                           NULL, OPEN_EXISTING, 0, NULL);
+    if (h != INVALID_HANDLE_VALUE) {
+      pipe = h;
+      return true;
+    }
+    // All instances taken: the server creates the next one right away.
+    if (GetLastError() != ERROR_PIPE_BUSY ||
+        !WaitNamedPipeA(endpoint.c_str(), 1000))
+      return false;
+  }
+  return false;
+}
+
+void ControlClient::Close() {
+  if (pipe != INVALID_HANDLE_VALUE)
+    CloseHandle((HANDLE)pipe);
+  pipe = INVALID_HANDLE_VALUE;
+  outbox.clear();
+  inbox.clear();
+  inboxPos = 0;
+}
+
+bool ControlClient::IsConnected() const {
+  return pipe != INVALID_HANDLE_VALUE;
+}
+
+bool ControlClient::Flush() {
+  size_t sent = 0;
+  while (sent < outbox.size()) {
+    DWORD n = 0;
+    if (!WriteFile((HANDLE)pipe, outbox.data() + sent,
+                   (DWORD)(outbox.size() - sent), &n, NULL))
+      return false;
+    sent += n;
+  }
+  outbox.clear();
+  return true;
+}
+
+bool ControlClient::Receive(ControlHeader &header, std::string &payload) {
+  char buffer[kReadChunk];
+  for (;;) {
+    const char *data = nullptr;
+    ptrdiff_t n = ParseControlFrame(inbox.data() + inboxPos,
+                                    inbox.size() - inboxPos, header, data);
+    if (n < 0)
+      return false;
+    if (n > 0) {
+      payload.assign(data, header.length);
+      inboxPos += (size_t)n;
+      if (inboxPos == inbox.size()) {
+        inbox.clear();
+        inboxPos = 0;
+      }
+      return true;
+    }
+    DWORD got = 0;
+    if (!ReadFile((HANDLE)pipe, buffer, (DWORD)sizeof(buffer), &got, NULL) ||
+        got == 0)
+      return false;
+    inbox.erase(0, inboxPos);
+    inboxPos = 0;
+    inbox.append(buffer, got);
+  }
+}
+
+#elif defined(__linux__)
+
+struct ControlServer::Connection {
+  int fd = -1;
+  uint32_t events = 0; // Registered with epoll
+  std::string in;
+  std::string out;
+};
+
+bool ControlServer::Start(const std::string &name, std::string &error) {
+  if (thread.joinable())
+    return true;
+  endpoint = name;
+
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (endpoint.size() >= sizeof(addr.sun_path)) {
+    error = "socket path too long: " + endpoint;
+    return false;
+  }
+  memcpy(addr.sun_path, endpoint.c_str(), endpoint.size() + 1);
+
+  listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  // A socket left behind by a crashed process of the same id is stale.
+  unlink(endpoint.c_str());
+  if (listenFd < 0 || epollFd < 0 || wakeFd < 0 ||
+      bind(listenFd, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+      chmod(endpoint.c_str(), 0600) != 0 || listen(listenFd, SOMAXCONN) != 0) {
+    error = "cannot listen on " + endpoint + ": " + strerror(errno);
+    Stop();
+    return false;
+  }
+
+  // The listening socket and the wake-up eventfd are told apart from
+  // connections by pointing at the members that hold them.
+  epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = &listenFd;
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+  ev.data.ptr = &wakeFd;
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+
+  thread = std::thread(&ControlServer::Run, this);
+  return true;
+}
+
+void ControlServer::Update(Connection *c) {
+  // Level-triggered: read while the client keeps up with its answers, wait
+  // for writability while answers are queued.
+  uint32_t events = 0;
+  if (c->out.size() <= kMaxPendingOutput)
+    events |= EPOLLIN;
+  if (!c->out.empty())
+    events |= EPOLLOUT;
+  if (events != c->events) {
+    epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = c;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->events = events;
+  }
+}
+
+void ControlServer::Close(Connection *c) {
+  // Freed only after the batch: later events of the same epoll_wait may
+  // still point at it, and a new connection must not get its address.
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, c->fd, nullptr);
+  close(c->fd);
+  open.erase(c);
+  closed.push_back(c);
+  connections--;
+}
+
+void ControlServer::Run() {
+  epoll_event events[64];
+  char buffer[kReadChunk];
+  for (;;) {
+    // While out of descriptors the listener is paused (it is level-triggered
+    // and would report the same pending connection forever). It is retried
+    // once a client leaves, else 100 ms after the pause.
+    int timeoutMs = -1;
+    if (listenPausedNs) {
+      const int64_t leftNs = listenPausedNs + kAcceptRetryNs - Clock::NowNs();
+      timeoutMs = leftNs > 0 ? (int)((leftNs + 999999) / 1000000) : 0;
+    }
+    int n = epoll_wait(epollFd, events, 64, timeoutMs);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    for (int i = 0; i < n; i++) {
+      void *ptr = events[i].data.ptr;
+      if (ptr == &wakeFd)
+        return;
+
+      if (ptr == &listenFd) {
+        for (;;) {
+          int fd = accept4(listenFd, nullptr, nullptr,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+          if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS ||
+                errno == ENOMEM) {
+              epoll_event ev = {};
+              ev.data.ptr = &listenFd;
+              epoll_ctl(epollFd, EPOLL_CTL_MOD, listenFd, &ev);
+              listenPausedNs = Clock::NowNs();
+            }
+            break; // EAGAIN, or out of descriptors
+          }
+          Connection *c = new Connection();
+          c->fd = fd;
+          c->events = EPOLLIN;
+          epoll_event ev;
+          ev.events = EPOLLIN;
+          ev.data.ptr = c;
+          epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+          open.insert(c);
+          connections++;
+        }
+        continue;
+      }
+
+      Connection *c = (Connection *)ptr;
+      if (!open.count(c))
+        continue;
+      const uint32_t ready = events[i].events;
+      bool alive = true;
+      if (ready & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        ssize_t got = recv(c->fd, buffer, sizeof(buffer), 0);
+        if (got > 0) {
+          c->in.append(buffer, (size_t)got);
+          alive = ProcessInput(c->in, c->out);
+        } else if (got == 0 || (errno != EAGAIN && errno != EINTR)) {
+          alive = false;
+        }
+      }
+      if (alive && !c->out.empty()) {
+        ssize_t sent =
+            send(c->fd, c->out.data(), c->out.size(), MSG_NOSIGNAL);
+        if (sent > 0)
+          c->out.erase(0, (size_t)sent);
+        else if (sent < 0 && errno != EAGAIN && errno != EINTR)
+          alive = false;
+      }
+      if (alive)
+        Update(c);
+      else
+        Close(c);
+    }
+    const bool freed = !closed.empty();
+    for (Connection *c : closed)
+      delete c;
+    closed.clear();
+    if (listenPausedNs &&
+        (freed || Clock::NowNs() - listenPausedNs >= kAcceptRetryNs)) {
+      epoll_event ev;
+      ev.events = EPOLLIN;
+      ev.data.ptr = &listenFd;
+      epoll_ctl(epollFd, EPOLL_CTL_MOD, listenFd, &ev);
+      listenPausedNs = 0;
+    }
+  }
+}
+
+void ControlServer::Stop() {
+  if (thread.joinable()) {
+    uint64_t one = 1;
+    (void)!write(wakeFd, &one, sizeof(one));
+    thread.join();
+  }
+  while (!open.empty())
+    Close(*open.begin());
+  for (Connection *c : closed)
+    delete c;
+  closed.clear();
+  if (listenFd >= 0) {
+    close(listenFd);
+    unlink(endpoint.c_str());
+  }
+  if (epollFd >= 0)
+    close(epollFd);
+  if (wakeFd >= 0)
+    close(wakeFd);
+  listenFd = epollFd = wakeFd = -1;
+}
+
+#else
+
+struct ControlServer::Connection {};
+
+bool ControlServer::Start(const std::string &name, std::string &error) {
+  endpoint = name;
+  error = "the control server needs epoll or I/O completion ports";
+  return false;
+}
+
+void ControlServer::Stop() {}
+
+#endif
+
+#ifndef _WIN32
+
+ControlClient::ControlClient() : inboxPos(0), nextId(1), fd(-1) {}
+
+ControlClient::~ControlClient() { Close(); }
+
+bool ControlClient::Connect(const std::string &endpoint) {
+  Close();
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (endpoint.size() >= sizeof(addr.sun_path))
+    return false;
+  memcpy(addr.sun_path, endpoint.c_str(), endpoint.size() + 1);
+  fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return false;
+  if (connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void ControlClient::Close() {
+  if (fd >= 0)
+    close(fd);
+  fd = -1;
+  outbox.clear();
+  inbox.clear();
+  inboxPos = 0;
+}
+
+bool ControlClient::IsConnected() const { return fd >= 0; }
+
+bool ControlClient::Flush() {
+  size_t sent = 0;
+  while (sent < outbox.size()) {
+    ssize_t n = send(fd, outbox.data() + sent, outbox.size() - sent,
+                     MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    sent += (size_t)n;
+  }
+  outbox.clear();
+  return true;
+}
+
+bool ControlClient::Receive(ControlHeader &header, std::string &payload) {
+  char buffer[kReadChunk];
+  for (;;) {
+    const char *data = nullptr;
+    ptrdiff_t n = ParseControlFrame(inbox.data() + inboxPos,
+                                    inbox.size() - inboxPos, header, data);
+    if (n < 0)
+      return false;
+    if (n > 0) {
+      payload.assign(data, header.length);
+      inboxPos += (size_t)n;
+      if (inboxPos == inbox.size()) {
+        inbox.clear();
+        inboxPos = 0;
+      }
+      return true;
+    }
+    ssize_t got = recv(fd, buffer, sizeof(buffer), 0);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0)
+      return false;
+    inbox.erase(0, inboxPos);
+    inboxPos = 0;
+    inbox.append(buffer, (size_t)got);
+  }
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef CONTROLSERVER_H
+#define CONTROLSERVER_H
+
+#include "AutoClicker.h"
+#include "ControlProtocol.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Lets scripts drive an AutoClicker over the protocol of ControlProtocol.h:
+// start and stop it, change its settings and read its counters.
+//
+// One event-loop thread serves every client: epoll over a Unix domain socket
+// on Linux, an I/O completion port over named pipe instances on Windows. It
+// reads whatever a client sent, runs all complete requests and answers them
+// with one write. Commands only go through AutoClicker's public calls, so the
+// loop thread waits as those do: Stop() until the click worker is idle,
+// Start() while it reads a histogram or template file. Settings from
+// clients go through ClampClickSettings() first. A client that stops
+// reading its answers is no longer read from until it catches up.
+//
+// The endpoint is local to the machine (and, on Linux, created 0600). The
+// settings the server starts the clicker with are its own copy: clients
+// change them, the dialog and settings.dat do not see those changes.
+class ControlServer {
+public:
+  ControlServer(AutoClicker &clicker, const ClickSettings &initial);
+  ~ControlServer();
+
+  // Creates `endpoint` (see DefaultControlEndpoint()) and starts serving.
+  // False with `error` set if it cannot.
+  bool Start(const std::string &endpoint, std::string &error);
+  void Stop();
+
+  const std::string &GetEndpoint() const { return endpoint; }
+  uint64_t GetRequestCount() const { return requests.load(); }
+  int GetConnectionCount() const { return connections.load(); }
+
+  // Output a client may leave unread before the server stops reading from
+  // it.
+  static const size_t kMaxPendingOutput = 1 << 20;
+
+private:
+  struct Connection;
+
+  ControlServer(const ControlServer &) = delete;
+  ControlServer &operator=(const ControlServer &) = delete;
+
+  void Run();
+  // Runs every complete request in `in`, appends the answers to `out` and
+  // drops what it consumed. False on a malformed frame.
+  bool ProcessInput(std::string &in, std::string &out);
+  void Execute(const ControlHeader &request, const char *payload,
+               std::string &out);
+  void Close(Connection *c);
+
+  AutoClicker &clicker;
+  ClickSettings settings; // Loop thread only
+  std::string endpoint;
+  std::thread thread;
+  std::unordered_set<Connection *> open;
+  std::atomic<uint64_t> requests;
+  std::atomic<int> connections;
+#ifdef _WIN32
+  bool CreateInstance(bool first);
+  void StartRead(Connection *c);
+  void StartWrite(Connection *c);
+  void Reap(Connection *c);
+  void *port; // HANDLE of the completion port
+#else
+  void Update(Connection *c);
+  int listenFd;
+  int epollFd;
+  int wakeFd; // eventfd; Stop() makes it readable
+  // Out of descriptors: when listenFd was taken out of the epoll set, else 0
+  int64_t listenPausedNs;
+  std::vector<Connection *> closed; // Freed after each epoll_wait batch
+#endif
+};
+
+// Blocking client for scripts, tools and the load test. Requests are queued
+// and sent together by Flush(), so a batch costs one write; answers come
+// back in request order.
+class ControlClient {
+public:
+  ControlClient();
+  ~ControlClient();
+
+  bool Connect(const std::string &endpoint);
+  void Close();
+  bool IsConnected() const;
+
+  // Returns the request id.
+  uint32_t Queue(ControlOp op, const void *payload = nullptr,
+                 size_t size = 0);
+  bool Flush();
+  // The next answer. False if the connection failed or closed.
+  bool Receive(ControlHeader &header, std::string &payload);
+
+  // Queue(), Flush() and Receive() for one request.
+  bool Call(ControlOp op, const void *payload, size_t size,
+            ControlHeader &header, std::string &response);
+
+private:
+  ControlClient(const ControlClient &) = delete;
+  ControlClient &operator=(const ControlClient &) = delete;
+
+  std::string outbox;
+  std::string inbox;
+  size_t inboxPos; // Start of the unread part of `inbox`
+  uint32_t nextId;
+#ifdef _WIN32
+  void *pipe; // HANDLE
+#else
+  int fd;
+#endif
+};
+
+#endif // CONTROLSERVER_H
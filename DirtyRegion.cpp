@@ -0,0 +1,140 @@
+#include "DirtyRegion.h"
+
+#include <algorithm>
+
+void DirtyRegion::Resize(int w, int h) {
+  width = w > 0 ? w : 0;
+  height = h > 0 ? h : 0;
+  columns = (width + kTileSize - 1) / kTileSize;
+  rows = (height + kTileSize - 1) / kTileSize;
+  tiles.assign((size_t)columns * rows, 0);
+  dirtyTiles = 0;
+}
+
+void DirtyRegion::Clear() {
+  std::fill(tiles.begin(), tiles.end(), (uint8_t)0);
+  dirtyTiles = 0;
+}
+
+void DirtyRegion::Add(int x, int y, int w, int h) {
+  int right = std::min(x + w, width);
+  int bottom = std::min(y + h, height);
+  x = std::max(x, 0);
+  y = std::max(y, 0);
+  if (x >= right || y >= bottom)
+    return;
+
+  const int c0 = x / kTileSize, c1 = (right - 1) / kTileSize;
+  const int r0 = y / kTileSize, r1 = (bottom - 1) / kTileSize;
+  for (int row = r0; row <= r1; row++) {
+    uint8_t *t = &tiles[(size_t)row * columns];
+    for (int col = c0; col <= c1; col++) {
+      dirtyTiles += !t[col];
+      t[col] = 1;
+    }
+  }
+}
+
+bool DirtyRegion::BlockDirty(int column, int row, int factor) const {
+  const int c1 = std::min((column + 1) * factor, columns);
+  const int r1 = std::min((row + 1) * factor, rows);
+  for (int r = row * factor; r < r1; r++) {
+    for (int c = column * factor; c < c1; c++) {
+      if (tiles[(size_t)r * columns + c])
+        return true;
+    }
+  }
+  return false;
+}
+
+bool DirtyRegion::BuildRects(int factor, std::vector<DirtyRect> &rects,
+                             size_t maxRects) const {
+  rects.clear();
+  const int blockSize = kTileSize * factor;
+  const int blockColumns = (columns + factor - 1) / factor;
+  const int blockRows = (rows + factor - 1) / factor;
+  std::vector<uint8_t> runs(blockColumns);
+
+  // Rects still growing downwards are those whose bottom is the current row.
+  size_t openBegin = 0;
+  for (int row = 0; row < blockRows; row++) {
+    for (int col = 0; col < blockColumns; col++)
+      runs[col] = BlockDirty(col, row, factor);
+    const int top = row * blockSize;
+    const int bottom = std::min(top + blockSize, height);
+    const size_t openEnd = rects.size();
+    size_t open = openBegin;
+
+    for (int col = 0; col < blockColumns;) {
+      if (!runs[col]) {
+        col++;
+        continue;
+      }
+      int end = col;
+      while (end < blockColumns && runs[end])
+        end++;
+      const int left = col * blockSize;
+      const int right = std::min(end * blockSize, width);
+      col = end;
+
+      // Open rects are sorted by left, as are the runs of this row.
+      while (open < openEnd && rects[open].left < left)
+        open++;
+      if (open < openEnd && rects[open].left == left &&
+          rects[open].right == right && rects[open].bottom == top) {
+        rects[open++].bottom = bottom;
+        continue;
+      }
+      rects.push_back({left, top, right, bottom});
+    }
+
+    // Rects from before this row that were not extended are closed.
+    size_t keep = openBegin;
+    for (size_t i = openBegin; i < rects.size(); i++) {
+      if (rects[i].bottom == bottom)
+        std::swap(rects[keep++], rects[i]);
+    }
+    // Keep open rects sorted by left for the next row.
+    std::sort(rects.begin() + openBegin, rects.begin() + keep,
+              [](const DirtyRect &a, const DirtyRect &b) {
+                return a.left < b.left;
+              });
+    // Closed rects move in front of the open ones.
+    std::rotate(rects.begin() + openBegin, rects.begin() + keep, rects.end());
+    openBegin = rects.size() - (keep - openBegin);
+
+    if (rects.size() > maxRects)
+      return false;
+  }
+  return true;
+}
+
+void DirtyRegion::GetRects(std::vector<DirtyRect> &rects,
+                           size_t maxRects) const {
+  rects.clear();
+  if (dirtyTiles == 0)
+    return;
+  if (maxRects < 1)
+    maxRects = 1;
+  // Coarser blocks cover more clean pixels but need fewer rects. At worst
+  // one block covers the whole area.
+  for (int factor = 1;; factor *= 2) {
+    if (BuildRects(factor, rects, maxRects) ||
+        (factor >= columns && factor >= rows))
+      break;
+  }
+  if (rects.size() > maxRects)
+    rects.assign(1, {0, 0, width, height});
+}
+
+uint64_t DirtyRegion::DirtyPixels() const {
+  uint64_t pixels = 0;
+  for (int row = 0; row < rows; row++) {
+    const int h = std::min(kTileSize, height - row * kTileSize);
+    for (int col = 0; col < columns; col++) {
+      if (tiles[(size_t)row * columns + col])
+        pixels += (uint64_t)h * std::min(kTileSize, width - col * kTileSize);
+    }
+  }
+  return pixels;
+}
@@ -0,0 +1,57 @@
+#ifndef DIRTYREGION_H
+#define DIRTYREGION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Edges as in a Win32 RECT: right and bottom are exclusive.
+struct DirtyRect {
+  int left;
+  int top;
+  int right;
+  int bottom;
+};
+
+// Collects the areas that changed during a frame on a grid of kTileSize
+// tiles, then hands them back as a few rectangles: runs of dirty tiles in a
+// tile row, merged with identical runs in the rows below. Marking is O(tiles
+// touched) regardless of how many rectangles are added.
+class DirtyRegion {
+public:
+  static const int kTileSize = 16;
+
+  DirtyRegion() : width(0), height(0), columns(0), rows(0), dirtyTiles(0) {}
+
+  // Clears the region for a width x height area.
+  void Resize(int width, int height);
+  void Clear();
+  bool Empty() const { return dirtyTiles == 0; }
+  int Width() const { return width; }
+  int Height() const { return height; }
+
+  // Clipped to the area; empty rectangles are ignored.
+  void Add(int x, int y, int w, int h);
+  void AddAll() { Add(0, 0, width, height); }
+
+  // Returns the dirty area as non-overlapping rectangles clipped to the area.
+  // If that would take more than `maxRects`, tiles are grouped into 2x2,
+  // 4x4, ... blocks until it fits, covering some clean pixels as well.
+  void GetRects(std::vector<DirtyRect> &rects, size_t maxRects) const;
+  // Pixels covered by the dirty tiles (clipped to the area).
+  uint64_t DirtyPixels() const;
+
+private:
+  bool BlockDirty(int column, int row, int factor) const;
+  bool BuildRects(int factor, std::vector<DirtyRect> &rects,
+                  size_t maxRects) const;
+
+  int width;
+  int height;
+  int columns;
+  int rows;
+  size_t dirtyTiles;
+  std::vector<uint8_t> tiles;
+};
+
+#endif // DIRTYREGION_H
@@ -0,0 +1,124 @@
+#include "DisplayList.h"
+
+#include <algorithm>
+
+static bool Overlaps(const DirtyRect &a, const DirtyRect &b) {
+  return a.left < b.right && b.left < a.right && a.top < b.bottom &&
+         b.top < a.bottom;
+}
+
+void DisplayList::Clear() {
+  list.clear();
+  textPool.clear();
+  columns = rows = 0;
+  tileStart.clear();
+  tileItems.clear();
+  seen.clear();
+}
+
+void DisplayList::AddFill(const DirtyRect &r, int paint) {
+  if (r.right <= r.left || r.bottom <= r.top)
+    return;
+  DisplayItem item = {DisplayOp::Fill, paint, r, 0, 0};
+  list.push_back(item);
+}
+
+void DisplayList::AddText(const DirtyRect &r, int paint, const wchar_t *text,
+                          size_t length) {
+  if (length == 0)
+    return;
+  DisplayItem item = {DisplayOp::Text, paint, r, (uint32_t)textPool.size(),
+                      (uint32_t)length};
+  textPool.insert(textPool.end(), text, text + length);
+  list.push_back(item);
+}
+
+void DisplayList::AddFrame(const DirtyRect &r, int paint,
+                           const DirtyRect *hole) {
+  const DirtyRect edges[4] = {
+      {r.left, r.top, r.right, r.top + 1},         // Top
+      {r.left, r.bottom - 1, r.right, r.bottom},   // Bottom
+      {r.left, r.top + 1, r.left + 1, r.bottom - 1},  // Left
+      {r.right - 1, r.top + 1, r.right, r.bottom - 1}, // Right
+  };
+  for (const DirtyRect &e : edges) {
+    if (!hole || !Overlaps(e, *hole)) {
+      AddFill(e, paint);
+      continue;
+    }
+    // What is left of the edge around the hole: up to four pieces.
+    const DirtyRect &h = *hole;
+    AddFill({e.left, e.top, e.right, std::max(e.top, h.top)}, paint);
+    AddFill({e.left, std::min(e.bottom, h.bottom), e.right, e.bottom}, paint);
+    const int top = std::max(e.top, h.top);
+    const int bottom = std::min(e.bottom, h.bottom);
+    AddFill({e.left, top, std::max(e.left, h.left), bottom}, paint);
+    AddFill({std::min(e.right, h.right), top, e.right, bottom}, paint);
+  }
+}
+
+void DisplayList::Build() {
+  int right = 0, bottom = 0;
+  for (const DisplayItem &item : list) {
+    right = std::max(right, item.bounds.right);
+    bottom = std::max(bottom, item.bounds.bottom);
+  }
+  columns = (right + kTileSize - 1) / kTileSize;
+  rows = (bottom + kTileSize - 1) / kTileSize;
+
+  // Counting sort of (tile, item) pairs: count, prefix sum, place.
+  tileStart.assign((size_t)columns * rows + 1, 0);
+  auto forTiles = [&](const DirtyRect &b, auto &&fn) {
+    const int c0 = std::max(b.left, 0) / kTileSize;
+    const int r0 = std::max(b.top, 0) / kTileSize;
+    const int c1 = std::min((b.right - 1) / kTileSize, columns - 1);
+    const int r1 = std::min((b.bottom - 1) / kTileSize, rows - 1);
+    for (int row = r0; row <= r1; row++)
+      for (int col = c0; col <= c1; col++)
+        fn((size_t)row * columns + col);
+  };
+  for (const DisplayItem &item : list)
+    forTiles(item.bounds, [&](size_t t) { tileStart[t + 1]++; });
+  for (size_t t = 1; t < tileStart.size(); t++)
+    tileStart[t] += tileStart[t - 1];
+  tileItems.resize(tileStart.back());
+  std::vector<uint32_t> fill(tileStart.begin(), tileStart.end() - 1);
+  for (uint32_t i = 0; i < list.size(); i++)
+    forTiles(list[i].bounds, [&](size_t t) { tileItems[fill[t]++] = i; });
+
+  seen.assign(list.size(), 0);
+  stamp = 0;
+}
+
+void DisplayList::Query(const DirtyRect *rects, size_t count,
+                        std::vector<uint32_t> &items) const {
+  items.clear();
+  if (columns == 0 || rows == 0)
+    return;
+  if (++stamp == 0) { // Wrapped: forget every mark
+    std::fill(seen.begin(), seen.end(), 0);
+    stamp = 1;
+  }
+  for (size_t k = 0; k < count; k++) {
+    const DirtyRect &r = rects[k];
+    if (r.right <= 0 || r.bottom <= 0 || r.right <= r.left ||
+        r.bottom <= r.top)
+      continue;
+    const int c0 = std::max(r.left, 0) / kTileSize;
+    const int r0 = std::max(r.top, 0) / kTileSize;
+    const int c1 = std::min((r.right - 1) / kTileSize, columns - 1);
+    const int r1 = std::min((r.bottom - 1) / kTileSize, rows - 1);
+    for (int row = r0; row <= r1; row++)
+      for (int col = c0; col <= c1; col++) {
+        const size_t t = (size_t)row * columns + col;
+        for (uint32_t j = tileStart[t]; j < tileStart[t + 1]; j++) {
+          const uint32_t i = tileItems[j];
+          if (seen[i] != stamp && Overlaps(list[i].bounds, r)) {
+            seen[i] = stamp;
+            items.push_back(i);
+          }
+        }
+      }
+  }
+  std::sort(items.begin(), items.end()); // Drawing order
+}
@@ -0,0 +1,73 @@
+#ifndef DISPLAYLIST_H
+#define DISPLAYLIST_H
+
+#include "DirtyRegion.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class DisplayOp : uint8_t {
+  Fill = 0, // Fill `bounds` with the paint
+  Text = 1, // Draw text at bounds.left/top; bounds is its measured extent
+};
+
+struct DisplayItem {
+  DisplayOp op;
+  int paint;        // Caller's brush (Fill) or colour (Text) index
+  DirtyRect bounds; // Everything the item touches
+  uint32_t text;    // Text: first character in the list's text pool
+  uint32_t length;  // Text: characters
+};
+
+// Drawing commands compiled once from a static layout and replayed every
+// frame. Everything that does not change between frames (text extents,
+// border pieces, which paint to use) is worked out when the list is built;
+// the caller rebuilds it when the layout, theme or DPI changes.
+//
+// Build() files the items under a grid of kTileSize tiles, so Query() only
+// looks at items near the rectangles being repainted: per-frame cost follows
+// the repainted area, not the number of items in the list.
+class DisplayList {
+public:
+  static const int kTileSize = 64;
+
+  DisplayList() : columns(0), rows(0), stamp(0) {}
+
+  void Clear();
+  void AddFill(const DirtyRect &r, int paint);
+  // `r` is the text's extent, as measured by the caller.
+  void AddText(const DirtyRect &r, int paint, const wchar_t *text,
+               size_t length);
+  // A 1-pixel border around `r` (as FrameRect draws it), minus `hole` if
+  // given: a group box title sits in a gap of the top edge.
+  void AddFrame(const DirtyRect &r, int paint, const DirtyRect *hole);
+
+  // Indexes the items; call after adding them and before Query().
+  void Build();
+
+  // Items that overlap any of `rects`, each once, in the order they were
+  // added. `items` is cleared first.
+  void Query(const DirtyRect *rects, size_t count,
+             std::vector<uint32_t> &items) const;
+
+  size_t Size() const { return list.size(); }
+  const DisplayItem &Item(uint32_t i) const { return list[i]; }
+  const wchar_t *Text(const DisplayItem &item) const {
+    return textPool.data() + item.text;
+  }
+
+private:
+  std::vector<DisplayItem> list;
+  std::vector<wchar_t> textPool;
+  // Items per tile: tileItems[tileStart[t] .. tileStart[t + 1]).
+  int columns;
+  int rows;
+  std::vector<uint32_t> tileStart;
+  std::vector<uint32_t> tileItems;
+  // Query() marks items it returned with the current stamp.
+  mutable std::vector<uint32_t> seen;
+  mutable uint32_t stamp;
+};
+
+#endif // DISPLAYLIST_H
@@ -0,0 +1,281 @@
+#include "Distribution.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+FastRandom::FastRandom(uint64_t seed) {
+  // splitmix64 spreads any seed, 0 included, over the whole state.
+  for (int i = 0; i < 4; i++) {
+    uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    s[i] = z ^ (z >> 31);
+  }
+}
+
+bool AliasTable::Build(const std::vector<double> &weights) {
+  cells.clear();
+  const size_t n = weights.size();
+  double sum = 0.0;
+  for (double w : weights) {
+    if (!(w >= 0.0))
+      return false; // Negative or NaN
+    sum += w;
+  }
+  if (n == 0 || n > 0xffffffffu || !(sum > 0.0))
+    return false;
+
+  // Vose: every column is filled to exactly 1 with its own outcome plus one
+  // alias taken from a column that had more than its share.
+  std::vector<double> p(n);
+  std::vector<uint32_t> small, large;
+  for (size_t i = 0; i < n; i++) {
+    p[i] = weights[i] * (double)n / sum;
+    (p[i] < 1.0 ? small : large).push_back((uint32_t)i);
+  }
+
+  cells.resize(n);
+  while (!small.empty() && !large.empty()) {
+    const uint32_t s = small.back(), l = large.back();
+    small.pop_back();
+    cells[s].threshold = (uint64_t)(p[s] * 4294967296.0);
+    cells[s].alias = l;
+    p[l] -= 1.0 - p[s];
+    if (p[l] < 1.0) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // What is left is 1 up to rounding.
+  for (uint32_t i : large) {
+    cells[i].threshold = 4294967296ull;
+    cells[i].alias = i;
+  }
+  for (uint32_t i : small) {
+    cells[i].threshold = 4294967296ull;
+    cells[i].alias = i;
+  }
+  return true;
+}
+
+Distribution::Distribution() : kind(DistributionKind::None), spread(0.0) {}
+
+void Distribution::SetNone() {
+  kind = DistributionKind::None;
+  spread = 0.0;
+  table.clear();
+  alias.Clear();
+}
+
+void Distribution::SetUniform(double halfWidth) {
+  SetNone();
+  kind = DistributionKind::Uniform;
+  spread = halfWidth;
+}
+
+void Distribution::SetGaussian(double sigma) {
+  SetNone();
+  kind = DistributionKind::Gaussian;
+  spread = sigma;
+  // table[i] = sigma * quantile(i / N) for i in 1..N-1; the outer 1/N on
+  // each side goes to InverseNormal() directly.
+  table.resize(kGaussianTableSize);
+  table[0] = 0.0;
+  for (int i = 1; i < kGaussianTableSize; i++)
+    table[i] = sigma * InverseNormal((double)i / kGaussianTableSize);
+}
+
+bool Distribution::SetHistogram(const std::vector<double> &values,
+                                const std::vector<double> &weights) {
+  SetNone();
+  if (values.size() != weights.size() || !alias.Build(weights))
+    return false;
+  kind = DistributionKind::Histogram;
+  table = values;
+  return true;
+}
+
+double Distribution::Sample(FastRandom &rng) const {
+  switch (kind) {
+  case DistributionKind::Uniform:
+    return spread * (2.0 * rng.NextDouble() - 1.0);
+  case DistributionKind::Gaussian: {
+    const double u = rng.NextDouble();
+    const double pos = u * kGaussianTableSize;
+    if (pos >= 1.0 && pos < kGaussianTableSize - 1) {
+      const int i = (int)pos;
+      const double f = pos - i;
+      return table[i] + f * (table[i + 1] - table[i]);
+    }
+    return spread * InverseNormal(u > 0.0 ? u : 0x1p-54); // Tails, 1 in 2048
+  }
+  case DistributionKind::Histogram:
+    return table[alias.Sample(rng.Next())];
+  default:
+    return 0.0;
+  }
+}
+
+double Distribution::InverseNormal(double p) {
+  // Acklam's rational approximation (relative error 1.2e-9), then one Halley
+  // step against erfc() for full double precision.
+  static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02,
+                             -2.759285104469687e+02, 1.383577518672690e+02,
+                             -3.066479806614716e+01, 2.506628277459239e+00};
+  static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02,
+                             -1.556989798598866e+02, 6.680131188771972e+01,
+                             -1.328068155288572e+01};
+  static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01,
+                             -2.400758277161838e+00, -2.549732539343734e+00,
+                             4.374664141464968e+00,  2.938163982698783e+00};
+  static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01,
+                             2.445134137142996e+00, 3.754408661907416e+00};
+  if (p <= 0.0)
+    return -INFINITY;
+  if (p >= 1.0)
+    return INFINITY;
+
+  const double pLow = 0.02425;
+  double x;
+  if (p < pLow || p > 1.0 - pLow) {
+    const double q = std::sqrt(-2.0 * std::log(p < pLow ? p : 1.0 - p));
+    x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+        ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+    if (p > pLow)
+      x = -x;
+  } else {
+    const double q = p - 0.5, r = q * q;
+    x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) *
+        q /
+        (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+  }
+
+  const double e = 0.5 * std::erfc(-x / std::sqrt(2.0)) - p;
+  const double sqrt2Pi = 2.5066282746310002;
+  const double u = e * sqrt2Pi * std::exp(x * x / 2.0);
+  return x - u / (1.0 + x * u / 2.0);
+}
+
+void OffsetDistribution::SetNone() {
+  kind = DistributionKind::None;
+  spread = 0;
+  x.SetNone();
+  y.SetNone();
+  pairs.Clear();
+  pairX.clear();
+  pairY.clear();
+}
+
+void OffsetDistribution::SetUniform(int pixels) {
+  SetNone();
+  kind = DistributionKind::Uniform;
+  spread = std::abs(pixels);
+}
+
+void OffsetDistribution::SetGaussian(double sigma) {
+  SetNone();
+  kind = DistributionKind::Gaussian;
+  x.SetGaussian(sigma);
+  y.SetGaussian(sigma);
+}
+
+bool OffsetDistribution::SetHistogram(const std::vector<int> &dx,
+                                      const std::vector<int> &dy,
+                                      const std::vector<double> &weights) {
+  SetNone();
+  if (dx.size() != weights.size() || dy.size() != weights.size() ||
+      !pairs.Build(weights))
+    return false;
+  kind = DistributionKind::Histogram;
+  pairX = dx;
+  pairY = dy;
+  return true;
+}
+
+// Round to nearest without a libm call or a data-dependent branch.
+static int RoundToInt(double v) {
+  const double h = v + 0.5;
+  const int i = (int)h; // Truncates towards zero
+  return i - (int)(h < i);
+}
+
+void OffsetDistribution::Sample(FastRandom &rng, int &dx, int &dy) const {
+  switch (kind) {
+  case DistributionKind::Uniform: {
+    // Every whole offset in [-spread, spread] equally likely, both axes from
+    // one 64-bit number.
+    const uint64_t r = rng.Next();
+    const uint64_t width = 2 * (uint64_t)spread + 1;
+    dx = (int)(((r >> 32) * width) >> 32) - spread;
+    dy = (int)(((r & 0xffffffffu) * width) >> 32) - spread;
+    break;
+  }
+  case DistributionKind::Gaussian:
+    dx = RoundToInt(x.Sample(rng));
+    dy = RoundToInt(y.Sample(rng));
+    break;
+  case DistributionKind::Histogram: {
+    const uint32_t i = pairs.Sample(rng.Next());
+    dx = pairX[i];
+    dy = pairY[i];
+    break;
+  }
+  default:
+    dx = dy = 0;
+    break;
+  }
+}
+
+bool LoadHistogramFile(const std::string &path, int columns,
+                       std::vector<double> &values,
+                       std::vector<double> &weights, std::string &error) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    error = "cannot open " + path;
+    return false;
+  }
+
+  values.clear();
+  weights.clear();
+  std::string line;
+  int lineNo = 0;
+  while (std::getline(file, line)) {
+    lineNo++;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos)
+      line.erase(hash);
+
+    std::istringstream words(line);
+    std::vector<double> numbers;
+    std::string word;
+    while (words >> word) {
+      char *end = NULL;
+      double v = strtod(word.c_str(), &end);
+      if (*end != '\0' || !std::isfinite(v)) {
+        error = "line " + std::to_string(lineNo) + ": not a number: " + word;
+        return false;
+      }
+      numbers.push_back(v);
+    }
+    if (numbers.empty())
+      continue;
+    if ((int)numbers.size() != columns + 1 || numbers.back() < 0.0) {
+      error = "line " + std::to_string(lineNo) + ": expected " +
+              std::to_string(columns) + " value(s) and a weight >= 0";
+      return false;
+    }
+    values.insert(values.end(), numbers.begin(), numbers.end() - 1);
+    weights.push_back(numbers.back());
+  }
+
+  double sum = 0.0;
+  for (double w : weights)
+    sum += w;
+  if (!(sum > 0.0)) {
+    error = path + ": no bin has a positive weight";
+    return false;
+  }
+  return true;
+}
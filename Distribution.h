@@ -0,0 +1,127 @@
+#ifndef DISTRIBUTION_H
+#define DISTRIBUTION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// xoshiro256** seeded through splitmix64. A few instructions per number and
+// no shared state, so each worker keeps its own instead of calling rand().
+class FastRandom {
+public:
+  explicit FastRandom(uint64_t seed);
+
+  uint64_t Next() {
+    const uint64_t result = Rotl(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = Rotl(s[3], 45);
+    return result;
+  }
+
+  // Uniform in [0, 1) with 53 random bits.
+  double NextDouble() { return (Next() >> 11) * (1.0 / 9007199254740992.0); }
+
+private:
+  static uint64_t Rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+  uint64_t s[4];
+};
+
+enum class DistributionKind {
+  None = 0,      // Always 0
+  Uniform = 1,   // Flat over [-spread, spread]
+  Gaussian = 2,  // Mean 0, standard deviation `spread`
+  Histogram = 3, // Weighted values loaded from a file
+};
+
+// Vose alias table: picks one of n weighted outcomes in O(1) from a single
+// 64-bit random number (high half picks a column, low half the coin).
+class AliasTable {
+public:
+  // False if there are no weights or none is positive.
+  bool Build(const std::vector<double> &weights);
+  void Clear() { cells.clear(); }
+
+  size_t Size() const { return cells.size(); }
+  // Requires Size() > 0.
+  uint32_t Sample(uint64_t r) const {
+    const uint32_t column = (uint32_t)(((r >> 32) * cells.size()) >> 32);
+    const Cell &c = cells[column];
+    // Branch-free: the coin is random, so a branch would mispredict often.
+    const uint32_t keep = (uint32_t)((r & 0xffffffffu) < c.threshold);
+    return c.alias + keep * (column - c.alias);
+  }
+
+private:
+  struct Cell {
+    uint64_t threshold; // Keep the column if the coin is below (2^32 = always)
+    uint32_t alias;
+  };
+  std::vector<Cell> cells;
+};
+
+// A scalar distribution compiled for cheap sampling: uniform directly,
+// gaussian from an inverse-CDF lookup table (exact tails), histograms from an
+// alias table.
+class Distribution {
+public:
+  Distribution();
+
+  void SetNone();
+  void SetUniform(double spread);
+  void SetGaussian(double sigma);
+  // `values[i]` is drawn with probability weights[i] / sum(weights).
+  bool SetHistogram(const std::vector<double> &values,
+                    const std::vector<double> &weights);
+
+  DistributionKind Kind() const { return kind; }
+  double Sample(FastRandom &rng) const;
+
+  // Standard normal quantile, for building tables and checking samples.
+  static double InverseNormal(double p);
+
+private:
+  static const int kGaussianTableSize = 4096;
+
+  DistributionKind kind;
+  double spread;
+  std::vector<double> table; // Gaussian quantiles or histogram values
+  AliasTable alias;
+};
+
+// Two-dimensional offsets (dx, dy) in whole pixels. Uniform and gaussian draw
+// each axis independently; histograms draw (dx, dy) pairs jointly.
+class OffsetDistribution {
+public:
+  void SetNone();
+  void SetUniform(int pixels);
+  void SetGaussian(double sigma);
+  bool SetHistogram(const std::vector<int> &dx, const std::vector<int> &dy,
+                    const std::vector<double> &weights);
+
+  DistributionKind Kind() const { return kind; }
+  void Sample(FastRandom &rng, int &dx, int &dy) const;
+
+private:
+  DistributionKind kind = DistributionKind::None;
+  int spread = 0; // Uniform
+  Distribution x; // Gaussian
+  Distribution y;
+  AliasTable pairs;
+  std::vector<int> pairX;
+  std::vector<int> pairY;
+};
+
+// Reads a text histogram: one bin per line, `columns` values followed by a
+// weight, '#' starts a comment. `values` gets the columns of every bin, one
+// bin after the other. Returns false and fills `error` ("line N: ...").
+bool LoadHistogramFile(const std::string &path, int columns,
+                       std::vector<double> &values,
+                       std::vector<double> &weights, std::string &error);
+
+#endif // DISTRIBUTION_H
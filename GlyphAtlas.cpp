@@ -0,0 +1,160 @@
+#include "GlyphAtlas.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+void GlyphAtlas::Build(const std::vector<GlyphMask> &masks, int cw, int ch,
+                       const std::vector<uint32_t> &levelColors) {
+  Clear();
+  if (masks.empty() || levelColors.empty() || cw <= 0 || ch <= 0)
+    return;
+
+  cellWidth = cw;
+  cellHeight = ch;
+  glyphCount = (int)masks.size();
+  levelCount = (int)levelColors.size();
+  sheet.width = cellWidth * glyphCount;
+  sheet.height = cellHeight * levelCount;
+  sheet.pixels.assign((size_t)sheet.width * sheet.height, 0);
+
+  for (int level = 0; level < levelCount; level++) {
+    const uint32_t rgb = levelColors[level] & 0x00FFFFFF;
+    for (int g = 0; g < glyphCount; g++) {
+      const uint8_t *mask = masks[g].data();
+      for (int row = 0; row < cellHeight; row++) {
+        uint32_t *dst = sheet.pixels.data() +
+                        (size_t)(level * cellHeight + row) * sheet.width +
+                        g * cellWidth;
+        for (int col = 0; col < cellWidth; col++) {
+          uint32_t a = mask[row * cellWidth + col];
+          dst[col] = a ? (a << 24) | rgb : 0;
+        }
+      }
+    }
+  }
+}
+
+void GlyphAtlas::Clear() {
+  sheet = Sprite();
+  cellWidth = cellHeight = glyphCount = levelCount = 0;
+}
+
+// 5x7 digits, one byte per row, bit 4 = leftmost column.
+static const uint8_t kBuiltinDigits[10][7] = {
+    {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, // 0
+    {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}, // 1
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}, // 2
+    {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}, // 3
+    {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, // 4
+    {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}, // 5
+    {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, // 6
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // 7
+    {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, // 8
+    {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}, // 9
+};
+
+bool RasterizeBuiltinGlyphs(const char *text, int cellHeight,
+                            std::vector<GlyphMask> &masks, int &cellWidth) {
+  masks.clear();
+  if (cellHeight < 8)
+    cellHeight = 8;
+  const int scale = cellHeight / 8; // 7 rows plus one of spacing
+  cellWidth = 6 * scale;
+  const int top = (cellHeight - 7 * scale) / 2;
+
+  for (const char *c = text; *c; c++) {
+    if (*c < '0' || *c > '9')
+      return false;
+    const uint8_t *rows = kBuiltinDigits[*c - '0'];
+    GlyphMask mask((size_t)cellWidth * cellHeight, 0);
+    for (int row = 0; row < 7 * scale; row++) {
+      for (int col = 0; col < 5 * scale; col++) {
+        if (rows[row / scale] & (0x10 >> (col / scale)))
+          mask[(size_t)(top + row) * cellWidth + col] = 255;
+      }
+    }
+    masks.push_back(mask);
+  }
+  return true;
+}
+
+#ifdef _WIN32
+
+bool RasterizeGdiGlyphs(const wchar_t *fontName, int height, int weight,
+                        const char *text, std::vector<GlyphMask> &masks,
+                        int &cellWidth, int &cellHeight) {
+  masks.clear();
+  const int n = (int)strlen(text);
+  if (n == 0)
+    return false;
+
+  HDC dc = CreateCompatibleDC(NULL);
+  if (!dc)
+    return false;
+  // Grayscale antialiasing so coverage can be read from a single channel.
+  HFONT font = CreateFontW(height, 0, 0, 0, weight, FALSE, FALSE, FALSE,
+                           ANSI_CHARSET, OUT_DEFAULT_PRECIS,
+                           CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY,
+                           DEFAULT_PITCH | FF_MODERN, fontName);
+  HFONT oldFont = (HFONT)SelectObject(dc, font);
+
+  TEXTMETRICW tm;
+  GetTextMetricsW(dc, &tm);
+  cellHeight = tm.tmHeight;
+  cellWidth = 0;
+  for (int i = 0; i < n; i++) {
+    SIZE size;
+    if (GetTextExtentPoint32A(dc, text + i, 1, &size) && size.cx > cellWidth)
+      cellWidth = size.cx;
+  }
+
+  bool ok = false;
+  BITMAPINFO bmi = {};
+  bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+  bmi.bmiHeader.biWidth = cellWidth * n;
+  bmi.bmiHeader.biHeight = -cellHeight; // Top-down
+  bmi.bmiHeader.biPlanes = 1;
+  bmi.bmiHeader.biBitCount = 32;
+  bmi.bmiHeader.biCompression = BI_RGB;
+  void *bits = nullptr;
+  HBITMAP bitmap =
+      cellWidth > 0 && cellHeight > 0
+          ? CreateDIBSection(dc, &bmi, DIB_RGB_COLORS, &bits, NULL, 0)
+          : NULL;
+  if (bitmap) {
+    HBITMAP oldBitmap = (HBITMAP)SelectObject(dc, bitmap);
+    const int stride = cellWidth * n;
+    memset(bits, 0, (size_t)stride * cellHeight * 4);
+    SetBkMode(dc, TRANSPARENT);
+    SetTextColor(dc, RGB(255, 255, 255));
+    for (int i = 0; i < n; i++)
+      TextOutA(dc, i * cellWidth, 0, text + i, 1);
+    GdiFlush();
+
+    // White on black: any channel is the coverage.
+    const uint32_t *pixels = (const uint32_t *)bits;
+    for (int i = 0; i < n; i++) {
+      GlyphMask mask((size_t)cellWidth * cellHeight);
+      for (int row = 0; row < cellHeight; row++) {
+        for (int col = 0; col < cellWidth; col++) {
+          uint32_t p = pixels[(size_t)row * stride + i * cellWidth + col];
+          mask[(size_t)row * cellWidth + col] = (uint8_t)(p >> 8);
+        }
+      }
+      masks.push_back(mask);
+    }
+    SelectObject(dc, oldBitmap);
+    DeleteObject(bitmap);
+    ok = true;
+  }
+
+  SelectObject(dc, oldFont);
+  DeleteObject(font);
+  DeleteDC(dc);
+  return ok;
+}
+
+#endif
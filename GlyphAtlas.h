@@ -0,0 +1,63 @@
+#ifndef GLYPHATLAS_H
+#define GLYPHATLAS_H
+
+#include "SoftRenderer.h"
+
+#include <cstdint>
+#include <vector>
+
+// Coverage (0..255) of one glyph, cellWidth x cellHeight, row-major.
+typedef std::vector<uint8_t> GlyphMask;
+
+// Glyphs pre-rendered once in every color they are drawn in, packed into a
+// single sprite sheet: one column per glyph, one row per color level. Drawing
+// a glyph is then a plain BlitSprite of its cell, with no font or text layout
+// work per frame.
+class GlyphAtlas {
+public:
+  GlyphAtlas() : cellWidth(0), cellHeight(0), glyphCount(0), levelCount(0) {}
+
+  // `masks` must all be cellWidth x cellHeight. Level i is masks tinted with
+  // levelColors[i], coverage becoming alpha.
+  void Build(const std::vector<GlyphMask> &masks, int cellWidth,
+             int cellHeight, const std::vector<uint32_t> &levelColors);
+  void Clear();
+  bool Empty() const { return glyphCount == 0; }
+
+  int CellWidth() const { return cellWidth; }
+  int CellHeight() const { return cellHeight; }
+  int GlyphCount() const { return glyphCount; }
+  int LevelCount() const { return levelCount; }
+  const Sprite &Sheet() const { return sheet; }
+
+  // Out-of-range levels draw the last level.
+  void Draw(Framebuffer &fb, int x, int y, int glyph, int level) const {
+    if (level >= levelCount)
+      level = levelCount - 1;
+    BlitSprite(fb, x, y, sheet, glyph * cellWidth, level * cellHeight,
+               cellWidth, cellHeight);
+  }
+
+private:
+  Sprite sheet;
+  int cellWidth;
+  int cellHeight;
+  int glyphCount;
+  int levelCount;
+};
+
+// Rasterizes the characters of `text` from a small built-in bitmap font
+// (digits only), scaled to `cellHeight`. Used where no system font is
+// available (the benchmarks, non-Windows builds).
+bool RasterizeBuiltinGlyphs(const char *text, int cellHeight,
+                            std::vector<GlyphMask> &masks, int &cellWidth);
+
+#ifdef _WIN32
+// Rasterizes the characters of `text` with GDI into a DIB section, one cell
+// per character sized to the font's widest glyph and line height.
+bool RasterizeGdiGlyphs(const wchar_t *fontName, int height, int weight,
+                        const char *text, std::vector<GlyphMask> &masks,
+                        int &cellWidth, int &cellHeight);
+#endif
+
+#endif // GLYPHATLAS_H
@@ -0,0 +1,465 @@
+#include "HotkeyListener.h"
+#include "InputSink.h"
+
+#include <algorithm>
+#include <cctype>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Key names with their Windows virtual-key and Linux KEY_* codes, so
+// settings written on Windows bind the same key on Linux.
+struct KeyName {
+  const char *name;
+  int vk;
+  int evdev;
+};
+
+const KeyName kKeyNames[] = {
+    {"a", 'A', 30},        {"b", 'B', 48},         {"c", 'C', 46},
+    {"d", 'D', 32},        {"e", 'E', 18},         {"f", 'F', 33},
+    {"g", 'G', 34},        {"h", 'H', 35},         {"i", 'I', 23},
+    {"j", 'J', 36},        {"k", 'K', 37},         {"l", 'L', 38},
+    {"m", 'M', 50},        {"n", 'N', 49},         {"o", 'O', 24},
+    {"p", 'P', 25},        {"q", 'Q', 16},         {"r", 'R', 19},
+    {"s", 'S', 31},        {"t", 'T', 20},         {"u", 'U', 22},
+    {"v", 'V', 47},        {"w", 'W', 17},         {"x", 'X', 45},
+    {"y", 'Y', 21},        {"z", 'Z', 44},         {"0", '0', 11},
+    {"1", '1', 2},         {"2", '2', 3},          {"3", '3', 4},
+    {"4", '4', 5},         {"5", '5', 6},          {"6", '6', 7},
+    {"7", '7', 8},         {"8", '8', 9},          {"9", '9', 10},
+    {"f1", 0x70, 59},      {"f2", 0x71, 60},       {"f3", 0x72, 61},
+    {"f4", 0x73, 62},      {"f5", 0x74, 63},       {"f6", 0x75, 64},
+    {"f7", 0x76, 65},      {"f8", 0x77, 66},       {"f9", 0x78, 67},
+    {"f10", 0x79, 68},     {"f11", 0x7A, 87},      {"f12", 0x7B, 88},
+    {"f13", 0x7C, 183},    {"f14", 0x7D, 184},     {"f15", 0x7E, 185},
+    {"f16", 0x7F, 186},    {"f17", 0x80, 187},     {"f18", 0x81, 188},
+    {"f19", 0x82, 189},    {"f20", 0x83, 190},     {"f21", 0x84, 191},
+    {"f22", 0x85, 192},    {"f23", 0x86, 193},     {"f24", 0x87, 194},
+    {"escape", 0x1B, 1},   {"backspace", 0x08, 14}, {"tab", 0x09, 15},
+    {"enter", 0x0D, 28},   {"space", 0x20, 57},    {"capslock", 0x14, 58},
+    {"scrolllock", 0x91, 70}, {"pause", 0x13, 119}, {"insert", 0x2D, 110},
+    {"delete", 0x2E, 111}, {"home", 0x24, 102},    {"end", 0x23, 107},
+    {"pageup", 0x21, 104}, {"pagedown", 0x22, 109}, {"left", 0x25, 105},
+    {"right", 0x27, 106},  {"up", 0x26, 103},      {"down", 0x28, 108},
+};
+
+int PlatformCode(const KeyName &k) {
+#ifdef _WIN32
+  return k.vk;
+#else
+  return k.evdev;
+#endif
+}
+
+// kHotkey* flag of a modifier key, else 0. Both the generic and the
+// left/right codes, as each API reports one or the other.
+int ModifierOf(int key) {
+#ifdef _WIN32
+  switch (key) {
+  case VK_SHIFT:
+  case VK_LSHIFT:
+  case VK_RSHIFT:
+    return kHotkeyShift;
+  case VK_CONTROL:
+  case VK_LCONTROL:
+  case VK_RCONTROL:
+    return kHotkeyControl;
+  case VK_MENU:
+  case VK_LMENU:
+  case VK_RMENU:
+    return kHotkeyAlt;
+  }
+#elif defined(__linux__)
+  switch (key) {
+  case KEY_LEFTSHIFT:
+  case KEY_RIGHTSHIFT:
+    return kHotkeyShift;
+  case KEY_LEFTCTRL:
+  case KEY_RIGHTCTRL:
+    return kHotkeyControl;
+  case KEY_LEFTALT:
+  case KEY_RIGHTALT:
+    return kHotkeyAlt;
+  }
+#else
+  (void)key;
+#endif
+  return 0;
+}
+
+} // namespace
+
+bool ParseHotkey(const std::string &text, Hotkey &out) {
+  std::string lower(text);
+  std::transform(lower.begin(), lower.end(), lower.begin(),
+                 [](unsigned char c) { return (char)tolower(c); });
+  Hotkey hk;
+  size_t start = 0;
+  for (;;) {
+    const size_t plus = lower.find('+', start);
+    const std::string part = lower.substr(start, plus - start);
+    if (plus == std::string::npos) {
+      for (const KeyName &k : kKeyNames)
+        if (part == k.name) {
+          hk.key = PlatformCode(k);
+          out = hk;
+          return true;
+        }
+      return false;
+    }
+    if (part == "ctrl" || part == "control")
+      hk.mods |= kHotkeyControl;
+    else if (part == "shift")
+      hk.mods |= kHotkeyShift;
+    else if (part == "alt")
+      hk.mods |= kHotkeyAlt;
+    else
+      return false;
+    start = plus + 1;
+  }
+}
+
+Hotkey HotkeyFromSettings(int vk, int mod) {
+  Hotkey hk;
+  hk.mods = mod & (kHotkeyShift | kHotkeyControl | kHotkeyAlt);
+#ifdef _WIN32
+  hk.key = vk;
+#else
+  for (const KeyName &k : kKeyNames)
+    if (k.vk == vk)
+      hk.key = PlatformCode(k);
+#endif
+  return hk;
+}
+
+HotkeyListener::JobId
+HotkeyListener::AddJob(AutoClicker &clicker, const ClickSettings &settings,
+                       const std::vector<Hotkey> &hotkeys) {
+  std::lock_guard<std::mutex> lock(jobsLock);
+  Job job = {nextJob++, &clicker, settings, hotkeys};
+  jobs.push_back(job);
+  return job.id;
+}
+
+void HotkeyListener::RemoveJob(JobId id) {
+  std::lock_guard<std::mutex> lock(jobsLock);
+  jobs.erase(std::remove_if(jobs.begin(), jobs.end(),
+                            [id](const Job &j) { return j.id == id; }),
+             jobs.end());
+}
+
+void HotkeyListener::SetHotkeys(JobId id, const std::vector<Hotkey> &hotkeys) {
+  std::lock_guard<std::mutex> lock(jobsLock);
+  for (Job &j : jobs)
+    if (j.id == id)
+      j.hotkeys = hotkeys;
+}
+
+void HotkeyListener::SetSettings(JobId id, const ClickSettings &settings) {
+  std::lock_guard<std::mutex> lock(jobsLock);
+  for (Job &j : jobs)
+    if (j.id == id)
+      j.settings = settings;
+}
+
+bool HotkeyListener::OnKey(int key, bool down) {
+  if (const int mod = ModifierOf(key)) {
+    mods = down ? (mods | mod) : (mods & ~mod);
+    return false;
+  }
+  // Key repeat sends more key downs; a hotkey toggles once per press.
+  if (key == heldHotkey) {
+    if (!down)
+      heldHotkey = 0;
+    return true;
+  }
+  if (!down)
+    return false;
+
+  {
+    std::lock_guard<std::mutex> lock(jobsLock);
+    for (const Job &j : jobs)
+      for (const Hotkey &hk : j.hotkeys)
+        if (hk.key == key && hk.mods == mods) {
+          hits.push_back({j.id, j.clicker, j.settings});
+          break;
+        }
+  }
+  if (hits.empty())
+    return false;
+
+  heldHotkey = key;
+  {
+    std::lock_guard<std::mutex> lock(pendingLock);
+    pending.insert(pending.end(), hits.begin(), hits.end());
+  }
+  pendingChanged.notify_one();
+  hits.clear(); // Keeps its capacity
+  return true;
+}
+
+void HotkeyListener::StartToggler() {
+  stopToggler = false;
+  toggler = std::thread(&HotkeyListener::RunToggler, this);
+}
+
+void HotkeyListener::StopToggler() {
+  if (!toggler.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(pendingLock);
+    stopToggler = true;
+  }
+  pendingChanged.notify_one();
+  toggler.join();
+}
+
+void HotkeyListener::RunToggler() {
+  // Toggles queued before Stop() are still made.
+  std::vector<Hit> batch;
+  batch.reserve(8);
+  std::unique_lock<std::mutex> lock(pendingLock);
+  for (;;) {
+    pendingChanged.wait(lock,
+                        [this] { return stopToggler || !pending.empty(); });
+    if (pending.empty())
+      return;
+    batch.swap(pending);
+    lock.unlock();
+    for (const Hit &hit : batch) {
+      hit.clicker->Toggle(hit.settings);
+      toggles++;
+      if (onToggle)
+        onToggle(hit.id, hit.clicker->IsRunning());
+    }
+    batch.clear();
+    lock.lock();
+  }
+}
+
+#ifdef _WIN32
+
+// Hook procedures have no context pointer; one listener runs at a time.
+static HotkeyListener *s_listener = nullptr;
+
+static LRESULT CALLBACK HotkeyHookProc(int code, WPARAM wParam,
+                                       LPARAM lParam) {
+  const KBDLLHOOKSTRUCT *k = (const KBDLLHOOKSTRUCT *)lParam;
+  // Injected keys (SendInput, macros among them) are not the user's.
+  if (code == HC_ACTION &&
+      (!(k->flags & LLKHF_INJECTED) || s_listener->GetAcceptInjected()) &&
+      s_listener->OnKey((int)k->vkCode,
+                        wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN))
+    return 1; // Swallowed, like a registered hotkey
+  return CallNextHookEx(NULL, code, wParam, lParam);
+}
+
+HotkeyListener::HotkeyListener()
+    : nextJob(1), mods(0), heldHotkey(0), stopToggler(false), running(false),
+      acceptInjected(false), toggles(0), threadId(0) {
+  hits.reserve(8);
+  pending.reserve(8);
+}
+
+HotkeyListener::~HotkeyListener() { Stop(); }
+
+bool HotkeyListener::Start(ToggleFn fn, const std::vector<std::string> &) {
+  if (running || s_listener)
+    return false;
+
+  onToggle = fn;
+  std::promise<bool> ready;
+  std::future<bool> started = ready.get_future();
+  running = true;
+  StartToggler();
+  thread = std::thread(&HotkeyListener::Run, this, std::ref(ready));
+  if (!started.get()) {
+    Stop();
+    return false;
+  }
+  return true;
+}
+
+void HotkeyListener::Stop() {
+  running = false;
+  if (thread.joinable()) {
+    PostThreadMessage(threadId, WM_QUIT, 0, 0);
+    thread.join();
+  }
+  StopToggler();
+}
+
+void HotkeyListener::Run(std::promise<bool> &ready) {
+  // Low-level hooks are called through the installing thread's message
+  // loop, which has nothing else to do. Windows drops a hook that answers
+  // too slowly, so the hook only queues hits for the toggler thread.
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+  MSG msg;
+  PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE); // Create the queue
+  threadId = GetCurrentThreadId();
+  s_listener = this;
+  mods = heldHotkey = 0;
+  HHOOK hook = SetWindowsHookEx(WH_KEYBOARD_LL, HotkeyHookProc,
+                                GetModuleHandle(NULL), 0);
+  ready.set_value(hook != NULL);
+
+  if (hook) {
+    while (GetMessage(&msg, NULL, 0, 0) > 0) {
+      TranslateMessage(&msg);
+      DispatchMessage(&msg);
+    }
+    UnhookWindowsHookEx(hook);
+  }
+  s_listener = nullptr;
+}
+
+#elif defined(__linux__)
+
+static bool TestBit(const unsigned long *bits, int bit) {
+  const int perLong = (int)sizeof(unsigned long) * 8;
+  return (bits[bit / perLong] >> (bit % perLong)) & 1;
+}
+
+HotkeyListener::HotkeyListener()
+    : nextJob(1), mods(0), heldHotkey(0), stopToggler(false), running(false),
+      acceptInjected(false), toggles(0), wakeFd(-1) {
+  hits.reserve(8);
+  pending.reserve(8);
+}
+
+HotkeyListener::~HotkeyListener() { Stop(); }
+
+bool HotkeyListener::Start(ToggleFn fn,
+                           const std::vector<std::string> &paths) {
+  if (running)
+    return false;
+
+  for (const std::string &path : paths) {
+    int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd >= 0)
+      devices.push_back(fd);
+  }
+  if (paths.empty()) {
+    DIR *dir = opendir("/dev/input");
+    while (dirent *entry = dir ? readdir(dir) : nullptr) {
+      if (strncmp(entry->d_name, "event", 5) != 0)
+        continue;
+      std::string path = std::string("/dev/input/") + entry->d_name;
+      int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+      if (fd < 0)
+        continue;
+      // Keyboards only: mice and pads would just add wake-ups. Our own
+      // uinput device claims every key, and a replayed hotkey press must
+      // not toggle the clicker that replays it.
+      char name[256] = {};
+      ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name);
+      const int bitsPerLong = (int)sizeof(unsigned long) * 8;
+      unsigned long keyBits[KEY_MAX / bitsPerLong + 1] = {};
+      if (strcmp(name, UinputInputSink::kDeviceName) != 0 &&
+          ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keyBits)), keyBits) >= 0 &&
+          (TestBit(keyBits, KEY_A) || TestBit(keyBits, KEY_F6)))
+        devices.push_back(fd);
+      else
+        close(fd);
+    }
+    if (dir)
+      closedir(dir);
+  }
+
+  wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (devices.empty() || wakeFd < 0) {
+    Stop();
+    return false;
+  }
+
+  onToggle = fn;
+  mods = heldHotkey = 0;
+  running = true;
+  StartToggler();
+  thread = std::thread(&HotkeyListener::Run, this);
+  return true;
+}
+
+void HotkeyListener::Stop() {
+  running = false;
+  if (wakeFd >= 0) {
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;
+  }
+  if (thread.joinable())
+    thread.join();
+  StopToggler();
+  for (int fd : devices)
+    close(fd);
+  devices.clear();
+  if (wakeFd >= 0)
+    close(wakeFd);
+  wakeFd = -1;
+}
+
+void HotkeyListener::Run() {
+  std::vector<pollfd> fds(devices.size() + 1);
+  for (size_t i = 0; i < devices.size(); i++)
+    fds[i] = {devices[i], POLLIN, 0};
+  fds.back() = {wakeFd, POLLIN, 0};
+
+  input_event buf[64];
+  while (running) {
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    if (fds.back().revents)
+      break; // Stop()
+
+    for (size_t i = 0; i < devices.size(); i++) {
+      if (fds[i].revents & (POLLERR | POLLNVAL)) {
+        fds[i].fd = -1; // Unplugged; poll() skips negative descriptors
+        continue;
+      }
+      if (!(fds[i].revents & (POLLIN | POLLHUP)))
+        continue;
+      ssize_t n;
+      while ((n = read(devices[i], buf, sizeof(buf))) > 0)
+        for (ssize_t k = 0; k < n / (ssize_t)sizeof(input_event); k++)
+          if (buf[k].type == EV_KEY && buf[k].code < BTN_MISC)
+            OnKey(buf[k].code, buf[k].value != 0); // 2 is a repeat
+      if (n == 0)
+        fds[i].fd = -1; // A pipe whose writer went away
+    }
+  }
+}
+
+#else
+
+HotkeyListener::HotkeyListener()
+    : nextJob(1), mods(0), heldHotkey(0), stopToggler(false), running(false),
+      acceptInjected(false), toggles(0), wakeFd(-1) {}
+
+HotkeyListener::~HotkeyListener() {}
+
+bool HotkeyListener::Start(ToggleFn, const std::vector<std::string> &) {
+  return false;
+}
+void HotkeyListener::Stop() {}
+void HotkeyListener::Run() {}
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef HOTKEYLISTENER_H
+#define HOTKEYLISTENER_H
+
+#include "AutoClicker.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Modifier flags of a Hotkey. Same values as the common controls' HOTKEYF_*
+// flags, so ClickSettings::hotkeyMod can be used as is.
+const int kHotkeyShift = 0x01;
+const int kHotkeyControl = 0x02;
+const int kHotkeyAlt = 0x04;
+
+struct Hotkey {
+  int key = 0;  // Virtual-key code (Windows), KEY_* (Linux); 0: unbound
+  int mods = 0; // kHotkey* flags, matched exactly
+};
+
+// Parses "F6", "Ctrl+Shift+A", "alt+pause" (case-insensitive) into this
+// platform's key codes. False for an unknown name.
+bool ParseHotkey(const std::string &text, Hotkey &out);
+
+// The hotkey stored in settings (a Windows virtual-key code and HOTKEYF_*
+// flags), in this platform's key codes. key is 0 if it has no equivalent.
+Hotkey HotkeyFromSettings(int vk, int mod);
+
+// Starts and stops clickers from the keyboard without going through any
+// window's message queue. A thread of its own watches the keyboard (a
+// low-level keyboard hook on Windows; every keyboard under /dev/input on
+// Linux, which needs root or the `input` group) and hands each hit to a
+// toggler thread, which calls Toggle() on the job's clicker with settings
+// resolved beforehand by SetSettings(). A busy UI thread therefore cannot
+// delay a hotkey, and the keyboard thread never waits on a click worker:
+// Toggle() does, and Windows drops a hook that answers too slowly. Keys
+// injected by a program (macros included) are ignored on Windows; on Linux
+// only the clickers' own uinput device is left out, as evdev cannot tell
+// other programs' virtual keyboards from real ones.
+//
+// Each job is one clicker with its settings and any number of hotkeys; a key
+// may be bound to several jobs. On Windows a matched key is swallowed, as
+// RegisterHotKey does; evdev cannot keep it from other programs.
+class HotkeyListener {
+public:
+  typedef int JobId;
+  // Called on the toggler thread after each toggle it made.
+  typedef std::function<void(JobId job, bool running)> ToggleFn;
+
+  HotkeyListener();
+  ~HotkeyListener();
+
+  // Jobs and their hotkeys and settings may be changed at any time, from
+  // any thread; the next key press sees them.
+  JobId AddJob(AutoClicker &clicker, const ClickSettings &settings,
+               const std::vector<Hotkey> &hotkeys);
+  void RemoveJob(JobId job);
+  void SetHotkeys(JobId job, const std::vector<Hotkey> &hotkeys);
+  void SetSettings(JobId job, const ClickSettings &settings);
+
+  // Starts listening. On Linux, `devices` lists event devices (or anything
+  // that reads as struct input_event) to use instead of all keyboards.
+  // False if there is nothing to listen to; one listener at a time on
+  // Windows.
+  bool Start(ToggleFn onToggle = nullptr,
+             const std::vector<std::string> &devices = {});
+  void Stop();
+  bool IsRunning() const { return running.load(); }
+
+  // Windows: lets keys injected with SendInput reach OnKey() too, for
+  // benchmarks that press the hotkey themselves. Off by default.
+  void SetAcceptInjected(bool accept) { acceptInjected = accept; }
+  bool GetAcceptInjected() const { return acceptInjected.load(); }
+
+  // Toggles made since construction.
+  uint64_t GetToggleCount() const { return toggles.load(); }
+
+  // Handles one key event; the platform readers call this. True if it
+  // matched a hotkey, whose toggles are then queued for the toggler thread.
+  bool OnKey(int key, bool down);
+
+private:
+  struct Job {
+    JobId id;
+    AutoClicker *clicker;
+    ClickSettings settings;
+    std::vector<Hotkey> hotkeys;
+  };
+  struct Hit {
+    JobId id;
+    AutoClicker *clicker;
+    ClickSettings settings;
+  };
+
+  HotkeyListener(const HotkeyListener &) = delete;
+  HotkeyListener &operator=(const HotkeyListener &) = delete;
+
+#ifdef _WIN32
+  void Run(std::promise<bool> &ready);
+#else
+  void Run();
+#endif
+  void StartToggler();
+  void StopToggler();
+  void RunToggler();
+
+  std::mutex jobsLock; // Held to look up or change jobs, never to toggle
+  std::vector<Job> jobs;
+  JobId nextJob;
+  // Listener thread only
+  int mods;       // Modifiers held now
+  int heldHotkey; // Key of the last hotkey, until released
+  std::vector<Hit> hits; // Jobs the current key matched
+  // Hits queued by OnKey() for the toggler thread
+  ToggleFn onToggle; // Set before either thread starts
+  std::mutex pendingLock;
+  std::condition_variable pendingChanged;
+  std::vector<Hit> pending;
+  bool stopToggler; // Under pendingLock
+  std::thread toggler;
+  std::atomic<bool> running;
+  std::atomic<bool> acceptInjected;
+  std::atomic<uint64_t> toggles;
+  std::thread thread;
+#ifdef _WIN32
+  unsigned long threadId;
+#else
+  std::vector<int> devices;
+  int wakeFd; // eventfd that interrupts poll() on Stop()
+#endif
+};
+
+#endif // HOTKEYLISTENER_H
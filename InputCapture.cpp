@@ -0,0 +1,360 @@
+#include "InputCapture.h"
+#include "Clock.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+// Hook procedures have no context pointer; one capture runs at a time.
+static InputCapture::EventFn *s_onEvent = nullptr;
+static POINT s_lastPoint = {-1, -1};
+
+static void Deliver(InputEventType type, MouseButton button, POINT pt,
+                    int wheel = 0) {
+  // Buttons and the wheel act at a position; replay it first if it changed.
+  if (type != InputEventType::Move &&
+      (pt.x != s_lastPoint.x || pt.y != s_lastPoint.y))
+    Deliver(InputEventType::Move, button, pt);
+
+  InputEvent ev;
+  ev.timeNs = Clock::NowNs();
+  ev.type = type;
+  ev.button = button;
+  ev.x = pt.x;
+  ev.y = pt.y;
+  ev.wheel = wheel;
+  s_lastPoint = pt;
+  (*s_onEvent)(ev);
+}
+
+static LRESULT CALLBACK MouseHookProc(int code, WPARAM wParam, LPARAM lParam) {
+  const MSLLHOOKSTRUCT *m = (const MSLLHOOKSTRUCT *)lParam;
+  if (code == HC_ACTION && !(m->flags & LLMHF_INJECTED)) {
+    switch (wParam) {
+    case WM_MOUSEMOVE:
+      Deliver(InputEventType::Move, MouseButton::Left, m->pt);
+      break;
+    case WM_LBUTTONDOWN:
+      Deliver(InputEventType::ButtonDown, MouseButton::Left, m->pt);
+      break;
+    case WM_LBUTTONUP:
+      Deliver(InputEventType::ButtonUp, MouseButton::Left, m->pt);
+      break;
+    case WM_RBUTTONDOWN:
+      Deliver(InputEventType::ButtonDown, MouseButton::Right, m->pt);
+      break;
+    case WM_RBUTTONUP:
+      Deliver(InputEventType::ButtonUp, MouseButton::Right, m->pt);
+      break;
+    case WM_MBUTTONDOWN:
+      Deliver(InputEventType::ButtonDown, MouseButton::Middle, m->pt);
+      break;
+    case WM_MBUTTONUP:
+      Deliver(InputEventType::ButtonUp, MouseButton::Middle, m->pt);
+      break;
+    case WM_MOUSEWHEEL:
+      Deliver(InputEventType::Wheel, MouseButton::Left, m->pt,
+              (short)HIWORD(m->mouseData));
+      break;
+    }
+  }
+  return CallNextHookEx(NULL, code, wParam, lParam);
+}
+
+static LRESULT CALLBACK KeyboardHookProc(int code, WPARAM wParam,
+                                         LPARAM lParam) {
+  const KBDLLHOOKSTRUCT *k = (const KBDLLHOOKSTRUCT *)lParam;
+  if (code == HC_ACTION && !(k->flags & LLKHF_INJECTED)) {
+    InputEvent ev;
+    ev.timeNs = Clock::NowNs();
+    ev.type = (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN)
+                  ? InputEventType::KeyDown
+                  : InputEventType::KeyUp;
+    ev.x = s_lastPoint.x;
+    ev.y = s_lastPoint.y;
+    ev.key = (int)k->vkCode;
+    (*s_onEvent)(ev);
+  }
+  return CallNextHookEx(NULL, code, wParam, lParam);
+}
+
+InputCapture::InputCapture(int width, int height)
+    : running(false), screenWidth(width), screenHeight(height), threadId(0) {}
+
+InputCapture::~InputCapture() { Stop(); }
+
+bool InputCapture::Start(EventFn fn) {
+  if (running || s_onEvent)
+    return false;
+
+  onEvent = fn;
+  std::promise<bool> ready;
+  std::future<bool> started = ready.get_future();
+  running = true;
+  thread = std::thread(&InputCapture::Run, this, std::ref(ready));
+  if (!started.get()) {
+    Stop();
+    return false;
+  }
+  return true;
+}
+
+void InputCapture::Stop() {
+  running = false;
+  if (thread.joinable()) {
+    PostThreadMessage(threadId, WM_QUIT, 0, 0);
+    thread.join();
+  }
+}
+
+void InputCapture::Run(std::promise<bool> &ready) {
+  // Low-level hooks are called through the installing thread's message loop.
+  MSG msg;
+  PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE); // Create the queue
+  threadId = GetCurrentThreadId();
+  s_onEvent = &onEvent;
+  s_lastPoint.x = s_lastPoint.y = -1;
+  HINSTANCE module = GetModuleHandle(NULL);
+  HHOOK mouse = SetWindowsHookEx(WH_MOUSE_LL, MouseHookProc, module, 0);
+  HHOOK keyboard =
+      SetWindowsHookEx(WH_KEYBOARD_LL, KeyboardHookProc, module, 0);
+  ready.set_value(mouse && keyboard);
+
+  if (mouse && keyboard) {
+    while (GetMessage(&msg, NULL, 0, 0) > 0) {
+      TranslateMessage(&msg);
+      DispatchMessage(&msg);
+    }
+  }
+  if (mouse)
+    UnhookWindowsHookEx(mouse);
+  if (keyboard)
+    UnhookWindowsHookEx(keyboard);
+  s_onEvent = nullptr;
+}
+
+#elif defined(__linux__)
+
+static bool TestBit(const unsigned long *bits, int bit) {
+  const int perLong = (int)sizeof(unsigned long) * 8;
+  return (bits[bit / perLong] >> (bit % perLong)) & 1;
+}
+
+InputCapture::InputCapture(int width, int height)
+    : running(false), screenWidth(width), screenHeight(height), wakeFd(-1) {}
+
+InputCapture::~InputCapture() { Stop(); }
+
+bool InputCapture::Start(EventFn fn) {
+  if (running)
+    return false;
+
+  DIR *dir = opendir("/dev/input");
+  if (!dir)
+    return false;
+  while (dirent *entry = readdir(dir)) {
+    if (strncmp(entry->d_name, "event", 5) != 0)
+      continue;
+    std::string path = std::string("/dev/input/") + entry->d_name;
+    int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+      continue;
+
+    char name[256] = {};
+    ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name);
+    if (strcmp(name, UinputInputSink::kDeviceName) == 0) {
+      close(fd); // Our own injected input
+      continue;
+    }
+    // Kernel timestamps on the same clock as Clock::NowNs().
+    int clock = CLOCK_MONOTONIC;
+    ioctl(fd, EVIOCSCLOCKID, &clock);
+
+    Device d = {fd, false, 0, 0, 0, 0};
+    const int bitsPerLong = (int)sizeof(unsigned long) * 8;
+    unsigned long absBits[ABS_MAX / bitsPerLong + 1] = {};
+    input_absinfo ax, ay;
+    if (ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(absBits)), absBits) >= 0 &&
+        TestBit(absBits, ABS_X) && TestBit(absBits, ABS_Y) &&
+        ioctl(fd, EVIOCGABS(ABS_X), &ax) == 0 &&
+        ioctl(fd, EVIOCGABS(ABS_Y), &ay) == 0 && ax.maximum > ax.minimum &&
+        ay.maximum > ay.minimum) {
+      d.absolute = true;
+      d.minX = ax.minimum;
+      d.maxX = ax.maximum;
+      d.minY = ay.minimum;
+      d.maxY = ay.maximum;
+    }
+    devices.push_back(d);
+  }
+  closedir(dir);
+
+  wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (devices.empty() || wakeFd < 0) {
+    Stop();
+    return false;
+  }
+
+  onEvent = fn;
+  running = true;
+  thread = std::thread(&InputCapture::Run, this);
+  return true;
+}
+
+void InputCapture::Stop() {
+  running = false;
+  if (wakeFd >= 0) {
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;
+  }
+  if (thread.joinable())
+    thread.join();
+  for (const Device &d : devices)
+    if (d.fd >= 0)
+      close(d.fd);
+  devices.clear();
+  if (wakeFd >= 0)
+    close(wakeFd);
+  wakeFd = -1;
+}
+
+void InputCapture::Run() {
+  std::vector<pollfd> fds(devices.size() + 1);
+  for (size_t i = 0; i < devices.size(); i++)
+    fds[i] = {devices[i].fd, POLLIN, 0};
+  fds.back() = {wakeFd, POLLIN, 0};
+
+  // Virtual cursor, starting in the middle of the screen
+  int x = screenWidth / 2, y = screenHeight / 2;
+  bool moved = false;
+  InputEvent ev;
+  auto emit = [&](InputEventType type) {
+    ev.type = type;
+    ev.x = x;
+    ev.y = y;
+    onEvent(ev);
+  };
+
+  input_event buf[64];
+  while (running) {
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    if (fds.back().revents)
+      break; // Stop()
+
+    for (size_t i = 0; i < devices.size(); i++) {
+      if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        fds[i].fd = -1; // Unplugged; poll() skips negative descriptors
+        continue;
+      }
+      if (!(fds[i].revents & POLLIN))
+        continue;
+
+      const Device &d = devices[i];
+      ssize_t n;
+      while ((n = read(d.fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t k = 0; k < n / (ssize_t)sizeof(input_event); k++) {
+          const input_event &e = buf[k];
+          ev = InputEvent();
+          ev.timeNs = (int64_t)e.input_event_sec * 1000000000LL +
+                      (int64_t)e.input_event_usec * 1000LL;
+          if (e.type == EV_REL && e.code == REL_X) {
+            x = std::min(std::max(x + e.value, 0), screenWidth - 1);
+            moved = true;
+          } else if (e.type == EV_REL && e.code == REL_Y) {
+            y = std::min(std::max(y + e.value, 0), screenHeight - 1);
+            moved = true;
+          } else if (e.type == EV_ABS && d.absolute && e.code == ABS_X) {
+            x = (int)((int64_t)(e.value - d.minX) * (screenWidth - 1) /
+                      (d.maxX - d.minX));
+            moved = true;
+          } else if (e.type == EV_ABS && d.absolute && e.code == ABS_Y) {
+            y = (int)((int64_t)(e.value - d.minY) * (screenHeight - 1) /
+                      (d.maxY - d.minY));
+            moved = true;
+          } else if (e.type == EV_REL && e.code == REL_WHEEL) {
+            ev.wheel = e.value * 120;
+            emit(InputEventType::Wheel);
+          } else if (e.type == EV_KEY &&
+                     (e.code == BTN_LEFT || e.code == BTN_RIGHT ||
+                      e.code == BTN_MIDDLE)) {
+            if (moved) {
+              emit(InputEventType::Move);
+              moved = false;
+            }
+            ev.button = e.code == BTN_RIGHT    ? MouseButton::Right
+                        : e.code == BTN_MIDDLE ? MouseButton::Middle
+                                               : MouseButton::Left;
+            emit(e.value ? InputEventType::ButtonDown
+                         : InputEventType::ButtonUp);
+          } else if (e.type == EV_KEY && e.code < BTN_MISC) {
+            // Auto-repeat (value 2) is a repeated key down, as on Windows.
+            ev.key = e.code;
+            emit(e.value ? InputEventType::KeyDown : InputEventType::KeyUp);
+          } else if (e.type == EV_SYN && e.code == SYN_REPORT && moved) {
+            emit(InputEventType::Move);
+            moved = false;
+          }
+        }
+      }
+    }
+  }
+}
+
+#else
+
+InputCapture::InputCapture(int width, int height)
+    : running(false), screenWidth(width), screenHeight(height), wakeFd(-1) {}
+
+InputCapture::~InputCapture() {}
+
+bool InputCapture::Start(EventFn) { return false; }
+void InputCapture::Stop() {}
+void InputCapture::Run() {}
+
+#endif
+
+InputRecorder::InputRecorder() : events(0) {}
+
+bool InputRecorder::Start(const std::string &path) {
+  if (capture.IsRunning() || !writer.Open(path))
+    return false;
+  events = 0;
+  if (!capture.Start([this](const InputEvent &event) {
+        if (writer.Append(event))
+          events.store(events.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+      })) {
+    writer.Close();
+    return false;
+  }
+  return true;
+}
+
+bool InputRecorder::Stop() {
+  if (!writer.IsOpen())
+    return false;
+  capture.Stop();
+  return writer.Close();
+}
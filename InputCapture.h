@@ -0,0 +1,77 @@
+#ifndef INPUTCAPTURE_H
+#define INPUTCAPTURE_H
+
+#include "InputLog.h"
+#include "InputSink.h"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Live capture of the user's mouse and keyboard on a thread of its own.
+// Windows: low-level mouse and keyboard hooks; injected input, ours
+// included, is ignored.
+// Linux: every readable /dev/input/event* device except our uinput pointer
+// (root or the `input` group). Relative motion moves a virtual cursor
+// clamped to the given screen size, which maps 1:1 onto UinputInputSink.
+// Events are stamped with Clock::NowNs() time.
+class InputCapture {
+public:
+  typedef std::function<void(const InputEvent &event)> EventFn;
+
+  InputCapture(int screenWidth = 1920, int screenHeight = 1080);
+  ~InputCapture();
+
+  // Calls `onEvent` on the capture thread for every event. False if nothing
+  // can be captured.
+  bool Start(EventFn onEvent);
+  void Stop();
+  bool IsRunning() const { return running.load(); }
+
+private:
+#ifdef _WIN32
+  void Run(std::promise<bool> &ready);
+#else
+  void Run();
+#endif
+
+  EventFn onEvent;
+  std::atomic<bool> running;
+  std::thread thread;
+  int screenWidth;
+  int screenHeight;
+#ifdef _WIN32
+  unsigned long threadId;
+#else
+  struct Device {
+    int fd;
+    bool absolute; // Tablet or touchscreen: ABS_X/ABS_Y scaled to the screen
+    int minX, maxX, minY, maxY;
+  };
+  std::vector<Device> devices;
+  int wakeFd; // eventfd that interrupts poll() on Stop()
+#endif
+};
+
+// Captures input straight into an InputLogWriter.
+class InputRecorder {
+public:
+  InputRecorder();
+
+  bool Start(const std::string &path);
+  // Stops capturing and closes the log. False if any write failed.
+  bool Stop();
+  bool IsRecording() const { return capture.IsRunning(); }
+  // Written so far; read from any thread.
+  uint64_t EventCount() const { return events.load(); }
+
+private:
+  InputCapture capture;
+  InputLogWriter writer;
+  std::atomic<uint64_t> events;
+};
+
+#endif // INPUTCAPTURE_H
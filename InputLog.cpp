@@ -0,0 +1,238 @@
+#include "InputLog.h"
+
+#include <cstring>
+
+namespace {
+
+const char kMagic[4] = {'A', 'C', 'I', 'L'};
+
+void PutVarint(std::vector<uint8_t> &out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back((uint8_t)(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back((uint8_t)v);
+}
+
+void PutSigned(std::vector<uint8_t> &out, int64_t v) {
+  PutVarint(out, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63)); // zigzag
+}
+
+bool GetVarint(const uint8_t *&p, const uint8_t *end, uint64_t &v) {
+  v = 0;
+  for (int shift = 0; shift < 64 && p < end; shift += 7) {
+    uint8_t b = *p++;
+    v |= (uint64_t)(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+bool GetSigned(const uint8_t *&p, const uint8_t *end, int64_t &v) {
+  uint64_t u;
+  if (!GetVarint(p, end, u))
+    return false;
+  v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+  return true;
+}
+
+} // namespace
+
+InputLogWriter::InputLogWriter()
+    : file(nullptr), failed(false), eventCount(0), bytesWritten(0),
+      firstTimeNs(0), lastTimeNs(0), lastX(0), lastY(0) {}
+
+InputLogWriter::~InputLogWriter() { Close(); }
+
+bool InputLogWriter::Open(const std::string &path) {
+  Close();
+  file = fopen(path.c_str(), "wb");
+  if (!file)
+    return false;
+
+  buffer.clear();
+  buffer.reserve(kBufferSize);
+  failed = false;
+  eventCount = 0;
+  bytesWritten = 0;
+  lastX = 0;
+  lastY = 0;
+
+  // Totals are zero until Close() rewrites the header.
+  InputLogHeader header = {};
+  memcpy(header.magic, kMagic, 4);
+  header.version = kInputLogVersion;
+  header.headerSize = (uint16_t)sizeof(InputLogHeader);
+  buffer.resize(sizeof(header));
+  memcpy(buffer.data(), &header, sizeof(header));
+  return true;
+}
+
+bool InputLogWriter::Append(const InputEvent &event) {
+  if (!file || failed)
+    return false;
+
+  if (eventCount == 0)
+    firstTimeNs = lastTimeNs = event.timeNs;
+  const int64_t t = event.timeNs > lastTimeNs ? event.timeNs : lastTimeNs;
+
+  buffer.push_back(
+      (uint8_t)((uint8_t)event.type | ((uint8_t)event.button << 3)));
+  PutVarint(buffer, (uint64_t)(t - lastTimeNs));
+  switch (event.type) {
+  case InputEventType::Move:
+    PutSigned(buffer, (int64_t)event.x - lastX);
+    PutSigned(buffer, (int64_t)event.y - lastY);
+    lastX = event.x;
+    lastY = event.y;
+    break;
+  case InputEventType::KeyDown:
+  case InputEventType::KeyUp:
+    PutVarint(buffer, (uint64_t)(uint32_t)event.key);
+    break;
+  case InputEventType::Wheel:
+    PutSigned(buffer, event.wheel);
+    break;
+  default:
+    break;
+  }
+  lastTimeNs = t;
+  eventCount++;
+
+  // A record is at most 31 bytes, so this never lets the buffer reallocate.
+  if (buffer.size() > kBufferSize - 32)
+    return Flush();
+  return true;
+}
+
+bool InputLogWriter::Flush() {
+  if (!buffer.empty()) {
+    const size_t written = fwrite(buffer.data(), 1, buffer.size(), file);
+    if (written != buffer.size())
+      failed = true;
+    bytesWritten += written;
+  }
+  buffer.clear();
+  return !failed;
+}
+
+bool InputLogWriter::Close() {
+  if (!file)
+    return false;
+
+  Flush();
+  InputLogHeader header = {};
+  memcpy(header.magic, kMagic, 4);
+  header.version = kInputLogVersion;
+  header.headerSize = (uint16_t)sizeof(InputLogHeader);
+  header.eventCount = eventCount;
+  header.durationNs = lastTimeNs - firstTimeNs;
+  if (fseek(file, 0, SEEK_SET) != 0 ||
+      fwrite(&header, sizeof(header), 1, file) != 1)
+    failed = true;
+  if (fclose(file) != 0)
+    failed = true;
+  file = nullptr;
+  return !failed;
+}
+
+InputLogReader::InputLogReader()
+    : header(), offset(0), released(0), timeNs(0), x(0), y(0) {}
+
+bool InputLogReader::Open(const std::string &path) {
+  Close();
+  if (!file.Open(path))
+    return false;
+
+  // Newer writers keep the same header prefix and may grow it.
+  if (file.Size() < sizeof(InputLogHeader)) {
+    Close();
+    return false;
+  }
+  memcpy(&header, file.Data(), sizeof(header));
+  if (memcmp(header.magic, kMagic, 4) != 0 ||
+      header.version > kInputLogVersion ||
+      header.headerSize < sizeof(InputLogHeader) ||
+      header.headerSize > file.Size()) {
+    Close();
+    return false;
+  }
+  Rewind();
+  return true;
+}
+
+void InputLogReader::Close() {
+  file.Close();
+  header = InputLogHeader();
+  offset = 0;
+  released = 0;
+}
+
+void InputLogReader::Rewind() {
+  offset = header.headerSize;
+  released = 0;
+  timeNs = 0;
+  x = 0;
+  y = 0;
+}
+
+bool InputLogReader::Next(InputEvent &event) {
+  if (!file.IsOpen() || offset >= file.Size())
+    return false;
+
+  const uint8_t *p = file.Data() + offset;
+  const uint8_t *end = file.Data() + file.Size();
+  const uint8_t tag = *p++;
+  const int type = tag & 7;
+  const int button = (tag >> 3) & 3;
+  if (type > (int)InputEventType::Wheel || button > (int)MouseButton::Middle)
+    return false;
+
+  uint64_t delta;
+  if (!GetVarint(p, end, delta))
+    return false;
+
+  InputEvent ev;
+  ev.type = (InputEventType)type;
+  ev.button = (MouseButton)button;
+  int64_t a = 0, b = 0;
+  uint64_t key = 0;
+  switch (ev.type) {
+  case InputEventType::Move:
+    if (!GetSigned(p, end, a) || !GetSigned(p, end, b))
+      return false;
+    x += (int)a;
+    y += (int)b;
+    break;
+  case InputEventType::KeyDown:
+  case InputEventType::KeyUp:
+    if (!GetVarint(p, end, key))
+      return false;
+    ev.key = (int)key;
+    break;
+  case InputEventType::Wheel:
+    if (!GetSigned(p, end, a))
+      return false;
+    ev.wheel = (int)a;
+    break;
+  default:
+    break;
+  }
+
+  timeNs += (int64_t)delta;
+  ev.timeNs = timeNs;
+  ev.x = x;
+  ev.y = y;
+  event = ev;
+  offset = (size_t)(p - file.Data());
+
+  // Give back whole chunks we are done with; chunk boundaries are page
+  // aligned, so nothing straddling is left behind.
+  if (offset - released >= 2 * kReleaseChunk) {
+    const size_t upTo = offset / kReleaseChunk * kReleaseChunk;
+    file.Release(released, upTo - released);
+    released = upTo;
+  }
+  return true;
+}
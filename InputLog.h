@@ -0,0 +1,116 @@
+#ifndef INPUTLOG_H
+#define INPUTLOG_H
+
+#include "InputSink.h"
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Input log layout (little endian):
+//
+//   InputLogHeader
+//   records, back to back, up to the end of the file
+//
+// Every record starts with a tag byte: the InputEventType in bits 0-2, the
+// mouse button in bits 3-4. Then comes the time since the previous record in
+// nanoseconds as an unsigned LEB128 varint, then the payload:
+//
+//   Move                 zigzag varints dx, dy from the previous position
+//   ButtonDown/ButtonUp  nothing
+//   KeyDown/KeyUp        varint key code
+//   Wheel                zigzag varint delta
+//
+// A small mouse move 1 ms after the previous event takes 6 bytes. Records are
+// self-delimiting, so a recording cut short by a crash is readable up to its
+// last complete record; the header totals are only filled in on Close().
+
+const uint16_t kInputLogVersion = 1;
+
+struct InputLogHeader {
+  char magic[4]; // "ACIL"
+  uint16_t version;
+  uint16_t headerSize;
+  uint64_t eventCount; // 0 if the writer was not closed
+  int64_t durationNs;  // First to last event
+};
+
+// Appends events to a log file through a fixed-size buffer, so memory use
+// does not grow with the length of the recording.
+class InputLogWriter {
+public:
+  InputLogWriter();
+  ~InputLogWriter();
+  InputLogWriter(const InputLogWriter &) = delete;
+  InputLogWriter &operator=(const InputLogWriter &) = delete;
+
+  // Creates or truncates `path`.
+  bool Open(const std::string &path);
+  // event.timeNs is absolute (Clock::NowNs()); out-of-order times are
+  // clamped to the previous event. False once a write has failed.
+  bool Append(const InputEvent &event);
+  // Flushes and writes the header totals. False if anything failed.
+  bool Close();
+
+  bool IsOpen() const { return file != nullptr; }
+  uint64_t EventCount() const { return eventCount; }
+  // Bytes in the file plus those still buffered; after a failed write only
+  // what reached the file.
+  uint64_t BytesWritten() const {
+    return failed ? bytesWritten : bytesWritten + buffer.size();
+  }
+
+private:
+  static const size_t kBufferSize = 64 * 1024;
+
+  bool Flush();
+
+  FILE *file;
+  std::vector<uint8_t> buffer;
+  bool failed;
+  uint64_t eventCount;
+  uint64_t bytesWritten;
+  int64_t firstTimeNs;
+  int64_t lastTimeNs;
+  int lastX;
+  int lastY;
+};
+
+// Reads a log sequentially from a memory mapping. Pages behind the read
+// position are released as it advances, so the working set stays a few
+// megabytes however large the file is.
+class InputLogReader {
+public:
+  InputLogReader();
+
+  // False if the file is missing or not an input log.
+  bool Open(const std::string &path);
+  void Close();
+  bool IsOpen() const { return file.IsOpen(); }
+
+  // Decodes the next event; its timeNs is relative to the first event. False
+  // at the end of the log or at a truncated record.
+  bool Next(InputEvent &event);
+  void Rewind();
+
+  // From the header; 0 if the recording was not closed.
+  uint64_t EventCount() const { return header.eventCount; }
+  int64_t DurationNs() const { return header.durationNs; }
+  size_t Offset() const { return offset; }
+  size_t Size() const { return file.Size(); }
+
+private:
+  static const size_t kReleaseChunk = 4 * 1024 * 1024;
+
+  MappedFile file;
+  InputLogHeader header;
+  size_t offset;
+  size_t released; // Everything before this was given back to the OS
+  int64_t timeNs;
+  int x;
+  int y;
+};
+
+#endif // INPUTLOG_H
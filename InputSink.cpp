@@ -0,0 +1,405 @@
+#include "InputSink.h"
+#include "Clock.h"
+
+#include <algorithm>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#ifdef __linux__
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool SendInputEvent(InputSink &sink, const InputEvent &event) {
+  switch (event.type) {
+  case InputEventType::Move:
+    return sink.MoveTo(event.x, event.y);
+  case InputEventType::ButtonDown:
+  case InputEventType::ButtonUp:
+    return sink.Button(event.button, event.type == InputEventType::ButtonDown);
+  case InputEventType::KeyDown:
+  case InputEventType::KeyUp:
+    return sink.Key(event.key, event.type == InputEventType::KeyDown);
+  case InputEventType::Wheel:
+    return sink.Wheel(event.wheel);
+  }
+  return false;
+}
+
+#ifdef _WIN32
+
+static DWORD GetButtonFlag(MouseButton button, bool down) {
+  switch (button) {
+  case MouseButton::Right:
+    return down ? MOUSEEVENTF_RIGHTDOWN : MOUSEEVENTF_RIGHTUP;
+  case MouseButton::Middle:
+    return down ? MOUSEEVENTF_MIDDLEDOWN : MOUSEEVENTF_MIDDLEUP;
+  default:
+    return down ? MOUSEEVENTF_LEFTDOWN : MOUSEEVENTF_LEFTUP;
+  }
+}
+
+bool Win32InputSink::MoveTo(int x, int y) { return SetCursorPos(x, y) != 0; }
+
+bool Win32InputSink::Button(MouseButton button, bool down) {
+  INPUT input = {};
+  input.type = INPUT_MOUSE;
+  input.mi.dwFlags = GetButtonFlag(button, down);
+  return SendInput(1, &input, sizeof(INPUT)) == 1;
+}
+
+bool Win32InputSink::Click(MouseButton button) {
+  INPUT inputs[2] = {};
+  inputs[0].type = INPUT_MOUSE;
+  inputs[1].type = INPUT_MOUSE;
+  inputs[0].mi.dwFlags = GetButtonFlag(button, true);
+  inputs[1].mi.dwFlags = GetButtonFlag(button, false);
+  return SendInput(2, inputs, sizeof(INPUT)) == 2;
+}
+
+int Win32InputSink::ClickBurst(MouseButton button, int count) {
+  // One SendInput per kMaxBurstClicks pairs instead of one per pair.
+  INPUT inputs[kMaxBurstClicks * 2] = {};
+  const DWORD downFlag = GetButtonFlag(button, true);
+  const DWORD upFlag = GetButtonFlag(button, false);
+
+  int sent = 0;
+  while (sent < count) {
+    int n = count - sent;
+    if (n > kMaxBurstClicks)
+      n = kMaxBurstClicks;
+    for (int i = 0; i < n; i++) {
+      inputs[2 * i].type = INPUT_MOUSE;
+      inputs[2 * i].mi.dwFlags = downFlag;
+      inputs[2 * i + 1].type = INPUT_MOUSE;
+      inputs[2 * i + 1].mi.dwFlags = upFlag;
+    }
+    UINT done = SendInput((UINT)(2 * n), inputs, sizeof(INPUT));
+    sent += (int)done / 2;
+    if (done != (UINT)(2 * n))
+      break; // Blocked by UIPI or the input desktop changed
+  }
+  return sent;
+}
+
+bool Win32InputSink::Key(int key, bool down) {
+  INPUT input = {};
+  input.type = INPUT_KEYBOARD;
+  input.ki.wVk = (WORD)key;
+  input.ki.dwFlags = down ? 0 : KEYEVENTF_KEYUP;
+  return SendInput(1, &input, sizeof(INPUT)) == 1;
+}
+
+bool Win32InputSink::Wheel(int delta) {
+  INPUT input = {};
+  input.type = INPUT_MOUSE;
+  input.mi.dwFlags = MOUSEEVENTF_WHEEL;
+  input.mi.mouseData = (DWORD)delta;
+  return SendInput(1, &input, sizeof(INPUT)) == 1;
+}
+
+#endif // _WIN32
+
+#ifdef __linux__
+
+const char *const UinputInputSink::kDeviceName = "AutoClicker virtual pointer";
+
+static int GetButtonCode(MouseButton button) {
+  switch (button) {
+  case MouseButton::Right:
+    return BTN_RIGHT;
+  case MouseButton::Middle:
+    return BTN_MIDDLE;
+  default:
+    return BTN_LEFT;
+  }
+}
+
+static void FillEvent(input_event &ev, int type, int code, int value) {
+  memset(&ev, 0, sizeof(ev));
+  ev.type = (unsigned short)type;
+  ev.code = (unsigned short)code;
+  ev.value = value;
+}
+
+// Readers (udev, the compositor) only see a new device once its
+// /dev/input/eventN node exists; events written before that are lost. Waits
+// for the node, up to a second.
+static void WaitForDeviceNode(int fd) {
+  const int64_t deadline = Clock::NowNs() + 1000000000LL;
+  char sysname[64] = {};
+  if (ioctl(fd, UI_GET_SYSNAME(sizeof(sysname) - 1), sysname) < 0) {
+    Clock::SleepUntilNs(Clock::NowNs() + 100000000LL); // Older kernels
+    return;
+  }
+  const std::string dir = std::string("/sys/devices/virtual/input/") + sysname;
+  while (Clock::NowNs() < deadline) {
+    std::string node;
+    if (DIR *d = opendir(dir.c_str())) {
+      while (dirent *entry = readdir(d))
+        if (strncmp(entry->d_name, "event", 5) == 0)
+          node = std::string("/dev/input/") + entry->d_name;
+      closedir(d);
+    }
+    struct stat st;
+    if (!node.empty() && stat(node.c_str(), &st) == 0)
+      return;
+    Clock::SleepUntilNs(Clock::NowNs() + 1000000);
+  }
+}
+
+UinputInputSink::UinputInputSink(int screenWidth, int screenHeight)
+    : fd(-1), wheelRemainder(0) {
+  int f = open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+  if (f < 0)
+    return;
+
+  bool ok = ioctl(f, UI_SET_EVBIT, EV_KEY) == 0 &&
+            ioctl(f, UI_SET_KEYBIT, BTN_LEFT) == 0 &&
+            ioctl(f, UI_SET_KEYBIT, BTN_RIGHT) == 0 &&
+            ioctl(f, UI_SET_KEYBIT, BTN_MIDDLE) == 0 &&
+            ioctl(f, UI_SET_EVBIT, EV_ABS) == 0 &&
+            ioctl(f, UI_SET_ABSBIT, ABS_X) == 0 &&
+            ioctl(f, UI_SET_ABSBIT, ABS_Y) == 0 &&
+            ioctl(f, UI_SET_PROPBIT, INPUT_PROP_POINTER) == 0 &&
+            ioctl(f, UI_SET_EVBIT, EV_REL) == 0 &&
+            ioctl(f, UI_SET_RELBIT, REL_WHEEL) == 0;
+#ifdef REL_WHEEL_HI_RES
+  ok = ok && ioctl(f, UI_SET_RELBIT, REL_WHEEL_HI_RES) == 0;
+#endif
+  // Keyboard keys for replayed sessions (everything below the button range)
+  for (int key = KEY_ESC; ok && key < BTN_MISC; key++)
+    ok = ioctl(f, UI_SET_KEYBIT, key) == 0;
+
+  uinput_abs_setup abs;
+  memset(&abs, 0, sizeof(abs));
+  abs.code = ABS_X;
+  abs.absinfo.maximum = std::max(screenWidth - 1, 1);
+  ok = ok && ioctl(f, UI_ABS_SETUP, &abs) == 0;
+  abs.code = ABS_Y;
+  abs.absinfo.maximum = std::max(screenHeight - 1, 1);
+  ok = ok && ioctl(f, UI_ABS_SETUP, &abs) == 0;
+
+  uinput_setup setup;
+  memset(&setup, 0, sizeof(setup));
+  setup.id.bustype = BUS_VIRTUAL;
+  setup.id.vendor = 0x1209;
+  setup.id.product = 0xac01;
+  strncpy(setup.name, kDeviceName, UINPUT_MAX_NAME_SIZE - 1);
+  ok = ok && ioctl(f, UI_DEV_SETUP, &setup) == 0 &&
+       ioctl(f, UI_DEV_CREATE) == 0;
+
+  if (!ok) {
+    close(f);
+    return;
+  }
+  WaitForDeviceNode(f);
+  fd = f;
+}
+
+UinputInputSink::~UinputInputSink() {
+  if (fd >= 0) {
+    ioctl(fd, UI_DEV_DESTROY);
+    close(fd);
+  }
+}
+
+bool UinputInputSink::MoveTo(int x, int y) {
+  input_event ev[3];
+  FillEvent(ev[0], EV_ABS, ABS_X, x);
+  FillEvent(ev[1], EV_ABS, ABS_Y, y);
+  FillEvent(ev[2], EV_SYN, SYN_REPORT, 0);
+  return fd >= 0 && write(fd, ev, sizeof(ev)) == (ssize_t)sizeof(ev);
+}
+
+bool UinputInputSink::Button(MouseButton button, bool down) {
+  input_event ev[2];
+  FillEvent(ev[0], EV_KEY, GetButtonCode(button), down ? 1 : 0);
+  FillEvent(ev[1], EV_SYN, SYN_REPORT, 0);
+  return fd >= 0 && write(fd, ev, sizeof(ev)) == (ssize_t)sizeof(ev);
+}
+
+bool UinputInputSink::Click(MouseButton button) {
+  // Each transition gets its own SYN_REPORT so readers see two frames, but
+  // both go to the kernel in a single write().
+  const int code = GetButtonCode(button);
+  input_event ev[4];
+  FillEvent(ev[0], EV_KEY, code, 1);
+  FillEvent(ev[1], EV_SYN, SYN_REPORT, 0);
+  FillEvent(ev[2], EV_KEY, code, 0);
+  FillEvent(ev[3], EV_SYN, SYN_REPORT, 0);
+  return fd >= 0 && write(fd, ev, sizeof(ev)) == (ssize_t)sizeof(ev);
+}
+
+int UinputInputSink::ClickBurst(MouseButton button, int count) {
+  if (fd < 0)
+    return 0;
+
+  // Same four events per click as Click(), but up to kMaxBurstClicks clicks
+  // per write().
+  static const int kEventsPerClick = 4;
+  input_event ev[kMaxBurstClicks * kEventsPerClick];
+  const int code = GetButtonCode(button);
+  const int filled = std::min(count, kMaxBurstClicks);
+  for (int i = 0; i < filled; i++) {
+    FillEvent(ev[4 * i], EV_KEY, code, 1);
+    FillEvent(ev[4 * i + 1], EV_SYN, SYN_REPORT, 0);
+    FillEvent(ev[4 * i + 2], EV_KEY, code, 0);
+    FillEvent(ev[4 * i + 3], EV_SYN, SYN_REPORT, 0);
+  }
+
+  int sent = 0;
+  while (sent < count) {
+    int n = count - sent;
+    if (n > kMaxBurstClicks)
+      n = kMaxBurstClicks;
+    ssize_t bytes = (ssize_t)(n * kEventsPerClick * sizeof(input_event));
+    ssize_t written = write(fd, ev, (size_t)bytes);
+    if (written <= 0)
+      break;
+    sent += (int)(written / (ssize_t)(kEventsPerClick * sizeof(input_event)));
+    if (written != bytes)
+      break;
+  }
+  return sent;
+}
+
+bool UinputInputSink::Key(int key, bool down) {
+  if (key < KEY_ESC || key >= BTN_MISC)
+    return false;
+  input_event ev[2];
+  FillEvent(ev[0], EV_KEY, key, down ? 1 : 0);
+  FillEvent(ev[1], EV_SYN, SYN_REPORT, 0);
+  return fd >= 0 && write(fd, ev, sizeof(ev)) == (ssize_t)sizeof(ev);
+}
+
+bool UinputInputSink::Wheel(int delta) {
+  // REL_WHEEL_HI_RES uses our unit (120 per notch) and takes the delta as
+  // is. REL_WHEEL only moves in whole notches: the remainder is carried to
+  // the next call, so a run of small deltas still scrolls.
+  wheelRemainder += delta;
+  const int notches = wheelRemainder / 120;
+  wheelRemainder -= notches * 120;
+
+  input_event ev[3];
+  int n = 0;
+#ifdef REL_WHEEL_HI_RES
+  FillEvent(ev[n++], EV_REL, REL_WHEEL_HI_RES, delta);
+#endif
+  if (notches != 0)
+    FillEvent(ev[n++], EV_REL, REL_WHEEL, notches);
+  FillEvent(ev[n++], EV_SYN, SYN_REPORT, 0);
+  const ssize_t bytes = (ssize_t)(n * sizeof(input_event));
+  return fd >= 0 && write(fd, ev, (size_t)bytes) == bytes;
+}
+
+#endif // __linux__
+
+RecordingInputSink::RecordingInputSink(size_t capacity)
+    : events(capacity), eventCount(0), cursorX(0), cursorY(0) {}
+
+const char *RecordingInputSink::Name() const {
+  return events.empty() ? "null" : "recording";
+}
+
+void RecordingInputSink::Record(const InputEvent &event) {
+  uint64_t n = eventCount.load(std::memory_order_relaxed);
+  if (n < events.size()) {
+    InputEvent &ev = events[(size_t)n];
+    ev = event;
+    ev.timeNs = Clock::NowNs();
+    ev.x = cursorX;
+    ev.y = cursorY;
+  }
+  eventCount.store(n + 1, std::memory_order_release);
+}
+
+bool RecordingInputSink::MoveTo(int x, int y) {
+  cursorX = x;
+  cursorY = y;
+  InputEvent ev;
+  ev.type = InputEventType::Move;
+  Record(ev);
+  return true;
+}
+
+bool RecordingInputSink::Button(MouseButton button, bool down) {
+  InputEvent ev;
+  ev.type = down ? InputEventType::ButtonDown : InputEventType::ButtonUp;
+  ev.button = button;
+  Record(ev);
+  return true;
+}
+
+int RecordingInputSink::ClickBurst(MouseButton button, int count) {
+  if (count <= 0)
+    return 0;
+  const uint64_t n = eventCount.load(std::memory_order_relaxed);
+  const uint64_t end = n + 2 * (uint64_t)count;
+  if (n < events.size()) {
+    InputEvent ev;
+    ev.timeNs = Clock::NowNs();
+    ev.button = button;
+    ev.x = cursorX;
+    ev.y = cursorY;
+    for (uint64_t i = n; i < end && i < events.size(); i++) {
+      ev.type = (i - n) % 2 == 0 ? InputEventType::ButtonDown
+                                 : InputEventType::ButtonUp;
+      events[(size_t)i] = ev;
+    }
+  }
+  eventCount.store(end, std::memory_order_release);
+  return count;
+}
+
+bool RecordingInputSink::Key(int key, bool down) {
+  InputEvent ev;
+  ev.type = down ? InputEventType::KeyDown : InputEventType::KeyUp;
+  ev.key = key;
+  Record(ev);
+  return true;
+}
+
+bool RecordingInputSink::Wheel(int delta) {
+  InputEvent ev;
+  ev.type = InputEventType::Wheel;
+  ev.wheel = delta;
+  Record(ev);
+  return true;
+}
+
+uint64_t RecordingInputSink::GetEventCount() const {
+  return eventCount.load(std::memory_order_acquire);
+}
+
+std::vector<InputEvent> RecordingInputSink::GetEvents() const {
+  uint64_t n = std::min<uint64_t>(GetEventCount(), events.size());
+  return std::vector<InputEvent>(events.begin(), events.begin() + (size_t)n);
+}
+
+void RecordingInputSink::Clear() {
+  eventCount.store(0, std::memory_order_relaxed);
+  cursorX = 0;
+  cursorY = 0;
+}
+
+std::unique_ptr<InputSink> CreateDefaultInputSink() {
+#if defined(_WIN32)
+  return std::unique_ptr<InputSink>(new Win32InputSink());
+#else
+#if defined(__linux__)
+  std::unique_ptr<UinputInputSink> uinput(new UinputInputSink());
+  if (uinput->IsOpen())
+    return std::unique_ptr<InputSink>(uinput.release());
+#endif
+  return std::unique_ptr<InputSink>(new RecordingInputSink());
+#endif
+}
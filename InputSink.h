@@ -0,0 +1,162 @@
+#ifndef INPUTSINK_H
+#define INPUTSINK_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Largest number of clicks a backend submits in one system call.
+const int kMaxBurstClicks = 256;
+
+enum class MouseButton : uint8_t { Left = 0, Right = 1, Middle = 2 };
+
+enum class InputEventType : uint8_t {
+  Move = 0,
+  ButtonDown = 1,
+  ButtonUp = 2,
+  KeyDown = 3,
+  KeyUp = 4,
+  Wheel = 5,
+};
+
+struct InputEvent {
+  int64_t timeNs = 0;
+  InputEventType type = InputEventType::Move;
+  MouseButton button = MouseButton::Left;
+  int x = 0;
+  int y = 0;
+  int key = 0;   // KeyDown/KeyUp: virtual-key code (Windows), KEY_* (Linux)
+  int wheel = 0; // Wheel: 120 per notch, positive away from the user
+};
+
+// Where the click engine delivers its input. Implementations are only called
+// from the click worker thread.
+class InputSink {
+public:
+  virtual ~InputSink() {}
+
+  virtual const char *Name() const = 0;
+
+  // Moves the cursor to absolute screen coordinates.
+  virtual bool MoveTo(int x, int y) = 0;
+
+  // Presses or releases `button` at the current cursor position.
+  virtual bool Button(MouseButton button, bool down) = 0;
+
+  // One press + release. Backends override this to submit both in one call.
+  virtual bool Click(MouseButton button) {
+    return Button(button, true) && Button(button, false);
+  }
+
+  // `count` press + release pairs, submitted in as few calls as the backend
+  // allows. Returns how many clicks were delivered.
+  virtual int ClickBurst(MouseButton button, int count) {
+    int sent = 0;
+    while (sent < count && Click(button))
+      sent++;
+    return sent;
+  }
+
+  // Keyboard and wheel input, for replaying recorded sessions. Key codes are
+  // those of the platform the session was recorded on. Backends without
+  // them return false.
+  virtual bool Key(int key, bool down) {
+    (void)key;
+    (void)down;
+    return false;
+  }
+  virtual bool Wheel(int delta) {
+    (void)delta;
+    return false;
+  }
+};
+
+// Sends one event of any type through the matching InputSink call.
+bool SendInputEvent(InputSink &sink, const InputEvent &event);
+
+#ifdef _WIN32
+
+// The original path: SetCursorPos + SendInput.
+class Win32InputSink : public InputSink {
+public:
+  const char *Name() const override { return "win32"; }
+  bool MoveTo(int x, int y) override;
+  bool Button(MouseButton button, bool down) override;
+  bool Click(MouseButton button) override;
+  int ClickBurst(MouseButton button, int count) override;
+  bool Key(int key, bool down) override;
+  bool Wheel(int delta) override;
+};
+
+#endif
+
+#ifdef __linux__
+
+// Virtual absolute pointer (with wheel and keyboard keys) created through
+// /dev/uinput. Needs write access to /dev/uinput (root or the `input` group).
+// Coordinates map 1:1 to pixels of a screen of the given size. The
+// constructor returns once the device's event node exists (at most a second),
+// so the first clicks are not lost.
+class UinputInputSink : public InputSink {
+public:
+  UinputInputSink(int screenWidth = 1920, int screenHeight = 1080);
+  ~UinputInputSink() override;
+
+  // Device name, so input capture can tell our own events apart.
+  static const char *const kDeviceName;
+
+  // False if the device could not be created; the sink is then unusable.
+  bool IsOpen() const { return fd >= 0; }
+
+  const char *Name() const override { return "uinput"; }
+  bool MoveTo(int x, int y) override;
+  bool Button(MouseButton button, bool down) override;
+  bool Click(MouseButton button) override;
+  int ClickBurst(MouseButton button, int count) override;
+  bool Key(int key, bool down) override;
+  bool Wheel(int delta) override;
+
+private:
+  int fd;
+  int wheelRemainder; // Wheel delta not yet sent as whole REL_WHEEL notches
+};
+
+#endif
+
+// Keeps injected events in memory instead of sending them anywhere. The buffer
+// is allocated up front; once full, events are only counted. With a capacity
+// of 0 this is a null sink, useful to measure raw engine throughput.
+class RecordingInputSink : public InputSink {
+public:
+  explicit RecordingInputSink(size_t capacity = 0);
+
+  const char *Name() const override;
+  bool MoveTo(int x, int y) override;
+  bool Button(MouseButton button, bool down) override;
+  // Records the whole burst with one timestamp and one counter update.
+  int ClickBurst(MouseButton button, int count) override;
+  bool Key(int key, bool down) override;
+  bool Wheel(int delta) override;
+
+  // Total events received, including those that did not fit in the buffer.
+  uint64_t GetEventCount() const;
+  // Copies the stored events. Safe to call while the worker is writing.
+  std::vector<InputEvent> GetEvents() const;
+  // Not safe while the worker is running.
+  void Clear();
+
+private:
+  void Record(const InputEvent &event);
+
+  std::vector<InputEvent> events;
+  std::atomic<uint64_t> eventCount;
+  int cursorX;
+  int cursorY;
+};
+
+// Win32 sink on Windows, uinput on Linux when available, otherwise a null
+// RecordingInputSink.
+std::unique_ptr<InputSink> CreateDefaultInputSink();
+
+#endif // INPUTSINK_H
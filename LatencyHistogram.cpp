@@ -0,0 +1,100 @@
+#include "LatencyHistogram.h"
+
+#include <climits>
+
+int64_t LatencySnapshot::Percentile(double q) const {
+  if (count == 0)
+    return 0;
+  uint64_t rank = (uint64_t)(q * count + 0.5);
+  if (rank < 1)
+    rank = 1;
+  if (rank > count)
+    rank = count;
+
+  uint64_t seen = 0;
+  for (int i = 0; i < kBucketCount; i++) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      int64_t bound = (int64_t)LatencyHistogram::BucketUpperBound(i);
+      return bound < maxNs ? bound : maxNs;
+    }
+  }
+  return maxNs;
+}
+
+LatencyHistogram::LatencyHistogram() { Reset(); }
+
+int LatencyHistogram::BucketIndex(uint64_t value) {
+  const uint64_t subCount = 1ull << kSubBucketBits;
+  if (value < subCount)
+    return (int)value;
+
+  int exponent = 63;
+  while (!(value >> exponent))
+    exponent--;
+  const int shift = exponent - kSubBucketBits;
+  const int sub = (int)((value >> shift) - subCount);
+  return (exponent - kSubBucketBits + 1) * (int)subCount + sub;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(int index) {
+  const int subCount = 1 << kSubBucketBits;
+  if (index < subCount)
+    return (uint64_t)index;
+
+  const int shift = index / subCount - 1;
+  const uint64_t lower = (uint64_t)(subCount + index % subCount) << shift;
+  return lower + (1ull << shift) - 1;
+}
+
+void LatencyHistogram::Record(int64_t valueNs) {
+  if (valueNs < 0)
+    valueNs = 0;
+
+  // Single writer: plain load + store instead of fetch_add keeps this free of
+  // locked instructions.
+  std::atomic<uint64_t> &bucket = buckets[BucketIndex((uint64_t)valueNs)];
+  bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+               std::memory_order_relaxed);
+  sum.store(sum.load(std::memory_order_relaxed) + (uint64_t)valueNs,
+            std::memory_order_relaxed);
+  if (valueNs < minValue.load(std::memory_order_relaxed))
+    minValue.store(valueNs, std::memory_order_relaxed);
+  if (valueNs > maxValue.load(std::memory_order_relaxed))
+    maxValue.store(valueNs, std::memory_order_relaxed);
+  count.store(count.load(std::memory_order_relaxed) + 1,
+              std::memory_order_release);
+}
+
+void LatencyHistogram::Reset() {
+  for (auto &b : buckets)
+    b.store(0, std::memory_order_relaxed);
+  count.store(0, std::memory_order_relaxed);
+  sum.store(0, std::memory_order_relaxed);
+  minValue.store(LLONG_MAX, std::memory_order_relaxed);
+  maxValue.store(0, std::memory_order_release);
+}
+
+LatencySnapshot LatencyHistogram::Snapshot() const {
+  LatencySnapshot s;
+
+  // Count what is actually in the buckets so percentiles are consistent
+  // with each other even while the writer is running.
+  uint64_t total = 0;
+  for (int i = 0; i < kBucketCount; i++) {
+    s.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    total += s.buckets[i];
+  }
+  s.count = total;
+  if (total == 0)
+    return s;
+
+  s.minNs = minValue.load(std::memory_order_relaxed);
+  s.maxNs = maxValue.load(std::memory_order_relaxed);
+  s.meanNs = (double)sum.load(std::memory_order_relaxed) / (double)total;
+  s.p50Ns = s.Percentile(0.50);
+  s.p90Ns = s.Percentile(0.90);
+  s.p99Ns = s.Percentile(0.99);
+  s.p999Ns = s.Percentile(0.999);
+  return s;
+}
@@ -0,0 +1,56 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+
+// Point-in-time copy of a LatencyHistogram.
+struct LatencySnapshot {
+  uint64_t count = 0;
+  int64_t minNs = 0;
+  int64_t maxNs = 0;
+  double meanNs = 0.0;
+  int64_t p50Ns = 0;
+  int64_t p90Ns = 0;
+  int64_t p99Ns = 0;
+  int64_t p999Ns = 0;
+
+  // Raw bucket counts, so snapshots can be merged or diffed.
+  static const int kBucketCount = 64 * 16;
+  uint64_t buckets[kBucketCount] = {};
+
+  // Value at quantile `q` (0..1), reported as the bucket's upper bound.
+  int64_t Percentile(double q) const;
+};
+
+// HDR-style log-bucketed histogram of nanosecond values: 64 power-of-two
+// ranges split into 16 linear sub-buckets each, so every recorded value is
+// accurate to within 1/16 (6.25%) over the whole 1ns..292y range.
+//
+// Record() is wait-free and meant for a single writer (the click worker): it
+// only does relaxed atomic stores, no read-modify-write. Snapshot() can run on
+// any thread at any time without stopping the writer; it may see a sample in
+// the buckets but not yet in the sum, which is fine for monitoring.
+class LatencyHistogram {
+public:
+  static const int kSubBucketBits = 4;
+  static const int kBucketCount = LatencySnapshot::kBucketCount;
+
+  LatencyHistogram();
+
+  void Record(int64_t valueNs);
+  void Reset(); // Only while no thread is recording
+  LatencySnapshot Snapshot() const;
+
+  static int BucketIndex(uint64_t value);
+  static uint64_t BucketUpperBound(int index);
+
+private:
+  std::atomic<uint64_t> buckets[kBucketCount];
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> sum;
+  std::atomic<int64_t> minValue;
+  std::atomic<int64_t> maxValue;
+};
+
+#endif // LATENCYHISTOGRAM_H
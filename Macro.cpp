@@ -0,0 +1,238 @@
+#include "Macro.h"
+
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+static bool ParseButton(const std::string &s, uint8_t &button) {
+  if (s == "left")
+    button = (uint8_t)MouseButton::Left;
+  else if (s == "right")
+    button = (uint8_t)MouseButton::Right;
+  else if (s == "middle")
+    button = (uint8_t)MouseButton::Middle;
+  else
+    return false;
+  return true;
+}
+
+static bool ParseInt(const std::string &s, int32_t &value) {
+  char *end = NULL;
+  long v = strtol(s.c_str(), &end, 10);
+  if (s.empty() || *end != '\0' || v < INT_MIN || v > INT_MAX)
+    return false;
+  value = (int32_t)v;
+  return true;
+}
+
+// "5ms", "250us", "1.5s"; no suffix means milliseconds.
+static bool ParseDurationUs(const std::string &s, int32_t &us) {
+  char *end = NULL;
+  double v = strtod(s.c_str(), &end);
+  if (s.empty() || end == s.c_str() || v < 0)
+    return false;
+  std::string unit = end;
+  double scale;
+  if (unit.empty() || unit == "ms")
+    scale = 1000.0;
+  else if (unit == "us")
+    scale = 1.0;
+  else if (unit == "s")
+    scale = 1000000.0;
+  else
+    return false;
+  double total = v * scale;
+  if (total > INT_MAX)
+    return false;
+  us = (int32_t)(total + 0.5);
+  return true;
+}
+
+static MacroInstr MakeInstr(MacroOp op, uint8_t button = 0, int32_t a = 0,
+                            int32_t b = 0) {
+  MacroInstr in;
+  in.op = op;
+  in.button = button;
+  in.slot = 0;
+  in.a = a;
+  in.b = b;
+  return in;
+}
+
+bool CompileMacro(const std::string &source, MacroProgram &program,
+                  std::string &error) {
+  struct OpenLoop {
+    int32_t start;
+    uint16_t slot;
+    int32_t count;
+    int line;
+  };
+  std::vector<OpenLoop> loops;
+  std::vector<MacroInstr> code;
+  int slots = 0;
+
+  std::istringstream in(source);
+  std::string line;
+  int lineNo = 0;
+  while (std::getline(in, line)) {
+    lineNo++;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos)
+      line.erase(hash);
+
+    std::istringstream words(line);
+    std::vector<std::string> w;
+    std::string word;
+    while (words >> word)
+      w.push_back(word);
+    if (w.empty())
+      continue;
+
+    auto fail = [&](const char *msg) {
+      error = "line " + std::to_string(lineNo) + ": " + msg;
+      return false;
+    };
+
+    const std::string &cmd = w[0];
+    if (cmd == "move") {
+      int32_t x, y;
+      if (w.size() != 3 || !ParseInt(w[1], x) || !ParseInt(w[2], y))
+        return fail("expected: move <x> <y>");
+      code.push_back(MakeInstr(MacroOp::Move, 0, x, y));
+    } else if (cmd == "click" || cmd == "dclick" || cmd == "down" ||
+               cmd == "up") {
+      // [button] [x y]
+      size_t i = 1;
+      uint8_t button = (uint8_t)MouseButton::Left;
+      if (i < w.size() && ParseButton(w[i], button))
+        i++;
+      if (i < w.size()) {
+        int32_t x, y;
+        if (w.size() != i + 2 || !ParseInt(w[i], x) || !ParseInt(w[i + 1], y))
+          return fail("expected: <cmd> [left|right|middle] [x y]");
+        code.push_back(MakeInstr(MacroOp::Move, 0, x, y));
+      }
+      if (cmd == "down") {
+        code.push_back(MakeInstr(MacroOp::Down, button));
+      } else if (cmd == "up") {
+        code.push_back(MakeInstr(MacroOp::Up, button));
+      } else {
+        code.push_back(MakeInstr(MacroOp::Click, button));
+        if (cmd == "dclick")
+          code.push_back(MakeInstr(MacroOp::Click, button));
+      }
+    } else if (cmd == "hold") {
+      size_t i = 1;
+      uint8_t button = (uint8_t)MouseButton::Left;
+      if (i < w.size() && ParseButton(w[i], button))
+        i++;
+      int32_t us;
+      if (w.size() != i + 1 || !ParseDurationUs(w[i], us))
+        return fail("expected: hold [left|right|middle] <time>");
+      code.push_back(MakeInstr(MacroOp::Down, button));
+      code.push_back(MakeInstr(MacroOp::Wait, 0, us));
+      code.push_back(MakeInstr(MacroOp::Up, button));
+    } else if (cmd == "wait") {
+      int32_t us;
+      if (w.size() != 2 || !ParseDurationUs(w[1], us))
+        return fail("expected: wait <time>");
+      code.push_back(MakeInstr(MacroOp::Wait, 0, us));
+    } else if (cmd == "loop") {
+      int32_t count = 0;
+      if (w.size() > 2 || (w.size() == 2 && (!ParseInt(w[1], count) ||
+                                              count < 1)))
+        return fail("expected: loop [count >= 1]");
+      if (slots == UINT16_MAX)
+        return fail("too many loops");
+      loops.push_back({(int32_t)code.size(), (uint16_t)slots++, count, lineNo});
+    } else if (cmd == "end") {
+      if (w.size() != 1 || loops.empty())
+        return fail("'end' without 'loop'");
+      OpenLoop l = loops.back();
+      loops.pop_back();
+      MacroInstr instr = MakeInstr(MacroOp::LoopEnd, 0, l.start, l.count);
+      instr.slot = l.slot;
+      code.push_back(instr);
+    } else {
+      return fail(("unknown command '" + cmd + "'").c_str());
+    }
+  }
+
+  if (!loops.empty()) {
+    error = "line " + std::to_string(loops.back().line) + ": missing 'end'";
+    return false;
+  }
+
+  code.push_back(MakeInstr(MacroOp::End));
+  program.code.swap(code);
+  program.loopSlots = slots;
+  return true;
+}
+
+bool CompileMacroFile(const std::string &path, MacroProgram &program,
+                      std::string &error) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    error = "cannot open " + path;
+    return false;
+  }
+  std::stringstream ss;
+  ss << file.rdbuf();
+  return CompileMacro(ss.str(), program, error);
+}
+
+MacroRunner::MacroRunner(const MacroProgram &program)
+    : code(program.code.data()), counters(program.loopSlots), pc(0) {}
+
+void MacroRunner::Reset() {
+  pc = 0;
+  for (auto &c : counters)
+    c = 0;
+}
+
+bool MacroRunner::IsFinished() const { return code[pc].op == MacroOp::End; }
+
+int64_t MacroRunner::Step(InputSink &sink, int64_t timeNs,
+                          unsigned long &clicks) {
+  for (int budget = kStepBudget; budget > 0; budget--) {
+    const MacroInstr &in = code[pc];
+    switch (in.op) {
+    case MacroOp::End:
+      return timeNs;
+    case MacroOp::Move:
+      sink.MoveTo(in.a, in.b);
+      pc++;
+      break;
+    case MacroOp::Down:
+      if (sink.Button((MouseButton)in.button, true))
+        clicks++;
+      pc++;
+      break;
+    case MacroOp::Up:
+      sink.Button((MouseButton)in.button, false);
+      pc++;
+      break;
+    case MacroOp::Click:
+      if (sink.Click((MouseButton)in.button))
+        clicks++;
+      pc++;
+      break;
+    case MacroOp::Wait:
+      pc++;
+      if (in.a > 0)
+        return timeNs + (int64_t)in.a * 1000;
+      break;
+    case MacroOp::LoopEnd: {
+      int32_t &counter = counters[in.slot];
+      if (in.b == 0 || ++counter < in.b) {
+        pc = (size_t)in.a;
+      } else {
+        counter = 0;
+        pc++;
+      }
+    } break;
+    }
+  }
+  return timeNs;
+}
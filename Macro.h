@@ -0,0 +1,79 @@
+#ifndef MACRO_H
+#define MACRO_H
+
+#include "InputSink.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Macro scripts are plain text, one step per line, '#' starts a comment:
+//
+//   move 100 200          absolute cursor move
+//   click [button] [x y]  press + release, optionally moving first
+//   dclick [button] [x y] double click
+//   down [button] [x y]   press and hold
+//   up [button] [x y]     release
+//   hold [button] <time>  press, wait, release
+//   wait <time>           e.g. 5ms, 250us, 1.5s (plain numbers are ms)
+//   loop [count]          repeat until the matching `end`; no count = forever
+//   end
+//
+// Buttons are left (default), right or middle. Scripts are compiled once
+// into a flat MacroInstr array which MacroRunner executes without allocating.
+
+enum class MacroOp : uint8_t {
+  End = 0,  // Program finished
+  Move,     // a = x, b = y
+  Down,     // button
+  Up,       // button
+  Click,    // button
+  Wait,     // a = microseconds
+  LoopEnd,  // slot, a = jump target, b = count (0 = forever)
+};
+
+struct MacroInstr {
+  MacroOp op;
+  uint8_t button;
+  uint16_t slot; // Loop counter index
+  int32_t a;
+  int32_t b;
+};
+
+struct MacroProgram {
+  std::vector<MacroInstr> code; // Always terminated by MacroOp::End
+  int loopSlots = 0;
+};
+
+// Returns false and fills `error` ("line N: ...") on a syntax error.
+bool CompileMacro(const std::string &source, MacroProgram &program,
+                  std::string &error);
+bool CompileMacroFile(const std::string &path, MacroProgram &program,
+                      std::string &error);
+
+// Executes a compiled program against an InputSink. The worker calls Step()
+// at each deadline; Step() runs instructions up to the next wait and returns
+// that wait's absolute deadline.
+class MacroRunner {
+public:
+  explicit MacroRunner(const MacroProgram &program);
+
+  void Reset();
+  bool IsFinished() const;
+
+  // `timeNs` is the time the current step is considered to happen at; waits
+  // are added to it. Returns the next deadline, or `timeNs` if the step budget
+  // ran out without reaching a wait. `clicks` is increased per press the
+  // sink accepted.
+  int64_t Step(InputSink &sink, int64_t timeNs, unsigned long &clicks);
+
+private:
+  // Instructions per Step() before returning control to the worker, so a
+  // loop without waits can still be stopped.
+  static const int kStepBudget = 1024;
+
+  const MacroInstr *code;
+  std::vector<int32_t> counters;
+  size_t pc;
+};
+
+#endif // MACRO_H
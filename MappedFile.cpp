@@ -0,0 +1,188 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+    : data(nullptr), size(0), fileHandle(INVALID_HANDLE_VALUE),
+      mappingHandle(NULL) {}
+
+MappedFile::~MappedFile() { Close(); }
+
+bool MappedFile::Open(const std::string &path) {
+  Close();
+  // Share delete so the file can still be replaced by WriteFileAtomic.
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                FILE_SHARE_DELETE,
+                            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 ||
+      (uint64_t)fileSize.QuadPart > (uint64_t)SIZE_MAX) {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!mapping) {
+    CloseHandle(file);
+    return false;
+  }
+  const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!view) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  fileHandle = file;
+  mappingHandle = mapping;
+  data = (const uint8_t *)view;
+  size = (size_t)fileSize.QuadPart;
+  return true;
+}
+
+void MappedFile::Release(size_t offset, size_t length) {
+  if (!data || offset >= size)
+    return;
+  if (length > size - offset)
+    length = size - offset;
+  // Unlocking pages that are not locked removes them from the working set.
+  VirtualUnlock((void *)(data + offset), length);
+}
+
+void MappedFile::Close() {
+  if (data)
+    UnmapViewOfFile(data);
+  if (mappingHandle)
+    CloseHandle(mappingHandle);
+  if (fileHandle != INVALID_HANDLE_VALUE)
+    CloseHandle(fileHandle);
+  data = nullptr;
+  size = 0;
+  mappingHandle = NULL;
+  fileHandle = INVALID_HANDLE_VALUE;
+}
+
+bool WriteFileAtomic(const std::string &path, const void *bytes, size_t size) {
+  std::string tmp = path + ".tmp";
+  HANDLE file = CreateFileA(tmp.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  DWORD written = 0;
+  bool ok = WriteFile(file, bytes, (DWORD)size, &written, NULL) &&
+            written == (DWORD)size && FlushFileBuffers(file);
+  CloseHandle(file);
+
+  // A file someone has mapped cannot be replaced, but it can be renamed
+  // out of the way; its readers keep the old data until they unmap it. The
+  // .old file cannot be deleted while they do, so a previous write may have
+  // left one behind: it goes now, and also frees the name for this write.
+  const std::string old = path + ".old";
+  DeleteFileA(old.c_str());
+  const DWORD flags = MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH;
+  if (ok && !MoveFileExA(tmp.c_str(), path.c_str(), flags)) {
+    ok = MoveFileExA(path.c_str(), old.c_str(), flags) &&
+         MoveFileExA(tmp.c_str(), path.c_str(), flags);
+    DeleteFileA(old.c_str()); // Fails while the old file is still mapped
+  }
+  if (!ok)
+    DeleteFileA(tmp.c_str());
+  return ok;
+}
+
+#else
+
+MappedFile::MappedFile() : data(nullptr), size(0), fd(-1) {}
+
+MappedFile::~MappedFile() { Close(); }
+
+bool MappedFile::Open(const std::string &path) {
+  Close();
+  int f = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (f < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(f, &st) != 0 || st.st_size <= 0) {
+    close(f);
+    return false;
+  }
+  void *view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, f, 0);
+  if (view == MAP_FAILED) {
+    close(f);
+    return false;
+  }
+
+  fd = f;
+  data = (const uint8_t *)view;
+  size = (size_t)st.st_size;
+  return true;
+}
+
+void MappedFile::Release(size_t offset, size_t length) {
+  if (!data || offset >= size)
+    return;
+  if (length > size - offset)
+    length = size - offset;
+  // madvise wants a page-aligned start; shrink the range inwards.
+  const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t begin = (offset + page - 1) / page * page;
+  size_t end = (offset + length) / page * page;
+  if (end > begin)
+    madvise((void *)(data + begin), end - begin, MADV_DONTNEED);
+}
+
+void MappedFile::Close() {
+  if (data)
+    munmap((void *)data, size);
+  if (fd >= 0)
+    close(fd);
+  data = nullptr;
+  size = 0;
+  fd = -1;
+}
+
+bool WriteFileAtomic(const std::string &path, const void *bytes, size_t size) {
+  std::string tmp = path + ".tmp";
+  int f = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (f < 0)
+    return false;
+
+  const char *p = (const char *)bytes;
+  size_t left = size;
+  bool ok = true;
+  while (left > 0) {
+    ssize_t n = write(f, p, left);
+    if (n <= 0) {
+      ok = false;
+      break;
+    }
+    p += n;
+    left -= (size_t)n;
+  }
+  ok = ok && fsync(f) == 0;
+  ok = close(f) == 0 && ok;
+
+  if (ok)
+    ok = rename(tmp.c_str(), path.c_str()) == 0;
+  if (!ok)
+    unlink(tmp.c_str());
+  return ok;
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+public:
+  MappedFile();
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // False if the file is missing, empty or cannot be mapped.
+  bool Open(const std::string &path);
+  void Close();
+
+  bool IsOpen() const { return data != nullptr; }
+  const uint8_t *Data() const { return data; }
+  size_t Size() const { return size; }
+
+  // Drops the pages of [offset, offset + length) from the process's working
+  // set, for sequential readers of large files. The data stays readable and
+  // is paged back in from the file if touched again.
+  void Release(size_t offset, size_t length);
+
+private:
+  const uint8_t *data;
+  size_t size;
+#ifdef _WIN32
+  void *fileHandle;
+  void *mappingHandle;
+#else
+  int fd;
+#endif
+};
+
+// Writes `path` atomically: the data goes to `path`.tmp, is flushed to disk
+// and then renamed over `path`, so readers see either the old or the new
+// file, never a partial one. On Windows a mapped `path` is first renamed to
+// `path`.old, which is deleted right away if no one still maps it, else by
+// the next write.
+bool WriteFileAtomic(const std::string &path, const void *data, size_t size);
+
+#endif // MAPPEDFILE_H
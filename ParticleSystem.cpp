@@ -0,0 +1,159 @@
+#include "ParticleSystem.h"
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PARTICLESYSTEM_SSE2 1
+#endif
+
+ParticleSystem::ParticleSystem()
+    : count(0), areaWidth(0), areaHeight(0), accumulator(0.0),
+      stepSeconds(kStepSeconds), stepScale(1.0f), rng{1, 2, 3, 4} {}
+
+uint32_t ParticleSystem::NextRandom(size_t lane) {
+  // xorshift32, one state per SIMD lane
+  uint32_t &s = rng[lane & 3];
+  s ^= s << 13;
+  s ^= s >> 17;
+  s ^= s << 5;
+  return s;
+}
+
+static float ToUnit(uint32_t r) { return (r >> 8) * (1.0f / 16777216.0f); }
+
+static int PickInt(uint32_t r, int lo, int hi) {
+  return hi > lo ? lo + (int)(r % (uint32_t)(hi - lo + 1)) : lo;
+}
+
+void ParticleSystem::Init(size_t n, const ParticleParams &p, int width,
+                          int height, uint32_t seed) {
+  params = p;
+  count = n;
+  areaWidth = width > 0 ? width : 1;
+  areaHeight = height > 0 ? height : 1;
+  accumulator = 0.0;
+  for (int lane = 0; lane < 4; lane++) {
+    // Never zero, and different per lane
+    rng[lane] = (seed ^ (0x9E3779B9u * (uint32_t)(lane + 1))) | 1u;
+  }
+
+  const size_t padded = (n + 3) & ~(size_t)3;
+  x.assign(padded, 0.0f);
+  y.assign(padded, -1e30f);
+  speed.assign(padded, 0.0f);
+  tail.assign(padded, 0.0f);
+  size.assign(padded, 0);
+  length.assign(padded, 0);
+  brightness.assign(padded, 0);
+
+  for (size_t i = 0; i < n; i++)
+    Spawn(i, true);
+}
+
+void ParticleSystem::Clear() { Init(0, params, areaWidth, areaHeight, 1); }
+
+void ParticleSystem::Spawn(size_t i, bool anywhere) {
+  const size_t lane = i & 3;
+  x[i] = ToUnit(NextRandom(lane)) * areaWidth;
+  y[i] = anywhere ? ToUnit(NextRandom(lane)) * areaHeight : 0.0f;
+  speed[i] = params.minSpeed +
+             ToUnit(NextRandom(lane)) * (params.maxSpeed - params.minSpeed);
+  length[i] =
+      (uint8_t)PickInt(NextRandom(lane), params.minLength, params.maxLength);
+  tail[i] = length[i] * params.lengthSpacing;
+  size[i] = (uint8_t)PickInt(NextRandom(lane), params.minSize, params.maxSize);
+  brightness[i] = (uint8_t)PickInt(NextRandom(lane), params.minBrightness,
+                                   params.maxBrightness);
+}
+
+void ParticleSystem::Resize(int width, int height) {
+  if (width <= 0 || height <= 0 ||
+      (width == areaWidth && height == areaHeight))
+    return;
+  const float sx = (float)width / areaWidth;
+  const float sy = (float)height / areaHeight;
+  for (size_t i = 0; i < count; i++) {
+    x[i] *= sx;
+    y[i] *= sy;
+  }
+  areaWidth = width;
+  areaHeight = height;
+}
+
+void ParticleSystem::SetCount(size_t n) {
+  if (n == count)
+    return;
+  const size_t padded = (n + 3) & ~(size_t)3;
+  x.resize(padded);
+  y.resize(padded);
+  speed.resize(padded);
+  tail.resize(padded);
+  size.resize(padded);
+  length.resize(padded);
+  brightness.resize(padded);
+
+  for (size_t i = count; i < n; i++)
+    Spawn(i, true);
+  for (size_t i = n; i < padded; i++) {
+    y[i] = -1e30f; // Inert padding lane
+    speed[i] = 0.0f;
+    tail[i] = 0.0f;
+  }
+  count = n;
+}
+
+void ParticleSystem::SetLengthSpacing(float spacing) {
+  params.lengthSpacing = spacing;
+  for (size_t i = 0; i < count; i++)
+    tail[i] = length[i] * spacing;
+}
+
+void ParticleSystem::SetStepRate(int hz) {
+  if (hz < 1)
+    hz = 1;
+  stepSeconds = 1.0 / hz;
+  stepScale = (float)(stepSeconds / kStepSeconds);
+}
+
+int ParticleSystem::Advance(double seconds) {
+  accumulator += seconds;
+  int steps = 0;
+  while (accumulator >= stepSeconds && steps < kMaxStepsPerAdvance) {
+    Step();
+    accumulator -= stepSeconds;
+    steps++;
+  }
+  if (steps == kMaxStepsPerAdvance)
+    accumulator = 0.0;
+  return steps;
+}
+
+void ParticleSystem::Step() {
+  const size_t padded = x.size();
+  const float h = (float)areaHeight;
+  size_t i = 0;
+
+#ifdef PARTICLESYSTEM_SSE2
+  const __m128 hv = _mm_set1_ps(h);
+  const __m128 scale = _mm_set1_ps(stepScale);
+  for (; i < padded; i += 4) {
+    __m128 yv = _mm_add_ps(_mm_loadu_ps(&y[i]),
+                           _mm_mul_ps(_mm_loadu_ps(&speed[i]), scale));
+    _mm_storeu_ps(&y[i], yv);
+    // Off the bottom once the whole trail has left the area
+    int out = _mm_movemask_ps(_mm_cmpgt_ps(_mm_sub_ps(yv, _mm_loadu_ps(&tail[i])), hv));
+    if (out) {
+      for (int lane = 0; lane < 4; lane++) {
+        if (out & (1 << lane))
+          Spawn(i + lane, false);
+      }
+    }
+  }
+#endif
+
+  for (; i < padded; i++) {
+    y[i] += speed[i] * stepScale;
+    if (y[i] - tail[i] > h)
+      Spawn(i, false);
+  }
+}
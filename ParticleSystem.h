@@ -0,0 +1,87 @@
+#ifndef PARTICLESYSTEM_H
+#define PARTICLESYSTEM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Ranges particles are spawned with. Lengths are for trails (Matrix streams,
+// in glyphs of `lengthSpacing` pixels); stars use 0.
+struct ParticleParams {
+  float minSpeed = 1.0f; // Pixels per kStepSeconds
+  float maxSpeed = 6.0f;
+  int minLength = 0;
+  int maxLength = 0;
+  float lengthSpacing = 0.0f;
+  int minSize = 1;
+  int maxSize = 2;
+  int minBrightness = 150;
+  int maxBrightness = 254;
+};
+
+// Falling particles stored as a structure of arrays, so the per-step update is
+// a straight SSE2 loop over x/y/speed. Each SIMD lane has its own xorshift
+// PRNG for respawns. The simulation advances in fixed steps (kStepSeconds
+// unless changed with SetStepRate) regardless of how often Advance() is
+// called.
+class ParticleSystem {
+public:
+  static constexpr double kStepSeconds = 1.0 / 30.0;
+  static const int kMaxStepsPerAdvance = 8; // Don't spiral after a stall
+
+  ParticleSystem();
+
+  // Spawns `count` particles spread over a width x height area.
+  void Init(size_t count, const ParticleParams &params, int width, int height,
+            uint32_t seed);
+  void Clear();
+  bool Empty() const { return count == 0; }
+
+  // Rescales positions to a new area so the field stays evenly covered.
+  void Resize(int width, int height);
+  // Grows (spawning anywhere in the area) or shrinks the particle count.
+  void SetCount(size_t n);
+  // Changes the trail pitch (e.g. when the glyph size changes with DPI).
+  void SetLengthSpacing(float spacing);
+  // Steps `hz` times per second, moving proportionally less per step, so
+  // motion matches the render rate without changing speed.
+  void SetStepRate(int hz);
+
+  // Accumulates real time and runs the fixed steps that are due. Returns the
+  // number of steps taken.
+  int Advance(double seconds);
+  void Step();
+
+  size_t Count() const { return count; }
+  int Width() const { return areaWidth; }
+  int Height() const { return areaHeight; }
+  const float *X() const { return x.data(); }
+  const float *Y() const { return y.data(); }
+  const uint8_t *Size() const { return size.data(); }
+  const uint8_t *Length() const { return length.data(); }
+  const uint8_t *Brightness() const { return brightness.data(); }
+
+private:
+  void Spawn(size_t i, bool anywhere);
+  uint32_t NextRandom(size_t lane);
+
+  ParticleParams params;
+  size_t count;
+  int areaWidth;
+  int areaHeight;
+  double accumulator;
+  double stepSeconds;
+  float stepScale; // stepSeconds / kStepSeconds
+
+  // Padded to a multiple of 4; padding lanes never move or respawn.
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> speed;
+  std::vector<float> tail; // length * lengthSpacing
+  std::vector<uint8_t> size;
+  std::vector<uint8_t> length;
+  std::vector<uint8_t> brightness;
+  uint32_t rng[4];
+};
+
+#endif // PARTICLESYSTEM_H
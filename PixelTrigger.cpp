@@ -0,0 +1,367 @@
+#include "PixelTrigger.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PIXELTRIGGER_SSE2 1
+#endif
+
+// AVX2 is compiled in for x86 GCC/Clang/MSVC builds regardless of the target
+// flags and only used after a CPU check, so one binary runs everywhere.
+#if defined(PIXELTRIGGER_SSE2) &&                                              \
+    (defined(__x86_64__) || defined(__i386__) || defined(_M_X64))
+#include <immintrin.h>
+#define PIXELTRIGGER_AVX2 1
+#if defined(__GNUC__)
+#define AVX2_TARGET __attribute__((target("avx2")))
+#else
+#include <intrin.h>
+#define AVX2_TARGET
+#endif
+#endif
+
+PixelTrigger PixelTrigger::FromSettings(const ClickSettings &settings) {
+  PixelTrigger t;
+  t.mode = (PixelTriggerMode)settings.triggerMode;
+  if (t.mode != PixelTriggerMode::Color &&
+      t.mode != PixelTriggerMode::Change &&
+      t.mode != PixelTriggerMode::Template)
+    t.mode = PixelTriggerMode::Off;
+  t.x = settings.triggerX;
+  t.y = settings.triggerY;
+  t.width = settings.triggerWidth > 0 ? settings.triggerWidth : 1;
+  t.height = settings.triggerHeight > 0 ? settings.triggerHeight : 1;
+  t.color = (uint32_t)settings.triggerColor & 0xFFFFFF;
+  t.tolerance = settings.triggerTolerance < 0     ? 0
+                : settings.triggerTolerance > 255 ? 255
+                                                  : settings.triggerTolerance;
+  // A full path field has no terminator.
+  const char *path = settings.templateImage;
+  const void *nul = memchr(path, '\0', sizeof(settings.templateImage));
+  t.templatePath.assign(path, nul ? (const char *)nul - path
+                                  : sizeof(settings.templateImage));
+  t.templateThreshold = settings.templateThreshold / 100.0;
+  return t;
+}
+
+static PixelKernel DetectPixelKernel() {
+#if defined(PIXELTRIGGER_AVX2) && defined(__GNUC__)
+  if (__builtin_cpu_supports("avx2"))
+    return PixelKernel::Avx2;
+#elif defined(PIXELTRIGGER_AVX2)
+  int info[4];
+  __cpuid(info, 1);
+  const bool osSavesYmm =
+      (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && // OSXSAVE, AVX
+      (_xgetbv(0) & 6) == 6;
+  if (osSavesYmm) {
+    __cpuidex(info, 7, 0);
+    if (info[1] & (1 << 5))
+      return PixelKernel::Avx2;
+  }
+#endif
+#ifdef PIXELTRIGGER_SSE2
+  return PixelKernel::Sse2;
+#else
+  return PixelKernel::Scalar;
+#endif
+}
+
+PixelKernel BestPixelKernel() {
+  static const PixelKernel best = DetectPixelKernel();
+  return best;
+}
+
+const char *PixelKernelName(PixelKernel kernel) {
+  switch (kernel) {
+  case PixelKernel::Avx2:
+    return "avx2";
+  case PixelKernel::Sse2:
+    return "sse2";
+  default:
+    return "scalar";
+  }
+}
+
+static inline int LowestBit(unsigned mask) {
+#if defined(__GNUC__)
+  return __builtin_ctz(mask);
+#else
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (int)index;
+#endif
+}
+
+static inline bool NearColor(uint32_t p, uint32_t color, int tolerance) {
+  for (int shift = 0; shift < 24; shift += 8) {
+    int d = (int)((p >> shift) & 0xFF) - (int)((color >> shift) & 0xFF);
+    if (d > tolerance || d < -tolerance)
+      return false;
+  }
+  return true;
+}
+
+// Each row function returns the index of the first hit in the row or -1.
+
+static int FindColorRowScalar(const uint32_t *p, int n, int start,
+                              uint32_t color, int tolerance) {
+  for (int i = start; i < n; i++)
+    if (NearColor(p[i], color, tolerance))
+      return i;
+  return -1;
+}
+
+static int FindDiffRowScalar(const uint32_t *a, const uint32_t *b, int n,
+                             int start) {
+  for (int i = start; i < n; i++)
+    if ((a[i] ^ b[i]) & 0xFFFFFF)
+      return i;
+  return -1;
+}
+
+#ifdef PIXELTRIGGER_SSE2
+
+// |p - c| per byte is subs(p, c) | subs(c, p). Subtracting the tolerance
+// (255 in the alpha byte) leaves zero in every byte of a matching pixel.
+static inline __m128i ColorMiss(__m128i p, __m128i c, __m128i tol) {
+  __m128i d = _mm_or_si128(_mm_subs_epu8(p, c), _mm_subs_epu8(c, p));
+  return _mm_subs_epu8(d, tol);
+}
+
+static int FindColorRowSse2(const uint32_t *p, int n, uint32_t color,
+                            int tolerance) {
+  const __m128i c = _mm_set1_epi32((int)color);
+  const __m128i tol =
+      _mm_set1_epi32((int)(0xFF000000u | (uint32_t)tolerance * 0x010101u));
+  const __m128i zero = _mm_setzero_si128();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    // Four vectors per test keeps the exit branch off the critical path.
+    __m128i m0 = _mm_cmpeq_epi32(
+        ColorMiss(_mm_loadu_si128((const __m128i *)(p + i)), c, tol), zero);
+    __m128i m1 = _mm_cmpeq_epi32(
+        ColorMiss(_mm_loadu_si128((const __m128i *)(p + i + 4)), c, tol),
+        zero);
+    __m128i m2 = _mm_cmpeq_epi32(
+        ColorMiss(_mm_loadu_si128((const __m128i *)(p + i + 8)), c, tol),
+        zero);
+    __m128i m3 = _mm_cmpeq_epi32(
+        ColorMiss(_mm_loadu_si128((const __m128i *)(p + i + 12)), c, tol),
+        zero);
+    __m128i any = _mm_or_si128(_mm_or_si128(m0, m1), _mm_or_si128(m2, m3));
+    if (_mm_movemask_epi8(any)) {
+      unsigned mask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(m0)) |
+                      (unsigned)_mm_movemask_ps(_mm_castsi128_ps(m1)) << 4 |
+                      (unsigned)_mm_movemask_ps(_mm_castsi128_ps(m2)) << 8 |
+                      (unsigned)_mm_movemask_ps(_mm_castsi128_ps(m3)) << 12;
+      return i + LowestBit(mask);
+    }
+  }
+  return FindColorRowScalar(p, n, i, color, tolerance);
+}
+
+static int FindDiffRowSse2(const uint32_t *a, const uint32_t *b, int n) {
+  const __m128i rgb = _mm_set1_epi32(0xFFFFFF);
+  const __m128i zero = _mm_setzero_si128();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i)),
+                               _mm_loadu_si128((const __m128i *)(b + i)));
+    __m128i x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i + 4)),
+                               _mm_loadu_si128((const __m128i *)(b + i + 4)));
+    __m128i x2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i + 8)),
+                               _mm_loadu_si128((const __m128i *)(b + i + 8)));
+    __m128i x3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i + 12)),
+                               _mm_loadu_si128((const __m128i *)(b + i + 12)));
+    __m128i any = _mm_and_si128(
+        _mm_or_si128(_mm_or_si128(x0, x1), _mm_or_si128(x2, x3)), rgb);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(any, zero)) != 0xFFFF)
+      return FindDiffRowScalar(a, b, i + 16, i);
+  }
+  return FindDiffRowScalar(a, b, n, i);
+}
+
+#endif // PIXELTRIGGER_SSE2
+
+#ifdef PIXELTRIGGER_AVX2
+
+AVX2_TARGET static int FindColorRowAvx2(const uint32_t *p, int n,
+                                        uint32_t color, int tolerance) {
+  const __m256i c = _mm256_set1_epi32((int)color);
+  const __m256i tol = _mm256_set1_epi32(
+      (int)(0xFF000000u | (uint32_t)tolerance * 0x010101u));
+  const __m256i zero = _mm256_setzero_si256();
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i m[4];
+    for (int k = 0; k < 4; k++) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(p + i + 8 * k));
+      __m256i d =
+          _mm256_or_si256(_mm256_subs_epu8(v, c), _mm256_subs_epu8(c, v));
+      m[k] = _mm256_cmpeq_epi32(_mm256_subs_epu8(d, tol), zero);
+    }
+    __m256i any =
+        _mm256_or_si256(_mm256_or_si256(m[0], m[1]), _mm256_or_si256(m[2], m[3]));
+    if (!_mm256_testz_si256(any, any)) {
+      unsigned mask = 0;
+      for (int k = 0; k < 4; k++)
+        mask |= (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(m[k]))
+                << (8 * k);
+      return i + LowestBit(mask);
+    }
+  }
+  return FindColorRowScalar(p, n, i, color, tolerance);
+}
+
+AVX2_TARGET static int FindDiffRowAvx2(const uint32_t *a, const uint32_t *b,
+                                       int n) {
+  const __m256i rgb = _mm256_set1_epi32(0xFFFFFF);
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i any = _mm256_setzero_si256();
+    for (int k = 0; k < 4; k++)
+      any = _mm256_or_si256(
+          any,
+          _mm256_xor_si256(
+              _mm256_loadu_si256((const __m256i *)(a + i + 8 * k)),
+              _mm256_loadu_si256((const __m256i *)(b + i + 8 * k))));
+    if (!_mm256_testz_si256(any, rgb))
+      return FindDiffRowScalar(a, b, i + 32, i);
+  }
+  return FindDiffRowScalar(a, b, n, i);
+}
+
+#endif // PIXELTRIGGER_AVX2
+
+static int FindColorRow(const uint32_t *p, int n, uint32_t color,
+                        int tolerance, PixelKernel kernel) {
+  switch (kernel) {
+#ifdef PIXELTRIGGER_AVX2
+  case PixelKernel::Avx2:
+    return FindColorRowAvx2(p, n, color, tolerance);
+#endif
+#ifdef PIXELTRIGGER_SSE2
+  case PixelKernel::Sse2:
+    return FindColorRowSse2(p, n, color, tolerance);
+#endif
+  default:
+    return FindColorRowScalar(p, n, 0, color, tolerance);
+  }
+}
+
+static int FindDiffRow(const uint32_t *a, const uint32_t *b, int n,
+                       PixelKernel kernel) {
+  switch (kernel) {
+#ifdef PIXELTRIGGER_AVX2
+  case PixelKernel::Avx2:
+    return FindDiffRowAvx2(a, b, n);
+#endif
+#ifdef PIXELTRIGGER_SSE2
+  case PixelKernel::Sse2:
+    return FindDiffRowSse2(a, b, n);
+#endif
+  default:
+    return FindDiffRowScalar(a, b, n, 0);
+  }
+}
+
+bool FindColor(const Framebuffer &frame, uint32_t color, int tolerance,
+               int &x, int &y, PixelKernel kernel) {
+  if (kernel > BestPixelKernel())
+    kernel = BestPixelKernel();
+  color &= 0xFFFFFF;
+  for (int row = 0; row < frame.Height(); row++) {
+    int i = FindColorRow(frame.Row(row), frame.Width(), color, tolerance,
+                         kernel);
+    if (i >= 0) {
+      x = i;
+      y = row;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SyncChanges(const Framebuffer &frame, Framebuffer &reference, int &x,
+                 int &y, PixelKernel kernel) {
+  if (kernel > BestPixelKernel())
+    kernel = BestPixelKernel();
+  const int w = frame.Width();
+  for (int row = 0; row < frame.Height(); row++) {
+    int i = FindDiffRow(frame.Row(row), reference.Row(row), w, kernel);
+    if (i < 0)
+      continue;
+    x = i;
+    y = row;
+    for (; row < frame.Height(); row++)
+      memcpy(reference.Row(row), frame.Row(row), (size_t)w * 4);
+    return true;
+  }
+  return false;
+}
+
+PixelWatcher::PixelWatcher(const PixelTrigger &trigger, PixelKernel kernel)
+    : trigger(trigger), kernel(kernel), primed(false), matching(false) {}
+
+PixelWatcher::~PixelWatcher() {}
+
+bool PixelWatcher::Prepare(WorkStealingPool *pool, std::string &error) {
+  if (trigger.mode != PixelTriggerMode::Template)
+    return true;
+  Framebuffer image;
+  if (!LoadBitmapFile(trigger.templatePath, image, error))
+    return false;
+  matcher.reset(new TemplateMatcher(pool));
+  matcher->SetThreshold(trigger.templateThreshold);
+  if (!matcher->SetTemplate(image)) {
+    error = trigger.templatePath + ": template is too small or blank";
+    matcher.reset();
+    return false;
+  }
+  return true;
+}
+
+bool PixelWatcher::Poll(ScreenSource &source, int &x, int &y) {
+  if (trigger.mode == PixelTriggerMode::Off)
+    return false;
+  const Framebuffer *frame =
+      source.Capture(trigger.x, trigger.y, trigger.width, trigger.height);
+  if (!frame)
+    return false;
+
+  int hx = 0, hy = 0;
+  bool fire = false;
+  if (trigger.mode == PixelTriggerMode::Color) {
+    const bool found =
+        FindColor(*frame, trigger.color, trigger.tolerance, hx, hy, kernel);
+    fire = found && !matching;
+    matching = found;
+  } else if (trigger.mode == PixelTriggerMode::Template) {
+    if (!matcher)
+      return false;
+    const TemplateMatch match = matcher->Find(*frame);
+    fire = match.found && (!lastMatch.found || match.x != lastMatch.x ||
+                           match.y != lastMatch.y);
+    lastMatch = match;
+    hx = match.CenterX();
+    hy = match.CenterY();
+  } else if (!primed) {
+    // The capture's buffer is reused, so the previous frame needs a copy of
+    // its own. After this, SyncChanges only rewrites rows that changed.
+    reference.Resize(frame->Width(), frame->Height());
+    for (int row = 0; row < frame->Height(); row++)
+      memcpy(reference.Row(row), frame->Row(row), (size_t)frame->Width() * 4);
+    primed = true;
+  } else {
+    fire = SyncChanges(*frame, reference, hx, hy, kernel);
+  }
+
+  if (fire) {
+    x = trigger.x + hx;
+    y = trigger.y + hy;
+  }
+  return fire;
+}
@@ -0,0 +1,93 @@
+#ifndef PIXELTRIGGER_H
+#define PIXELTRIGGER_H
+
+#include "AutoClicker.h"
+#include "ScreenCapture.h"
+#include "SoftRenderer.h"
+#include "TemplateMatcher.h"
+#include "WorkStealingPool.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+enum class PixelTriggerMode {
+  Off = 0,
+  Color = 1,  // Fire when a pixel of the region comes within tolerance
+  Change = 2, // Fire whenever the region differs from the previous poll
+  Template = 3, // Fire when an image is found in the region; click its centre
+};
+
+// Region and condition watched by PixelWatcher, in screen coordinates.
+struct PixelTrigger {
+  PixelTriggerMode mode = PixelTriggerMode::Off;
+  int x = 0;
+  int y = 0;
+  int width = 1;
+  int height = 1;
+  uint32_t color = 0; // 0xRRGGBB
+  int tolerance = 0;  // Largest difference per channel that still matches
+  std::string templatePath;       // Template: .bmp file
+  double templateThreshold = 0.9; // Template: lowest correlation that counts
+
+  static PixelTrigger FromSettings(const ClickSettings &settings);
+};
+
+// Comparison kernels. They only look at the RGB bytes, read four (SSE2) or
+// eight (AVX2) pixels per instruction and stop at the first hit.
+enum class PixelKernel { Scalar = 0, Sse2 = 1, Avx2 = 2 };
+
+// The fastest kernel this build and CPU can run (checked once).
+PixelKernel BestPixelKernel();
+const char *PixelKernelName(PixelKernel kernel);
+
+// Finds the first pixel, in row-major order, whose R, G and B are each
+// within `tolerance` of `color`. A kernel the CPU lacks is stepped down.
+bool FindColor(const Framebuffer &frame, uint32_t color, int tolerance,
+               int &x, int &y, PixelKernel kernel = BestPixelKernel());
+
+// Finds the first pixel where `frame` differs from `reference` (same size)
+// and brings `reference` up to date: rows before the change are equal and
+// are not written, the rest are copied without comparing further. Unchanged
+// frames therefore cost one read of each buffer and no writes.
+bool SyncChanges(const Framebuffer &frame, Framebuffer &reference, int &x,
+                 int &y, PixelKernel kernel = BestPixelKernel());
+
+// Polls one region of a ScreenSource and decides when to click. Lives on the
+// worker thread that polls it.
+class PixelWatcher {
+public:
+  explicit PixelWatcher(const PixelTrigger &trigger,
+                        PixelKernel kernel = BestPixelKernel());
+  ~PixelWatcher();
+
+  // Reads the template image in template mode; nothing to do otherwise.
+  // The search runs on `pool` (single-threaded if null), which the caller
+  // keeps across watchers and must outlive this one. Call before polling, off
+  // the worker.
+  bool Prepare(WorkStealingPool *pool, std::string &error);
+
+  // Captures the region once. True when the trigger fires, with the screen
+  // position of the pixel responsible in x/y. Color mode fires when a match
+  // appears, not again while it stays. Change mode fires on every poll that
+  // sees a difference; its first poll only takes the reference frame.
+  // Template mode fires when the image appears or moves, with its centre.
+  bool Poll(ScreenSource &source, int &x, int &y);
+
+  const PixelTrigger &GetTrigger() const { return trigger; }
+  // Template mode clicks on what it found rather than at the click position.
+  bool ClicksAtHit() const {
+    return trigger.mode == PixelTriggerMode::Template;
+  }
+
+private:
+  PixelTrigger trigger;
+  PixelKernel kernel;
+  bool primed;   // Change: reference holds the previous frame
+  bool matching; // Color: the last poll matched
+  Framebuffer reference;
+  std::unique_ptr<TemplateMatcher> matcher;
+  TemplateMatch lastMatch;
+};
+
+#endif // PIXELTRIGGER_H
@@ -0,0 +1,267 @@
+#include "RealTime.h"
+
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <avrt.h>
+#include <mmsystem.h>
+#elif defined(__linux__)
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+// Process-wide settings are shared by every active scope.
+std::mutex processLock;
+int processScopes = 0; // Scopes holding the process-wide setting
+bool processApplied = false;
+
+#ifdef __linux__
+// Below what audio servers and IRQ threads usually take, so the clicker can
+// not starve them, but above every normal thread.
+const int kFifoPriority = 49;
+#endif
+
+void AddNote(std::string &notes, const std::string &note) {
+  if (!notes.empty())
+    notes += "; ";
+  notes += note;
+}
+
+} // namespace
+
+std::string RealTimeStatus::Describe() const {
+  if (!active)
+    return "off";
+  std::string s;
+  auto add = [&s](const std::string &part) {
+    if (!s.empty())
+      s += ", ";
+    s += part;
+  };
+  if (cpu >= 0)
+    add("cpu " + std::to_string(cpu));
+#ifdef _WIN32
+  if (priority)
+    add("time-critical");
+  if (multimedia)
+    add("mmcss");
+  if (timerResolution)
+    add("1 ms timer");
+#else
+  if (priority)
+    add("fifo");
+  if (memoryLocked)
+    add("mlock");
+#endif
+  if (s.empty())
+    s = "nothing applied";
+  return s;
+}
+
+RealTimeScope::RealTimeScope() {
+#ifdef _WIN32
+  oldAffinity = 0;
+  oldPriority = 0;
+  mmcss = nullptr;
+#elif defined(__linux__)
+  CPU_ZERO(&oldAffinity);
+  oldPolicy = SCHED_OTHER;
+  oldSchedPriority = 0;
+#endif
+}
+
+RealTimeScope::~RealTimeScope() { Leave(); }
+
+#ifdef _WIN32
+
+RealTimeStatus RealTimeScope::Enter(int cpu) {
+  Leave();
+  status.active = true;
+  HANDLE self = GetCurrentThread();
+
+  DWORD_PTR processMask = 0, systemMask = 0;
+  GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask);
+  if (cpu < 0) {
+    for (int i = (int)sizeof(DWORD_PTR) * 8 - 1; i >= 0 && cpu < 0; i--)
+      if (processMask & ((DWORD_PTR)1 << i))
+        cpu = i;
+  }
+  if (cpu >= 0 && cpu < (int)sizeof(DWORD_PTR) * 8 &&
+      (processMask & ((DWORD_PTR)1 << cpu))) {
+    DWORD_PTR old = SetThreadAffinityMask(self, (DWORD_PTR)1 << cpu);
+    if (old) {
+      oldAffinity = old;
+      status.cpu = cpu;
+    } else {
+      AddNote(status.notes,
+              "affinity: error " + std::to_string(GetLastError()));
+    }
+  } else {
+    AddNote(status.notes, "affinity: cpu " + std::to_string(cpu) +
+                              " not available");
+  }
+
+  // MMCSS boosts the thread through its scheduler service; the explicit
+  // priority below covers systems where that service is stopped.
+  DWORD taskIndex = 0;
+  HANDLE task = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex);
+  if (task) {
+    AvSetMmThreadPriority(task, AVRT_PRIORITY_CRITICAL);
+    mmcss = task;
+    status.multimedia = true;
+  } else {
+    AddNote(status.notes, "mmcss: error " + std::to_string(GetLastError()));
+  }
+
+  oldPriority = GetThreadPriority(self);
+  if (SetThreadPriority(self, THREAD_PRIORITY_TIME_CRITICAL))
+    status.priority = true;
+  else
+    AddNote(status.notes,
+            "priority: error " + std::to_string(GetLastError()));
+
+  {
+    std::lock_guard<std::mutex> guard(processLock);
+    if (!processApplied)
+      processApplied = timeBeginPeriod(1) == TIMERR_NOERROR;
+    if (processApplied) {
+      processScopes++;
+      status.timerResolution = true;
+    } else {
+      AddNote(status.notes, "timeBeginPeriod(1) failed");
+    }
+  }
+  return status;
+}
+
+void RealTimeScope::Leave() {
+  if (!status.active)
+    return;
+  HANDLE self = GetCurrentThread();
+  if (status.priority)
+    SetThreadPriority(self, oldPriority);
+  if (mmcss) {
+    AvRevertMmThreadCharacteristics((HANDLE)mmcss);
+    mmcss = nullptr;
+  }
+  if (status.cpu >= 0)
+    SetThreadAffinityMask(self, (DWORD_PTR)oldAffinity);
+  if (status.timerResolution) {
+    std::lock_guard<std::mutex> guard(processLock);
+    if (--processScopes == 0) {
+      timeEndPeriod(1);
+      processApplied = false;
+    }
+  }
+  status = RealTimeStatus();
+}
+
+#elif defined(__linux__)
+
+// Touches the stack the worker will use, so with memory locked its pages
+// are resident before the first click rather than faulted in during one.
+__attribute__((noinline)) static void PrefaultStack() {
+  volatile unsigned char stack[64 * 1024];
+  for (size_t i = 0; i < sizeof(stack); i += 4096)
+    stack[i] = 0;
+}
+
+RealTimeStatus RealTimeScope::Enter(int cpu) {
+  Leave();
+  status.active = true;
+  pthread_t self = pthread_self();
+
+  int err = pthread_getaffinity_np(self, sizeof(oldAffinity), &oldAffinity);
+  if (err == 0) {
+    if (cpu < 0) {
+      for (int i = CPU_SETSIZE - 1; i >= 0 && cpu < 0; i--)
+        if (CPU_ISSET(i, &oldAffinity))
+          cpu = i;
+    }
+    if (cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &oldAffinity)) {
+      cpu_set_t one;
+      CPU_ZERO(&one);
+      CPU_SET(cpu, &one);
+      err = pthread_setaffinity_np(self, sizeof(one), &one);
+      if (err == 0)
+        status.cpu = cpu;
+    } else {
+      AddNote(status.notes, "affinity: cpu " + std::to_string(cpu) +
+                                " not available");
+    }
+  }
+  if (err)
+    AddNote(status.notes, std::string("affinity: ") + strerror(err));
+
+  sched_param param;
+  err = pthread_getschedparam(self, &oldPolicy, &param);
+  if (err == 0) {
+    oldSchedPriority = param.sched_priority;
+    param.sched_priority = kFifoPriority;
+    err = pthread_setschedparam(self, SCHED_FIFO, &param);
+  }
+  if (err == 0)
+    status.priority = true;
+  else
+    AddNote(status.notes, std::string("SCHED_FIFO: ") + strerror(err));
+
+  {
+    std::lock_guard<std::mutex> guard(processLock);
+    if (!processApplied) {
+      // What is mapped now only. MCL_FUTURE would also pin every later
+      // mapping, such as a replay log the worker maps after this and
+      // releases behind its read position with MADV_DONTNEED, which does not
+      // work on locked pages.
+      if (mlockall(MCL_CURRENT) == 0)
+        processApplied = true;
+      else
+        AddNote(status.notes, std::string("mlockall: ") + strerror(errno));
+    }
+    if (processApplied) {
+      processScopes++;
+      status.memoryLocked = true;
+    }
+  }
+  if (status.memoryLocked)
+    PrefaultStack();
+  return status;
+}
+
+void RealTimeScope::Leave() {
+  if (!status.active)
+    return;
+  pthread_t self = pthread_self();
+  if (status.priority) {
+    sched_param param;
+    param.sched_priority = oldSchedPriority;
+    pthread_setschedparam(self, oldPolicy, &param);
+  }
+  if (status.cpu >= 0)
+    pthread_setaffinity_np(self, sizeof(oldAffinity), &oldAffinity);
+  if (status.memoryLocked) {
+    std::lock_guard<std::mutex> guard(processLock);
+    if (--processScopes == 0) {
+      munlockall();
+      processApplied = false;
+    }
+  }
+  status = RealTimeStatus();
+}
+
+#else
+
+RealTimeStatus RealTimeScope::Enter(int) {
+  status = RealTimeStatus();
+  status.active = true;
+  status.notes = "not supported on this platform";
+  return status;
+}
+
+void RealTimeScope::Leave() { status = RealTimeStatus(); }
+
+#endif
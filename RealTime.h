@@ -0,0 +1,71 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <string>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// What RealTimeScope managed to apply. Every step is tried on its own; one
+// that is denied (no privilege, limit too low) is left out and noted.
+struct RealTimeStatus {
+  bool active = false;          // Enter() was called and Leave() was not
+  int cpu = -1;                 // Pinned to this CPU, -1 if not pinned
+  bool priority = false;        // SCHED_FIFO / THREAD_PRIORITY_TIME_CRITICAL
+  bool multimedia = false;      // Windows: MMCSS "Pro Audio", critical
+  bool timerResolution = false; // Windows: timeBeginPeriod(1)
+  bool memoryLocked = false;    // Linux: mlockall
+  std::string notes;            // Why the steps left out failed
+
+  // One line for logs and the benchmark, e.g. "cpu 3, fifo, mlock".
+  std::string Describe() const;
+};
+
+// Low-latency mode for the calling thread: pins it to one CPU, raises it to
+// real-time priority and keeps the rest of the system from adding to its
+// wake-up latency.
+//
+// Linux: CPU affinity, SCHED_FIFO, and mlockall(MCL_CURRENT) so the pages
+// mapped when the run starts are never faulted in mid-click; later mappings
+// (a replay log) are left alone so they can still be released. Needs root or
+// CAP_SYS_NICE / CAP_IPC_LOCK, or matching rtprio/memlock limits.
+// Windows: affinity mask, THREAD_PRIORITY_TIME_CRITICAL, the MMCSS "Pro
+// Audio" task at critical priority, and a 1 ms system timer resolution.
+// MMCSS needs no privilege; the priority may be capped by the process
+// priority class.
+//
+// Elsewhere Enter() applies nothing and says so.
+//
+// Leave() (or the destructor) restores everything Enter() changed, on the
+// same thread. Memory locking and the timer resolution are process-wide and
+// stay on while any scope is active.
+class RealTimeScope {
+public:
+  RealTimeScope();
+  ~RealTimeScope();
+
+  // `cpu` -1 picks the last CPU the thread may run on, which is the one
+  // least likely to be handling interrupts.
+  RealTimeStatus Enter(int cpu = -1);
+  void Leave();
+
+  const RealTimeStatus &GetStatus() const { return status; }
+
+private:
+  RealTimeScope(const RealTimeScope &) = delete;
+  RealTimeScope &operator=(const RealTimeScope &) = delete;
+
+  RealTimeStatus status;
+#ifdef _WIN32
+  unsigned long long oldAffinity; // DWORD_PTR
+  int oldPriority;
+  void *mmcss; // HANDLE from AvSetMmThreadCharacteristics
+#elif defined(__linux__)
+  cpu_set_t oldAffinity;
+  int oldPolicy;
+  int oldSchedPriority;
+#endif
+};
+
+#endif // REALTIME_H
@@ -0,0 +1,159 @@
+#include "RenderLoop.h"
+#include "Clock.h"
+
+RenderLoop::RenderLoop()
+    : readySlot(1), back(0), front(2), hasFront(false), running(false),
+      rate(60), width(1), height(1), frameCount(0), missedFrames(0),
+      animated(true), redraw(true) {}
+
+RenderLoop::~RenderLoop() { Stop(); }
+
+int RenderLoop::ClampRate(int rateHz) {
+  if (rateHz < 45)
+    return 30;
+  if (rateHz < 90)
+    return 60;
+  return 120;
+}
+
+void RenderLoop::Start(int rateHz, ComposeFn composeFn, ReadyFn readyFn) {
+  if (running)
+    return;
+  if (thread.joinable())
+    thread.join();
+
+  compose = composeFn;
+  onReady = readyFn;
+  rate = ClampRate(rateHz);
+  frameCount = 0;
+  missedFrames = 0;
+  frameTime.Reset();
+  lateness.Reset();
+  redraw = true;
+  running = true;
+  thread = std::thread(&RenderLoop::Run, this);
+}
+
+void RenderLoop::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    running = false;
+  }
+  wake.notify_one();
+  if (thread.joinable())
+    thread.join();
+}
+
+void RenderLoop::SetRate(int rateHz) { rate = ClampRate(rateHz); }
+
+void RenderLoop::SetSize(int w, int h) {
+  width = w > 0 ? w : 1;
+  height = h > 0 ? h : 1;
+  RequestFrame();
+}
+
+void RenderLoop::SetAnimated(bool on) {
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    animated = on;
+    redraw = true;
+  }
+  wake.notify_one();
+}
+
+void RenderLoop::RequestFrame() {
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    redraw = true;
+  }
+  wake.notify_one();
+}
+
+const RenderFrame *RenderLoop::AcquireFrame(bool *fresh) {
+  bool taken = false;
+  if (readySlot.load(std::memory_order_acquire) & kFresh) {
+    front = readySlot.exchange(front, std::memory_order_acq_rel) & 3;
+    hasFront = true;
+    taken = true;
+  }
+  if (fresh)
+    *fresh = taken;
+  return hasFront ? &frames[front] : nullptr;
+}
+
+const RenderFrame *RenderLoop::FrontFrame() const {
+  return hasFront ? &frames[front] : nullptr;
+}
+
+RenderStats RenderLoop::GetStats() const {
+  RenderStats s;
+  s.rateHz = rate.load();
+  s.frames = frameCount.load(std::memory_order_relaxed);
+  s.missedFrames = missedFrames.load(std::memory_order_relaxed);
+  s.frameTime = frameTime.Snapshot();
+  s.lateness = lateness.Snapshot();
+  return s;
+}
+
+void RenderLoop::Run() {
+  int currentRate = rate.load();
+  int64_t periodNs = 1000000000LL / currentRate;
+  int64_t deadline = Clock::NowNs();
+  int64_t lastNs = 0;
+
+  while (running.load(std::memory_order_relaxed)) {
+    {
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      if (!animated && !redraw) {
+        wake.wait(lock, [this] { return !running || animated || redraw; });
+        // Time spent parked is neither simulated nor missed.
+        deadline = Clock::NowNs();
+        lastNs = 0;
+      }
+      redraw = false;
+    }
+    if (!running.load(std::memory_order_relaxed))
+      break;
+    Clock::SleepUntilNs(deadline);
+
+    const int64_t start = Clock::NowNs();
+    lateness.Record(start > deadline ? start - deadline : 0);
+    const double seconds = lastNs ? (start - lastNs) / 1e9 : periodNs / 1e9;
+    lastNs = start;
+
+    RenderFrame &frame = frames[back];
+    const int w = width.load(), h = height.load();
+    frame.pixels.Resize(w, h);
+    if (frame.dirty.Width() != w || frame.dirty.Height() != h)
+      frame.dirty.Resize(w, h);
+    else
+      frame.dirty.Clear();
+    compose(frame, seconds, currentRate);
+
+    const uint64_t n = frameCount.load(std::memory_order_relaxed) + 1;
+    frame.sequence = n;
+    frameTime.Record(Clock::NowNs() - start);
+    frameCount.store(n, std::memory_order_relaxed);
+
+    // Publish; whatever was in the ready slot (taken or not) is ours now.
+    back = readySlot.exchange(back | kFresh, std::memory_order_acq_rel) & 3;
+    if (onReady)
+      onReady();
+
+    const int newRate = rate.load();
+    if (newRate != currentRate) {
+      currentRate = newRate;
+      periodNs = 1000000000LL / currentRate;
+    }
+    // Next deadline; skip the ones this frame overran.
+    deadline += periodNs;
+    const int64_t now = Clock::NowNs();
+    if (now >= deadline) {
+      const int64_t missed = (now - deadline) / periodNs + 1;
+      missedFrames.store(missedFrames.load(std::memory_order_relaxed) +
+                             missed,
+                         std::memory_order_relaxed);
+      deadline += missed * periodNs;
+    }
+  }
+}
@@ -0,0 +1,106 @@
+#ifndef RENDERLOOP_H
+#define RENDERLOOP_H
+
+#include "DirtyRegion.h"
+#include "LatencyHistogram.h"
+#include "SoftRenderer.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// One composed frame. `dirty` is what changed since the previous frame.
+struct RenderFrame {
+  Framebuffer pixels;
+  DirtyRegion dirty;
+  uint64_t sequence = 0; // 1 for the first frame, +1 per frame
+};
+
+struct RenderStats {
+  int rateHz = 0;
+  uint64_t frames = 0;
+  uint64_t missedFrames = 0; // Deadlines that passed without a frame
+  LatencySnapshot frameTime; // Time to compose each frame
+  LatencySnapshot lateness;  // Wake-up lateness against each deadline
+};
+
+// Composes frames on its own thread at a fixed rate, independent of the UI
+// message loop, and hands them over through a triple buffer: the render
+// thread always has a free buffer to draw into and the consumer always has
+// the newest finished frame, so neither ever waits for the other.
+//
+// Frames are paced by sleeping to absolute deadlines (Clock::SleepUntilNs,
+// never spinning: a background does not need sub-millisecond accuracy). A
+// frame that runs long drops the deadlines it overran instead of bunching
+// frames up afterwards. While not animated the thread parks and composes
+// only when woken by SetSize() or SetAnimated().
+class RenderLoop {
+public:
+  // Advances by `seconds`, draws the full frame into frame.pixels (already
+  // sized) and marks frame.dirty (already cleared). Runs on the render thread.
+  typedef std::function<void(RenderFrame &frame, double seconds, int rateHz)>
+      ComposeFn;
+  // Called on the render thread after each frame is published.
+  typedef std::function<void()> ReadyFn;
+
+  RenderLoop();
+  ~RenderLoop();
+
+  void Start(int rateHz, ComposeFn compose, ReadyFn ready);
+  void Stop();
+  bool IsRunning() const { return running.load(); }
+
+  // All take effect at the next frame; safe from any thread.
+  void SetRate(int rateHz);
+  void SetSize(int width, int height); // Also composes one frame if parked
+  // False parks the thread after one more frame (a static background needs
+  // only that one); true resumes pacing. Animated until told otherwise.
+  void SetAnimated(bool animated);
+
+  // Consumer side; call from a single thread. Makes the newest finished
+  // frame the front frame and returns it, or nullptr before the first frame.
+  // `fresh` is set when it is a frame the consumer has not seen.
+  const RenderFrame *AcquireFrame(bool *fresh = nullptr);
+  // The front frame from the last AcquireFrame(), or nullptr.
+  const RenderFrame *FrontFrame() const;
+
+  // Lock-free; does not disturb the render thread.
+  RenderStats GetStats() const;
+
+  // Supported rates are 30, 60 and 120 Hz; anything else picks the nearest.
+  static int ClampRate(int rateHz);
+
+private:
+  void Run();
+  void RequestFrame();
+
+  static const int kFresh = 4; // Flag in readySlot: published, not yet taken
+
+  RenderFrame frames[3];
+  std::atomic<int> readySlot; // Slot index, | kFresh
+  int back;                   // Owned by the render thread
+  int front;                  // Owned by the consumer
+  bool hasFront;
+
+  std::atomic<bool> running;
+  std::atomic<int> rate;
+  std::atomic<int> width;
+  std::atomic<int> height;
+  std::atomic<uint64_t> frameCount;
+  std::atomic<uint64_t> missedFrames;
+  ComposeFn compose;
+  ReadyFn onReady;
+  LatencyHistogram frameTime;
+  LatencyHistogram lateness;
+
+  // Parking: the thread waits on `wake` while !animated && !redraw.
+  std::mutex wakeMutex;
+  std::condition_variable wake;
+  bool animated;
+  bool redraw; // Compose one frame even though not animated
+  std::thread thread;
+};
+
+#endif // RENDERLOOP_H
@@ -0,0 +1,115 @@
+#include "ScreenCapture.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#ifdef _WIN32
+
+Win32ScreenSource::Win32ScreenSource()
+    : screenDc(GetDC(NULL)), memoryDc(NULL), bitmap(NULL), oldBitmap(NULL),
+      bits(nullptr), bitmapWidth(0), bitmapHeight(0) {
+  if (screenDc)
+    memoryDc = CreateCompatibleDC((HDC)screenDc);
+}
+
+Win32ScreenSource::~Win32ScreenSource() {
+  if (bitmap) {
+    SelectObject((HDC)memoryDc, (HGDIOBJ)oldBitmap);
+    DeleteObject((HBITMAP)bitmap);
+  }
+  if (memoryDc)
+    DeleteDC((HDC)memoryDc);
+  if (screenDc)
+    ReleaseDC(NULL, (HDC)screenDc);
+}
+
+const Framebuffer *Win32ScreenSource::Capture(int x, int y, int w, int h) {
+  if (!memoryDc || w <= 0 || h <= 0)
+    return nullptr;
+
+  if (w > bitmapWidth || h > bitmapHeight) {
+    if (bitmap) {
+      SelectObject((HDC)memoryDc, (HGDIOBJ)oldBitmap);
+      DeleteObject((HBITMAP)bitmap);
+      bitmap = NULL;
+      bits = nullptr;
+    }
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = w;
+    bmi.bmiHeader.biHeight = -h; // Top-down, like Framebuffer
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    void *memory = nullptr;
+    HBITMAP dib = CreateDIBSection((HDC)memoryDc, &bmi, DIB_RGB_COLORS,
+                                   &memory, NULL, 0);
+    if (!dib) {
+      bitmapWidth = bitmapHeight = 0;
+      return nullptr;
+    }
+    bitmap = dib;
+    bits = (uint32_t *)memory;
+    oldBitmap = SelectObject((HDC)memoryDc, dib);
+    bitmapWidth = w;
+    bitmapHeight = h;
+  }
+
+  if (!BitBlt((HDC)memoryDc, 0, 0, w, h, (HDC)screenDc, x, y, SRCCOPY))
+    return nullptr;
+  GdiFlush(); // BitBlt may still be queued; the bits are read right after.
+  frame.Attach(bits, w, h, bitmapWidth);
+  return &frame;
+}
+
+#endif // _WIN32
+
+SyntheticScreenSource::SyntheticScreenSource(int width, int height)
+    : screen(width, height) {
+  FillRect(screen, 0, 0, width, height, PackColor(0, 0, 0));
+}
+
+const Framebuffer *SyntheticScreenSource::Capture(int x, int y, int w, int h) {
+  if (w <= 0 || h <= 0)
+    return nullptr;
+  frame.Resize(w, h);
+
+  std::lock_guard<std::mutex> guard(lock);
+  // Whatever lies outside the screen reads as black, as with BitBlt.
+  for (int row = 0; row < h; row++) {
+    uint32_t *dst = frame.Row(row);
+    const int sy = y + row;
+    if (sy < 0 || sy >= screen.Height()) {
+      memset(dst, 0, (size_t)w * 4);
+      continue;
+    }
+    int left = x < 0 ? -x : 0;
+    if (left > w)
+      left = w;
+    int right = x + w > screen.Width() ? screen.Width() - x : w;
+    if (right < left)
+      right = left;
+    memset(dst, 0, (size_t)left * 4);
+    if (right > left)
+      memcpy(dst + left, screen.Row(sy) + x + left,
+             (size_t)(right - left) * 4);
+    memset(dst + right, 0, (size_t)(w - right) * 4);
+  }
+  return &frame;
+}
+
+void SyntheticScreenSource::Paint(int x, int y, int w, int h, uint32_t color) {
+  std::lock_guard<std::mutex> guard(lock);
+  FillRect(screen, x, y, w, h, color);
+}
+
+std::unique_ptr<ScreenSource> CreateDefaultScreenSource() {
+#ifdef _WIN32
+  return std::unique_ptr<ScreenSource>(new Win32ScreenSource());
+#else
+  return nullptr;
+#endif
+}
@@ -0,0 +1,75 @@
+#ifndef SCREENCAPTURE_H
+#define SCREENCAPTURE_H
+
+#include "SoftRenderer.h"
+
+#include <memory>
+#include <mutex>
+
+// Where the pixel trigger reads the screen from. Implementations are only
+// called from the worker thread that polls them.
+class ScreenSource {
+public:
+  virtual ~ScreenSource() {}
+
+  virtual const char *Name() const = 0;
+
+  // Grabs the w x h rectangle whose top-left corner is at screen (x, y).
+  // The returned frame is owned by the source and stays valid until the next
+  // Capture(). Only the RGB bytes are meaningful: BitBlt leaves alpha
+  // undefined. nullptr if the capture failed.
+  virtual const Framebuffer *Capture(int x, int y, int w, int h) = 0;
+};
+
+#ifdef _WIN32
+
+// BitBlt from the screen DC into a DIB section that is kept across captures
+// and only recreated when the rectangle grows. The returned frame points
+// straight into the DIB section, so there is no copy after BitBlt.
+class Win32ScreenSource : public ScreenSource {
+public:
+  Win32ScreenSource();
+  ~Win32ScreenSource() override;
+
+  const char *Name() const override { return "win32"; }
+  const Framebuffer *Capture(int x, int y, int w, int h) override;
+
+private:
+  // HDC / HBITMAP / HGDIOBJ, kept opaque so this header stays free of
+  // <windows.h>.
+  void *screenDc;
+  void *memoryDc;
+  void *bitmap;
+  void *oldBitmap;
+  uint32_t *bits;
+  int bitmapWidth;
+  int bitmapHeight;
+  Framebuffer frame;
+};
+
+#endif
+
+// An in-memory "screen" for tests and benchmarks on any platform. Another
+// thread draws into it with Paint(); Capture() copies the rectangle out like
+// BitBlt would.
+class SyntheticScreenSource : public ScreenSource {
+public:
+  SyntheticScreenSource(int width = 1920, int height = 1080);
+
+  const char *Name() const override { return "synthetic"; }
+  const Framebuffer *Capture(int x, int y, int w, int h) override;
+
+  // Fills a rectangle of the screen. Safe while another thread captures.
+  void Paint(int x, int y, int w, int h, uint32_t color);
+
+private:
+  std::mutex lock;
+  Framebuffer screen;
+  Framebuffer frame;
+};
+
+// Win32 capture on Windows. Elsewhere there is no built-in screen capture
+// and this returns nullptr; use a SyntheticScreenSource.
+std::unique_ptr<ScreenSource> CreateDefaultScreenSource();
+
+#endif // SCREENCAPTURE_H
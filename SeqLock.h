@@ -0,0 +1,74 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Publishes a trivially copyable value from one writer to readers that must
+// never block it, e.g. settings read by the click worker every tick.
+//
+// The writer makes the sequence odd, stores the value and makes it even
+// again; a reader copies the value between two reads of the sequence and
+// retries if they differ or are odd, so it never returns a mix of two
+// stores. The value is kept in atomic words, which makes the reader's racy
+// copy well defined. Readers write no shared memory.
+template <typename T> class SeqLock {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SeqLock copies T word by word");
+
+public:
+  SeqLock() : sequence(0) {
+    for (size_t i = 0; i < kWords; i++)
+      words[i].store(0, std::memory_order_relaxed);
+  }
+  explicit SeqLock(const T &value) : SeqLock() { Store(value); }
+
+  // Writers must be serialized by the caller.
+  void Store(const T &value) {
+    uint64_t buffer[kWords] = {};
+    memcpy(buffer, &value, sizeof(T));
+
+    const uint32_t seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWords; i++)
+      words[i].store(buffer[i], std::memory_order_relaxed);
+    sequence.store(seq + 2, std::memory_order_release);
+  }
+
+  // Changes with every completed Store(). One load, so cheap enough to poll
+  // per tick; compare with what Load() returned to see if there is news.
+  uint32_t Version() const { return sequence.load(std::memory_order_acquire); }
+
+  // Copies the latest complete value into `out` and returns its version.
+  // Spins only while a Store() is in progress.
+  uint32_t Load(T &out) const {
+    uint64_t buffer[kWords];
+    for (;;) {
+      const uint32_t before = sequence.load(std::memory_order_acquire);
+      if (before & 1)
+        continue;
+      for (size_t i = 0; i < kWords; i++)
+        buffer[i] = words[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence.load(std::memory_order_relaxed) == before) {
+        memcpy(&out, buffer, sizeof(T));
+        return before;
+      }
+    }
+  }
+
+private:
+  SeqLock(const SeqLock &) = delete;
+  SeqLock &operator=(const SeqLock &) = delete;
+
+  static const size_t kWords = (sizeof(T) + 7) / 8;
+
+  std::atomic<uint32_t> sequence;
+  std::atomic<uint64_t> words[kWords];
+};
+
+#endif // SEQLOCK_H
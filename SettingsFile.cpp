@@ -0,0 +1,336 @@
+#include "SettingsFile.h"
+
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+const char kMagic[4] = {'A', 'C', 'S', 'T'};
+
+// Field tags are part of the file format: never renumber or reuse one.
+struct FieldDesc {
+  uint16_t tag;
+  uint16_t size;
+  size_t offset;
+};
+
+#define SETTINGS_FIELD(tag, member)                                            \
+  {tag, (uint16_t)sizeof(ClickSettings::member), offsetof(ClickSettings, member)}
+
+const FieldDesc kFields[] = {
+    SETTINGS_FIELD(1, intervalMs),    SETTINGS_FIELD(2, isLeftClick),
+    SETTINGS_FIELD(3, fixedPosition), SETTINGS_FIELD(4, x),
+    SETTINGS_FIELD(5, y),             SETTINGS_FIELD(6, themeIndex),
+    SETTINGS_FIELD(7, hotkeyVk),      SETTINGS_FIELD(8, hotkeyMod),
+    SETTINGS_FIELD(9, intervalUs),    SETTINGS_FIELD(10, missPolicy),
+    SETTINGS_FIELD(11, burstMode),    SETTINGS_FIELD(12, frameRateHz),
+    SETTINGS_FIELD(13, intervalDistribution),
+    SETTINGS_FIELD(14, intervalSpreadUs),
+    SETTINGS_FIELD(15, positionDistribution),
+    SETTINGS_FIELD(16, positionSpreadPx),
+    SETTINGS_FIELD(17, intervalHistogram),
+    SETTINGS_FIELD(18, positionHistogram),
+    SETTINGS_FIELD(19, triggerMode),
+    SETTINGS_FIELD(20, triggerX),
+    SETTINGS_FIELD(21, triggerY),
+    SETTINGS_FIELD(22, triggerWidth),
+    SETTINGS_FIELD(23, triggerHeight),
+    SETTINGS_FIELD(24, triggerColor),
+    SETTINGS_FIELD(25, triggerTolerance),
+    SETTINGS_FIELD(26, triggerPollHz),
+    SETTINGS_FIELD(27, templateImage),
+    SETTINGS_FIELD(28, templateThreshold),
+    SETTINGS_FIELD(29, realTime),
+    SETTINGS_FIELD(30, realTimeCpu),
+    SETTINGS_FIELD(31, controlServer),
+    SETTINGS_FIELD(32, altHotkeyVk),
+    SETTINGS_FIELD(33, altHotkeyMod),
+};
+
+#undef SETTINGS_FIELD
+
+uint32_t Crc32(const void *data, size_t size) {
+  static uint32_t table[256];
+  static bool init = [] {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++)
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    }
+    return true;
+  }();
+  (void)init;
+
+  uint32_t crc = 0xFFFFFFFFu;
+  const uint8_t *p = (const uint8_t *)data;
+  for (size_t i = 0; i < size; i++)
+    crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+  return crc ^ 0xFFFFFFFFu;
+}
+
+uint32_t HashName(const char *name, size_t length) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    h ^= (uint8_t)name[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+template <typename T> void Append(std::string &out, const T &value) {
+  out.append((const char *)&value, sizeof(T));
+}
+
+} // namespace
+
+std::string EncodeSettingsRecord(const ClickSettings &settings) {
+  std::string out;
+  for (const FieldDesc &f : kFields) {
+    Append(out, f.tag);
+    Append(out, f.size);
+    out.append((const char *)&settings + f.offset, f.size);
+  }
+  return out;
+}
+
+std::string EncodeSettingsChanges(const ClickSettings &base,
+                                  const ClickSettings &settings) {
+  std::string out;
+  for (const FieldDesc &f : kFields) {
+    const char *field = (const char *)&settings + f.offset;
+    if (memcmp(field, (const char *)&base + f.offset, f.size) == 0)
+      continue;
+    Append(out, f.tag);
+    Append(out, f.size);
+    out.append(field, f.size);
+  }
+  return out;
+}
+
+bool ApplySettingsRecord(const uint8_t *data, size_t size,
+                         ClickSettings &settings) {
+  ClickSettings s = settings;
+  size_t pos = 0;
+  while (pos + 4 <= size) {
+    uint16_t tag, length;
+    memcpy(&tag, data + pos, 2);
+    memcpy(&length, data + pos + 2, 2);
+    pos += 4;
+    if (pos + length > size)
+      return false;
+
+    for (const FieldDesc &f : kFields) {
+      // A field whose size changed is treated like an unknown one.
+      if (f.tag == tag && f.size == length) {
+        memcpy((char *)&s + f.offset, data + pos, length);
+        break;
+      }
+    }
+    pos += length;
+  }
+  if (pos != size)
+    return false;
+  settings = s;
+  return true;
+}
+
+bool DecodeSettingsRecord(const uint8_t *data, size_t size,
+                          ClickSettings &settings) {
+  ClickSettings s;
+  if (!ApplySettingsRecord(data, size, s))
+    return false;
+  settings = s;
+  return true;
+}
+
+bool WriteSettingsFile(const std::string &path,
+                       const std::vector<SettingsProfileRecord> &profiles,
+                       const std::string &activeProfile) {
+  const uint32_t count = (uint32_t)profiles.size();
+  uint32_t tableSize = 8;
+  while (tableSize < count * 2)
+    tableSize *= 2;
+
+  SettingsFileHeader header = {};
+  memcpy(header.magic, kMagic, 4);
+  header.version = kSettingsFileVersion;
+  header.headerSize = sizeof(SettingsFileHeader);
+  header.profileCount = count;
+  header.activeProfile = 0;
+  header.indexOffset = sizeof(SettingsFileHeader);
+  header.tableOffset = header.indexOffset + count * sizeof(SettingsFileEntry);
+  header.tableSize = tableSize;
+
+  std::vector<SettingsFileEntry> entries(count);
+  std::vector<uint32_t> table(tableSize, 0);
+  std::string blob;
+  const uint32_t blobOffset = header.tableOffset + tableSize * 4;
+
+  for (uint32_t i = 0; i < count; i++) {
+    const SettingsProfileRecord &p = profiles[i];
+    if (p.name.size() > UINT16_MAX || p.record.size() > UINT16_MAX)
+      return false;
+
+    SettingsFileEntry &e = entries[i];
+    e.nameHash = HashName(p.name.data(), p.name.size());
+    e.nameLength = (uint16_t)p.name.size();
+    e.nameOffset = blobOffset + (uint32_t)blob.size();
+    blob += p.name;
+    e.recordLength = (uint16_t)p.record.size();
+    e.recordOffset = blobOffset + (uint32_t)blob.size();
+    e.recordChecksum = Crc32(p.record.data(), p.record.size());
+    blob += p.record;
+
+    uint32_t slot = e.nameHash & (tableSize - 1);
+    while (table[slot] != 0)
+      slot = (slot + 1) & (tableSize - 1);
+    table[slot] = i + 1;
+
+    if (p.name == activeProfile)
+      header.activeProfile = i;
+  }
+
+  std::string meta;
+  meta.append((const char *)entries.data(),
+              entries.size() * sizeof(SettingsFileEntry));
+  meta.append((const char *)table.data(), table.size() * 4);
+  header.checksum = Crc32(meta.data(), meta.size());
+  header.fileSize = blobOffset + (uint32_t)blob.size();
+
+  std::string out;
+  out.reserve(header.fileSize);
+  Append(out, header);
+  out += meta;
+  out += blob;
+  return WriteFileAtomic(path, out.data(), out.size());
+}
+
+SettingsFile::Status SettingsFile::Open(const std::string &path) {
+  Close();
+  if (!file.Open(path))
+    return Missing;
+
+  const uint8_t *data = file.Data();
+  const size_t size = file.Size();
+  if (size < 4 || memcmp(data, kMagic, 4) != 0) {
+    if (size <= sizeof(ClickSettings))
+      return Legacy; // Stays mapped for ReadLegacy()
+    Close();
+    return Corrupt;
+  }
+
+  if (size < sizeof(SettingsFileHeader)) {
+    Close();
+    return Corrupt;
+  }
+  memcpy(&header, data, sizeof(header));
+
+  // Newer writers keep the same header prefix and may grow it.
+  const uint64_t indexEnd =
+      (uint64_t)header.indexOffset +
+      (uint64_t)header.profileCount * sizeof(SettingsFileEntry);
+  const uint64_t tableEnd = (uint64_t)header.tableOffset + header.tableSize * 4ull;
+  bool ok = header.headerSize >= sizeof(SettingsFileHeader) &&
+            header.fileSize == size && header.indexOffset >= header.headerSize &&
+            indexEnd == header.tableOffset && tableEnd <= size &&
+            header.tableSize > 0 &&
+            (header.tableSize & (header.tableSize - 1)) == 0 &&
+            header.tableSize >= header.profileCount &&
+            (header.profileCount == 0 ||
+             header.activeProfile < header.profileCount) &&
+            Crc32(data + header.indexOffset,
+                  (size_t)(tableEnd - header.indexOffset)) == header.checksum;
+
+  for (size_t i = 0; ok && i < header.profileCount; i++) {
+    const SettingsFileEntry *e = GetEntry(i);
+    ok = (uint64_t)e->nameOffset + e->nameLength <= size &&
+         (uint64_t)e->recordOffset + e->recordLength <= size;
+  }
+  if (!ok) {
+    Close();
+    return Corrupt;
+  }
+  return Ok;
+}
+
+void SettingsFile::Close() {
+  file.Close();
+  header = SettingsFileHeader();
+}
+
+size_t SettingsFile::GetProfileCount() const {
+  return file.IsOpen() ? header.profileCount : 0;
+}
+
+const SettingsFileEntry *SettingsFile::GetEntry(size_t index) const {
+  return (const SettingsFileEntry *)(file.Data() + header.indexOffset) + index;
+}
+
+std::string SettingsFile::GetProfileName(size_t index) const {
+  if (index >= GetProfileCount())
+    return std::string();
+  const SettingsFileEntry *e = GetEntry(index);
+  return std::string((const char *)file.Data() + e->nameOffset, e->nameLength);
+}
+
+bool SettingsFile::GetProfileRecord(size_t index,
+                                    SettingsProfileRecord &out) const {
+  if (index >= GetProfileCount())
+    return false;
+  const SettingsFileEntry *e = GetEntry(index);
+  const uint8_t *record = file.Data() + e->recordOffset;
+  if (Crc32(record, e->recordLength) != e->recordChecksum)
+    return false;
+  out.name = GetProfileName(index);
+  out.record.assign((const char *)record, e->recordLength);
+  return true;
+}
+
+std::string SettingsFile::GetActiveProfileName() const {
+  return GetProfileName(header.activeProfile);
+}
+
+int SettingsFile::FindEntry(const std::string &name) const {
+  if (GetProfileCount() == 0)
+    return -1;
+  const uint32_t hash = HashName(name.data(), name.size());
+  const uint32_t *table =
+      (const uint32_t *)(file.Data() + header.tableOffset);
+  const uint32_t mask = header.tableSize - 1;
+
+  for (uint32_t probe = 0, slot = hash & mask; probe < header.tableSize;
+       probe++, slot = (slot + 1) & mask) {
+    uint32_t index = table[slot];
+    if (index == 0)
+      return -1;
+    if (index > header.profileCount)
+      return -1; // Damaged table
+    const SettingsFileEntry *e = GetEntry(index - 1);
+    if (e->nameHash == hash && e->nameLength == name.size() &&
+        memcmp(file.Data() + e->nameOffset, name.data(), name.size()) == 0)
+      return (int)(index - 1);
+  }
+  return -1;
+}
+
+bool SettingsFile::FindProfile(const std::string &name,
+                               ClickSettings &out) const {
+  int index = FindEntry(name);
+  if (index < 0)
+    return false;
+  const SettingsFileEntry *e = GetEntry((size_t)index);
+  const uint8_t *record = file.Data() + e->recordOffset;
+  if (Crc32(record, e->recordLength) != e->recordChecksum)
+    return false;
+  return DecodeSettingsRecord(record, e->recordLength, out);
+}
+
+bool SettingsFile::ReadLegacy(ClickSettings &out) const {
+  if (!file.IsOpen() || file.Size() > sizeof(ClickSettings))
+    return false;
+  ClickSettings s;
+  memcpy(&s, file.Data(), file.Size());
+  out = s;
+  return true;
+}
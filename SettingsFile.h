@@ -0,0 +1,98 @@
+#ifndef SETTINGSFILE_H
+#define SETTINGSFILE_H
+
+#include "AutoClicker.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// settings.dat layout (little endian, offsets from the start of the file):
+//
+//   SettingsFileHeader
+//   SettingsFileEntry[profileCount]   profile index
+//   uint32_t[tableSize]               open-addressed name hash table,
+//                                     entry index + 1 (0 = empty)
+//   names and records                 records are tag/length/value fields
+//
+// The header checksum covers the index and hash table; every record has its
+// own checksum, so looking up one profile only touches that profile's bytes.
+// Unknown tags are skipped and missing tags keep their defaults, so fields
+// can be added to ClickSettings without breaking older or newer files.
+
+const uint16_t kSettingsFileVersion = 1;
+
+struct SettingsFileHeader {
+  char magic[4]; // "ACST"
+  uint16_t version;
+  uint16_t headerSize;
+  uint32_t fileSize;
+  uint32_t checksum; // CRC-32 of the index and hash table
+  uint32_t profileCount;
+  uint32_t activeProfile;
+  uint32_t indexOffset;
+  uint32_t tableOffset;
+  uint32_t tableSize; // Power of two, at least 2 * profileCount
+  uint32_t reserved;
+};
+
+struct SettingsFileEntry {
+  uint32_t nameHash; // FNV-1a
+  uint32_t nameOffset;
+  uint32_t recordOffset;
+  uint32_t recordChecksum;
+  uint16_t nameLength;
+  uint16_t recordLength;
+};
+
+// A profile's encoded field record, ready to be written without re-encoding.
+struct SettingsProfileRecord {
+  std::string name;
+  std::string record;
+};
+
+std::string EncodeSettingsRecord(const ClickSettings &settings);
+bool DecodeSettingsRecord(const uint8_t *data, size_t size,
+                          ClickSettings &settings);
+// Only the fields where `settings` differs from `base`, in the same format.
+std::string EncodeSettingsChanges(const ClickSettings &base,
+                                  const ClickSettings &settings);
+// Like DecodeSettingsRecord, but fields missing from the record keep their
+// value in `settings` instead of the default. Unchanged on failure.
+bool ApplySettingsRecord(const uint8_t *data, size_t size,
+                         ClickSettings &settings);
+
+// Serializes the profiles and writes them with WriteFileAtomic().
+bool WriteSettingsFile(const std::string &path,
+                       const std::vector<SettingsProfileRecord> &profiles,
+                       const std::string &activeProfile);
+
+// Memory-mapped reader. Profile lookups by name are O(1).
+class SettingsFile {
+public:
+  enum Status { Ok, Missing, Legacy, Corrupt };
+
+  Status Open(const std::string &path);
+  void Close();
+
+  size_t GetProfileCount() const;
+  std::string GetProfileName(size_t index) const;
+  // Raw encoded record, e.g. to copy unchanged profiles into a new file.
+  bool GetProfileRecord(size_t index, SettingsProfileRecord &out) const;
+  std::string GetActiveProfileName() const;
+
+  // False if the profile does not exist or its record is damaged.
+  bool FindProfile(const std::string &name, ClickSettings &out) const;
+
+  // Pre-versioning files are a raw ClickSettings dump.
+  bool ReadLegacy(ClickSettings &out) const;
+
+private:
+  const SettingsFileEntry *GetEntry(size_t index) const;
+  int FindEntry(const std::string &name) const;
+
+  MappedFile file;
+  SettingsFileHeader header = {};
+};
+
+#endif // SETTINGSFILE_H
@@ -0,0 +1,202 @@
+#include "SettingsStore.h"
+
+#include <chrono>
+#include <cstdio>
+#include <set>
+
+const char *const SettingsStore::kDefaultProfile = "Default";
+
+SettingsStore::SettingsStore(const std::string &settingsPath)
+    : path(settingsPath), activeProfile(kDefaultProfile), dirty(false),
+      stopping(false), diskReads(0), diskWrites(0) {}
+
+SettingsStore::~SettingsStore() { Shutdown(); }
+
+void SettingsStore::Load() {
+  std::lock_guard<std::mutex> diskLock(diskMutex);
+  ClickSettings s;
+  std::string active = kDefaultProfile;
+  bool migrate = false;
+
+  diskReads++;
+  switch (file.Open(path)) {
+  case SettingsFile::Ok:
+    if (!file.GetActiveProfileName().empty())
+      active = file.GetActiveProfileName();
+    file.FindProfile(active, s);
+    break;
+  case SettingsFile::Legacy:
+    file.ReadLegacy(s);
+    file.Close();
+    migrate = true;
+    break;
+  case SettingsFile::Corrupt: {
+    // Keep the damaged file for inspection instead of overwriting it.
+    std::string aside = path + ".corrupt";
+    remove(aside.c_str());
+    rename(path.c_str(), aside.c_str());
+  } break;
+  case SettingsFile::Missing:
+    break;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  settings = s;
+  activeProfile = active;
+  unsaved.clear();
+  dirty = migrate;
+  if (migrate)
+    unsaved[active] = s;
+}
+
+ClickSettings SettingsStore::Get() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return settings;
+}
+
+void SettingsStore::Set(const ClickSettings &newSettings) {
+  ClickSettings oldSettings;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    oldSettings = settings;
+    settings = newSettings;
+    unsaved[activeProfile] = newSettings;
+    dirty = true;
+    if (!writer.joinable() && !stopping)
+      writer = std::thread(&SettingsStore::WriterThread, this);
+  }
+  cv.notify_all();
+  Notify(oldSettings, newSettings);
+}
+
+void SettingsStore::Notify(const ClickSettings &oldSettings,
+                           const ClickSettings &newSettings) {
+  std::vector<Listener> toNotify;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    toNotify = listeners;
+  }
+  for (auto &listener : toNotify)
+    listener(oldSettings, newSettings);
+}
+
+void SettingsStore::AddListener(Listener listener) {
+  std::lock_guard<std::mutex> lock(mutex);
+  listeners.push_back(std::move(listener));
+}
+
+std::string SettingsStore::GetActiveProfile() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return activeProfile;
+}
+
+std::vector<std::string> SettingsStore::GetProfileNames() const {
+  std::set<std::string> names;
+  {
+    std::lock_guard<std::mutex> diskLock(diskMutex);
+    for (size_t i = 0; i < file.GetProfileCount(); i++)
+      names.insert(file.GetProfileName(i));
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    names.insert(activeProfile);
+    for (auto &p : unsaved)
+      names.insert(p.first);
+  }
+  return std::vector<std::string>(names.begin(), names.end());
+}
+
+void SettingsStore::SwitchProfile(const std::string &name) {
+  ClickSettings oldSettings;
+  ClickSettings newSettings;
+  {
+    std::lock_guard<std::mutex> diskLock(diskMutex);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (name == activeProfile)
+      return;
+    oldSettings = settings;
+    newSettings = settings;
+
+    auto it = unsaved.find(name);
+    if (it != unsaved.end()) {
+      newSettings = it->second;
+    } else if (!file.FindProfile(name, newSettings)) {
+      unsaved[name] = newSettings; // New profile
+    }
+    settings = newSettings;
+    activeProfile = name;
+    dirty = true; // The active profile is recorded in the file header
+    if (!writer.joinable() && !stopping)
+      writer = std::thread(&SettingsStore::WriterThread, this);
+  }
+  cv.notify_all();
+  Notify(oldSettings, newSettings);
+}
+
+void SettingsStore::Flush() {
+  std::lock_guard<std::mutex> diskLock(diskMutex);
+  std::map<std::string, ClickSettings> pending;
+  std::string active;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!dirty)
+      return;
+    pending.swap(unsaved);
+    active = activeProfile;
+    dirty = false;
+  }
+
+  // Unchanged profiles are copied as raw records straight from the mapping.
+  std::vector<SettingsProfileRecord> records;
+  for (size_t i = 0; i < file.GetProfileCount(); i++) {
+    SettingsProfileRecord record;
+    if (file.GetProfileRecord(i, record) && !pending.count(record.name))
+      records.push_back(record);
+  }
+  for (auto &p : pending)
+    records.push_back({p.first, EncodeSettingsRecord(p.second)});
+
+  // The mapping has to go before the file can be replaced on Windows.
+  file.Close();
+  diskWrites++;
+  bool ok = WriteSettingsFile(path, records, active);
+  file.Open(path);
+
+  if (!ok) {
+    // Keep the changes for the next attempt, without clobbering newer ones.
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &p : pending)
+      unsaved.insert(p);
+    dirty = true;
+  }
+}
+
+void SettingsStore::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  cv.notify_all();
+  if (writer.joinable())
+    writer.join();
+  Flush();
+}
+
+void SettingsStore::WriterThread() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    cv.wait(lock, [this] { return dirty || stopping; });
+    if (stopping)
+      break; // Shutdown() does the final flush
+
+    // Let a burst of changes settle before touching the disk.
+    cv.wait_for(lock, std::chrono::milliseconds(kFlushDelayMs),
+                [this] { return stopping; });
+    if (stopping)
+      break;
+
+    lock.unlock();
+    Flush();
+    lock.lock();
+  }
+}
@@ -0,0 +1,80 @@
+#ifndef SETTINGSSTORE_H
+#define SETTINGSSTORE_H
+
+#include "AutoClicker.h"
+#include "SettingsFile.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The authoritative in-memory copy of the active profile's ClickSettings. The
+// file is mapped once by Load(); after that Get() never touches the disk and
+// switching profiles is a hash lookup in the mapping. Set() notifies listeners
+// and schedules a write-behind flush on a background thread, coalescing
+// changes that arrive within kFlushDelayMs of each other.
+class SettingsStore {
+public:
+  typedef std::function<void(const ClickSettings &oldSettings,
+                             const ClickSettings &newSettings)>
+      Listener;
+
+  static const int kFlushDelayMs = 500;
+  static const char *const kDefaultProfile;
+
+  explicit SettingsStore(const std::string &path);
+  ~SettingsStore();
+
+  // Maps the file and loads its active profile. Missing files keep the
+  // defaults, pre-versioning files are migrated on the next flush and damaged
+  // ones are moved aside to `path`.corrupt.
+  void Load();
+
+  ClickSettings Get() const;
+
+  // Listeners run synchronously on the thread calling Set().
+  void Set(const ClickSettings &settings);
+  void AddListener(Listener listener);
+
+  std::string GetActiveProfile() const;
+  std::vector<std::string> GetProfileNames() const;
+  // Makes `name` the active profile and notifies listeners. A new name starts
+  // as a copy of the current settings.
+  void SwitchProfile(const std::string &name);
+
+  // Writes pending changes now. Shutdown() also stops the writer thread.
+  void Flush();
+  void Shutdown();
+
+  uint64_t GetDiskReads() const { return diskReads; }
+  uint64_t GetDiskWrites() const { return diskWrites; }
+
+private:
+  void WriterThread();
+  void Notify(const ClickSettings &oldSettings,
+              const ClickSettings &newSettings);
+
+  std::string path;
+  mutable std::mutex mutex;
+  std::condition_variable cv;
+  ClickSettings settings;
+  std::string activeProfile;
+  std::map<std::string, ClickSettings> unsaved; // Profiles changed since flush
+  std::vector<Listener> listeners;
+  bool dirty;
+  bool stopping;
+  std::thread writer;
+
+  mutable std::mutex diskMutex; // Guards `file`; serializes flushes
+  SettingsFile file;
+
+  std::atomic<uint64_t> diskReads;
+  std::atomic<uint64_t> diskWrites;
+};
+
+#endif // SETTINGSSTORE_H
@@ -0,0 +1,200 @@
+#include "SoftRenderer.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTRENDERER_SSE2 1
+#endif
+
+void Framebuffer::Resize(int w, int h) {
+  if (w < 0)
+    w = 0;
+  if (h < 0)
+    h = 0;
+  size_t needed = (size_t)w * (size_t)h;
+  if (storage.size() < needed)
+    storage.resize(needed);
+  pixels = storage.data();
+  width = w;
+  height = h;
+  stride = w;
+}
+
+void Framebuffer::Attach(uint32_t *memory, int w, int h, int strideInPixels) {
+  pixels = memory;
+  width = w;
+  height = h;
+  stride = strideInPixels;
+}
+
+static bool ClipRect(const Framebuffer &fb, int &x, int &y, int &w, int &h) {
+  if (x < 0) {
+    w += x;
+    x = 0;
+  }
+  if (y < 0) {
+    h += y;
+    y = 0;
+  }
+  if (x + w > fb.Width())
+    w = fb.Width() - x;
+  if (y + h > fb.Height())
+    h = fb.Height() - y;
+  return w > 0 && h > 0;
+}
+
+static inline uint32_t BlendPixel(uint32_t dst, uint32_t src, uint32_t a) {
+  // x / 255 computed as (x + 128 + ((x + 128) >> 8)) >> 8, exact for 0..65025
+  uint32_t ia = 255 - a;
+  uint32_t out = 0;
+  for (int shift = 0; shift < 32; shift += 8) {
+    uint32_t t = ((src >> shift) & 0xFF) * a + ((dst >> shift) & 0xFF) * ia;
+    t += 128;
+    t = (t + (t >> 8)) >> 8;
+    out |= t << shift;
+  }
+  return out;
+}
+
+#ifdef SOFTRENDERER_SSE2
+static inline __m128i Div255Epu16(__m128i x) {
+  x = _mm_add_epi16(x, _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+#endif
+
+static void FillRow(uint32_t *p, int n, uint32_t color) {
+  int i = 0;
+#ifdef SOFTRENDERER_SSE2
+  const __m128i c = _mm_set1_epi32((int)color);
+  for (; i + 8 <= n; i += 8) {
+    _mm_storeu_si128((__m128i *)(p + i), c);
+    _mm_storeu_si128((__m128i *)(p + i + 4), c);
+  }
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_si128((__m128i *)(p + i), c);
+#endif
+  for (; i < n; i++)
+    p[i] = color;
+}
+
+void FillRect(Framebuffer &fb, int x, int y, int w, int h, uint32_t color) {
+  if (!ClipRect(fb, x, y, w, h))
+    return;
+  for (int row = y; row < y + h; row++)
+    FillRow(fb.Row(row) + x, w, color);
+}
+
+void FillHatchCross(Framebuffer &fb, int x, int y, int w, int h,
+                    uint32_t background, uint32_t line, int spacing) {
+  if (spacing < 1 || !ClipRect(fb, x, y, w, h))
+    return;
+  const int firstColumn = x + (spacing - x % spacing) % spacing;
+  for (int row = y; row < y + h; row++) {
+    uint32_t *p = fb.Row(row);
+    if (row % spacing == 0) {
+      FillRow(p + x, w, line);
+      continue;
+    }
+    FillRow(p + x, w, background);
+    for (int col = firstColumn; col < x + w; col += spacing)
+      p[col] = line;
+  }
+}
+
+void CopyPixels(Framebuffer &dst, const Framebuffer &src, int x, int y, int w,
+                int h) {
+  if (!ClipRect(dst, x, y, w, h) || !ClipRect(src, x, y, w, h))
+    return;
+  for (int row = y; row < y + h; row++)
+    memcpy(dst.Row(row) + x, src.Row(row) + x, (size_t)w * 4);
+}
+
+void BlendRect(Framebuffer &fb, int x, int y, int w, int h, uint32_t color,
+               int alpha) {
+  if (alpha <= 0 || !ClipRect(fb, x, y, w, h))
+    return;
+  if (alpha >= 255) {
+    FillRect(fb, x, y, w, h, color);
+    return;
+  }
+
+#ifdef SOFTRENDERER_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i src =
+      _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero),
+                      _mm_set1_epi16((short)alpha));
+  const __m128i ia = _mm_set1_epi16((short)(255 - alpha));
+#endif
+
+  for (int row = y; row < y + h; row++) {
+    uint32_t *p = fb.Row(row) + x;
+    int i = 0;
+#ifdef SOFTRENDERER_SSE2
+    for (; i + 4 <= w; i += 4) {
+      __m128i d = _mm_loadu_si128((const __m128i *)(p + i));
+      __m128i lo = _mm_unpacklo_epi8(d, zero);
+      __m128i hi = _mm_unpackhi_epi8(d, zero);
+      lo = Div255Epu16(_mm_add_epi16(_mm_mullo_epi16(lo, ia), src));
+      hi = Div255Epu16(_mm_add_epi16(_mm_mullo_epi16(hi, ia), src));
+      _mm_storeu_si128((__m128i *)(p + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < w; i++)
+      p[i] = BlendPixel(p[i], color, (uint32_t)alpha);
+  }
+}
+
+void BlitSprite(Framebuffer &fb, int x, int y, const Sprite &sprite) {
+  BlitSprite(fb, x, y, sprite, 0, 0, sprite.width, sprite.height);
+}
+
+void BlitSprite(Framebuffer &fb, int x, int y, const Sprite &sprite, int srcX,
+                int srcY, int w, int h) {
+  int sx = x, sy = y;
+  if (!ClipRect(fb, sx, sy, w, h))
+    return;
+  const int offX = srcX + sx - x;
+  const int offY = srcY + sy - y;
+
+#ifdef SOFTRENDERER_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i full = _mm_set1_epi16(255);
+#endif
+
+  for (int row = 0; row < h; row++) {
+    uint32_t *d = fb.Row(sy + row) + sx;
+    const uint32_t *s =
+        sprite.pixels.data() + (size_t)(offY + row) * sprite.width + offX;
+    int i = 0;
+#ifdef SOFTRENDERER_SSE2
+    for (; i + 4 <= w; i += 4) {
+      __m128i sv = _mm_loadu_si128((const __m128i *)(s + i));
+      __m128i dv = _mm_loadu_si128((const __m128i *)(d + i));
+
+      __m128i slo = _mm_unpacklo_epi8(sv, zero);
+      __m128i shi = _mm_unpackhi_epi8(sv, zero);
+      // Broadcast each pixel's alpha (16-bit lane 3 / 7) over its channels.
+      __m128i alo = _mm_shufflehi_epi16(
+          _mm_shufflelo_epi16(slo, _MM_SHUFFLE(3, 3, 3, 3)),
+          _MM_SHUFFLE(3, 3, 3, 3));
+      __m128i ahi = _mm_shufflehi_epi16(
+          _mm_shufflelo_epi16(shi, _MM_SHUFFLE(3, 3, 3, 3)),
+          _MM_SHUFFLE(3, 3, 3, 3));
+
+      __m128i lo = _mm_add_epi16(
+          _mm_mullo_epi16(slo, alo),
+          _mm_mullo_epi16(_mm_unpacklo_epi8(dv, zero), _mm_sub_epi16(full, alo)));
+      __m128i hi = _mm_add_epi16(
+          _mm_mullo_epi16(shi, ahi),
+          _mm_mullo_epi16(_mm_unpackhi_epi8(dv, zero), _mm_sub_epi16(full, ahi)));
+      _mm_storeu_si128((__m128i *)(d + i),
+                       _mm_packus_epi16(Div255Epu16(lo), Div255Epu16(hi)));
+    }
+#endif
+    for (; i < w; i++)
+      d[i] = BlendPixel(d[i], s[i], s[i] >> 24);
+  }
+}
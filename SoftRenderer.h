@@ -0,0 +1,77 @@
+#ifndef SOFTRENDERER_H
+#define SOFTRENDERER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Pixels are 0xAARRGGBB, which is the memory layout of a top-down 32 bpp
+// BI_RGB DIB, so a Framebuffer can be handed to StretchDIBits as is.
+inline uint32_t PackColor(int r, int g, int b, int a = 255) {
+  return ((uint32_t)a << 24) | ((uint32_t)r << 16) | ((uint32_t)g << 8) |
+         (uint32_t)b;
+}
+
+class Framebuffer {
+public:
+  Framebuffer() : pixels(nullptr), width(0), height(0), stride(0) {}
+  Framebuffer(int w, int h) : Framebuffer() { Resize(w, h); }
+
+  // Reallocates only when the new size needs more memory than we have.
+  void Resize(int w, int h);
+  // Renders into memory owned by someone else (e.g. a DIB section).
+  void Attach(uint32_t *memory, int w, int h, int strideInPixels);
+
+  int Width() const { return width; }
+  int Height() const { return height; }
+  int Stride() const { return stride; }
+  uint32_t *Pixels() { return pixels; }
+  const uint32_t *Pixels() const { return pixels; }
+  uint32_t *Row(int y) { return pixels + (size_t)y * stride; }
+  const uint32_t *Row(int y) const { return pixels + (size_t)y * stride; }
+
+private:
+  std::vector<uint32_t> storage;
+  uint32_t *pixels;
+  int width;
+  int height;
+  int stride;
+};
+
+// A small ARGB image with straight (non-premultiplied) alpha.
+struct Sprite {
+  int width = 0;
+  int height = 0;
+  std::vector<uint32_t> pixels;
+};
+
+// All drawing functions clip to the framebuffer. Rows are processed four
+// pixels at a time with SSE2 where available.
+
+void FillRect(Framebuffer &fb, int x, int y, int w, int h, uint32_t color);
+
+// GDI HS_CROSS look-alike: `line` on every `spacing`-th row and column
+// (counted from the framebuffer origin), `background` elsewhere.
+void FillHatchCross(Framebuffer &fb, int x, int y, int w, int h,
+                    uint32_t background, uint32_t line, int spacing = 8);
+
+inline void PlotPoint(Framebuffer &fb, int x, int y, uint32_t color) {
+  if ((unsigned)x < (unsigned)fb.Width() && (unsigned)y < (unsigned)fb.Height())
+    fb.Row(y)[x] = color;
+}
+
+// Blends `color` over the rectangle with a constant alpha (0..255).
+void BlendRect(Framebuffer &fb, int x, int y, int w, int h, uint32_t color,
+               int alpha);
+
+// Copies a rectangle from `src` to the same place in `dst`.
+void CopyPixels(Framebuffer &dst, const Framebuffer &src, int x, int y, int w,
+                int h);
+
+// Draws `sprite` with its per-pixel alpha, top-left corner at (x, y).
+void BlitSprite(Framebuffer &fb, int x, int y, const Sprite &sprite);
+// Same, for the w x h cell of `sprite` at (srcX, srcY) (e.g. an atlas cell).
+void BlitSprite(Framebuffer &fb, int x, int y, const Sprite &sprite, int srcX,
+                int srcY, int w, int h);
+
+#endif // SOFTRENDERER_H
@@ -0,0 +1,435 @@
+#include "TemplateMatcher.h"
+#include "PixelTrigger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEMPLATEMATCHER_SSE2 1
+#endif
+
+namespace {
+
+const int kBandRows = 32;     // Cache granularity; multiple of 2^(levels-1)
+const int kMaxLevels = 5;     // Full resolution plus four halvings
+const int kMinCoarseSize = 6; // Smallest template side at the top level
+const int kTileRows = 8;      // Rows of positions per search task
+const size_t kCandidates = 8; // Coarse hits carried down to full resolution
+const int kRefineRadius = 2;  // Search window per finer level, in pixels
+
+// 0.114 B + 0.587 G + 0.299 R in 1/128ths.
+const int kGrayB = 15, kGrayG = 75, kGrayR = 38;
+
+void ToGray(const uint32_t *src, uint8_t *dst, int n) {
+  int i = 0;
+#ifdef TEMPLATEMATCHER_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i weights =
+      _mm_setr_epi16(kGrayB, kGrayG, kGrayR, 0, kGrayB, kGrayG, kGrayR, 0);
+  const __m128i ones = _mm_set1_epi16(1);
+  const __m128i half = _mm_set1_epi32(64);
+  for (; i + 8 <= n; i += 8) {
+    __m128i gray[2];
+    for (int k = 0; k < 2; k++) {
+      // Bytes are B, G, R, A: madd gives (15B + 75G, 38R) per pixel, the
+      // second madd adds the pair.
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + i + 4 * k));
+      __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weights);
+      __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weights);
+      __m128i sum = _mm_madd_epi16(_mm_packs_epi32(lo, hi), ones);
+      gray[k] = _mm_srli_epi32(_mm_add_epi32(sum, half), 7);
+    }
+    __m128i words = _mm_packs_epi32(gray[0], gray[1]);
+    _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(words, zero));
+  }
+#endif
+  for (; i < n; i++) {
+    const uint32_t p = src[i];
+    dst[i] = (uint8_t)((kGrayB * (p & 0xFF) + kGrayG * ((p >> 8) & 0xFF) +
+                        kGrayR * ((p >> 16) & 0xFF) + 64) >>
+                       7);
+  }
+}
+
+// dst row r is the 2x2 average of src rows 2r and 2r + 1.
+void DownsampleRow(const uint8_t *a, const uint8_t *b, uint8_t *dst, int n) {
+  int i = 0;
+#ifdef TEMPLATEMATCHER_SSE2
+  const __m128i lowBytes = _mm_set1_epi16(0xFF);
+  for (; i + 16 <= n; i += 16) {
+    __m128i v0 = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(a + 2 * i)),
+                              _mm_loadu_si128((const __m128i *)(b + 2 * i)));
+    __m128i v1 =
+        _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(a + 2 * i + 16)),
+                     _mm_loadu_si128((const __m128i *)(b + 2 * i + 16)));
+    __m128i h0 = _mm_avg_epu16(_mm_and_si128(v0, lowBytes),
+                               _mm_srli_epi16(v0, 8));
+    __m128i h1 = _mm_avg_epu16(_mm_and_si128(v1, lowBytes),
+                               _mm_srli_epi16(v1, 8));
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(h0, h1));
+  }
+#endif
+  // Same rounding as the SSE2 path: vertical, then horizontal average.
+  for (; i < n; i++) {
+    int left = (a[2 * i] + b[2 * i] + 1) >> 1;
+    int right = (a[2 * i + 1] + b[2 * i + 1] + 1) >> 1;
+    dst[i] = (uint8_t)((left + right + 1) >> 1);
+  }
+}
+
+} // namespace
+
+void TemplateMatcher::GrayImage::Resize(int w, int h) {
+  width = w;
+  height = h;
+  // Kernels read up to 32 bytes past the last pixel of a row.
+  stride = (w + 32 + 15) & ~15;
+  pixels.assign((size_t)stride * (h + 1), 0);
+}
+
+TemplateMatcher::TemplateMatcher(WorkStealingPool *pool)
+    : pool(pool), threshold(0.9), cacheValid(false), cachedLevels(0),
+      searches(0), cacheHits(0) {}
+
+bool TemplateMatcher::SetTemplate(const Framebuffer &image) {
+  templates.clear();
+  cacheValid = false;
+  if (image.Width() < 4 || image.Height() < 4)
+    return false;
+
+  templateGray.Resize(image.Width(), image.Height());
+  for (int y = 0; y < image.Height(); y++)
+    ToGray(image.Row(y), templateGray.Row(y), image.Width());
+
+  GrayImage level = templateGray;
+  for (int l = 0; l < kMaxLevels; l++) {
+    if (l > 0) {
+      if (std::min(level.width, level.height) / 2 < kMinCoarseSize)
+        break;
+      GrayImage half;
+      half.Resize(level.width / 2, level.height / 2);
+      for (int y = 0; y < half.height; y++)
+        DownsampleRow(level.Row(2 * y), level.Row(2 * y + 1), half.Row(y),
+                      half.width);
+      level = half;
+    }
+
+    LevelTemplate t;
+    t.width = level.width;
+    t.height = level.height;
+    t.chunks = (level.width + 7) / 8;
+    t.pixels.assign((size_t)t.chunks * 8 * t.height, 0);
+    t.mask.assign(t.pixels.size(), 0);
+    double sum = 0.0, sumSq = 0.0;
+    for (int y = 0; y < t.height; y++)
+      for (int x = 0; x < t.width; x++) {
+        const int v = level.Row(y)[x];
+        t.pixels[(size_t)y * t.chunks * 8 + x] = (int16_t)v;
+        t.mask[(size_t)y * t.chunks * 8 + x] = -1;
+        sum += v;
+        sumSq += (double)v * v;
+      }
+    const double n = (double)t.width * t.height;
+    t.sum = sum;
+    t.norm = std::sqrt(sumSq - sum * sum / n);
+    // A level averaged flat cannot be matched; stop above it.
+    if (t.norm < 1e-6)
+      break;
+    templates.push_back(t);
+  }
+  return !templates.empty();
+}
+
+void TemplateMatcher::AddCandidate(std::vector<Candidate> &best,
+                                   const Candidate &c, int radius) {
+  // Neighbours of one peak all score well; keep only the best of them.
+  for (Candidate &b : best) {
+    if (std::abs(b.x - c.x) <= radius && std::abs(b.y - c.y) <= radius) {
+      if (c.score > b.score)
+        b = c;
+      return;
+    }
+  }
+  if (best.size() < kCandidates) {
+    best.push_back(c);
+    return;
+  }
+  size_t worst = 0;
+  for (size_t i = 1; i < best.size(); i++)
+    if (best[i].score < best[worst].score)
+      worst = i;
+  if (c.score > best[worst].score)
+    best[worst] = c;
+}
+
+int TemplateMatcher::LevelCount(int frameWidth, int frameHeight) const {
+  int levels = 0;
+  for (const LevelTemplate &t : templates) {
+    if ((frameWidth >> levels) < t.width || (frameHeight >> levels) < t.height)
+      break;
+    levels++;
+  }
+  return levels;
+}
+
+double TemplateMatcher::Score(const GrayImage &image, const LevelTemplate &t,
+                              int x, int y) const {
+  int64_t sumF = 0, sumFF = 0, sumFT = 0;
+#ifdef TEMPLATEMATCHER_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi16(1);
+  // 32-bit lanes are flushed before 2 * 255^2 per pixel could overflow them.
+  const int flushRows = std::max(1, (int)(16000 / t.chunks));
+  for (int row0 = 0; row0 < t.height; row0 += flushRows) {
+    const int row1 = std::min(t.height, row0 + flushRows);
+    __m128i accF = zero, accFF = zero, accFT = zero;
+    for (int row = row0; row < row1; row++) {
+      const uint8_t *f = image.Row(y + row) + x;
+      const int16_t *tp = t.pixels.data() + (size_t)row * t.chunks * 8;
+      const int16_t *mp = t.mask.data() + (size_t)row * t.chunks * 8;
+      for (int c = 0; c < t.chunks; c++) {
+        __m128i f16 = _mm_unpacklo_epi8(
+            _mm_loadl_epi64((const __m128i *)(f + 8 * c)), zero);
+        f16 =
+            _mm_and_si128(f16, _mm_loadu_si128((const __m128i *)(mp + 8 * c)));
+        __m128i tv = _mm_loadu_si128((const __m128i *)(tp + 8 * c));
+        accF = _mm_add_epi32(accF, _mm_madd_epi16(f16, ones));
+        accFF = _mm_add_epi32(accFF, _mm_madd_epi16(f16, f16));
+        accFT = _mm_add_epi32(accFT, _mm_madd_epi16(f16, tv));
+      }
+    }
+    alignas(16) int32_t lanes[3][4];
+    _mm_store_si128((__m128i *)lanes[0], accF);
+    _mm_store_si128((__m128i *)lanes[1], accFF);
+    _mm_store_si128((__m128i *)lanes[2], accFT);
+    for (int k = 0; k < 4; k++) {
+      sumF += lanes[0][k];
+      sumFF += lanes[1][k];
+      sumFT += lanes[2][k];
+    }
+  }
+#else
+  for (int row = 0; row < t.height; row++) {
+    const uint8_t *f = image.Row(y + row) + x;
+    const int16_t *tp = t.pixels.data() + (size_t)row * t.chunks * 8;
+    for (int i = 0; i < t.width; i++) {
+      sumF += f[i];
+      sumFF += f[i] * f[i];
+      sumFT += f[i] * tp[i];
+    }
+  }
+#endif
+  // sum((f - mean f)(t - mean t)) = sum(f t) - sum(f) sum(t) / n.
+  const double n = (double)t.width * t.height;
+  const double varF = (double)sumFF - (double)sumF * sumF / n;
+  if (varF < 1e-6)
+    return 0.0; // Flat window: no evidence either way
+  const double cov = (double)sumFT - (double)sumF * t.sum / n;
+  return cov / (std::sqrt(varF) * t.norm);
+}
+
+void TemplateMatcher::UpdateBand(const Framebuffer &frame, int band,
+                                 int levels) {
+  const int y0 = band * kBandRows;
+  const int y1 = std::min(frame.Height(), y0 + kBandRows);
+  const int w = frame.Width();
+
+  // Compare and resync just this band's rows of the reference frame.
+  bool changed = true;
+  if (cacheValid) {
+    Framebuffer now, before;
+    now.Attach(const_cast<uint32_t *>(frame.Row(y0)), w, y1 - y0,
+               frame.Stride());
+    before.Attach(reference.Row(y0), w, y1 - y0, reference.Stride());
+    int x, y;
+    changed = SyncChanges(now, before, x, y);
+  } else {
+    for (int y = y0; y < y1; y++)
+      memcpy(reference.Row(y), frame.Row(y), (size_t)w * 4);
+  }
+  bandChanged[band] = changed;
+  if (!changed)
+    return;
+
+  for (int y = y0; y < y1; y++)
+    ToGray(frame.Row(y), pyramid[0].Row(y), w);
+  // Bands are a multiple of 2^(levels-1) rows, so each one owns its rows on
+  // every level.
+  for (int l = 1; l < levels; l++) {
+    GrayImage &src = pyramid[l - 1];
+    GrayImage &dst = pyramid[l];
+    for (int y = y0 >> l; y < std::min(dst.height, y1 >> l); y++)
+      DownsampleRow(src.Row(2 * y), src.Row(2 * y + 1), dst.Row(y),
+                    dst.width);
+  }
+}
+
+void TemplateMatcher::SearchTile(int level, int firstRow, int lastRow,
+                                 std::vector<Candidate> &best) const {
+  const GrayImage &image = pyramid[level];
+  const LevelTemplate &t = templates[level];
+  const int radius = std::max(t.width, t.height) / 2;
+  // Once the list is full, anything not above its worst entry is dropped
+  // without looking at the list.
+  double floor = -2.0;
+  for (int y = firstRow; y < lastRow; y++)
+    for (int x = 0; x + t.width <= image.width; x++) {
+      Candidate c = {x, y, Score(image, t, x, y)};
+      if (c.score <= floor)
+        continue;
+      AddCandidate(best, c, radius);
+      if (best.size() == kCandidates) {
+        floor = best[0].score;
+        for (const Candidate &b : best)
+          floor = std::min(floor, b.score);
+      }
+    }
+}
+
+TemplateMatch TemplateMatcher::Find(const Framebuffer &frame) {
+  TemplateMatch result;
+  const int levels = LevelCount(frame.Width(), frame.Height());
+  if (levels == 0)
+    return result; // No template, or the frame is smaller than it
+
+  if (frame.Width() != reference.Width() ||
+      frame.Height() != reference.Height() || levels != cachedLevels) {
+    cacheValid = false;
+    reference.Resize(frame.Width(), frame.Height());
+    pyramid.resize(levels);
+    pyramid[0].Resize(frame.Width(), frame.Height());
+    for (int l = 1; l < levels; l++)
+      pyramid[l].Resize(pyramid[l - 1].width / 2, pyramid[l - 1].height / 2);
+    cachedLevels = levels;
+  }
+
+  auto parallelFor = [this](int count, const std::function<void(int)> &fn) {
+    if (pool) {
+      pool->ParallelFor(count, fn);
+    } else {
+      for (int i = 0; i < count; i++)
+        fn(i);
+    }
+  };
+
+  const int bands = (frame.Height() + kBandRows - 1) / kBandRows;
+  bandChanged.assign(bands, 0);
+  parallelFor(bands, [&](int band) { UpdateBand(frame, band, levels); });
+  bool anyChanged = !cacheValid;
+  for (uint8_t changed : bandChanged)
+    anyChanged = anyChanged || changed;
+  cacheValid = true;
+  if (!anyChanged) {
+    cacheHits++;
+    return cached;
+  }
+  searches++;
+
+  // Exhaustive search of the coarsest level, a band of positions per task.
+  const int top = levels - 1;
+  const int positionRows = pyramid[top].height - templates[top].height + 1;
+  const int tiles = (positionRows + kTileRows - 1) / kTileRows;
+  std::vector<std::vector<Candidate>> tileBest(tiles);
+  parallelFor(tiles, [&](int tile) {
+    SearchTile(top, tile * kTileRows,
+               std::min(positionRows, (tile + 1) * kTileRows), tileBest[tile]);
+  });
+  std::vector<Candidate> best;
+  const int radius = std::max(templates[top].width, templates[top].height) / 2;
+  for (const std::vector<Candidate> &tile : tileBest)
+    for (const Candidate &c : tile)
+      AddCandidate(best, c, radius);
+
+  // Each candidate walks down the pyramid, re-centring in a small window.
+  parallelFor((int)best.size(), [&](int i) {
+    Candidate c = best[i];
+    for (int l = top - 1; l >= 0; l--) {
+      const GrayImage &image = pyramid[l];
+      const LevelTemplate &t = templates[l];
+      const int cx = 2 * c.x, cy = 2 * c.y;
+      c.score = -2.0;
+      for (int y = std::max(0, cy - kRefineRadius);
+           y <= std::min(image.height - t.height, cy + kRefineRadius); y++)
+        for (int x = std::max(0, cx - kRefineRadius);
+             x <= std::min(image.width - t.width, cx + kRefineRadius); x++) {
+          double s = Score(image, t, x, y);
+          if (s > c.score) {
+            c.score = s;
+            c.x = x;
+            c.y = y;
+          }
+        }
+    }
+    best[i] = c;
+  });
+
+  for (const Candidate &c : best) {
+    if (c.score > result.score || !result.found) {
+      result.found = true;
+      result.x = c.x;
+      result.y = c.y;
+      result.score = c.score;
+    }
+  }
+  result.found = result.found && result.score >= threshold;
+  result.width = templates[0].width;
+  result.height = templates[0].height;
+  cached = result;
+  return result;
+}
+
+static uint32_t ReadLE(const unsigned char *p, int bytes) {
+  uint32_t v = 0;
+  for (int i = bytes - 1; i >= 0; i--)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+bool LoadBitmapFile(const std::string &path, Framebuffer &image,
+                    std::string &error) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    error = "cannot open " + path;
+    return false;
+  }
+  std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+  if (data.size() < 54 || data[0] != 'B' || data[1] != 'M') {
+    error = path + ": not a .bmp file";
+    return false;
+  }
+
+  const uint32_t offset = ReadLE(&data[10], 4);
+  const int width = (int)ReadLE(&data[18], 4);
+  const int height = (int)ReadLE(&data[22], 4); // Negative: top-down
+  const int bpp = (int)ReadLE(&data[28], 2);
+  const uint32_t compression = ReadLE(&data[30], 4);
+  const int rows = height < 0 ? -height : height;
+  // BI_RGB, or BI_BITFIELDS with the usual masks for 32 bpp.
+  if ((bpp != 24 && bpp != 32) || (compression != 0 && compression != 3) ||
+      width <= 0 || rows == 0 || width > 16384 || rows > 16384) {
+    error = path + ": only uncompressed 24/32-bit bitmaps are supported";
+    return false;
+  }
+  const size_t rowBytes = ((size_t)width * (bpp / 8) + 3) & ~(size_t)3;
+  if (offset > data.size() || data.size() - offset < rowBytes * rows) {
+    error = path + ": file is truncated";
+    return false;
+  }
+
+  image.Resize(width, rows);
+  for (int y = 0; y < rows; y++) {
+    const unsigned char *src =
+        &data[offset + rowBytes * (height < 0 ? y : rows - 1 - y)];
+    uint32_t *dst = image.Row(y);
+    for (int x = 0; x < width; x++, src += bpp / 8)
+      dst[x] = PackColor(src[2], src[1], src[0]);
+  }
+  return true;
+}
@@ -0,0 +1,115 @@
+#ifndef TEMPLATEMATCHER_H
+#define TEMPLATEMATCHER_H
+
+#include "SoftRenderer.h"
+#include "WorkStealingPool.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Where a template was found, in frame coordinates.
+struct TemplateMatch {
+  bool found = false;
+  int x = 0; // Top-left corner
+  int y = 0;
+  int width = 0;
+  int height = 0;
+  double score = 0.0; // Normalized cross-correlation, -1..1
+
+  int CenterX() const { return x + width / 2; }
+  int CenterY() const { return y + height / 2; }
+};
+
+// Finds an image inside screen frames ("click this button").
+//
+// Frames and the template are converted to 8-bit gray and reduced to a
+// pyramid of 2x2 averages. The coarsest level is searched exhaustively for
+// the best few candidates, in tiles spread over a WorkStealingPool; each
+// candidate is then refined level by level in a small window, down to full
+// resolution. Every score is a normalized cross-correlation computed with
+// SSE2, so brightness and contrast changes do not matter.
+//
+// Results are cached: the frame is compared with the previous one in bands
+// of rows, only changed bands are converted again, and a frame without any
+// change returns the previous result without searching.
+class TemplateMatcher {
+public:
+  // Runs everything on the calling thread when `pool` is null.
+  explicit TemplateMatcher(WorkStealingPool *pool = nullptr);
+
+  // Copies the template (RGB; alpha ignored). False if it is smaller than
+  // 4x4 or has no contrast at all.
+  bool SetTemplate(const Framebuffer &image);
+  // Lowest score that counts as found. Default 0.9.
+  void SetThreshold(double minScore) { threshold = minScore; }
+
+  TemplateMatch Find(const Framebuffer &frame);
+
+  uint64_t GetSearchCount() const { return searches; }
+  uint64_t GetCacheHitCount() const { return cacheHits; }
+  // Forget the previous frame, e.g. to time full searches.
+  void InvalidateCache() { cacheValid = false; }
+
+private:
+  struct GrayImage {
+    int width = 0;
+    int height = 0;
+    int stride = 0; // Bytes; rows have slack so kernels may over-read
+    std::vector<uint8_t> pixels;
+
+    void Resize(int w, int h);
+    uint8_t *Row(int y) { return pixels.data() + (size_t)y * stride; }
+    const uint8_t *Row(int y) const {
+      return pixels.data() + (size_t)y * stride;
+    }
+  };
+
+  // The template at one pyramid level, rows widened to int16 and padded to
+  // whole SSE2 vectors.
+  struct LevelTemplate {
+    int width = 0;
+    int height = 0;
+    int chunks = 0; // 8-pixel vectors per row
+    std::vector<int16_t> pixels;
+    std::vector<int16_t> mask; // -1 for real pixels, 0 for padding
+    double sum = 0.0;
+    double norm = 0.0; // sqrt(sum of squared deviations)
+  };
+
+  struct Candidate {
+    int x, y;
+    double score;
+  };
+
+  static void AddCandidate(std::vector<Candidate> &best, const Candidate &c,
+                           int radius);
+  int LevelCount(int frameWidth, int frameHeight) const;
+  double Score(const GrayImage &image, const LevelTemplate &t, int x,
+               int y) const;
+  void UpdateBand(const Framebuffer &frame, int band, int levels);
+  void SearchTile(int level, int firstRow, int lastRow,
+                  std::vector<Candidate> &best) const;
+
+  WorkStealingPool *pool;
+  double threshold;
+
+  GrayImage templateGray;
+  std::vector<LevelTemplate> templates; // Per pyramid level
+
+  Framebuffer reference; // Last frame seen, for the cache
+  bool cacheValid;
+  int cachedLevels;
+  std::vector<GrayImage> pyramid;
+  std::vector<uint8_t> bandChanged;
+  TemplateMatch cached;
+  uint64_t searches;
+  uint64_t cacheHits;
+};
+
+// Reads an uncompressed 24 or 32 bpp .bmp file (what Paint and the Snipping
+// Tool save). Returns false and fills `error` otherwise.
+bool LoadBitmapFile(const std::string &path, Framebuffer &image,
+                    std::string &error);
+
+#endif // TEMPLATEMATCHER_H
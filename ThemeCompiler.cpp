@@ -0,0 +1,92 @@
+// Compiles theme packs (themes/*.theme, see ThemePack.h) into the blob the
+// app maps at startup. Themes are ordered by their `order` key, then file
+// name. The output is replaced atomically, so a running app picks it up.
+//
+//   AutoClickerThemes <out.bin> <pack or directory>...
+//
+// A directory stands for the .theme files in it. Exit code 0 on success, 1 on
+// bad arguments or a pack that does not parse (nothing is written then).
+
+#include "MappedFile.h"
+#include "ThemePack.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Pack {
+  std::string file; // Sort key after `order`
+  ThemeDesc theme;
+};
+
+bool ReadPack(const fs::path &path, std::vector<Pack> &packs) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    fprintf(stderr, "Cannot read %s\n", path.string().c_str());
+    return false;
+  }
+  std::stringstream text;
+  text << in.rdbuf();
+  Pack pack;
+  pack.file = path.filename().string();
+  std::string error;
+  if (!ParseThemePack(text.str(), pack.theme, error)) {
+    fprintf(stderr, "%s: %s\n", path.string().c_str(), error.c_str());
+    return false;
+  }
+  packs.push_back(pack);
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: AutoClickerThemes <out.bin> <pack or "
+                    "directory>...\n");
+    return 1;
+  }
+
+  std::vector<Pack> packs;
+  for (int i = 2; i < argc; i++) {
+    std::error_code ec;
+    if (!fs::is_directory(argv[i], ec)) {
+      if (!ReadPack(argv[i], packs))
+        return 1;
+      continue;
+    }
+    for (const fs::directory_entry &e : fs::directory_iterator(argv[i], ec))
+      if (e.path().extension() == ".theme" && !ReadPack(e.path(), packs))
+        return 1;
+  }
+  if (packs.empty()) {
+    fprintf(stderr, "No theme packs given\n");
+    return 1;
+  }
+
+  std::stable_sort(packs.begin(), packs.end(),
+                   [](const Pack &a, const Pack &b) {
+                     if (a.theme.order != b.theme.order)
+                       return a.theme.order < b.theme.order;
+                     return a.file < b.file;
+                   });
+  std::vector<ThemeDesc> themes;
+  for (const Pack &p : packs)
+    themes.push_back(p.theme);
+
+  const std::string blob = EncodeThemeBlob(themes);
+  if (!WriteFileAtomic(argv[1], blob.data(), blob.size())) {
+    fprintf(stderr, "Cannot write %s\n", argv[1]);
+    return 1;
+  }
+  printf("%zu themes, %zu bytes -> %s\n", themes.size(), blob.size(), argv[1]);
+  return 0;
+}
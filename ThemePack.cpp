@@ -0,0 +1,525 @@
+#include "ThemePack.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const uint32_t kBlobMagic = 0x42544341; // "ACTB"
+const uint32_t kBlobVersion = 1;
+
+struct BlobHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t recordSize;
+  uint32_t poolOffset; // From the start of the blob
+  uint32_t poolSize;
+};
+
+// Offsets are into the pool; colour arrays are 4-byte aligned there.
+struct ThemeRecord {
+  uint32_t name, nameLength;
+  uint32_t flags; // kRecord* below
+  uint32_t background, text, hatchColor;
+  uint32_t animation, particleCount;
+  float minSpeed, maxSpeed;
+  int32_t minLength, maxLength, minSize, maxSize, minBrightness,
+      maxBrightness;
+  uint32_t glyphs, glyphsLength, glyphFont, glyphFontLength;
+  int32_t glyphSize, order;
+  uint32_t glyphColors, glyphColorCount;
+};
+
+const uint32_t kRecordSystemColors = 1;
+const uint32_t kRecordHatch = 2;
+
+std::string Trim(const std::string &s) {
+  size_t b = 0, e = s.size();
+  while (b < e && isspace((unsigned char)s[b]))
+    b++;
+  while (e > b && isspace((unsigned char)s[e - 1]))
+    e--;
+  return s.substr(b, e - b);
+}
+
+bool ParseColor(const std::string &s, uint32_t &out) {
+  if (s.size() != 7 || s[0] != '#')
+    return false;
+  char *end = nullptr;
+  const unsigned long v = strtoul(s.c_str() + 1, &end, 16);
+  if (*end)
+    return false;
+  out = (uint32_t)v;
+  return true;
+}
+
+template <typename T> bool ParsePair(std::istringstream &in, T &a, T &b) {
+  return (in >> a >> b) && a <= b;
+}
+
+// What ParseThemePack accepts, checked again on themes decoded from a blob:
+// its records are read as they are, and nothing else stands between them
+// and the particle system or the glyph rasterizer.
+bool ThemeInRange(const ThemeDesc &t) {
+  const ParticleParams &p = t.particles;
+  const uint32_t kMaxColor = 0xFFFFFF;
+  if (t.name.empty() || t.background > kMaxColor || t.text > kMaxColor ||
+      t.hatchColor > kMaxColor || t.particleCount > 100000 ||
+      t.glyphSize < 4 || t.glyphSize > 256)
+    return false;
+  if (!(p.minSpeed >= 0 && p.minSpeed <= p.maxSpeed &&
+        std::isfinite(p.maxSpeed)) ||
+      p.minLength < 0 || p.minLength > p.maxLength || p.maxLength > 255 ||
+      p.minSize < 1 || p.minSize > p.maxSize || p.maxSize > 255 ||
+      p.minBrightness < 0 || p.minBrightness > p.maxBrightness ||
+      p.maxBrightness > 255)
+    return false;
+  for (uint32_t c : t.glyphColors)
+    if (c > kMaxColor)
+      return false;
+  return t.animation != ThemeAnimation::Rain ||
+         (!t.glyphs.empty() && !t.glyphColors.empty());
+}
+
+} // namespace
+
+bool ParseThemePack(const std::string &text, ThemeDesc &out,
+                    std::string &error) {
+  ThemeDesc t;
+  std::istringstream lines(text);
+  std::string line;
+  for (int n = 1; std::getline(lines, line); n++) {
+    line = Trim(line);
+    if (line.empty() || line[0] == '#') // '#' also starts colours
+      continue;
+
+    auto fail = [&](const char *what) {
+      error = "line " + std::to_string(n) + ": " + what;
+      return false;
+    };
+    const size_t eq = line.find('=');
+    if (eq == std::string::npos)
+      return fail("expected key = value");
+    std::string key = Trim(line.substr(0, eq));
+    const std::string value = Trim(line.substr(eq + 1));
+    std::transform(key.begin(), key.end(), key.begin(),
+                   [](unsigned char c) { return (char)tolower(c); });
+    std::istringstream in(value);
+    ParticleParams &p = t.particles;
+
+    if (key == "name") {
+      t.name = value;
+    } else if (key == "order") {
+      if (!(in >> t.order))
+        return fail("order: expected a number");
+    } else if (key == "background") {
+      t.systemColors = value == "system";
+      if (!t.systemColors && !ParseColor(value, t.background))
+        return fail("background: expected #RRGGBB or system");
+    } else if (key == "text") {
+      if (!ParseColor(value, t.text))
+        return fail("text: expected #RRGGBB");
+    } else if (key == "pattern") {
+      std::string kind, color;
+      in >> kind >> color;
+      t.hatch = kind == "cross";
+      if (kind != "solid" && !(t.hatch && ParseColor(color, t.hatchColor)))
+        return fail("pattern: expected solid or cross #RRGGBB");
+    } else if (key == "animation") {
+      if (value == "none")
+        t.animation = ThemeAnimation::None;
+      else if (value == "stars")
+        t.animation = ThemeAnimation::Stars;
+      else if (value == "rain")
+        t.animation = ThemeAnimation::Rain;
+      else
+        return fail("animation: expected none, stars or rain");
+    } else if (key == "particles") {
+      if (!(in >> t.particleCount) || t.particleCount > 100000)
+        return fail("particles: expected 0 to 100000");
+    } else if (key == "speed") {
+      if (!ParsePair(in, p.minSpeed, p.maxSpeed) || p.minSpeed < 0)
+        return fail("speed: expected min max");
+    } else if (key == "length") {
+      if (!ParsePair(in, p.minLength, p.maxLength) || p.minLength < 0 ||
+          p.maxLength > 255)
+        return fail("length: expected min max, 0 to 255");
+    } else if (key == "size") {
+      if (!ParsePair(in, p.minSize, p.maxSize) || p.minSize < 1 ||
+          p.maxSize > 255)
+        return fail("size: expected min max, 1 to 255");
+    } else if (key == "brightness") {
+      if (!ParsePair(in, p.minBrightness, p.maxBrightness) ||
+          p.minBrightness < 0 || p.maxBrightness > 255)
+        return fail("brightness: expected min max, 0 to 255");
+    } else if (key == "glyphs") {
+      t.glyphs = value;
+    } else if (key == "glyph-font") {
+      t.glyphFont = value;
+    } else if (key == "glyph-size") {
+      if (!(in >> t.glyphSize) || t.glyphSize < 4 || t.glyphSize > 256)
+        return fail("glyph-size: expected 4 to 256");
+    } else if (key == "glyph-colors") {
+      t.glyphColors.clear();
+      std::string c;
+      uint32_t color;
+      while (in >> c) {
+        if (!ParseColor(c, color))
+          return fail("glyph-colors: expected #RRGGBB ...");
+        t.glyphColors.push_back(color);
+      }
+    } else {
+      return fail(("unknown key '" + key + "'").c_str());
+    }
+  }
+  if (t.name.empty()) {
+    error = "missing name";
+    return false;
+  }
+  if (t.animation == ThemeAnimation::Rain &&
+      (t.glyphs.empty() || t.glyphColors.empty())) {
+    error = "rain needs glyphs and glyph-colors";
+    return false;
+  }
+  out = t;
+  return true;
+}
+
+std::string EncodeThemeBlob(const std::vector<ThemeDesc> &themes) {
+  std::string pool;
+  auto addString = [&](const std::string &s, uint32_t &offset,
+                       uint32_t &length) {
+    offset = (uint32_t)pool.size();
+    length = (uint32_t)s.size();
+    pool += s;
+  };
+
+  std::vector<ThemeRecord> records;
+  for (const ThemeDesc &t : themes) {
+    ThemeRecord r = {};
+    addString(t.name, r.name, r.nameLength);
+    r.flags = (t.systemColors ? kRecordSystemColors : 0) |
+              (t.hatch ? kRecordHatch : 0);
+    r.background = t.background;
+    r.text = t.text;
+    r.hatchColor = t.hatchColor;
+    r.animation = (uint32_t)t.animation;
+    r.particleCount = t.particleCount;
+    r.minSpeed = t.particles.minSpeed;
+    r.maxSpeed = t.particles.maxSpeed;
+    r.minLength = t.particles.minLength;
+    r.maxLength = t.particles.maxLength;
+    r.minSize = t.particles.minSize;
+    r.maxSize = t.particles.maxSize;
+    r.minBrightness = t.particles.minBrightness;
+    r.maxBrightness = t.particles.maxBrightness;
+    addString(t.glyphs, r.glyphs, r.glyphsLength);
+    addString(t.glyphFont, r.glyphFont, r.glyphFontLength);
+    r.glyphSize = t.glyphSize;
+    r.order = t.order;
+    pool.resize((pool.size() + 3) & ~(size_t)3);
+    r.glyphColors = (uint32_t)pool.size();
+    r.glyphColorCount = (uint32_t)t.glyphColors.size();
+    pool.append((const char *)t.glyphColors.data(),
+                t.glyphColors.size() * sizeof(uint32_t));
+    records.push_back(r);
+  }
+
+  BlobHeader h;
+  h.magic = kBlobMagic;
+  h.version = kBlobVersion;
+  h.count = (uint32_t)records.size();
+  h.recordSize = sizeof(ThemeRecord);
+  h.poolOffset =
+      (uint32_t)(sizeof(BlobHeader) + records.size() * sizeof(ThemeRecord));
+  h.poolSize = (uint32_t)pool.size();
+
+  std::string blob((const char *)&h, sizeof(h));
+  blob.append((const char *)records.data(),
+              records.size() * sizeof(ThemeRecord));
+  blob += pool;
+  return blob;
+}
+
+bool ThemeBlob::Open(const std::string &path) {
+  return file.Open(path) && Attach(file.Data(), file.Size());
+}
+
+bool ThemeBlob::Attach(const uint8_t *bytes, size_t length) {
+  data = nullptr;
+  size = count = 0;
+  BlobHeader h;
+  if (length < sizeof(h))
+    return false;
+  memcpy(&h, bytes, sizeof(h));
+  if (h.magic != kBlobMagic || h.version != kBlobVersion ||
+      h.recordSize != sizeof(ThemeRecord) ||
+      h.poolOffset !=
+          sizeof(BlobHeader) + (uint64_t)h.count * sizeof(ThemeRecord) ||
+      (uint64_t)h.poolOffset + h.poolSize != length)
+    return false;
+  data = bytes;
+  size = length;
+  count = h.count;
+  return true;
+}
+
+bool ThemeBlob::Get(size_t index, ThemeDesc &out) const {
+  if (index >= count)
+    return false;
+  ThemeRecord r;
+  memcpy(&r, data + sizeof(BlobHeader) + index * sizeof(ThemeRecord),
+         sizeof(r));
+  const size_t poolOffset = sizeof(BlobHeader) + count * sizeof(ThemeRecord);
+  const uint8_t *pool = data + poolOffset;
+  const uint64_t poolSize = size - poolOffset;
+  auto inPool = [&](uint32_t offset, uint64_t length) {
+    return offset + length <= poolSize;
+  };
+  if (!inPool(r.name, r.nameLength) || !inPool(r.glyphs, r.glyphsLength) ||
+      !inPool(r.glyphFont, r.glyphFontLength) ||
+      !inPool(r.glyphColors, (uint64_t)r.glyphColorCount * 4) ||
+      r.animation > (uint32_t)ThemeAnimation::Rain)
+    return false;
+
+  ThemeDesc t;
+  t.name.assign((const char *)pool + r.name, r.nameLength);
+  t.order = r.order;
+  t.systemColors = (r.flags & kRecordSystemColors) != 0;
+  t.background = r.background;
+  t.text = r.text;
+  t.hatch = (r.flags & kRecordHatch) != 0;
+  t.hatchColor = r.hatchColor;
+  t.animation = (ThemeAnimation)r.animation;
+  t.particleCount = r.particleCount;
+  t.particles.minSpeed = r.minSpeed;
+  t.particles.maxSpeed = r.maxSpeed;
+  t.particles.minLength = r.minLength;
+  t.particles.maxLength = r.maxLength;
+  t.particles.minSize = r.minSize;
+  t.particles.maxSize = r.maxSize;
+  t.particles.minBrightness = r.minBrightness;
+  t.particles.maxBrightness = r.maxBrightness;
+  t.glyphs.assign((const char *)pool + r.glyphs, r.glyphsLength);
+  t.glyphFont.assign((const char *)pool + r.glyphFont, r.glyphFontLength);
+  t.glyphSize = r.glyphSize;
+  t.glyphColors.resize(r.glyphColorCount);
+  if (r.glyphColorCount)
+    memcpy(t.glyphColors.data(), pool + r.glyphColors,
+           r.glyphColorCount * sizeof(uint32_t));
+  if (!ThemeInRange(t))
+    return false;
+  out = t;
+  return true;
+}
+
+std::shared_ptr<const ThemeBlob> ThemeLibrary::Get() const {
+  return std::atomic_load(&current);
+}
+
+bool ThemeLibrary::Load(const std::string &file) {
+  path = file;
+  return Reload();
+}
+
+bool ThemeLibrary::Reload() {
+  std::shared_ptr<ThemeBlob> blob(new ThemeBlob());
+  if (!blob->Open(path))
+    return false;
+  std::atomic_store(&current, std::shared_ptr<const ThemeBlob>(blob));
+  reloads++;
+  return true;
+}
+
+// Directory and file name parts of a path, either separator.
+static void SplitPath(const std::string &path, std::string &dir,
+                      std::string &name) {
+  const size_t slash = path.find_last_of("/\\");
+  dir = slash == std::string::npos ? "." : path.substr(0, slash);
+  name = slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+#ifdef _WIN32
+
+ThemeLibrary::ThemeLibrary() : watching(false), reloads(0), stopEvent(NULL) {}
+
+ThemeLibrary::~ThemeLibrary() { StopWatching(); }
+
+bool ThemeLibrary::Watch(std::function<void()> fn) {
+  if (watching || path.empty())
+    return false;
+  stopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+  if (!stopEvent)
+    return false;
+  onReload = fn;
+  watching = true;
+  thread = std::thread(&ThemeLibrary::Run, this);
+  return true;
+}
+
+void ThemeLibrary::StopWatching() {
+  watching = false;
+  if (stopEvent)
+    SetEvent(stopEvent);
+  if (thread.joinable())
+    thread.join();
+  if (stopEvent)
+    CloseHandle(stopEvent);
+  stopEvent = NULL;
+}
+
+void ThemeLibrary::Run() {
+  std::string dir, name;
+  SplitPath(path, dir, name);
+  std::wstring wideName(name.begin(), name.end()); // Our names are ASCII
+
+  HANDLE handle = CreateFileA(
+      dir.c_str(), FILE_LIST_DIRECTORY,
+      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+      OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+  if (handle == INVALID_HANDLE_VALUE)
+    return;
+  OVERLAPPED ov = {};
+  ov.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+  DWORD buffer[4096]; // DWORD-aligned, as ReadDirectoryChangesW requires
+  const HANDLE waits[2] = {ov.hEvent, (HANDLE)stopEvent};
+
+  while (watching) {
+    ResetEvent(ov.hEvent);
+    if (!ReadDirectoryChangesW(handle, buffer, sizeof(buffer), FALSE,
+                               FILE_NOTIFY_CHANGE_FILE_NAME |
+                                   FILE_NOTIFY_CHANGE_LAST_WRITE,
+                               NULL, &ov, NULL))
+      break;
+    if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0) {
+      CancelIoEx(handle, &ov);
+      DWORD ignored;
+      GetOverlappedResult(handle, &ov, &ignored, TRUE);
+      break;
+    }
+    DWORD bytes = 0;
+    if (!GetOverlappedResult(handle, &ov, &bytes, FALSE))
+      break;
+
+    bool ours = bytes == 0; // Overflowed: look anyway
+    for (const uint8_t *p = (const uint8_t *)buffer; bytes && !ours;) {
+      const FILE_NOTIFY_INFORMATION *info =
+          (const FILE_NOTIFY_INFORMATION *)p;
+      const std::wstring changed(info->FileName,
+                                 info->FileNameLength / sizeof(wchar_t));
+      ours = (info->Action == FILE_ACTION_ADDED ||
+              info->Action == FILE_ACTION_MODIFIED ||
+              info->Action == FILE_ACTION_RENAMED_NEW_NAME) &&
+             _wcsicmp(changed.c_str(), wideName.c_str()) == 0;
+      if (!info->NextEntryOffset)
+        break;
+      p += info->NextEntryOffset;
+    }
+    if (ours && Reload() && onReload)
+      onReload();
+  }
+  CloseHandle(ov.hEvent);
+  CloseHandle(handle);
+}
+
+#elif defined(__linux__)
+
+ThemeLibrary::ThemeLibrary()
+    : watching(false), reloads(0), notifyFd(-1), wakeFd(-1) {}
+
+ThemeLibrary::~ThemeLibrary() { StopWatching(); }
+
+bool ThemeLibrary::Watch(std::function<void()> fn) {
+  if (watching || path.empty())
+    return false;
+  std::string dir, name;
+  SplitPath(path, dir, name);
+  notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  // Replacing with rename() is IN_MOVED_TO; rewriting in place ends with
+  // IN_CLOSE_WRITE.
+  if (notifyFd < 0 || wakeFd < 0 ||
+      inotify_add_watch(notifyFd, dir.c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    StopWatching();
+    return false;
+  }
+  onReload = fn;
+  watching = true;
+  thread = std::thread(&ThemeLibrary::Run, this);
+  return true;
+}
+
+void ThemeLibrary::StopWatching() {
+  watching = false;
+  if (wakeFd >= 0) {
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;
+  }
+  if (thread.joinable())
+    thread.join();
+  if (notifyFd >= 0)
+    close(notifyFd);
+  if (wakeFd >= 0)
+    close(wakeFd);
+  notifyFd = wakeFd = -1;
+}
+
+void ThemeLibrary::Run() {
+  std::string dir, name;
+  SplitPath(path, dir, name);
+  pollfd fds[2] = {{notifyFd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+  alignas(inotify_event) char buf[4096];
+  while (watching) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    if (fds[1].revents)
+      break; // StopWatching()
+    bool ours = false;
+    ssize_t n;
+    while ((n = read(notifyFd, buf, sizeof(buf))) > 0) {
+      for (char *p = buf; p < buf + n;) {
+        const inotify_event *e = (const inotify_event *)p;
+        if ((e->mask & IN_Q_OVERFLOW) || (e->len && name == e->name))
+          ours = true;
+        p += sizeof(inotify_event) + e->len;
+      }
+    }
+    if (ours && Reload() && onReload)
+      onReload();
+  }
+}
+
+#else
+
+ThemeLibrary::ThemeLibrary()
+    : watching(false), reloads(0), notifyFd(-1), wakeFd(-1) {}
+
+ThemeLibrary::~ThemeLibrary() {}
+
+bool ThemeLibrary::Watch(std::function<void()>) { return false; }
+void ThemeLibrary::StopWatching() {}
+void ThemeLibrary::Run() {}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef THEMEPACK_H
+#define THEMEPACK_H
+
+#include "MappedFile.h"
+#include "ParticleSystem.h"
+#include "ThemeScene.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A theme as written in a theme pack: a text file of `key = value` lines;
+// lines starting with '#' are comments. Colours are #RRGGBB.
+//
+//   name = Matrix
+//   order = 2                  position in the theme cycle (then file name)
+//   background = #000000       or `system` for the Windows dialog colours
+//   text = #00FF00             ignored with background = system
+//   pattern = solid            or `cross #RRGGBB` (Blueprint's grid)
+//   animation = rain           none, stars or rain
+//   particles = 40             per 800x600, more in a larger window
+//   speed = 2.0 6.9            pixels per 1/30 s, min max
+//   length = 5 19              rain trail in glyphs, min max
+//   size = 1 2                 star size in pixels, min max
+//   brightness = 150 254       star brightness, min max
+//   glyphs = 01                rain characters
+//   glyph-font = Consolas      GDI face; the built-in font if missing
+//   glyph-size = 14            pixels at 96 DPI
+//   glyph-colors = #00FF00 #008C00 ...   head first, then each fade level
+struct ThemeDesc {
+  std::string name;
+  int order = 1000;
+  bool systemColors = false;
+  uint32_t background = 0; // 0xRRGGBB
+  uint32_t text = 0;
+  bool hatch = false;
+  uint32_t hatchColor = 0;
+  ThemeAnimation animation = ThemeAnimation::None;
+  uint32_t particleCount = 0;
+  ParticleParams particles;
+  std::string glyphs;
+  std::string glyphFont;
+  int glyphSize = 14;
+  std::vector<uint32_t> glyphColors;
+};
+
+// Parses one pack. False with `error` ("line N: ...") on a bad line.
+bool ParseThemePack(const std::string &text, ThemeDesc &out,
+                    std::string &error);
+
+// The compiled form of a set of packs, in the order given: a header, one
+// fixed-size record per theme and a pool of strings and colour arrays.
+// Loading it touches only the header; a theme is decoded when asked for.
+std::string EncodeThemeBlob(const std::vector<ThemeDesc> &themes);
+
+// Read-only view of a theme blob, memory-mapped.
+class ThemeBlob {
+public:
+  // Maps `path` and checks its header: constant time whatever the number of
+  // themes. False if missing or not a theme blob.
+  bool Open(const std::string &path);
+  // Same over bytes in memory, which must outlive this object.
+  bool Attach(const uint8_t *data, size_t size);
+
+  size_t Count() const { return count; }
+  // Decodes theme `index`. False if its record points outside the blob or
+  // holds a value ParseThemePack would have refused (ranges, colours, a
+  // missing name, rain without glyphs).
+  bool Get(size_t index, ThemeDesc &out) const;
+
+private:
+  MappedFile file;
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+  size_t count = 0;
+};
+
+// The theme blob the app draws with. Get() may be called from any thread;
+// Watch() reloads the file whenever it is replaced on disk (inotify on
+// Linux, ReadDirectoryChangesW on Windows) and swaps the new blob in with
+// one pointer exchange, so readers see the old themes or the new ones, and
+// the old mapping goes away when its last reader lets go. A blob that fails
+// to load is ignored and the current one kept. Only the blob is watched:
+// an edited pack shows up once AutoClickerThemes has recompiled it.
+class ThemeLibrary {
+public:
+  ThemeLibrary();
+  ~ThemeLibrary();
+
+  bool Load(const std::string &path);
+  std::shared_ptr<const ThemeBlob> Get() const;
+
+  // Called on the watcher thread after each successful reload.
+  bool Watch(std::function<void()> onReload);
+  void StopWatching();
+  uint64_t GetReloadCount() const { return reloads.load(); }
+
+private:
+  ThemeLibrary(const ThemeLibrary &) = delete;
+  ThemeLibrary &operator=(const ThemeLibrary &) = delete;
+
+  void Run();
+  bool Reload();
+
+  std::string path;
+  std::shared_ptr<const ThemeBlob> current; // std::atomic_load/store only
+  std::function<void()> onReload;
+  std::atomic<bool> watching;
+  std::atomic<uint64_t> reloads;
+  std::thread thread;
+#ifdef _WIN32
+  void *stopEvent; // HANDLE
+#else
+  int notifyFd;
+  int wakeFd; // eventfd that interrupts poll() on StopWatching()
+#endif
+};
+
+#endif // THEMEPACK_H
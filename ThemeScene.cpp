@@ -0,0 +1,167 @@
+#include "ThemeScene.h"
+
+void FillThemeBackground(Framebuffer &fb, const ThemeStyle &style, int x,
+                         int y, int w, int h) {
+  if (style.hatch)
+    FillHatchCross(fb, x, y, w, h, style.background, style.hatchColor);
+  else
+    FillRect(fb, x, y, w, h, style.background);
+}
+
+// Particle counts grow with the window so density stays the same; the
+// original dialog-sized field is the minimum.
+static size_t ScaleParticleCount(size_t base, int width, int height) {
+  size_t scaled = (size_t)width * (size_t)height * base / (800 * 600);
+  return scaled > base ? scaled : base;
+}
+
+static bool SameParticles(const ThemeStyle &a, const ThemeStyle &b) {
+  const ParticleParams &p = a.particles, &q = b.particles;
+  return a.animation == b.animation && a.particleCount == b.particleCount &&
+         p.minSpeed == q.minSpeed && p.maxSpeed == q.maxSpeed &&
+         p.minLength == q.minLength && p.maxLength == q.maxLength &&
+         p.minSize == q.minSize && p.maxSize == q.maxSize &&
+         p.minBrightness == q.minBrightness &&
+         p.maxBrightness == q.maxBrightness;
+}
+
+static uint32_t XorShift(uint32_t &s) {
+  s ^= s << 13;
+  s ^= s >> 17;
+  s ^= s << 5;
+  return s;
+}
+
+ThemeScene::ThemeScene(uint32_t seed)
+    : stylePending(false), seed(seed | 1u), width(0), height(0),
+      flickerSeed(0x2545F491), flickerClock(0.0) {}
+
+void ThemeScene::SetStyle(const ThemeStyle &newStyle) {
+  std::lock_guard<std::mutex> lock(styleMutex);
+  pendingStyle = newStyle;
+  stylePending = true;
+}
+
+size_t ThemeScene::ParticleCount() const {
+  switch (style.animation) {
+  case ThemeAnimation::Stars:
+    return stars.Count();
+  case ThemeAnimation::Rain:
+    return rain.Count();
+  default:
+    return 0;
+  }
+}
+
+void ThemeScene::Update(int w, int h, double seconds, int stepHz,
+                        DirtyRegion &dirty) {
+  bool changed = false;
+  {
+    std::lock_guard<std::mutex> lock(styleMutex);
+    if (stylePending) {
+      // Other particles (another theme, or this one edited): start over.
+      // Otherwise the field carries on, e.g. across a DPI change.
+      if (!SameParticles(style, pendingStyle)) {
+        stars.Clear();
+        rain.Clear();
+      }
+      style = pendingStyle;
+      pendingStyle.glyphs.reset();
+      stylePending = false;
+      changed = true;
+    }
+  }
+  if (changed || w != width || h != height) {
+    width = w;
+    height = h;
+    dirty.AddAll();
+  } else {
+    MarkParticles(dirty); // Where they were
+  }
+
+  const float spacing =
+      (float)(style.glyphs ? style.glyphs->CellHeight() : kRainSpacing);
+  if (style.animation == ThemeAnimation::Stars) {
+    const size_t count = ScaleParticleCount(style.particleCount, w, h);
+    if (stars.Empty())
+      stars.Init(count, style.particles, w, h, XorShift(seed));
+    stars.SetStepRate(stepHz);
+    stars.Resize(w, h);
+    stars.SetCount(count);
+    stars.Advance(seconds);
+  } else if (style.animation == ThemeAnimation::Rain) {
+    const size_t count = ScaleParticleCount(style.particleCount, w, h);
+    if (rain.Empty()) {
+      ParticleParams params = style.particles;
+      params.lengthSpacing = spacing;
+      rain.Init(count, params, w, h, XorShift(seed));
+    } else if (changed) {
+      rain.SetLengthSpacing(spacing);
+    }
+    rain.SetStepRate(stepHz);
+    rain.Resize(w, h);
+    rain.SetCount(count);
+    rain.Advance(seconds);
+
+    flickerClock += seconds;
+    if (flickerClock >= ParticleSystem::kStepSeconds) {
+      flickerClock = 0.0;
+      XorShift(flickerSeed);
+    }
+  }
+
+  MarkParticles(dirty); // Where they are now
+}
+
+void ThemeScene::MarkParticles(DirtyRegion &dirty) const {
+  if (style.animation == ThemeAnimation::Stars) {
+    const float *x = stars.X();
+    const float *y = stars.Y();
+    const uint8_t *size = stars.Size();
+    for (size_t i = 0; i < stars.Count(); i++)
+      dirty.Add((int)x[i], (int)y[i], size[i], size[i]);
+  } else if (style.animation == ThemeAnimation::Rain) {
+    const int cellWidth =
+        style.glyphs ? style.glyphs->CellWidth() : kRainSpacing;
+    const int spacing =
+        style.glyphs ? style.glyphs->CellHeight() : kRainSpacing;
+    const float *x = rain.X();
+    const float *y = rain.Y();
+    const uint8_t *length = rain.Length();
+    for (size_t m = 0; m < rain.Count(); m++) {
+      // Every glyph of a stream flickers, so the whole trail is dirty.
+      int trail = length[m] > 0 ? (length[m] - 1) * spacing : 0;
+      dirty.Add((int)x[m], (int)y[m] - trail, cellWidth, trail + spacing);
+    }
+  }
+}
+
+void ThemeScene::Render(Framebuffer &fb) const {
+  FillThemeBackground(fb, style, 0, 0, fb.Width(), fb.Height());
+
+  if (style.animation == ThemeAnimation::Stars) {
+    const float *x = stars.X();
+    const float *y = stars.Y();
+    const uint8_t *size = stars.Size();
+    const uint8_t *brightness = stars.Brightness();
+    for (size_t i = 0; i < stars.Count(); i++) {
+      int b = brightness[i];
+      FillRect(fb, (int)x[i], (int)y[i], size[i], size[i], PackColor(b, b, b));
+    }
+  } else if (style.animation == ThemeAnimation::Rain && style.glyphs &&
+             !style.glyphs->Empty()) {
+    const GlyphAtlas &glyphs = *style.glyphs;
+    const int spacing = glyphs.CellHeight();
+    uint32_t rng = flickerSeed;
+    const float *x = rain.X();
+    const float *y = rain.Y();
+    const uint8_t *length = rain.Length();
+    for (size_t m = 0; m < rain.Count(); m++) {
+      for (int i = 0; i < length[m]; i++) {
+        // Head is bright, tail fades; glyphs picked at random
+        glyphs.Draw(fb, (int)x[m], (int)y[m] - i * spacing,
+                    (int)(XorShift(rng) % (uint32_t)glyphs.GlyphCount()), i);
+      }
+    }
+  }
+}
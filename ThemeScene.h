@@ -0,0 +1,78 @@
+#ifndef THEMESCENE_H
+#define THEMESCENE_H
+
+#include "DirtyRegion.h"
+#include "GlyphAtlas.h"
+#include "ParticleSystem.h"
+#include "SoftRenderer.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+enum class ThemeAnimation {
+  None = 0,
+  Stars = 1, // Space
+  Rain = 2,  // Matrix
+};
+
+// Everything the background renderer needs to know about a theme.
+struct ThemeStyle {
+  ThemeAnimation animation = ThemeAnimation::None;
+  uint32_t background = PackColor(0, 0, 0);
+  bool hatch = false; // GDI HS_CROSS look-alike in hatchColor
+  uint32_t hatchColor = PackColor(0, 0, 0);
+  std::shared_ptr<const GlyphAtlas> glyphs; // Rain only
+  // Particles per 800x600 (more in a larger window) and how they move.
+  // Rain's lengthSpacing is taken from the glyph atlas.
+  size_t particleCount = 0;
+  ParticleParams particles;
+};
+
+// Fills a rectangle with the theme's background (solid or cross hatch).
+void FillThemeBackground(Framebuffer &fb, const ThemeStyle &style, int x,
+                         int y, int w, int h);
+
+// The animated part of a theme background: stars or digital rain. Owned by
+// the thread that renders; SetStyle is the only call that may come from
+// another thread, and takes effect at the next Update().
+class ThemeScene {
+public:
+  static const int kRainSpacing = 14; // Trail pitch without a glyph atlas
+
+  explicit ThemeScene(uint32_t seed);
+
+  void SetStyle(const ThemeStyle &style);
+
+  // Applies a pending style, follows the area size and advances the
+  // simulation by `seconds` in steps of 1 / stepHz. Marks in `dirty` the area
+  // of every particle before and after (everything after a style or size
+  // change).
+  void Update(int width, int height, double seconds, int stepHz,
+              DirtyRegion &dirty);
+
+  // Draws the whole frame: background, then particles.
+  void Render(Framebuffer &fb) const;
+
+  const ThemeStyle &Style() const { return style; }
+  size_t ParticleCount() const;
+
+private:
+  void MarkParticles(DirtyRegion &dirty) const;
+
+  std::mutex styleMutex;
+  ThemeStyle pendingStyle;
+  bool stylePending;
+
+  ThemeStyle style;
+  ParticleSystem stars;
+  ParticleSystem rain;
+  uint32_t seed;
+  int width;
+  int height;
+  // Rain glyphs flicker at the original 30 Hz whatever the frame rate.
+  uint32_t flickerSeed;
+  double flickerClock;
+};
+
+#endif // THEMESCENE_H
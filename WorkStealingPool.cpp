@@ -0,0 +1,112 @@
+#include "WorkStealingPool.h"
+
+WorkStealingPool::WorkStealingPool(int threads)
+    : generation(0), stopping(false), job(nullptr), pending(0), steals(0) {
+  if (threads <= 0)
+    threads = (int)std::thread::hardware_concurrency();
+  if (threads <= 0)
+    threads = 1;
+  for (int i = 0; i < threads; i++)
+    queues.emplace_back(new Queue());
+  for (int i = 1; i < threads; i++)
+    helpers.emplace_back(&WorkStealingPool::HelperThread, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> guard(wakeLock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread &t : helpers)
+    t.join();
+}
+
+void WorkStealingPool::ParallelFor(int count,
+                                   const std::function<void(int)> &fn) {
+  if (count <= 0)
+    return;
+  std::lock_guard<std::mutex> serial(callerLock);
+  if (count == 1 || queues.size() == 1) {
+    for (int i = 0; i < count; i++)
+      fn(i);
+    return;
+  }
+
+  // Published before any task, so whoever takes a task sees the function.
+  job.store(&fn);
+  pending.store(count);
+  const int n = (int)queues.size();
+  for (int q = 0; q < n; q++) {
+    std::lock_guard<std::mutex> guard(queues[q]->lock);
+    for (int i = (int)((int64_t)count * q / n);
+         i < (int)((int64_t)count * (q + 1) / n); i++)
+      queues[q]->tasks.push_back(i);
+  }
+  {
+    std::lock_guard<std::mutex> guard(wakeLock);
+    generation++;
+  }
+  wake.notify_all();
+
+  RunTasks(0);
+
+  // The last tasks may still be running on helpers.
+  std::unique_lock<std::mutex> guard(wakeLock);
+  done.wait(guard, [this] { return pending.load() == 0; });
+}
+
+void WorkStealingPool::HelperThread(int self) {
+  uint64_t seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> guard(wakeLock);
+      wake.wait(guard, [&] { return stopping || generation != seen; });
+      if (stopping)
+        return;
+      seen = generation;
+    }
+    RunTasks(self);
+  }
+}
+
+int WorkStealingPool::RunTasks(int self) {
+  int ran = 0;
+  int task;
+  while (Take(self, task)) {
+    (*job.load())(task);
+    ran++;
+    if (pending.fetch_sub(1) == 1) {
+      // Taking the lock orders this with the caller's check-then-wait.
+      std::lock_guard<std::mutex> guard(wakeLock);
+      done.notify_all();
+    }
+  }
+  return ran;
+}
+
+bool WorkStealingPool::Take(int self, int &task) {
+  {
+    Queue &own = *queues[self];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (!own.tasks.empty()) {
+      task = own.tasks.back();
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+  // Steal the oldest task of the next thread that has any. Dealt runs are
+  // contiguous, so the front is furthest from where the owner is working.
+  const int n = (int)queues.size();
+  for (int k = 1; k < n; k++) {
+    Queue &victim = *queues[(self + k) % n];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.tasks.empty()) {
+      task = victim.tasks.front();
+      victim.tasks.pop_front();
+      steals.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,62 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of helper threads for data-parallel loops. ParallelFor deals the
+// indices out in contiguous runs, one per thread (the caller is one of
+// them). Each thread works through its own run from the back and, once it is
+// empty, steals from the front of another thread's run, so a thread that got
+// the expensive tiles is helped instead of waited for.
+//
+// Helpers sleep on a condition variable between loops. One ParallelFor runs
+// at a time; concurrent callers are serialized.
+class WorkStealingPool {
+public:
+  // `threads` includes the calling thread; 0 means one per hardware thread.
+  explicit WorkStealingPool(int threads = 0);
+  ~WorkStealingPool();
+
+  int GetThreadCount() const { return (int)queues.size(); }
+
+  // Runs fn(i) for every i in [0, count) and returns when all are done.
+  void ParallelFor(int count, const std::function<void(int index)> &fn);
+
+  // Tasks that ran on another thread than the one they were dealt to.
+  uint64_t GetStealCount() const { return steals.load(); }
+
+private:
+  struct Queue {
+    std::mutex lock;
+    std::deque<int> tasks;
+  };
+
+  void HelperThread(int self);
+  // Runs tasks until none are left to take; returns how many it ran.
+  int RunTasks(int self);
+  bool Take(int self, int &task);
+
+  std::vector<std::unique_ptr<Queue>> queues; // [0] is the caller's
+  std::vector<std::thread> helpers;
+  std::mutex callerLock; // One ParallelFor at a time
+
+  std::mutex wakeLock;
+  std::condition_variable wake;
+  std::condition_variable done;
+  uint64_t generation; // Bumped per ParallelFor, under wakeLock
+  bool stopping;
+
+  std::atomic<const std::function<void(int)> *> job;
+  std::atomic<int> pending;
+  std::atomic<uint64_t> steals;
+};
+
+#endif // WORKSTEALINGPOOL_H
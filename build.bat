@@ -1,6 +1,8 @@
 @echo off
 if not exist "bin" mkdir bin
 
+set ENGINE=AutoClicker.cpp ClickEngine.cpp ClickHumanizer.cpp ClickScheduler.cpp Clock.cpp ControlProtocol.cpp ControlServer.cpp DirtyRegion.cpp DisplayList.cpp Distribution.cpp GlyphAtlas.cpp HotkeyListener.cpp InputCapture.cpp InputLog.cpp InputSink.cpp LatencyHistogram.cpp Macro.cpp MappedFile.cpp ParticleSystem.cpp PixelTrigger.cpp RealTime.cpp RenderLoop.cpp ScreenCapture.cpp SettingsFile.cpp SettingsStore.cpp SoftRenderer.cpp TemplateMatcher.cpp ThemePack.cpp ThemeScene.cpp WorkStealingPool.cpp
+
 echo Compiling Resources...
 rc /fo bin\AutoClicker.res AutoClicker.rc
 if %errorlevel% neq 0 (
@@ -9,17 +11,42 @@ if %errorlevel% neq 0 (
 )
 
 echo Compiling Application...
-cl /EHsc /W3 /O2 /DUNICODE /D_UNICODE ^
-    main.cpp AutoClicker.cpp ^
+cl /EHsc /W3 /O2 /std:c++17 /DUNICODE /D_UNICODE ^
+    main.cpp %ENGINE% ^
     bin\AutoClicker.res ^
-    user32.lib gdi32.lib shell32.lib comctl32.lib ^
+    user32.lib gdi32.lib shell32.lib comctl32.lib avrt.lib winmm.lib ^
     /Fe:bin\AutoClicker.exe /link /SUBSYSTEM:WINDOWS
+if %errorlevel% neq 0 goto failed
 
-if %errorlevel% == 0 (
-    echo.
-    echo Build Successful! 
-    echo Run bin\AutoClicker.exe to start.
-) else (
-    echo Build Failed!
-)
+echo Compiling Benchmarks...
+cl /EHsc /W3 /O2 /std:c++17 /DUNICODE /D_UNICODE ^
+    Bench.cpp %ENGINE% ^
+    user32.lib gdi32.lib avrt.lib winmm.lib ^
+    /Fe:bin\AutoClickerBench.exe /link /SUBSYSTEM:CONSOLE
+if %errorlevel% neq 0 goto failed
+
+echo Compiling Headless Clicker...
+cl /EHsc /W3 /O2 /std:c++17 /DUNICODE /D_UNICODE ^
+    Cli.cpp %ENGINE% ^
+    user32.lib gdi32.lib avrt.lib winmm.lib ^
+    /Fe:bin\AutoClickerCli.exe /link /SUBSYSTEM:CONSOLE
+if %errorlevel% neq 0 goto failed
+
+echo Compiling Theme Packs...
+cl /EHsc /W3 /O2 /std:c++17 /DUNICODE /D_UNICODE ^
+    ThemeCompiler.cpp %ENGINE% ^
+    user32.lib gdi32.lib avrt.lib winmm.lib ^
+    /Fe:bin\AutoClickerThemes.exe /link /SUBSYSTEM:CONSOLE
+if %errorlevel% neq 0 goto failed
+bin\AutoClickerThemes.exe bin\themes.bin themes
+if %errorlevel% neq 0 goto failed
+
+echo.
+echo Build Successful! 
+echo Run bin\AutoClicker.exe to start.
+pause
+exit /b 0
+
+:failed
+echo Build Failed!
 pause
@@ -0,0 +1,25 @@
+#!/bin/sh
+# Linux build of the portable click engine and its headless tools.
+# The Windows GUI is built with build.bat.
+set -e
+cd "$(dirname "$0")"
+mkdir -p bin
+
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-"-std=c++17 -O2 -Wall -pthread"}
+
+ENGINE="AutoClicker.cpp ClickEngine.cpp ClickHumanizer.cpp ClickScheduler.cpp Clock.cpp ControlProtocol.cpp ControlServer.cpp DirtyRegion.cpp DisplayList.cpp Distribution.cpp GlyphAtlas.cpp HotkeyListener.cpp InputCapture.cpp InputLog.cpp InputSink.cpp LatencyHistogram.cpp Macro.cpp MappedFile.cpp ParticleSystem.cpp PixelTrigger.cpp RealTime.cpp RenderLoop.cpp ScreenCapture.cpp SettingsFile.cpp SettingsStore.cpp SoftRenderer.cpp TemplateMatcher.cpp ThemePack.cpp ThemeScene.cpp WorkStealingPool.cpp"
+
+echo "Compiling Benchmarks..."
+$CXX $CXXFLAGS Bench.cpp $ENGINE -o bin/AutoClickerBench
+
+echo "Compiling Headless Clicker..."
+$CXX $CXXFLAGS Cli.cpp $ENGINE -o bin/AutoClickerCli
+
+echo "Compiling Theme Packs..."
+$CXX $CXXFLAGS ThemeCompiler.cpp $ENGINE -o bin/AutoClickerThemes
+bin/AutoClickerThemes bin/themes.bin themes
+
+echo
+echo "Build Successful!"
+echo "Run bin/AutoClickerBench to list the benchmarks, bin/AutoClickerCli --help for the headless clicker."
@@ -1,8 +1,19 @@
 #include "AutoClicker.h"
+#include "ControlServer.h"
+#include "DirtyRegion.h"
+#include "DisplayList.h"
+#include "GlyphAtlas.h"
+#include "HotkeyListener.h"
+#include "RenderLoop.h"
+#include "SettingsStore.h"
+#include "SoftRenderer.h"
+#include "ThemePack.h"
+#include "ThemeScene.h"
 #include "resource.h"
+#include <atomic>
 #include <commctrl.h>
 #include <ctime>
-#include <fstream>
+#include <cwchar>
 #include <string>
 #include <vector>
 #include <windows.h>
@@ -11,27 +22,54 @@
 
 AutoClicker g_clicker;
 HWND g_hDlg = NULL;
+// Scripted control (settings.controlServer), on \\.\pipe\AutoClicker-<pid>.
+std::unique_ptr<ControlServer> g_control;
+
+// Start/Stop hotkeys are watched by a thread of their own that toggles the
+// clicker itself with settings resolved as the dialog changes, so a busy
+// message loop cannot delay them. It tells the dialog with WM_APP_TOGGLED.
+// RegisterHotKey / WM_HOTKEY is the fallback when it cannot start.
+HotkeyListener g_hotkeys;
+HotkeyListener::JobId g_hotkeyJob = 0;
+bool g_hotkeyThread = false;
+const UINT WM_APP_TOGGLED = WM_APP + 2;
+
+// Themes come from themes.bin beside the executable, compiled from
+// themes/*.theme by AutoClickerThemes. Rewriting it swaps the new themes in
+// while running: the watcher thread posts WM_APP_THEMES and the current theme
+// is rebuilt.
+ThemeLibrary g_themes;
+const UINT WM_APP_THEMES = WM_APP + 3;
 
 // Theme globals
 HBRUSH g_hbrTheme = NULL;
 COLORREF g_textColor = RGB(0, 0, 0);
 COLORREF g_bkColor = GetSysColor(COLOR_3DFACE);
-
-// Animation Structs
-struct Star {
-  float x, y;
-  float speed;
-  int size;
-  COLORREF color;
-};
-std::vector<Star> g_stars;
-
-struct MatrixStream {
-  float x, y;
-  float speed;
-  int length;
-};
-std::vector<MatrixStream> g_matrix;
+bool g_hatch = false; // Background is a cross hatch (Blueprint)
+COLORREF g_hatchColor = RGB(0, 0, 0);
+
+// Background style as handed to the render thread; also used to paint before
+// its first frame arrives.
+ThemeStyle g_style;
+
+// The back buffer: a DIB section that lives across frames and is reallocated
+// only when the client area changes size. g_frame points at its pixels.
+Framebuffer g_frame;
+HDC g_backDC = NULL;
+HBITMAP g_backBitmap = NULL;
+HBITMAP g_backOldBitmap = NULL;
+HRGN g_updateRgn = NULL; // Reused to fetch each WM_PAINT's update region
+
+// Animation runs on its own thread at ClickSettings::frameRateHz, so a busy
+// dialog (modal boxes, joining the worker) no longer stalls it. Finished
+// frames are announced with WM_APP_PRESENT; only what changed is invalidated,
+// in at most MAX_DIRTY_RECTS rectangles.
+ThemeScene g_scene((uint32_t)time(NULL));
+RenderLoop g_render;
+std::atomic<bool> g_presentPending(false);
+uint64_t g_presentedSequence = 0;
+const UINT WM_APP_PRESENT = WM_APP + 1;
+const size_t MAX_DIRTY_RECTS = 1024;
 
 // Layout Replication
 struct LayoutElement {
@@ -40,10 +78,13 @@ struct LayoutElement {
   bool isGroup;
 };
 std::vector<LayoutElement> g_layout;
+// g_layout compiled for drawing (CompileOverlay); replayed by each WM_PAINT
+DisplayList g_overlay;
+HBRUSH g_overlayBrush = NULL; // Group box borders, in g_textColor
 
 // Forward declarations
-void InitTheme(int themeIndex);
-void UpdateAnimation(int themeIndex, int width, int height);
+void UpdateTheme(int themeIndex);
+void CompileOverlay();
 
 // Helper to format hotkey string
 std::wstring GetHotkeyString(int vk, int mod) {
@@ -80,39 +121,22 @@ UINT GetWinModFromCommCtrl(int mod) {
 }
 
 const int HK_START_STOP = 1;
-const char *SETTINGS_FILE = "settings.dat";
+const int HK_START_STOP_ALT = 2;
 
-void SaveSettings(const ClickSettings &settings) {
-  std::ofstream file(SETTINGS_FILE, std::ios::binary);
-  if (file.is_open()) {
-    file.write(reinterpret_cast<const char *>(&settings),
-               sizeof(ClickSettings));
-  }
-}
+// Read once at startup; paint/timer code reads the in-memory copy.
+SettingsStore g_settings("settings.dat");
 
-ClickSettings LoadSettings() {
-  ClickSettings s;
-  // Initialize with defaults in case file doesn't exist or is corrupt
-  s.intervalMs = 100;
-  s.isLeftClick = true;
-  s.fixedPosition = false;
-  s.x = 0;
-  s.y = 0;
-  s.themeIndex = 0;
-
-  std::ifstream file(SETTINGS_FILE, std::ios::binary);
-  if (file.is_open()) {
-    file.read(reinterpret_cast<char *>(&s), sizeof(ClickSettings));
-  }
-  return s;
-}
+// Run state the dialog shows. The timer compares it with the clicker's, so
+// runs started or stopped by control clients, or ended by a macro, show up.
+bool g_shownRunning = false;
 
 void UpdateUIState() {
   bool running = g_clicker.IsRunning();
+  g_shownRunning = running;
   SetDlgItemText(g_hDlg, IDC_BTN_STARTSTOP, running ? L"Stop" : L"Start");
 
   // Update button text with hotkey
-  ClickSettings s = LoadSettings();
+  ClickSettings s = g_settings.Get();
   std::wstring btnText = running ? L"Stop (" : L"Start (";
   btnText += GetHotkeyString(s.hotkeyVk, s.hotkeyMod);
   btnText += L")";
@@ -121,30 +145,29 @@ void UpdateUIState() {
   SetDlgItemText(g_hDlg, IDC_STAT_STATUS,
                  running ? L"Status: Running" : L"Status: Stopped");
 
-  // Disable inputs while running
-  EnableWindow(GetDlgItem(g_hDlg, IDC_EDIT_INTERVAL), !running);
-  EnableWindow(GetDlgItem(g_hDlg, IDC_RADIO_LEFT), !running);
-  EnableWindow(GetDlgItem(g_hDlg, IDC_RADIO_RIGHT), !running);
-  EnableWindow(GetDlgItem(g_hDlg, IDC_RADIO_CURRENT), !running);
-  EnableWindow(GetDlgItem(g_hDlg, IDC_RADIO_FIXED), !running);
-
-  // only enable coords if Fixed is checked AND not running
+  // Inputs stay editable while running (see ApplyLiveSettings); coords
+  // only when Fixed is checked
   bool fixed = IsDlgButtonChecked(g_hDlg, IDC_RADIO_FIXED) == BST_CHECKED;
-  EnableWindow(GetDlgItem(g_hDlg, IDC_EDIT_X), !running && fixed);
-  EnableWindow(GetDlgItem(g_hDlg, IDC_EDIT_Y), !running && fixed);
+  EnableWindow(GetDlgItem(g_hDlg, IDC_EDIT_X), fixed);
+  EnableWindow(GetDlgItem(g_hDlg, IDC_EDIT_Y), fixed);
 }
 
 void UpdateClickCount() {
-  if (g_hDlg) {
-    std::wstring s = L"Clicks: " + std::to_wstring(g_clicker.GetClickCount());
+  // Only touch the label (and make it repaint) when the count changed.
+  static unsigned long shown = (unsigned long)-1;
+  if (g_hDlg && g_clicker.GetClickCount() != shown) {
+    shown = g_clicker.GetClickCount();
+    std::wstring s = L"Clicks: " + std::to_wstring(shown);
     SetDlgItemText(g_hDlg, IDC_STAT_CLICKS, s.c_str());
   }
 }
 
 ClickSettings GetSettingsFromUI() {
-  ClickSettings s;
+  // Start from the stored settings so fields without a control (theme,
+  // hotkey, sub-millisecond interval, miss policy, frame rate) are preserved.
+  ClickSettings s = g_settings.Get();
   s.intervalMs = GetDlgItemInt(g_hDlg, IDC_EDIT_INTERVAL, NULL, FALSE);
-  if (s.intervalMs < 1)
+  if (s.intervalMs < 1 && s.intervalUs <= 0)
     s.intervalMs = 1; // Minimum safety
 
   s.isLeftClick = (IsDlgButtonChecked(g_hDlg, IDC_RADIO_LEFT) == BST_CHECKED);
@@ -165,146 +188,242 @@ void SetUIFromSettings(const ClickSettings &s) {
   SetDlgItemInt(g_hDlg, IDC_EDIT_Y, s.y, TRUE);
 }
 
-void InitTheme(int themeIndex) {
-  if (themeIndex % 6 == 5) { // Space
-    if (g_stars.empty()) {
-      for (int i = 0; i < 100; i++) {
-        Star s;
-        s.x = (float)(rand() % 800);
-        s.y = (float)(rand() % 600);
-        s.speed = 1.0f + (rand() % 50) / 10.0f;
-        s.size = (rand() % 2) + 1;
-        int b = 150 + rand() % 105;
-        s.color = RGB(b, b, b);
-        g_stars.push_back(s);
-      }
-    }
-  } else if (themeIndex % 6 == 2) { // Matrix
-    if (g_matrix.empty()) {
-      for (int i = 0; i < 40; i++) {
-        MatrixStream m;
-        m.x = (float)(rand() % 800);
-        m.y = (float)(rand() % 600);
-        m.speed = 2.0f + (rand() % 50) / 10.0f;
-        m.length = 5 + (rand() % 15);
-        g_matrix.push_back(m);
-      }
-    }
+// Both Start/Stop hotkeys of the settings, as the listener takes them.
+std::vector<Hotkey> GetHotkeys(const ClickSettings &s) {
+  std::vector<Hotkey> keys;
+  keys.push_back(HotkeyFromSettings(s.hotkeyVk, s.hotkeyMod));
+  if (s.altHotkeyVk)
+    keys.push_back(HotkeyFromSettings(s.altHotkeyVk, s.altHotkeyMod));
+  return keys;
+}
+
+void RegisterHotkeys(const ClickSettings &s) {
+  if (g_hotkeyThread) {
+    g_hotkeys.SetHotkeys(g_hotkeyJob, GetHotkeys(s));
+    return;
   }
+  UnregisterHotKey(g_hDlg, HK_START_STOP);
+  UnregisterHotKey(g_hDlg, HK_START_STOP_ALT);
+  if (!RegisterHotKey(g_hDlg, HK_START_STOP,
+                      GetWinModFromCommCtrl(s.hotkeyMod), s.hotkeyVk))
+    MessageBox(g_hDlg, L"Failed to register hotkey!", L"Error",
+               MB_OK | MB_ICONERROR);
+  if (s.altHotkeyVk)
+    RegisterHotKey(g_hDlg, HK_START_STOP_ALT,
+                   GetWinModFromCommCtrl(s.altHotkeyMod), s.altHotkeyVk);
 }
 
-void UpdateAnimation(int themeIndex, int width, int height) {
-  if (themeIndex % 6 == 5) { // Space
-    for (auto &s : g_stars) {
-      s.y += s.speed;
-      if (s.y > height) {
-        s.y = 0;
-        s.x = (float)(rand() % width);
-      }
-    }
-  } else if (themeIndex % 6 == 2) { // Matrix
-    for (auto &m : g_matrix) {
-      m.y += m.speed;
-      if (m.y - (m.length * 14) > height) {
-        m.y = 0;
-        m.x = (float)(rand() % width);
-        m.length = 5 + (rand() % 15);
-      }
-    }
+// What the hotkey thread starts the clicker with; refreshed on every change
+// in the dialog, so a hotkey never reads a control.
+void ResolveHotkeySettings() {
+  if (g_hotkeyThread)
+    g_hotkeys.SetSettings(g_hotkeyJob, GetSettingsFromUI());
+}
+
+// Hands the dialog's values to a running clicker, which switches at its next
+// tick. Edits call this when they lose focus rather than per keystroke, so
+// half-typed intervals ("5" on the way to "500") never reach the worker.
+void ApplyLiveSettings() {
+  ResolveHotkeySettings();
+  if (g_clicker.IsRunning())
+    g_clicker.UpdateSettings(GetSettingsFromUI());
+}
+
+static uint32_t ToPixel(COLORREF c) {
+  return PackColor(GetRValue(c), GetGValue(c), GetBValue(c));
+}
+
+static COLORREF ToColorRef(uint32_t rgb) {
+  return RGB((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF);
+}
+
+// Rasterizes a theme's rain glyphs, in every colour it lists, for the
+// dialog's current DPI.
+static std::shared_ptr<const GlyphAtlas> BuildGlyphs(const ThemeDesc &theme) {
+  HDC hdc = GetDC(g_hDlg);
+  int dpi = GetDeviceCaps(hdc, LOGPIXELSY);
+  ReleaseDC(g_hDlg, hdc);
+
+  std::vector<GlyphMask> masks;
+  int cellWidth = 0, cellHeight = 0;
+  const int height = MulDiv(theme.glyphSize, dpi, 96);
+  const std::wstring font(theme.glyphFont.begin(), theme.glyphFont.end());
+  if (font.empty() ||
+      !RasterizeGdiGlyphs(font.c_str(), height, FW_BOLD, theme.glyphs.c_str(),
+                          masks, cellWidth, cellHeight)) {
+    cellHeight = height;
+    RasterizeBuiltinGlyphs(theme.glyphs.c_str(), cellHeight, masks,
+                           cellWidth);
   }
+
+  std::vector<uint32_t> levels;
+  for (uint32_t rgb : theme.glyphColors)
+    levels.push_back(PackColor((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF,
+                               rgb & 0xFF));
+  std::shared_ptr<GlyphAtlas> atlas(new GlyphAtlas());
+  atlas->Build(masks, cellWidth, cellHeight, levels);
+  return atlas;
 }
 
 void UpdateTheme(int themeIndex) {
   if (g_hbrTheme)
     DeleteObject(g_hbrTheme);
 
-  switch (themeIndex % 6) {
-  case 0: // Default
+  // Without themes.bin (or with an empty one) only Default is left.
+  ThemeDesc theme;
+  theme.name = "Default";
+  theme.systemColors = true;
+  std::shared_ptr<const ThemeBlob> themes = g_themes.Get();
+  if (themes && themes->Count())
+    themes->Get(themeIndex % themes->Count(), theme);
+
+  g_hatch = theme.hatch;
+  g_hatchColor = ToColorRef(theme.hatchColor);
+  if (theme.systemColors) {
     g_bkColor = GetSysColor(COLOR_3DFACE);
     g_textColor = GetSysColor(COLOR_WINDOWTEXT);
     g_hbrTheme = GetSysColorBrush(COLOR_3DFACE);
-    break;
-  case 1: // Dark Mode
-    g_bkColor = RGB(50, 50, 50);
-    g_textColor = RGB(255, 255, 255);
-    g_hbrTheme = CreateSolidBrush(g_bkColor);
-    break;
-  case 2: // Matrix
-    g_bkColor = RGB(0, 0, 0);
-    g_textColor = RGB(0, 255, 0);
-    g_hbrTheme = CreateSolidBrush(g_bkColor);
-    break;
-  case 3: // Blueprint
-    g_bkColor = RGB(20, 40, 100);
-    g_textColor = RGB(200, 220, 255);
-    g_hbrTheme = CreateHatchBrush(HS_CROSS, RGB(30, 60, 150)); // Grid pattern
-    break;
-  case 4: // Sunset
-    g_bkColor = RGB(255, 100, 50);
-    g_textColor = RGB(50, 0, 0);
-    g_hbrTheme = CreateSolidBrush(g_bkColor);
-    break;
-  case 5: // Space
-    g_bkColor = RGB(0, 0, 20);
-    g_textColor = RGB(200, 200, 255);
-    g_hbrTheme = CreateSolidBrush(g_bkColor);
-    break;
+  } else {
+    g_bkColor = ToColorRef(theme.background);
+    g_textColor = ToColorRef(theme.text);
+    g_hbrTheme = g_hatch ? CreateHatchBrush(HS_CROSS, g_hatchColor)
+                         : CreateSolidBrush(g_bkColor);
   }
 
+  ThemeStyle style;
+  style.background = ToPixel(g_bkColor);
+  style.hatch = g_hatch;
+  style.hatchColor = ToPixel(g_hatchColor);
+  style.animation = theme.animation;
+  style.particleCount = theme.particleCount;
+  style.particles = theme.particles;
+  if (theme.animation == ThemeAnimation::Rain)
+    style.glyphs = BuildGlyphs(theme);
+  g_style = style;
+  g_scene.SetStyle(style);
+  // A static background is composed once, then the render thread parks.
+  g_render.SetAnimated(style.animation != ThemeAnimation::None);
+  CompileOverlay(); // Border brush and text colour, extents at this DPI
+
   // Force full repaint of children too (because of WS_CLIPCHILDREN)
   RedrawWindow(g_hDlg, NULL, NULL,
                RDW_INVALIDATE | RDW_UPDATENOW | RDW_ALLCHILDREN);
 }
 
-void DrawThemeBackground(HDC hdc, RECT r, int themeIndex) {
-  // Fill background first
-  // Fill background
-  // Use g_hbrTheme so that Hatch brushes (Blueprint) show the pattern.
-  // Ensure BkColor/Mode are set for the gaps in the hatch.
-  COLORREF oldBk = SetBkColor(hdc, g_bkColor);
-  int oldMode = SetBkMode(hdc, OPAQUE);
-
-  FillRect(hdc, &r, g_hbrTheme);
-
-  SetBkColor(hdc, oldBk);
-  SetBkMode(hdc, oldMode);
-
-  if (themeIndex % 6 == 5) { // Space
-    for (const auto &s : g_stars) {
-      SetPixel(hdc, (int)s.x, (int)s.y, s.color);
-      if (s.size > 1) {
-        SetPixel(hdc, (int)s.x + 1, (int)s.y, s.color);
-        SetPixel(hdc, (int)s.x, (int)s.y + 1, s.color);
-        SetPixel(hdc, (int)s.x + 1, (int)s.y + 1, s.color);
-      }
-    }
-  } else if (themeIndex % 6 == 2) { // Matrix
-    SetBkMode(hdc, TRANSPARENT);
-    HFONT hFont =
-        CreateFont(14, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE, ANSI_CHARSET,
-                   OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
-                   DEFAULT_PITCH | FF_MODERN, L"Consolas");
-    HFONT hOld = (HFONT)SelectObject(hdc, hFont);
-
-    for (const auto &m : g_matrix) {
-      for (int i = 0; i < m.length; i++) {
-        // Head is bright, tail fades (LUT or simple logic)
-        int green = 255;
-        if (i > 0)
-          green = 150 - (i * 10);
-        if (green < 50)
-          green = 50;
-
-        SetTextColor(hdc, RGB(0, green, 0));
-
-        char c = (rand() % 2) ? '1' : '0';
-        // Draw at y - index * spacing
-        TextOutA(hdc, (int)m.x, (int)m.y - (i * 14), &c, 1);
-      }
+// (Re)creates the back buffer when the client size changed. g_frame then
+// points directly at its pixels.
+static void EnsureBackBuffer(HDC hdc, int width, int height) {
+  if (width < 1)
+    width = 1;
+  if (height < 1)
+    height = 1;
+  if (g_backBitmap && g_frame.Width() == width && g_frame.Height() == height)
+    return;
+
+  if (!g_backDC)
+    g_backDC = CreateCompatibleDC(hdc);
+  BITMAPINFO bmi = {};
+  bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+  bmi.bmiHeader.biWidth = width;
+  bmi.bmiHeader.biHeight = -height; // Top-down, same layout as Framebuffer
+  bmi.bmiHeader.biPlanes = 1;
+  bmi.bmiHeader.biBitCount = 32;
+  bmi.bmiHeader.biCompression = BI_RGB;
+  void *bits = nullptr;
+  HBITMAP bitmap =
+      CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+  if (!bitmap)
+    return;
+
+  HBITMAP old = (HBITMAP)SelectObject(g_backDC, bitmap);
+  if (g_backBitmap)
+    DeleteObject(g_backBitmap);
+  else
+    g_backOldBitmap = old;
+  g_backBitmap = bitmap;
+  g_frame.Attach((uint32_t *)bits, width, height, width);
+}
+
+static void FreeBackBuffer() {
+  if (g_backDC) {
+    SelectObject(g_backDC, g_backOldBitmap);
+    DeleteDC(g_backDC);
+  }
+  if (g_backBitmap)
+    DeleteObject(g_backBitmap);
+  g_backDC = NULL;
+  g_backBitmap = NULL;
+}
+
+// Rectangles of a region, in a buffer reused across calls.
+static const std::vector<RECT> &GetRegionRects(HRGN rgn) {
+  static std::vector<char> data;
+  static std::vector<RECT> rects;
+  rects.clear();
+  DWORD size = GetRegionData(rgn, 0, NULL);
+  if (size == 0)
+    return rects;
+  if (data.size() < size)
+    data.resize(size);
+  RGNDATA *rgnData = (RGNDATA *)data.data();
+  if (GetRegionData(rgn, size, rgnData) == 0)
+    return rects;
+  const RECT *r = (const RECT *)rgnData->Buffer;
+  rects.assign(r, r + rgnData->rdh.nCount);
+  return rects;
+}
+
+// Copies the background of `rects` from the newest rendered frame into the
+// back buffer. Before the first frame (or while one of the new size is not
+// ready yet) the plain theme background is used.
+void DrawThemeBackground(const std::vector<RECT> &rects) {
+  const RenderFrame *frame = g_render.FrontFrame();
+  const bool usable = frame && frame->pixels.Width() == g_frame.Width() &&
+                      frame->pixels.Height() == g_frame.Height();
+  GdiFlush(); // GDI must be done with the DIB before we write to it
+  for (const RECT &r : rects) {
+    if (usable)
+      CopyPixels(g_frame, frame->pixels, r.left, r.top, r.right - r.left,
+                 r.bottom - r.top);
+    else
+      FillThemeBackground(g_frame, g_style, r.left, r.top, r.right - r.left,
+                          r.bottom - r.top);
+  }
+}
+
+// Render thread: advance the scene and draw the whole frame.
+static void ComposeFrame(RenderFrame &frame, double seconds, int rateHz) {
+  g_scene.Update(frame.pixels.Width(), frame.pixels.Height(), seconds, rateHz,
+                 frame.dirty);
+  g_scene.Render(frame.pixels);
+}
+
+// Render thread: ask the UI thread to present, at most one request queued.
+static void OnFrameReady() {
+  if (!g_presentPending.exchange(true))
+    PostMessage(g_hDlg, WM_APP_PRESENT, 0, 0);
+}
+
+// UI thread: takes the newest frame and invalidates what changed since the
+// one presented before it (everything if frames were skipped in between).
+static void PresentFrame() {
+  g_presentPending = false;
+  bool fresh = false;
+  const RenderFrame *frame = g_render.AcquireFrame(&fresh);
+  if (!frame || !fresh)
+    return;
+
+  if (frame->sequence == g_presentedSequence + 1) {
+    static std::vector<DirtyRect> dirty;
+    frame->dirty.GetRects(dirty, MAX_DIRTY_RECTS);
+    for (const DirtyRect &d : dirty) {
+      RECT rc = {d.left, d.top, d.right, d.bottom};
+      InvalidateRect(g_hDlg, &rc, FALSE);
     }
-    SelectObject(hdc, hOld);
-    DeleteObject(hFont);
+  } else {
+    InvalidateRect(g_hDlg, NULL, FALSE);
   }
+  g_presentedSequence = frame->sequence;
 }
 
 // Callback to scan controls
@@ -371,60 +490,66 @@ void ScanLayout() {
   EnumChildWindows(g_hDlg, ScanEnumProc, 0);
 }
 
-// Custom Draw Helper
-void DrawUIOverlay(HDC hdc) {
-  SetBkMode(hdc, TRANSPARENT);
-  SetTextColor(hdc, g_textColor);
-
-  HFONT hFont = (HFONT)GetStockObject(DEFAULT_GUI_FONT);
-  HFONT hOld = (HFONT)SelectObject(hdc, hFont);
-
-  for (const auto &el : g_layout) {
+// Compiles g_layout into g_overlay for the current theme and DPI: text
+// extents measured, group box borders cut into pieces around their titles,
+// one cached border brush. Called whenever any of those change.
+void CompileOverlay() {
+  g_overlay.Clear();
+  if (g_overlayBrush)
+    DeleteObject(g_overlayBrush);
+  g_overlayBrush = CreateSolidBrush(g_textColor);
+
+  HDC hdc = GetDC(g_hDlg);
+  HFONT hOld = (HFONT)SelectObject(hdc, GetStockObject(DEFAULT_GUI_FONT));
+  for (const LayoutElement &el : g_layout) {
+    const DirtyRect r = {el.r.left, el.r.top, el.r.right, el.r.bottom};
+    SIZE size = {0, 0};
+    if (!el.text.empty())
+      GetTextExtentPoint32W(hdc, el.text.c_str(), (int)el.text.length(),
+                            &size);
     if (el.isGroup) {
-      // Draw Title (Inset slightly)
-      if (!el.text.empty()) {
-        RECT rText = el.r;
-        rText.left += 10;
-        rText.top -= 7;
-
-        // Measure text exact size
-        SIZE size;
-        GetTextExtentPoint32W(hdc, el.text.c_str(), (int)el.text.length(),
-                              &size);
-        rText.right = rText.left + size.cx;
-        rText.bottom = rText.top + size.cy;
-
-        // Clip out the text area so FrameRect doesn't draw through it
-        SaveDC(hdc);
-        ExcludeClipRect(hdc, rText.left, rText.top, rText.right, rText.bottom);
-
-        // Draw Box
-        HBRUSH borderBrush = CreateSolidBrush(g_textColor);
-        FrameRect(hdc, &el.r, borderBrush);
-        DeleteObject(borderBrush);
-
-        RestoreDC(hdc, -1); // Restore clip region
-
-        // NOW Draw Text
-        TextOutW(hdc, rText.left, rText.top, el.text.c_str(),
-                 (int)el.text.length());
-      } else {
-        // No text, just box
-        HBRUSH borderBrush = CreateSolidBrush(g_textColor);
-        FrameRect(hdc, &el.r, borderBrush);
-        DeleteObject(borderBrush);
-      }
+      // Title inset on the top edge, in a gap of the border
+      const DirtyRect title = {r.left + 10, r.top - 7, r.left + 10 + size.cx,
+                               r.top - 7 + size.cy};
+      g_overlay.AddFrame(r, 0, el.text.empty() ? NULL : &title);
+      g_overlay.AddText(title, 0, el.text.c_str(), el.text.length());
     } else {
-      // Draw Label
-      // Check if it has text (we filtered empty ones usually)
-      if (!el.text.empty()) {
-        // Vertically center? Statics usually align top-left.
-        TextOutW(hdc, el.r.left, el.r.top, el.text.c_str(),
-                 (int)el.text.length());
-      }
+      const DirtyRect text = {r.left, r.top, r.left + size.cx,
+                              r.top + size.cy};
+      g_overlay.AddText(text, 0, el.text.c_str(), el.text.length());
     }
   }
+  SelectObject(hdc, hOld);
+  ReleaseDC(g_hDlg, hdc);
+  g_overlay.Build();
+}
+
+// Replays the part of g_overlay under `rects` (the update region, which
+// also clips `hdc`).
+void DrawUIOverlay(HDC hdc, const std::vector<RECT> &rects) {
+  static std::vector<DirtyRect> area;
+  static std::vector<uint32_t> items;
+  area.clear();
+  for (const RECT &r : rects)
+    area.push_back({r.left, r.top, r.right, r.bottom});
+  g_overlay.Query(area.data(), area.size(), items);
+  if (items.empty())
+    return;
 
+  SetBkMode(hdc, TRANSPARENT);
+  SetTextColor(hdc, g_textColor);
+  HFONT hOld = (HFONT)SelectObject(hdc, GetStockObject(DEFAULT_GUI_FONT));
+  for (uint32_t i : items) {
+    const DisplayItem &item = g_overlay.Item(i);
+    if (item.op == DisplayOp::Fill) {
+      const RECT rc = {item.bounds.left, item.bounds.top, item.bounds.right,
+                       item.bounds.bottom};
+      FillRect(hdc, &rc, g_overlayBrush);
+    } else {
+      TextOutW(hdc, item.bounds.left, item.bounds.top, g_overlay.Text(item),
+               (int)item.length);
+    }
+  }
   SelectObject(hdc, hOld);
 }
 
@@ -433,17 +558,48 @@ INT_PTR CALLBACK DialogProc(HWND hDlg, UINT uMsg, WPARAM wParam,
   switch (uMsg) {
   case WM_INITDIALOG: {
     g_hDlg = hDlg;
+    g_updateRgn = CreateRectRgn(0, 0, 0, 0); // Before anything can paint
     // Load settings and apply to UI
-    ClickSettings s = LoadSettings();
+    g_settings.Load();
+    ClickSettings s = g_settings.Get();
     SetUIFromSettings(s);
 
+    if (s.controlServer) {
+      std::string error;
+      g_control.reset(new ControlServer(g_clicker, s));
+      if (!g_control->Start(DefaultControlEndpoint(), error)) {
+        OutputDebugStringA(("AutoClicker: " + error + "\n").c_str());
+        g_control.reset();
+      }
+    }
+
+    // Theme changes repaint from here, whoever made them.
+    g_settings.AddListener(
+        [](const ClickSettings &oldS, const ClickSettings &newS) {
+          if (oldS.themeIndex != newS.themeIndex)
+            UpdateTheme(newS.themeIndex);
+          if (oldS.frameRateHz != newS.frameRateHz)
+            g_render.SetRate(newS.frameRateHz);
+        });
+
     // Init Theme and Layout
-    srand((unsigned int)time(NULL));
-    InitTheme(s.themeIndex);
+    {
+      // Next to the executable, where the build puts it
+      char exe[MAX_PATH];
+      std::string path = "themes.bin";
+      const DWORD n = GetModuleFileNameA(NULL, exe, MAX_PATH);
+      if (n > 0 && n < MAX_PATH) {
+        path = exe;
+        path = path.substr(0, path.find_last_of("\\/") + 1) + "themes.bin";
+      }
+      g_themes.Load(path);
+    }
+    g_themes.Watch([] { PostMessage(g_hDlg, WM_APP_THEMES, 0, 0); });
     UpdateTheme(s.themeIndex);
 
     // Scan and hide default controls for replication
     ScanLayout();
+    CompileOverlay();
 
     // Clear text from checkboxes... NO, we want them visible and OPAQUE now.
     // In Hybrid mode, interactive controls draw themselves.
@@ -453,12 +609,23 @@ INT_PTR CALLBACK DialogProc(HWND hDlg, UINT uMsg, WPARAM wParam,
     SendDlgItemMessage(hDlg, IDC_HOTKEY_FIELD, HKM_SETHOTKEY,
                        MAKEWORD(s.hotkeyVk, s.hotkeyMod), 0);
 
-    // Register Hotkey
-    RegisterHotKey(hDlg, HK_START_STOP, GetWinModFromCommCtrl(s.hotkeyMod),
-                   s.hotkeyVk);
+    // Hotkeys: the listener thread, else registered with the dialog
+    g_hotkeyJob = g_hotkeys.AddJob(g_clicker, GetSettingsFromUI(),
+                                   GetHotkeys(s));
+    g_hotkeyThread = g_hotkeys.Start([](HotkeyListener::JobId, bool) {
+      PostMessage(g_hDlg, WM_APP_TOGGLED, 0, 0);
+    });
+    if (!g_hotkeyThread)
+      RegisterHotkeys(s);
 
-    // Timer for updating click count and animation
+    // Timer for updating the click count
     SetTimer(hDlg, 1, 33, NULL);
+
+    // Animation
+    RECT client;
+    GetClientRect(hDlg, &client);
+    g_render.SetSize(client.right, client.bottom);
+    g_render.Start(s.frameRateHz, ComposeFrame, OnFrameReady);
     UpdateUIState();
     return TRUE;
   }
@@ -478,25 +645,27 @@ INT_PTR CALLBACK DialogProc(HWND hDlg, UINT uMsg, WPARAM wParam,
   }
 
   case WM_PAINT: {
+    // Only the update region is rendered and copied; the timer invalidates
+    // just what the animation touched. Must be read before BeginPaint
+    // validates it.
+    GetUpdateRgn(hDlg, g_updateRgn, FALSE);
     PAINTSTRUCT ps;
     HDC hdc = BeginPaint(hDlg, &ps);
     RECT r;
     GetClientRect(hDlg, &r);
+    EnsureBackBuffer(hdc, r.right, r.bottom);
 
-    // Manual Double Buffering (Restored)
-    HDC memDC = CreateCompatibleDC(hdc);
-    HBITMAP hBM = CreateCompatibleBitmap(hdc, r.right, r.bottom);
-    HBITMAP hOld = (HBITMAP)SelectObject(memDC, hBM);
+    const std::vector<RECT> &rects = GetRegionRects(g_updateRgn);
+    DrawThemeBackground(rects);
+    SelectClipRgn(g_backDC, g_updateRgn);
+    DrawUIOverlay(g_backDC, rects);
+    SelectClipRgn(g_backDC, NULL);
 
-    ClickSettings s = LoadSettings();
-    DrawThemeBackground(memDC, r, s.themeIndex);
-    DrawUIOverlay(memDC);
-
-    BitBlt(hdc, 0, 0, r.right, r.bottom, memDC, 0, 0, SRCCOPY);
-
-    SelectObject(memDC, hOld);
-    DeleteObject(hBM);
-    DeleteDC(memDC);
+    // hdc is clipped to the update region, so only that is pushed.
+    BitBlt(hdc, ps.rcPaint.left, ps.rcPaint.top,
+           ps.rcPaint.right - ps.rcPaint.left,
+           ps.rcPaint.bottom - ps.rcPaint.top, g_backDC, ps.rcPaint.left,
+           ps.rcPaint.top, SRCCOPY);
 
     EndPaint(hDlg, &ps);
     return 0;
@@ -510,24 +679,35 @@ INT_PTR CALLBACK DialogProc(HWND hDlg, UINT uMsg, WPARAM wParam,
       break;
 
     case IDC_BTN_THEME: {
-      ClickSettings s = GetSettingsFromUI();
-      // We need to know current theme index.
-      // Since GetSettingsFromUI doesn't read it from UI (it's hidden state),
-      // we must load it or store it.
-      // Let's use a static variable or just rely on LoadSettings since we
-      // save on exit? No, we haven't saved yet. Let's adding themeIndex to
-      // GetSettingsFromUI is hard because it's not a control. Hack: Load,
-      // increment, Save, Update.
-      ClickSettings current = LoadSettings();
+      // The theme index is hidden state, so it lives only in the store. The
+      // listener registered in WM_INITDIALOG applies it.
+      ClickSettings current = g_settings.Get();
       current.themeIndex++;
-      InitTheme(current.themeIndex); // Ensure initialized if switching to it
-      SaveSettings(current);         // Save immediately
-      UpdateTheme(current.themeIndex);
+      g_settings.Set(current);
     } break;
 
     case IDC_RADIO_CURRENT:
     case IDC_RADIO_FIXED:
       UpdateUIState();
+      ApplyLiveSettings();
+      break;
+
+    case IDC_RADIO_LEFT:
+    case IDC_RADIO_RIGHT:
+      ApplyLiveSettings();
+      break;
+
+    case IDC_EDIT_INTERVAL:
+    case IDC_EDIT_X:
+    case IDC_EDIT_Y:
+      if (HIWORD(wParam) == EN_KILLFOCUS)
+        ApplyLiveSettings();
+      else if (HIWORD(wParam) == EN_CHANGE)
+        ResolveHotkeySettings(); // What a hotkey would start with now
+      break;
+
+    case IDOK: // Enter in an edit
+      ApplyLiveSettings();
       break;
 
     case IDC_BTN_SETHOTKEY: {
@@ -537,41 +717,19 @@ INT_PTR CALLBACK DialogProc(HWND hDlg, UINT uMsg, WPARAM wParam,
       int vk = LOBYTE(LOWORD(hk));
       int mod = HIBYTE(LOWORD(hk)); // This returns HOTKEYF_* flags
 
-      // Validating mod flags for RegisterHotKey
-      // HKM_GETHOTKEY returns HOTKEYF_SHIFT (0x01), HOTKEYF_CONTROL (0x02),
-      // HOTKEYF_ALT (0x04) RegisterHotKey expects MOD_SHIFT (0x04),
-      // MOD_CONTROL (0x02), MOD_SHIFT (0x04) Wait, Windows API is confusing
-      // here. CommCtrl.h: HOTKEYF_SHIFT   0x01 HOTKEYF_CONTROL 0x02
-      // HOTKEYF_ALT 0x04
-      //
-      // WinUser.h:
-      // MOD_ALT      0x0001
-      // MOD_CONTROL  0x0002
-      // MOD_SHIFT    0x0004
-      //
-      // So they are SWAPPED. We need to convert.
-
-      UINT fsModifiers = GetWinModFromCommCtrl(mod);
+      // HKM_GETHOTKEY returns HOTKEYF_* flags (Shift 0x01, Alt 0x04), which
+      // the listener takes as they are; RegisterHotKey's MOD_* flags have
+      // Shift and Alt swapped and are converted by GetWinModFromCommCtrl.
 
       // Update Settings
-      ClickSettings s = LoadSettings(); // Load to preserve other settings
-
-      // Store the COMMCTRL modifiers for display/control, but we might need
-      // logic for RegisterHotKey Let's store what we get from HKM_GETHOTKEY,
-      // and convert when registering. ACTUALLY, checking AutoClicker.h, I
-      // just added `hotkeyVk` and `hotkeyMod`. Let's decide `hotkeyMod`
-      // stores the COMMCTRL flags (for easy set back to control).
+      ClickSettings s = g_settings.Get(); // Preserve other settings
 
       s.hotkeyVk = vk;
       s.hotkeyMod = mod;
-      SaveSettings(s);
+      g_settings.Set(s);
 
-      // Re-register
-      UnregisterHotKey(hDlg, HK_START_STOP);
-      if (!RegisterHotKey(hDlg, HK_START_STOP, fsModifiers, vk)) {
-        MessageBox(hDlg, L"Failed to register hotkey!", L"Error",
-                   MB_OK | MB_ICONERROR);
-      }
+      RegisterHotkeys(s);
+      ResolveHotkeySettings();
 
       UpdateUIState();
 
@@ -587,8 +745,12 @@ INT_PTR CALLBACK DialogProc(HWND hDlg, UINT uMsg, WPARAM wParam,
     }
     break;
 
-  case WM_HOTKEY:
-    if (wParam == HK_START_STOP) {
+  case WM_APP_TOGGLED: // The hotkey thread started or stopped the clicker
+    UpdateUIState();
+    break;
+
+  case WM_HOTKEY: // Only without the hotkey thread
+    if (wParam == HK_START_STOP || wParam == HK_START_STOP_ALT) {
       g_clicker.Toggle(GetSettingsFromUI());
       UpdateUIState();
     }
@@ -597,22 +759,28 @@ INT_PTR CALLBACK DialogProc(HWND hDlg, UINT uMsg, WPARAM wParam,
   case WM_TIMER:
     if (wParam == 1) {
       UpdateClickCount();
-
-      // Animation update
-      ClickSettings s = LoadSettings();
-      if (s.themeIndex % 6 == 5 || s.themeIndex % 6 == 2) {
-        RECT r;
-        GetClientRect(hDlg, &r);
-        UpdateAnimation(s.themeIndex, r.right, r.bottom);
-        InvalidateRect(hDlg, NULL,
-                       FALSE); // FALSE to not erase background (flicker
-                               // redudancy, since we handle Erase)
-        // Actually with WS_EX_COMPOSITED, InvalidateRect(..., FALSE) +
-        // WM_ERASEBKGND handling is good.
-      }
+      if (g_clicker.IsRunning() != g_shownRunning)
+        UpdateUIState();
     }
     break;
 
+  case WM_APP_PRESENT:
+    // FALSE invalidation: we never erase, WM_PAINT repaints the region.
+    PresentFrame();
+    return TRUE;
+
+  case WM_SIZE:
+    g_render.SetSize(LOWORD(lParam), HIWORD(lParam));
+    break;
+
+  case WM_DPICHANGED:
+    UpdateTheme(g_settings.Get().themeIndex); // Re-rasterizes the glyphs
+    break;
+
+  case WM_APP_THEMES: // themes.bin was replaced
+    UpdateTheme(g_settings.Get().themeIndex);
+    break;
+
   case WM_CTLCOLORDLG:
     return (INT_PTR)GetStockObject(
         NULL_BRUSH); // Return hollow brush for dialog background
@@ -622,15 +790,18 @@ INT_PTR CALLBACK DialogProc(HWND hDlg, UINT uMsg, WPARAM wParam,
     return TRUE;
 
   case WM_DESTROY:
+    g_render.Stop();
+    g_hotkeys.Stop();
+    g_themes.StopWatching();
     UnregisterHotKey(hDlg, HK_START_STOP);
+    UnregisterHotKey(hDlg, HK_START_STOP_ALT);
+    g_control.reset(); // Before Stop(), so no client starts it again
     g_clicker.Stop();
-    {
-      ClickSettings s = GetSettingsFromUI();
-      // Preserve theme index
-      ClickSettings saved = LoadSettings();
-      s.themeIndex = saved.themeIndex;
-      SaveSettings(s);
-    }
+    g_settings.Set(GetSettingsFromUI()); // Theme index is preserved by Get()
+    g_settings.Shutdown();               // Final synchronous flush
+    FreeBackBuffer();
+    DeleteObject(g_overlayBrush);
+    DeleteObject(g_updateRgn);
     break;
   }
   return FALSE;